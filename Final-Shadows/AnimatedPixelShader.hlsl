@@ -1,11 +1,15 @@
 #include "ShaderIncludes.hlsli"
 
-cbuffer ExternalData : register(b0)
+cbuffer PerFrame : register(b0)
 {
-	float4 colorTint;
 	float totalTime;
 }
 
+cbuffer PerMaterial : register(b1)
+{
+	float4 colorTint;
+}
+
 
 // The entry point (main method) for our pixel shader
 float4 main(VertexToPixel input) : SV_TARGET
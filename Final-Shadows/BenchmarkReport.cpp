@@ -0,0 +1,190 @@
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "BenchmarkReport.h"
+
+void BenchmarkReport::Add(const std::string& name, int scale, float ms)
+{
+	BenchmarkRecord record = { name, scale, ms };
+	records.push_back(record);
+}
+
+const BenchmarkRecord* BenchmarkReport::Find(const std::string& name, int scale) const
+{
+	for (auto& record : records)
+	{
+		if (record.name == name && record.scale == scale)
+			return &record;
+	}
+	return 0;
+}
+
+std::vector<BenchmarkRegression> BenchmarkReport::Compare(const BenchmarkReport& baseline, float threshold, float minMs) const
+{
+	std::vector<BenchmarkRegression> regressions;
+	for (auto& record : records)
+	{
+		const BenchmarkRecord* before = baseline.Find(record.name, record.scale);
+		if (!before)
+			continue;
+
+		float slower = record.ms - before->ms;
+		if (slower > before->ms * threshold && slower > minMs)
+		{
+			BenchmarkRegression regression = { record.name, record.scale, before->ms, record.ms };
+			regressions.push_back(regression);
+		}
+	}
+	return regressions;
+}
+
+// --------------------------------------------------------
+// One record per line, which keeps the files easy to diff,
+// followed by the regressions when there are any
+// - Names are written as they are, so they shouldn't
+//   contain quotes or backslashes
+// --------------------------------------------------------
+std::string BenchmarkReport::WriteJson(const std::vector<BenchmarkRegression>& regressions) const
+{
+	std::ostringstream out;
+	out.setf(std::ios::fixed);
+	out.precision(4);
+
+	out << "{\n\t\"results\": [\n";
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		out << "\t\t{ \"name\": \"" << records[i].name << "\", \"scale\": " << records[i].scale
+			<< ", \"ms\": " << records[i].ms << " }" << (i + 1 < records.size() ? "," : "") << "\n";
+	}
+	out << "\t]";
+
+	if (!regressions.empty())
+	{
+		out << ",\n\t\"regressions\": [\n";
+		for (size_t i = 0; i < regressions.size(); i++)
+		{
+			out << "\t\t{ \"name\": \"" << regressions[i].name << "\", \"scale\": " << regressions[i].scale
+				<< ", \"baselineMs\": " << regressions[i].baselineMs << ", \"ms\": " << regressions[i].ms
+				<< " }" << (i + 1 < regressions.size() ? "," : "") << "\n";
+		}
+		out << "\t]";
+	}
+
+	out << "\n}\n";
+	return out.str();
+}
+
+// --------------------------------------------------------
+// Finds the value after "field": starting from position at
+// and before position end, and moves at past it
+// --------------------------------------------------------
+static bool FindField(const std::string& json, const char* field, size_t end, size_t* at, size_t* valueStart)
+{
+	size_t found = json.find(std::string("\"") + field + "\"", *at);
+	if (found == std::string::npos || found >= end)
+		return false;
+
+	size_t colon = json.find(':', found);
+	if (colon == std::string::npos)
+		return false;
+
+	*valueStart = json.find_first_not_of(" \t\r\n", colon + 1);
+	*at = colon + 1;
+	return *valueStart != std::string::npos;
+}
+
+bool BenchmarkReport::ReadJson(const std::string& json)
+{
+	if (json.find("\"results\"") == std::string::npos)
+		return false;
+
+	// Regressions come after the results, and have names too
+	size_t end = json.find("\"regressions\"");
+
+	std::vector<BenchmarkRecord> read;
+	size_t at = 0;
+	size_t value;
+	while (FindField(json, "name", end, &at, &value))
+	{
+		BenchmarkRecord record;
+		size_t nameEnd = json.find('"', value + 1);
+		if (json[value] != '"' || nameEnd == std::string::npos)
+			return false;
+		record.name = json.substr(value + 1, nameEnd - value - 1);
+		at = nameEnd + 1;
+
+		if (!FindField(json, "scale", end, &at, &value))
+			return false;
+		record.scale = (int)strtol(json.c_str() + value, 0, 10);
+
+		if (!FindField(json, "ms", end, &at, &value))
+			return false;
+		record.ms = (float)strtod(json.c_str() + value, 0);
+
+		read.push_back(record);
+	}
+
+	records.swap(read);
+	return true;
+}
+
+bool BenchmarkReport::Save(const std::string& file, const std::vector<BenchmarkRegression>& regressions) const
+{
+	std::ofstream stream(file);
+	if (!stream.is_open())
+		return false;
+
+	stream << WriteJson(regressions);
+	return stream.good();
+}
+
+bool BenchmarkReport::Load(const std::string& file)
+{
+	std::ifstream stream(file);
+	if (!stream.is_open())
+		return false;
+
+	std::stringstream contents;
+	contents << stream.rdbuf();
+	return ReadJson(contents.str());
+}
+
+// --------------------------------------------------------
+// Saves the run, and compares it against a baseline when one
+// is named, returning the code to exit with
+// - A run that couldn't be saved fails whatever the baseline
+//   says, since there's nothing left to look at afterwards
+// - Otherwise problems with the baseline itself are reported
+//   ahead of regressions, as there can't be any without one
+// --------------------------------------------------------
+BenchmarkResult BenchmarkReport::SaveAndCompare(
+	const std::string& outputFile,
+	const std::string& baselineFile,
+	float threshold,
+	std::vector<BenchmarkRegression>* regressions) const
+{
+	regressions->clear();
+
+	BenchmarkResult result = BENCHMARK_PASSED;
+	BenchmarkReport baseline;
+	if (!baselineFile.empty())
+	{
+		if (!std::ifstream(baselineFile).is_open())
+			result = BENCHMARK_BASELINE_MISSING;
+		else if (!baseline.Load(baselineFile))
+			result = BENCHMARK_BASELINE_UNREADABLE;
+		else if (baseline.GetRecords().empty())
+			result = BENCHMARK_BASELINE_EMPTY;
+		else
+		{
+			*regressions = Compare(baseline, threshold);
+			if (!regressions->empty())
+				result = BENCHMARK_REGRESSED;
+		}
+	}
+
+	if (!Save(outputFile, *regressions))
+		return BENCHMARK_SAVE_FAILED;
+
+	return result;
+}
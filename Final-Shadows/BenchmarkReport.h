@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// One timed run of a benchmark at one scale, such as the
+// number of entities or draws it was run over
+// --------------------------------------------------------
+struct BenchmarkRecord
+{
+	std::string name;
+	int scale;
+	float ms;
+};
+
+// --------------------------------------------------------
+// A record that got slower than its baseline by more than
+// the allowed amount
+// --------------------------------------------------------
+struct BenchmarkRegression
+{
+	std::string name;
+	int scale;
+	float baselineMs;
+	float ms;
+};
+
+// --------------------------------------------------------
+// Exit codes for automated benchmark runs, from checking a
+// run against a baseline
+// - Nothing to compare against counts as passing, but a
+//   baseline that was asked for and can't be used doesn't
+// --------------------------------------------------------
+enum BenchmarkResult
+{
+	BENCHMARK_PASSED = 0,
+	BENCHMARK_REGRESSED = 1,
+	BENCHMARK_SAVE_FAILED = 2,
+	BENCHMARK_BASELINE_MISSING = 3,
+	BENCHMARK_BASELINE_UNREADABLE = 4,
+	BENCHMARK_BASELINE_EMPTY = 5
+};
+
+// --------------------------------------------------------
+// The results of a benchmark run, which can be saved as JSON
+// and compared against an earlier run's
+//
+// Records are matched up by name and scale, and anything only
+// in one of the two runs is left out of the comparison. Very
+// short times are mostly noise, so a record only counts as a
+// regression once it's slower by both the threshold and a
+// minimum number of milliseconds.
+//
+// Regressions can be saved along with the results, so they
+// can be seen without a console. Loading only needs to
+// understand files written by Save(), so it reads the fields
+// it expects rather than any JSON, and skips the regressions.
+// Nothing here needs Direct3D
+// --------------------------------------------------------
+class BenchmarkReport
+{
+public:
+	void Add(const std::string& name, int scale, float ms);
+	void Clear() { records.clear(); }
+
+	const std::vector<BenchmarkRecord>& GetRecords() const { return records; }
+	const BenchmarkRecord* Find(const std::string& name, int scale) const;
+
+	// A threshold of 0.1 allows each record to be 10% slower
+	std::vector<BenchmarkRegression> Compare(const BenchmarkReport& baseline, float threshold, float minMs = 0.05f) const;
+
+	std::string WriteJson(const std::vector<BenchmarkRegression>& regressions = std::vector<BenchmarkRegression>()) const;
+	bool ReadJson(const std::string& json);
+
+	bool Save(const std::string& file, const std::vector<BenchmarkRegression>& regressions = std::vector<BenchmarkRegression>()) const;
+	bool Load(const std::string& file);
+
+	// Compares against the baseline file, if one is named, then
+	// saves this run along with whatever regressed
+	BenchmarkResult SaveAndCompare(
+		const std::string& outputFile,
+		const std::string& baselineFile,
+		float threshold,
+		std::vector<BenchmarkRegression>* regressions) const;
+
+private:
+	std::vector<BenchmarkRecord> records;
+};
@@ -0,0 +1,462 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include "Benchmarks.h"
+
+// --------------------------------------------------------
+// Sets each named variable once per draw, first through the
+// string setters and then through handles looked up beforehand,
+// uploading whatever changed after each draw's variables
+//
+// The constants are packed just as a SimpleShader with this
+// reflection would pack them, but uploaded to a stand-in device
+// that only copies them, so the timings are purely CPU overhead
+// --------------------------------------------------------
+ShaderVariableBenchmark Benchmarks::ShaderVariables(
+	const ShaderReflection& shader,
+	const std::vector<std::string>& names,
+	int draws)
+{
+	ShaderVariableBenchmark result = {};
+	result.variables = (int)names.size();
+	result.draws = draws;
+
+	ShaderConstants constants;
+	constants.Init(shader);
+	CopyingConstantBufferDevice device;
+
+	// Handles are looked up once, outside of the timed loop
+	std::vector<SimpleShaderVariableHandle> handles;
+	std::vector<unsigned int> sizes;
+	unsigned int largest = 0;
+	for (auto& name : names)
+	{
+		SimpleShaderVariableHandle handle = constants.GetVariableHandle(name);
+		handles.push_back(handle);
+		sizes.push_back(handle.Size);
+		largest = handle.Size > largest ? handle.Size : largest;
+	}
+
+	std::vector<unsigned char> data(largest > 0 ? largest : 1, 0);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int d = 0; d < draws; d++)
+	{
+		data[0] = (unsigned char)d;
+		for (int v = 0; v < (int)names.size(); v++)
+			constants.SetData(names[v], data.data(), sizes[v]);
+		constants.UploadDirty(&device);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	result.byNameMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int d = 0; d < draws; d++)
+	{
+		data[0] = (unsigned char)d;
+		for (int v = 0; v < (int)handles.size(); v++)
+			constants.SetData(handles[v], data.data(), sizes[v]);
+		constants.UploadDirty(&device);
+	}
+	end = std::chrono::high_resolution_clock::now();
+	result.byHandleMs = std::chrono::duration<float, std::milli>(end - start).count();
+	result.uploads = device.GetUploadCount();
+
+	return result;
+}
+
+// --------------------------------------------------------
+// Allocates a mix of typical constant buffer sizes for each
+// draw, ending a frame after every drawsPerFrame allocations
+// and retiring frames once they're framesInFlight old, as if
+// the GPU were running that far behind
+// --------------------------------------------------------
+RingAllocatorBenchmark Benchmarks::RingAllocations(
+	size_t ringSize,
+	int frames,
+	int drawsPerFrame,
+	int framesInFlight)
+{
+	RingAllocatorBenchmark result = {};
+	result.frames = frames;
+	result.drawsPerFrame = drawsPerFrame;
+
+	// Per object, per material and occasional larger per frame buffers
+	const size_t sizes[] = { 128, 48, 128, 32, 2048 };
+	const int sizeCount = sizeof(sizes) / sizeof(sizes[0]);
+
+	RingAllocator ring(ringSize, 256);
+	size_t offset = 0;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int f = 0; f < frames; f++)
+	{
+		for (int d = 0; d < drawsPerFrame; d++)
+		{
+			if (ring.Allocate(sizes[d % sizeCount], &offset))
+				result.allocations++;
+			else
+				result.failures++;
+		}
+
+		ring.EndFrame(f);
+		if (f >= framesInFlight)
+			ring.Retire(f - framesInFlight);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	result.ms = std::chrono::duration<float, std::milli>(end - start).count();
+	result.wraps = ring.GetWrapCount();
+
+	return result;
+}
+
+// --------------------------------------------------------
+// Sorts packets with keys spread over a scene's worth of
+// shaders, materials and meshes at random depths
+// - Both sorts are given the same unsorted packets
+// --------------------------------------------------------
+RenderQueueSortBenchmark Benchmarks::RenderQueueSort(int packets)
+{
+	RenderQueueSortBenchmark result = {};
+	result.packets = packets;
+
+	// Fixed seed so every run sorts the same keys
+	unsigned int state = 12345;
+	auto next = [&state]()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	};
+
+	std::vector<RenderPacket> unsorted(packets);
+	for (int i = 0; i < packets; i++)
+	{
+		unsorted[i].entity = i;
+		unsorted[i].key =
+			((unsigned long long)(next() % 8) << RenderQueue::ShaderShift) |
+			((unsigned long long)(next() % 64) << RenderQueue::MaterialShift) |
+			((unsigned long long)(next() % 256) << RenderQueue::MeshShift) |
+			(next() & 0xFFFFFF);
+	}
+
+	std::vector<RenderPacket> sorted = unsorted;
+	std::vector<RenderPacket> scratch;
+	auto start = std::chrono::high_resolution_clock::now();
+	RenderQueue::RadixSort(&sorted, &scratch);
+	auto end = std::chrono::high_resolution_clock::now();
+	result.radixMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+	sorted = unsorted;
+	start = std::chrono::high_resolution_clock::now();
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[](const RenderPacket& a, const RenderPacket& b) { return a.key < b.key; });
+	end = std::chrono::high_resolution_clock::now();
+	result.stdSortMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+	return result;
+}
+
+// --------------------------------------------------------
+// Replays a stream over and over, first just decoding it, then
+// into a counting backend and then into another stream
+// - None of these reach a context, so the difference between
+//   them and a real replay is the driver's share of the work
+// --------------------------------------------------------
+CommandReplayBenchmark Benchmarks::CommandReplay(const CommandStream& stream, int repeats)
+{
+	CommandReplayBenchmark result = {};
+	result.commands = stream.GetCommandCount();
+	result.bytes = stream.GetByteCount();
+	result.repeats = repeats;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++)
+		stream.Replay(0);
+	auto end = std::chrono::high_resolution_clock::now();
+	result.decodeMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+	CommandStatsBackend stats;
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++)
+	{
+		stats.Reset();
+		stream.Replay(&stats);
+	}
+	end = std::chrono::high_resolution_clock::now();
+	result.statsMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+	std::shared_ptr<CommandStream> copy = std::make_shared<CommandStream>();
+	CommandStreamWriter writer(copy);
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < repeats; r++)
+	{
+		copy->Clear();
+		stream.Replay(&writer);
+	}
+	end = std::chrono::high_resolution_clock::now();
+	result.encodeMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+	return result;
+}
+// --------------------------------------------------------
+// Opens and closes markers around a counter, first without
+// any, then with recording switched off, then on
+// - Markers are used directly rather than through PROFILE_SCOPE,
+//   so they're measured even when the macro compiles them out
+// - The recorded markers are thrown away afterwards, so they
+//   don't flood this frame
+// --------------------------------------------------------
+CpuProfilerBenchmark Benchmarks::CpuProfilerMarkers(int markers)
+{
+	CpuProfilerBenchmark result = {};
+	result.markers = markers;
+
+	bool wasEnabled = CpuProfiler::Enabled;
+	volatile int counter = 0;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int m = 0; m < markers; m++)
+		counter = counter + 1;
+	auto end = std::chrono::high_resolution_clock::now();
+	result.emptyMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+	CpuProfiler::Enabled = false;
+	start = std::chrono::high_resolution_clock::now();
+	for (int m = 0; m < markers; m++)
+	{
+		CpuProfileScope marker("Benchmark marker");
+		counter = counter + 1;
+	}
+	end = std::chrono::high_resolution_clock::now();
+	result.disabledMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+	CpuProfiler::Enabled = true;
+	start = std::chrono::high_resolution_clock::now();
+	for (int m = 0; m < markers; m++)
+	{
+		CpuProfileScope marker("Benchmark marker");
+		counter = counter + 1;
+	}
+	end = std::chrono::high_resolution_clock::now();
+	result.enabledMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+	CpuProfiler::Enabled = wasEnabled;
+	CpuProfiler::DiscardPending();
+	return result;
+}
+
+// --------------------------------------------------------
+// Moves and turns each transform a little, then asks for the
+// matrices a draw would use, which rebuilds them
+// - The transforms are made before timing starts
+// --------------------------------------------------------
+TransformUpdateBenchmark Benchmarks::TransformUpdates(int transforms)
+{
+	TransformUpdateBenchmark result = {};
+	result.transforms = transforms;
+
+	std::vector<Transform> scene(transforms);
+	for (int t = 0; t < transforms; t++)
+		scene[t].SetPosition((float)(t % 100), 0.0f, (float)(t / 100));
+
+	DirectX::XMFLOAT4X4 sink;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (auto& t : scene)
+	{
+		t.MoveAbsolute(0.01f, 0.0f, 0.0f);
+		t.Rotate(0.0f, 0.01f, 0.0f);
+		sink = t.GetWorldMatrix();
+		sink = t.GetWorldInverseTransposeMatrix();
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	result.ms = std::chrono::duration<float, std::milli>(end - start).count();
+
+	return result;
+}
+
+// --------------------------------------------------------
+// Moves the camera and rebuilds both of its matrices each
+// update, as a resize and a frame of movement would
+// - Camera::Update() isn't used, since it reads the input
+// --------------------------------------------------------
+CameraMatrixBenchmark Benchmarks::CameraMatrices(int updates)
+{
+	CameraMatrixBenchmark result = {};
+	result.updates = updates;
+
+	Camera camera(DirectX::XMFLOAT3(0.0f, 0.0f, -10.0f), DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int u = 0; u < updates; u++)
+	{
+		camera.GetTransform()->MoveRelative(0.0f, 0.0f, 0.001f);
+		camera.GetTransform()->Rotate(0.0f, 0.001f, 0.0f);
+		camera.UpdateViewMatrix();
+		camera.UpdateProjectionMatrix(16.0f / 9.0f);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	result.ms = std::chrono::duration<float, std::milli>(end - start).count();
+
+	return result;
+}
+
+// --------------------------------------------------------
+// A grid of quads in the XZ plane, split into two triangles
+// each, with a uv per position and a single shared normal
+// - Faces are written as triangles, as both parsers read them
+// --------------------------------------------------------
+std::string Benchmarks::MakeObjGrid(int triangles)
+{
+	int quads = (triangles + 1) / 2;
+	int columns = std::max(1, (int)std::ceil(std::sqrt((double)quads)));
+	int rows = std::max(1, (quads + columns - 1) / columns);
+
+	std::ostringstream obj;
+	for (int z = 0; z <= rows; z++)
+		for (int x = 0; x <= columns; x++)
+			obj << "v " << x << " 0 " << z << "\n";
+	for (int z = 0; z <= rows; z++)
+		for (int x = 0; x <= columns; x++)
+			obj << "vt " << (float)x / columns << " " << (float)z / rows << "\n";
+	obj << "vn 0 1 0\n";
+
+	// OBJ indices start at 1
+	auto corner = [columns](int x, int z) { return z * (columns + 1) + x + 1; };
+	auto write = [&obj](int a, int b, int c)
+	{
+		obj << "f " << a << "/" << a << "/1 " << b << "/" << b << "/1 " << c << "/" << c << "/1\n";
+	};
+
+	for (int t = 0; t < triangles; t++)
+	{
+		int quad = t / 2;
+		int x = quad % columns;
+		int z = quad / columns;
+		if (t % 2 == 0)
+			write(corner(x, z), corner(x, z + 1), corner(x + 1, z + 1));
+		else
+			write(corner(x, z), corner(x + 1, z + 1), corner(x + 1, z));
+	}
+
+	return obj.str();
+}
+
+// --------------------------------------------------------
+// Parses the text with both of the parsers Mesh can load
+// with, then works out tangents for the first one's vertices
+// - The text is read from memory, so disk speed doesn't count
+// --------------------------------------------------------
+ObjParseBenchmark Benchmarks::ObjParsing(const std::string& obj)
+{
+	ObjParseBenchmark result = {};
+	result.bytes = obj.size();
+
+	MeshData parsed;
+	std::istringstream parseStream(obj);
+	auto start = std::chrono::high_resolution_clock::now();
+	MeshImport::ParseObj(parseStream, &parsed);
+	auto end = std::chrono::high_resolution_clock::now();
+	result.parseMs = std::chrono::duration<float, std::milli>(end - start).count();
+	result.triangles = (int)parsed.indices.size() / 3;
+
+	MeshData tinyObjParsed;
+	std::istringstream tinyObjStream(obj);
+	start = std::chrono::high_resolution_clock::now();
+	MeshImport::ParseObjWithTinyObj(tinyObjStream, &tinyObjParsed);
+	end = std::chrono::high_resolution_clock::now();
+	result.tinyObjMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+	if (!parsed.indices.empty())
+	{
+		start = std::chrono::high_resolution_clock::now();
+		MeshImport::CalculateTangents(&parsed.vertices[0], (int)parsed.vertices.size(), &parsed.indices[0], (int)parsed.indices.size());
+		end = std::chrono::high_resolution_clock::now();
+		result.tangentsMs = std::chrono::duration<float, std::milli>(end - start).count();
+	}
+
+	return result;
+}
+
+// --------------------------------------------------------
+// Builds the matrices of every shadow map the lights would
+// need, going round them again until there are enough faces
+// - Lights are treated as if they all cast shadows
+// --------------------------------------------------------
+ShadowFaceBenchmark Benchmarks::ShadowFaces(const std::vector<Light>& lights, int faces)
+{
+	ShadowFaceBenchmark result = {};
+	if (lights.empty())
+		return result;
+
+	ShadowFaceMatrices sink;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t light = 0; result.faces < faces; light = (light + 1) % lights.size())
+	{
+		int count = LightMatrices::GetShadowFaceCount(lights[light]);
+		for (int face = 0; face < count && result.faces < faces; face++, result.faces++)
+			sink = LightMatrices::CalculateShadowFace(lights[light], face);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	result.ms = std::chrono::duration<float, std::milli>(end - start).count();
+
+	return result;
+}
+
+// --------------------------------------------------------
+// One of each type of light, pointing in different directions
+// --------------------------------------------------------
+static std::vector<Light> MakeBenchmarkLights()
+{
+	std::vector<Light> lights(3);
+	for (int i = 0; i < 3; i++)
+	{
+		lights[i].type = i;
+		lights[i].direction = DirectX::XMFLOAT3(1.0f, -1.0f, (float)i);
+		lights[i].position = DirectX::XMFLOAT3(0.0f, 5.0f, (float)i);
+		lights[i].range = 20.0f;
+		lights[i].spotFalloff = 25.0f;
+		lights[i].castsShadows = 1;
+	}
+	return lights;
+}
+
+// --------------------------------------------------------
+// Everything that scales with the size of the scene, at each
+// of the given sizes
+// - The ring allocator is only bookkeeping, so the ring can be
+//   sized to fit every frame in flight whatever the scale
+// --------------------------------------------------------
+void Benchmarks::Sweep(
+	BenchmarkReport* report,
+	const std::vector<int>& scales,
+	const ShaderReflection& shader,
+	const std::vector<std::string>& names)
+{
+	std::vector<Light> lights = MakeBenchmarkLights();
+
+	for (int scale : scales)
+	{
+		report->Add("Transform updates", scale, TransformUpdates(scale).ms);
+		report->Add("Camera matrices", scale, CameraMatrices(scale).ms);
+
+		ShaderVariableBenchmark variables = ShaderVariables(shader, names, scale);
+		report->Add("Shader variables by name", scale, variables.byNameMs);
+		report->Add("Shader variables by handle", scale, variables.byHandleMs);
+
+		report->Add("Render queue sort", scale, RenderQueueSort(scale).radixMs);
+
+		const int ringFrames = 10;
+		report->Add("Ring allocations x10 frames", scale, RingAllocations((size_t)scale * 1024 * 4, ringFrames, scale, 3).ms);
+
+		// A mesh of this many triangles
+		ObjParseBenchmark obj = ObjParsing(MakeObjGrid(scale));
+		report->Add("OBJ parse", scale, obj.parseMs);
+		report->Add("OBJ parse with tinyobjloader", scale, obj.tinyObjMs);
+		report->Add("Tangents", scale, obj.tangentsMs);
+
+		report->Add("Shadow face matrices", scale, ShadowFaces(lights, scale).ms);
+	}
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "ShaderConstants.h"
+#include "RingAllocator.h"
+#include "RenderQueue.h"
+#include "CommandStream.h"
+#include "CpuProfiler.h"
+#include "Camera.h"
+#include "MeshData.h"
+#include "LightMatrices.h"
+#include "BenchmarkReport.h"
+
+// --------------------------------------------------------
+// Time taken to set shader variables by name and upload them,
+// compared to setting the same variables through handles
+// --------------------------------------------------------
+struct ShaderVariableBenchmark
+{
+	int variables;		// Variables set per draw
+	int draws;
+	unsigned int uploads;	// Across both ways of setting them
+	float byNameMs;
+	float byHandleMs;
+};
+
+// --------------------------------------------------------
+// Time taken to sub-allocate per draw constant data from an
+// upload ring over a number of simulated frames
+// --------------------------------------------------------
+struct RingAllocatorBenchmark
+{
+	int frames;
+	int drawsPerFrame;
+	int allocations;		// Successful ones
+	int failures;			// Allocations that didn't fit while waiting on the GPU
+	unsigned int wraps;
+	float ms;
+};
+
+// --------------------------------------------------------
+// Time taken to sort render queue packets with the radix sort,
+// compared to a comparison sort of the same packets
+// --------------------------------------------------------
+struct RenderQueueSortBenchmark
+{
+	int packets;
+	float radixMs;
+	float stdSortMs;
+};
+
+// --------------------------------------------------------
+// Time taken to play back a captured frame's commands, with
+// nothing at the other end but the cost of reading them
+// --------------------------------------------------------
+struct CommandReplayBenchmark
+{
+	unsigned int commands;	// Per replay
+	size_t bytes;
+	int repeats;
+	float decodeMs;			// Reading the commands without calling anything
+	float statsMs;			// Calling a backend that only counts them
+	float encodeMs;			// Writing them into a new stream
+};
+
+// --------------------------------------------------------
+// Time taken to move every entity's transform and rebuild
+// the matrices drawing it needs
+// --------------------------------------------------------
+struct TransformUpdateBenchmark
+{
+	int transforms;
+	float ms;
+};
+
+// --------------------------------------------------------
+// Time taken to move a camera and rebuild its view and
+// projection matrices
+// --------------------------------------------------------
+struct CameraMatrixBenchmark
+{
+	int updates;
+	float ms;
+};
+
+// --------------------------------------------------------
+// Time taken to read the same OBJ text with each parser, and
+// to work out tangents for what was read
+// --------------------------------------------------------
+struct ObjParseBenchmark
+{
+	int triangles;
+	size_t bytes;			// Of OBJ text
+	float parseMs;			// Mesh's own parser
+	float tinyObjMs;
+	float tangentsMs;
+};
+
+// --------------------------------------------------------
+// Time taken to build the view and projection of a number
+// of shadow maps
+// --------------------------------------------------------
+struct ShadowFaceBenchmark
+{
+	int faces;
+	float ms;
+};
+
+// --------------------------------------------------------
+// Time taken by CPU profiler markers around an empty block,
+// both while recording and while switched off at runtime
+// --------------------------------------------------------
+struct CpuProfilerBenchmark
+{
+	int markers;
+	float emptyMs;			// The same loop with no markers
+	float disabledMs;
+	float enabledMs;
+};
+
+// --------------------------------------------------------
+// Timed workloads for comparing different ways of doing the
+// same CPU-side rendering work
+// - None of them need Direct3D, so they also build into the
+//   stand-alone benchmark on other platforms
+// --------------------------------------------------------
+namespace Benchmarks
+{
+	ShaderVariableBenchmark ShaderVariables(
+		const ShaderReflection& shader,
+		const std::vector<std::string>& names,
+		int draws);
+
+	RingAllocatorBenchmark RingAllocations(
+		size_t ringSize,
+		int frames,
+		int drawsPerFrame,
+		int framesInFlight);
+
+	RenderQueueSortBenchmark RenderQueueSort(int packets);
+
+	CommandReplayBenchmark CommandReplay(const CommandStream& stream, int repeats);
+
+	CpuProfilerBenchmark CpuProfilerMarkers(int markers);
+
+	TransformUpdateBenchmark TransformUpdates(int transforms);
+
+	CameraMatrixBenchmark CameraMatrices(int updates);
+
+	// OBJ text for a flat grid of the given number of triangles
+	std::string MakeObjGrid(int triangles);
+
+	ObjParseBenchmark ObjParsing(const std::string& obj);
+
+	ShadowFaceBenchmark ShadowFaces(const std::vector<Light>& lights, int faces);
+
+	// Runs each scalable benchmark at every scale, adding them to the report
+	void Sweep(
+		BenchmarkReport* report,
+		const std::vector<int>& scales,
+		const ShaderReflection& shader,
+		const std::vector<std::string>& names);
+}
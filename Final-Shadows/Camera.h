@@ -37,6 +37,7 @@ public:
 	void SetFarClip(float val);
 	void SetProjectionType(ProjectionType val);
 
+	// Keyboard and mouse controls, in CameraControls.cpp
 	void Update(float dt);
 
 private:
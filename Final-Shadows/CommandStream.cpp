@@ -0,0 +1,511 @@
+#include <cstring>
+#include <fstream>
+#include "CommandStream.h"
+
+// Identifies the file type and layout
+static const char CommandStreamMagic[4] = { 'C', 'M', 'D', 'S' };
+static const unsigned int CommandStreamVersion = 1;
+
+// --------------------------------------------------------
+// Fixed size start of a command stream file, followed by
+// dataSize bytes of commands
+// - Only the number of objects is kept, as their addresses
+//   mean nothing outside of the run that captured them
+// --------------------------------------------------------
+struct CommandStreamFileHeader
+{
+	char magic[4];
+	unsigned int version;
+	unsigned int commandCount;
+	unsigned int objectCount;
+	unsigned int dataSize;
+};
+
+CommandStream::CommandStream()
+	:
+	commandCount(0),
+	liveObjects(true)
+{
+}
+
+void CommandStream::Clear()
+{
+	data.clear();
+	commandCount = 0;
+	objects.clear();
+	objectIds.clear();
+	liveObjects = true;
+}
+
+// --------------------------------------------------------
+// Packs a command's arguments in the order its type reads them
+// back, skipping any the type doesn't use
+// --------------------------------------------------------
+void CommandStream::Write(const Command& command)
+{
+	if (command.type < 0 || command.type >= COMMAND_TYPE_COUNT)
+		return;
+
+	data.push_back((unsigned char)command.type);
+	commandCount++;
+
+	const unsigned int* v = command.values;
+	switch (command.type)
+	{
+	case COMMAND_INPUT_LAYOUT:
+	case COMMAND_VERTEX_SHADER:
+	case COMMAND_PIXEL_SHADER:
+		WriteObject(command.object);
+		break;
+
+	case COMMAND_PRIMITIVE_TOPOLOGY:
+		WriteUInt(v[0]);
+		break;
+
+	case COMMAND_VERTEX_BUFFER:
+		WriteUInt(v[0]);
+		WriteObject(command.object);
+		WriteUInt(v[1]);
+		WriteUInt(v[2]);
+		break;
+
+	case COMMAND_INDEX_BUFFER:
+		WriteObject(command.object);
+		WriteUInt(v[0]);
+		WriteUInt(v[1]);
+		break;
+
+	case COMMAND_CONSTANT_BUFFER:
+		WriteUInt(v[0]);
+		WriteUInt(v[1]);
+		WriteObject(command.object);
+		WriteUInt(v[2]);
+		WriteUInt(v[3]);
+		break;
+
+	case COMMAND_SHADER_RESOURCE:
+	case COMMAND_SAMPLER:
+		WriteUInt(v[0]);
+		WriteUInt(v[1]);
+		WriteObject(command.object);
+		break;
+
+	case COMMAND_UPDATE_BUFFER:
+		WriteObject(command.object);
+		WriteUInt(v[0]);
+		WriteBytes(command.data, v[0]);
+		break;
+
+	case COMMAND_DRAW_INDEXED:
+		WriteUInt(v[0]);
+		WriteUInt(v[1]);
+		WriteInt(command.baseVertex);
+		break;
+
+	case COMMAND_DRAW_INDEXED_INSTANCED:
+		WriteUInt(v[0]);
+		WriteUInt(v[1]);
+		WriteUInt(v[2]);
+		WriteInt(command.baseVertex);
+		WriteUInt(v[3]);
+		break;
+
+	case COMMAND_CLEAR_RENDER_TARGET:
+		WriteObject(command.object);
+		WriteFloats(command.floats, 4);
+		break;
+
+	case COMMAND_CLEAR_DEPTH:
+		WriteObject(command.object);
+		WriteFloats(command.floats, 1);
+		break;
+
+	case COMMAND_VIEWPORT:
+		WriteFloats(command.floats, 6);
+		break;
+
+	case COMMAND_RENDER_TARGETS:
+		WriteObject(command.object);
+		WriteObject(command.object2);
+		break;
+
+	default:
+		break;
+	}
+}
+
+// --------------------------------------------------------
+// Writes 7 bits at a time, low bits first, with the top bit
+// of each byte set when there's more to follow
+// --------------------------------------------------------
+void CommandStream::WriteUInt(unsigned int value)
+{
+	while (value >= 0x80)
+	{
+		data.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	data.push_back((unsigned char)value);
+}
+
+// --------------------------------------------------------
+// Interleaves negative and positive values (0, -1, 1, -2...)
+// so small negative numbers stay small too
+// --------------------------------------------------------
+void CommandStream::WriteInt(int value)
+{
+	WriteUInt(((unsigned int)value << 1) ^ (unsigned int)(value >> 31));
+}
+
+void CommandStream::WriteObject(const void* object)
+{
+	if (!object)
+	{
+		WriteUInt(0);
+		return;
+	}
+
+	auto it = objectIds.find(object);
+	if (it == objectIds.end())
+	{
+		objects.push_back(object);
+		it = objectIds.insert(std::make_pair(object, (unsigned int)objects.size())).first;
+	}
+	WriteUInt(it->second);
+}
+
+void CommandStream::WriteFloats(const float* values, unsigned int count)
+{
+	WriteBytes(values, count * sizeof(float));
+}
+
+void CommandStream::WriteBytes(const void* bytes, unsigned int size)
+{
+	if (size == 0)
+		return;
+
+	const unsigned char* b = (const unsigned char*)bytes;
+	data.insert(data.end(), b, b + size);
+}
+
+bool CommandStream::ReadUInt(size_t* offset, unsigned int* value) const
+{
+	*value = 0;
+	for (unsigned int shift = 0; shift < 35; shift += 7)
+	{
+		if (*offset >= data.size())
+			return false;
+
+		unsigned char b = data[(*offset)++];
+		*value |= (unsigned int)(b & 0x7F) << shift;
+		if (!(b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+bool CommandStream::ReadInt(size_t* offset, int* value) const
+{
+	unsigned int u;
+	if (!ReadUInt(offset, &u))
+		return false;
+
+	*value = (int)(u >> 1) ^ -(int)(u & 1);
+	return true;
+}
+
+bool CommandStream::ReadObject(size_t* offset, const void** object) const
+{
+	unsigned int id;
+	if (!ReadUInt(offset, &id) || id > objects.size())
+		return false;
+
+	*object = id == 0 ? 0 : objects[id - 1];
+	return true;
+}
+
+bool CommandStream::ReadFloats(size_t* offset, float* values, unsigned int count) const
+{
+	size_t size = count * sizeof(float);
+	if (data.size() - *offset < size)
+		return false;
+
+	memcpy(values, &data[*offset], size);
+	*offset += size;
+	return true;
+}
+
+// --------------------------------------------------------
+// Reads the command starting at offset, moving offset past it
+// - Buffer update data is pointed to where it sits in the stream
+// --------------------------------------------------------
+bool CommandStream::ReadCommand(size_t* offset, Command* command) const
+{
+	if (*offset >= data.size())
+		return false;
+
+	*command = {};
+	unsigned char type = data[(*offset)++];
+	command->type = (CommandType)type;
+	unsigned int* v = command->values;
+
+	switch (type)
+	{
+	case COMMAND_INPUT_LAYOUT:
+	case COMMAND_VERTEX_SHADER:
+	case COMMAND_PIXEL_SHADER:
+		return ReadObject(offset, &command->object);
+
+	case COMMAND_PRIMITIVE_TOPOLOGY:
+		return ReadUInt(offset, &v[0]);
+
+	case COMMAND_VERTEX_BUFFER:
+		return ReadUInt(offset, &v[0]) && ReadObject(offset, &command->object) &&
+			ReadUInt(offset, &v[1]) && ReadUInt(offset, &v[2]);
+
+	case COMMAND_INDEX_BUFFER:
+		return ReadObject(offset, &command->object) && ReadUInt(offset, &v[0]) && ReadUInt(offset, &v[1]);
+
+	case COMMAND_CONSTANT_BUFFER:
+		return ReadUInt(offset, &v[0]) && ReadUInt(offset, &v[1]) && ReadObject(offset, &command->object) &&
+			ReadUInt(offset, &v[2]) && ReadUInt(offset, &v[3]) && v[0] < STAGE_COUNT;
+
+	case COMMAND_SHADER_RESOURCE:
+	case COMMAND_SAMPLER:
+		return ReadUInt(offset, &v[0]) && ReadUInt(offset, &v[1]) && ReadObject(offset, &command->object) &&
+			v[0] < STAGE_COUNT;
+
+	case COMMAND_UPDATE_BUFFER:
+		if (!ReadObject(offset, &command->object) || !ReadUInt(offset, &v[0]) || data.size() - *offset < v[0])
+			return false;
+
+		// An empty update can end the stream, with nothing left to point at
+		if (v[0] > 0)
+			command->data = &data[*offset];
+		*offset += v[0];
+		return true;
+
+	case COMMAND_DRAW_INDEXED:
+		return ReadUInt(offset, &v[0]) && ReadUInt(offset, &v[1]) && ReadInt(offset, &command->baseVertex);
+
+	case COMMAND_DRAW_INDEXED_INSTANCED:
+		return ReadUInt(offset, &v[0]) && ReadUInt(offset, &v[1]) && ReadUInt(offset, &v[2]) &&
+			ReadInt(offset, &command->baseVertex) && ReadUInt(offset, &v[3]);
+
+	case COMMAND_CLEAR_RENDER_TARGET:
+		return ReadObject(offset, &command->object) && ReadFloats(offset, command->floats, 4);
+
+	case COMMAND_CLEAR_DEPTH:
+		return ReadObject(offset, &command->object) && ReadFloats(offset, command->floats, 1);
+
+	case COMMAND_VIEWPORT:
+		return ReadFloats(offset, command->floats, 6);
+
+	case COMMAND_RENDER_TARGETS:
+		return ReadObject(offset, &command->object) && ReadObject(offset, &command->object2);
+	}
+
+	return false;
+}
+
+bool CommandStream::Replay(ICommandBackend* backend) const
+{
+	size_t offset = 0;
+	Command command;
+	for (unsigned int c = 0; c < commandCount; c++)
+	{
+		if (!ReadCommand(&offset, &command))
+			return false;
+		if (backend)
+			backend->Execute(command);
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Steps through both streams a command at a time, comparing
+// the bytes each command takes up
+// - Objects are compared by id, so this finds where two frames
+//   first asked for something different, or in a different order
+// --------------------------------------------------------
+int CommandStream::FindFirstDifference(const CommandStream& other) const
+{
+	size_t offset = 0;
+	size_t otherOffset = 0;
+	Command command;
+	unsigned int count = commandCount < other.commandCount ? commandCount : other.commandCount;
+	for (unsigned int c = 0; c < count; c++)
+	{
+		size_t start = offset;
+		size_t otherStart = otherOffset;
+		if (!ReadCommand(&offset, &command) || !other.ReadCommand(&otherOffset, &command) ||
+			offset - start != otherOffset - otherStart ||
+			memcmp(&data[start], &other.data[otherStart], offset - start) != 0)
+			return (int)c;
+	}
+
+	return commandCount == other.commandCount ? -1 : (int)count;
+}
+
+// --------------------------------------------------------
+// Writes the commands to a file
+// --------------------------------------------------------
+bool CommandStream::Save(const std::string& file) const
+{
+	std::ofstream stream(file, std::ios::binary);
+	if (!stream.is_open())
+		return false;
+
+	return Save(stream);
+}
+
+// --------------------------------------------------------
+// Writes the commands to a binary stream
+// --------------------------------------------------------
+bool CommandStream::Save(std::ostream& stream) const
+{
+	CommandStreamFileHeader header = {};
+	memcpy(header.magic, CommandStreamMagic, sizeof(CommandStreamMagic));
+	header.version = CommandStreamVersion;
+	header.commandCount = commandCount;
+	header.objectCount = (unsigned int)objects.size();
+	header.dataSize = (unsigned int)data.size();
+	stream.write((const char*)&header, sizeof(header));
+	stream.write((const char*)data.data(), data.size());
+
+	return stream.good();
+}
+
+// --------------------------------------------------------
+// Reads commands from a file written by Save()
+// --------------------------------------------------------
+bool CommandStream::Load(const std::string& file)
+{
+	std::ifstream stream(file, std::ios::binary);
+	if (!stream.is_open())
+	{
+		Clear();
+		return false;
+	}
+
+	return Load(stream);
+}
+
+// --------------------------------------------------------
+// Reads commands from a binary stream written by Save()
+//
+// Returns false if the data is missing or malformed, in which
+// case the stream is left empty
+// --------------------------------------------------------
+bool CommandStream::Load(std::istream& stream)
+{
+	Clear();
+
+	CommandStreamFileHeader header = {};
+	stream.read((char*)&header, sizeof(header));
+	if (!stream ||
+		memcmp(header.magic, CommandStreamMagic, sizeof(CommandStreamMagic)) != 0 ||
+		header.version != CommandStreamVersion)
+		return false;
+
+	data.resize(header.dataSize);
+	stream.read((char*)data.data(), data.size());
+	if (!stream)
+	{
+		Clear();
+		return false;
+	}
+
+	// Each object gets a made up address of its own, which is
+	// enough to tell them apart but can't be used for drawing
+	for (unsigned int o = 0; o < header.objectCount; o++)
+		objects.push_back((const void*)(size_t)(o + 1));
+	commandCount = header.commandCount;
+	liveObjects = false;
+
+	// Make sure every command can be read back before using any of them
+	if (!Replay(0))
+	{
+		Clear();
+		return false;
+	}
+	return true;
+}
+
+
+CommandStatsBackend::CommandStatsBackend()
+{
+	Reset();
+}
+
+void CommandStatsBackend::Reset()
+{
+	stats = {};
+	bound.clear();
+}
+
+void CommandStatsBackend::Set(CommandType type, StateStage stage, unsigned int slot, const void* object, unsigned int a, unsigned int b, const void* object2)
+{
+	stats.commands[type]++;
+
+	unsigned long long key = ((unsigned long long)type << 40) | ((unsigned long long)stage << 32) | slot;
+	auto it = bound.find(key);
+	if (it != bound.end() && it->second.object == object && it->second.object2 == object2 && it->second.a == a && it->second.b == b)
+	{
+		stats.redundant++;
+		return;
+	}
+
+	BoundState state = { object, object2, a, b };
+	bound[key] = state;
+}
+
+void CommandStatsBackend::Execute(const Command& command)
+{
+	const unsigned int* v = command.values;
+	switch (command.type)
+	{
+	case COMMAND_INPUT_LAYOUT: Set(command.type, STAGE_VERTEX, 0, command.object); break;
+	case COMMAND_PRIMITIVE_TOPOLOGY: Set(command.type, STAGE_VERTEX, 0, 0, v[0]); break;
+	case COMMAND_VERTEX_BUFFER: Set(command.type, STAGE_VERTEX, v[0], command.object, v[1], v[2]); break;
+	case COMMAND_INDEX_BUFFER: Set(command.type, STAGE_VERTEX, 0, command.object, v[0], v[1]); break;
+	case COMMAND_VERTEX_SHADER: Set(command.type, STAGE_VERTEX, 0, command.object); break;
+	case COMMAND_PIXEL_SHADER: Set(command.type, STAGE_PIXEL, 0, command.object); break;
+	case COMMAND_CONSTANT_BUFFER: Set(command.type, (StateStage)v[0], v[1], command.object, v[2], v[3]); break;
+	case COMMAND_SHADER_RESOURCE: Set(command.type, (StateStage)v[0], v[1], command.object); break;
+	case COMMAND_SAMPLER: Set(command.type, (StateStage)v[0], v[1], command.object); break;
+	case COMMAND_RENDER_TARGETS: Set(command.type, STAGE_PIXEL, 0, command.object, 0, 0, command.object2); break;
+
+	case COMMAND_VIEWPORT:
+		// Only the size is compared, which is all that changes between passes here
+		Set(command.type, STAGE_PIXEL, 0, 0, (unsigned int)command.floats[2], (unsigned int)command.floats[3]);
+		break;
+
+	case COMMAND_UPDATE_BUFFER:
+		stats.commands[command.type]++;
+		stats.updateBytes += v[0];
+		break;
+
+	case COMMAND_DRAW_INDEXED:
+		stats.commands[command.type]++;
+		stats.draws++;
+		stats.indices += v[0];
+		stats.instances++;
+		break;
+
+	case COMMAND_DRAW_INDEXED_INSTANCED:
+		stats.commands[command.type]++;
+		stats.draws++;
+		stats.indices += v[0] * v[1];
+		stats.instances += v[1];
+		break;
+
+	case COMMAND_CLEAR_RENDER_TARGET:
+	case COMMAND_CLEAR_DEPTH:
+		stats.commands[command.type]++;
+		break;
+
+	default:
+		break;
+	}
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "StateStage.h"
+
+// --------------------------------------------------------
+// Every kind of call a command stream can hold, one for each
+// state backend function
+// --------------------------------------------------------
+enum CommandType
+{
+	COMMAND_INPUT_LAYOUT,
+	COMMAND_PRIMITIVE_TOPOLOGY,
+	COMMAND_VERTEX_BUFFER,
+	COMMAND_INDEX_BUFFER,
+	COMMAND_VERTEX_SHADER,
+	COMMAND_PIXEL_SHADER,
+	COMMAND_CONSTANT_BUFFER,
+	COMMAND_SHADER_RESOURCE,
+	COMMAND_SAMPLER,
+	COMMAND_UPDATE_BUFFER,
+	COMMAND_DRAW_INDEXED,
+	COMMAND_DRAW_INDEXED_INSTANCED,
+	COMMAND_CLEAR_RENDER_TARGET,
+	COMMAND_CLEAR_DEPTH,
+	COMMAND_VIEWPORT,
+	COMMAND_RENDER_TARGETS,
+	COMMAND_TYPE_COUNT
+};
+
+// --------------------------------------------------------
+// One command and its arguments, with whatever it binds kept
+// as an opaque handle - the stream never looks behind them
+//
+// The values used by each type, in order:
+//  - Primitive topology:  topology
+//  - Vertex buffer:       slot, stride, offset
+//  - Index buffer:        format, offset
+//  - Constant buffer:     stage, slot, first constant, count
+//  - Shader resource:     stage, slot
+//  - Sampler:             stage, slot
+//  - Update buffer:       size (of data)
+//  - Draw indexed:        index count, start index (and baseVertex)
+//  - Instanced:           index count, instance count, start index,
+//                         start instance (and baseVertex)
+// Clears and viewports use floats instead, and render targets
+// put the depth stencil view in object2
+// --------------------------------------------------------
+struct Command
+{
+	CommandType type;
+	const void* object;
+	const void* object2;
+	unsigned int values[4];
+	int baseVertex;
+	float floats[6];
+	const void* data;
+};
+
+// --------------------------------------------------------
+// Somewhere to send the commands read back from a stream
+// --------------------------------------------------------
+class ICommandBackend
+{
+public:
+	virtual ~ICommandBackend() {}
+
+	virtual void Execute(const Command& command) = 0;
+};
+
+// --------------------------------------------------------
+// A frame's worth of state backend calls packed into bytes
+//
+// Each command is a one byte type followed by its arguments.
+// Counts, slots and offsets are stored as variable length
+// integers, so most take a single byte, and buffer updates
+// carry a copy of the data they upload.
+//
+// Objects (buffers, shaders, views and so on) are stored as
+// small ids handed out in the order they're first seen, with 0
+// meaning null. Two captures of the same scene therefore look
+// the same byte for byte, and can be compared even when they
+// were saved by different runs.
+//
+// Streams that were loaded from a file only have stand-in
+// addresses for their objects, so they can be replayed into
+// backends that count and compare but not into a real context.
+//
+// Nothing here knows what the objects are, so streams can be
+// built, saved and replayed without Direct3D - see
+// CommandStreamRecorder for capturing them from a state cache
+// --------------------------------------------------------
+class CommandStream
+{
+public:
+	CommandStream();
+
+	void Clear();
+
+	// Adds a command to the end of the stream
+	void Write(const Command& command);
+
+	// Sends every command to a backend in order, returning false
+	// if the stream turns out to be malformed part way through
+	// - With no backend the commands are only decoded
+	bool Replay(ICommandBackend* backend) const;
+
+	// Index of the first command that differs between two streams,
+	// or -1 if they hold exactly the same commands
+	int FindFirstDifference(const CommandStream& other) const;
+
+	bool Save(const std::string& file) const;
+	bool Save(std::ostream& stream) const;
+	bool Load(const std::string& file);
+	bool Load(std::istream& stream);
+
+	unsigned int GetCommandCount() const { return commandCount; }
+	size_t GetByteCount() const { return data.size(); }
+	size_t GetObjectCount() const { return objects.size(); }
+	bool HasLiveObjects() const { return liveObjects; }
+
+private:
+	void WriteUInt(unsigned int value);
+	void WriteInt(int value);
+	void WriteObject(const void* object);
+	void WriteFloats(const float* values, unsigned int count);
+	void WriteBytes(const void* bytes, unsigned int size);
+
+	bool ReadCommand(size_t* offset, Command* command) const;
+	bool ReadUInt(size_t* offset, unsigned int* value) const;
+	bool ReadInt(size_t* offset, int* value) const;
+	bool ReadObject(size_t* offset, const void** object) const;
+	bool ReadFloats(size_t* offset, float* values, unsigned int count) const;
+
+	std::vector<unsigned char> data;
+	unsigned int commandCount;
+
+	// Objects by id - 1, and ids by object while recording
+	std::vector<const void*> objects;
+	std::unordered_map<const void*, unsigned int> objectIds;
+	bool liveObjects;
+};
+
+// --------------------------------------------------------
+// Backend that writes each command it's sent into a stream,
+// such as to copy one stream into another
+// --------------------------------------------------------
+class CommandStreamWriter : public ICommandBackend
+{
+public:
+	CommandStreamWriter(std::shared_ptr<CommandStream> stream) : stream(stream) {}
+
+	void Execute(const Command& command) { stream->Write(command); }
+
+private:
+	std::shared_ptr<CommandStream> stream;
+};
+
+// --------------------------------------------------------
+// What a command stream asks for, as counted by replaying it
+// into a statistics backend
+// --------------------------------------------------------
+struct CommandStats
+{
+	unsigned int commands[COMMAND_TYPE_COUNT];
+	unsigned int redundant;		// State changes that set what was already set
+	unsigned int draws;
+	unsigned int indices;		// Across every instance
+	unsigned int instances;
+	unsigned int updateBytes;
+};
+
+// --------------------------------------------------------
+// Null backend that does nothing but count what it's sent
+// - Remembers the last thing set in each slot, so it can spot
+//   changes a state cache would have skipped
+// --------------------------------------------------------
+class CommandStatsBackend : public ICommandBackend
+{
+public:
+	CommandStatsBackend();
+
+	void Execute(const Command& command);
+
+	const CommandStats& GetStats() { return stats; }
+	void Reset();
+
+private:
+	// Counts a state change, and whether it matches what the
+	// same type, stage and slot was last set to
+	void Set(CommandType type, StateStage stage, unsigned int slot,
+		const void* object, unsigned int a = 0, unsigned int b = 0, const void* object2 = 0);
+
+	struct BoundState
+	{
+		const void* object;
+		const void* object2;
+		unsigned int a;
+		unsigned int b;
+	};
+
+	CommandStats stats;
+	std::unordered_map<unsigned long long, BoundState> bound;
+};
@@ -0,0 +1,191 @@
+#include "CommandStreamRecorder.h"
+
+CommandStreamRecorder::CommandStreamRecorder(std::shared_ptr<CommandStream> stream, std::shared_ptr<IStateBackend> next)
+	:
+	stream(stream),
+	next(next)
+{
+}
+
+void CommandStreamRecorder::Write(CommandType type, const void* object, unsigned int a, unsigned int b, unsigned int c, unsigned int d)
+{
+	Command command = {};
+	command.type = type;
+	command.object = object;
+	command.values[0] = a;
+	command.values[1] = b;
+	command.values[2] = c;
+	command.values[3] = d;
+	stream->Write(command);
+}
+
+void CommandStreamRecorder::SetInputLayout(ID3D11InputLayout* layout)
+{
+	Write(COMMAND_INPUT_LAYOUT, layout);
+	if (next) next->SetInputLayout(layout);
+}
+
+void CommandStreamRecorder::SetPrimitiveTopology(StateTopology topology)
+{
+	Write(COMMAND_PRIMITIVE_TOPOLOGY, 0, topology);
+	if (next) next->SetPrimitiveTopology(topology);
+}
+
+void CommandStreamRecorder::SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset)
+{
+	Write(COMMAND_VERTEX_BUFFER, buffer, slot, stride, offset);
+	if (next) next->SetVertexBuffer(slot, buffer, stride, offset);
+}
+
+void CommandStreamRecorder::SetIndexBuffer(ID3D11Buffer* buffer, StateIndexFormat format, unsigned int offset)
+{
+	Write(COMMAND_INDEX_BUFFER, buffer, format, offset);
+	if (next) next->SetIndexBuffer(buffer, format, offset);
+}
+
+void CommandStreamRecorder::SetVertexShader(ID3D11VertexShader* shader)
+{
+	Write(COMMAND_VERTEX_SHADER, shader);
+	if (next) next->SetVertexShader(shader);
+}
+
+void CommandStreamRecorder::SetPixelShader(ID3D11PixelShader* shader)
+{
+	Write(COMMAND_PIXEL_SHADER, shader);
+	if (next) next->SetPixelShader(shader);
+}
+
+void CommandStreamRecorder::SetConstantBuffer(StateStage stage, unsigned int slot, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int count)
+{
+	Write(COMMAND_CONSTANT_BUFFER, buffer, stage, slot, firstConstant, count);
+	if (next) next->SetConstantBuffer(stage, slot, buffer, firstConstant, count);
+}
+
+void CommandStreamRecorder::SetShaderResource(StateStage stage, unsigned int slot, ID3D11ShaderResourceView* srv)
+{
+	Write(COMMAND_SHADER_RESOURCE, srv, stage, slot);
+	if (next) next->SetShaderResource(stage, slot, srv);
+}
+
+void CommandStreamRecorder::SetSampler(StateStage stage, unsigned int slot, ID3D11SamplerState* sampler)
+{
+	Write(COMMAND_SAMPLER, sampler, stage, slot);
+	if (next) next->SetSampler(stage, slot, sampler);
+}
+
+void CommandStreamRecorder::UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size)
+{
+	Command command = {};
+	command.type = COMMAND_UPDATE_BUFFER;
+	command.object = buffer;
+	command.values[0] = size;
+	command.data = data;
+	stream->Write(command);
+	if (next) next->UpdateBuffer(buffer, data, size);
+}
+
+void CommandStreamRecorder::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	Command command = {};
+	command.type = COMMAND_DRAW_INDEXED;
+	command.values[0] = indexCount;
+	command.values[1] = startIndex;
+	command.baseVertex = baseVertex;
+	stream->Write(command);
+	if (next) next->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void CommandStreamRecorder::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	Command command = {};
+	command.type = COMMAND_DRAW_INDEXED_INSTANCED;
+	command.values[0] = indexCount;
+	command.values[1] = instanceCount;
+	command.values[2] = startIndex;
+	command.values[3] = startInstance;
+	command.baseVertex = baseVertex;
+	stream->Write(command);
+	if (next) next->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void CommandStreamRecorder::ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4])
+{
+	Command command = {};
+	command.type = COMMAND_CLEAR_RENDER_TARGET;
+	command.object = rtv;
+	for (int i = 0; i < 4; i++)
+		command.floats[i] = color[i];
+	stream->Write(command);
+	if (next) next->ClearRenderTarget(rtv, color);
+}
+
+void CommandStreamRecorder::ClearDepth(ID3D11DepthStencilView* dsv, float depth)
+{
+	Command command = {};
+	command.type = COMMAND_CLEAR_DEPTH;
+	command.object = dsv;
+	command.floats[0] = depth;
+	stream->Write(command);
+	if (next) next->ClearDepth(dsv, depth);
+}
+
+void CommandStreamRecorder::SetViewport(const StateViewport& viewport)
+{
+	Command command = {};
+	command.type = COMMAND_VIEWPORT;
+	command.floats[0] = viewport.topLeftX;
+	command.floats[1] = viewport.topLeftY;
+	command.floats[2] = viewport.width;
+	command.floats[3] = viewport.height;
+	command.floats[4] = viewport.minDepth;
+	command.floats[5] = viewport.maxDepth;
+	stream->Write(command);
+	if (next) next->SetViewport(viewport);
+}
+
+void CommandStreamRecorder::SetRenderTargets(ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv)
+{
+	Command command = {};
+	command.type = COMMAND_RENDER_TARGETS;
+	command.object = rtv;
+	command.object2 = dsv;
+	stream->Write(command);
+	if (next) next->SetRenderTargets(rtv, dsv);
+}
+
+
+void CommandStreamPlayer::Execute(const Command& command)
+{
+	const unsigned int* v = command.values;
+	void* object = (void*)command.object;
+	const float* f = command.floats;
+
+	switch (command.type)
+	{
+	case COMMAND_INPUT_LAYOUT: backend->SetInputLayout((ID3D11InputLayout*)object); break;
+	case COMMAND_PRIMITIVE_TOPOLOGY: backend->SetPrimitiveTopology((StateTopology)v[0]); break;
+	case COMMAND_VERTEX_BUFFER: backend->SetVertexBuffer(v[0], (ID3D11Buffer*)object, v[1], v[2]); break;
+	case COMMAND_INDEX_BUFFER: backend->SetIndexBuffer((ID3D11Buffer*)object, (StateIndexFormat)v[0], v[1]); break;
+	case COMMAND_VERTEX_SHADER: backend->SetVertexShader((ID3D11VertexShader*)object); break;
+	case COMMAND_PIXEL_SHADER: backend->SetPixelShader((ID3D11PixelShader*)object); break;
+	case COMMAND_CONSTANT_BUFFER: backend->SetConstantBuffer((StateStage)v[0], v[1], (ID3D11Buffer*)object, v[2], v[3]); break;
+	case COMMAND_SHADER_RESOURCE: backend->SetShaderResource((StateStage)v[0], v[1], (ID3D11ShaderResourceView*)object); break;
+	case COMMAND_SAMPLER: backend->SetSampler((StateStage)v[0], v[1], (ID3D11SamplerState*)object); break;
+	case COMMAND_UPDATE_BUFFER: backend->UpdateBuffer((ID3D11Buffer*)object, command.data, v[0]); break;
+	case COMMAND_DRAW_INDEXED: backend->DrawIndexed(v[0], v[1], command.baseVertex); break;
+	case COMMAND_DRAW_INDEXED_INSTANCED: backend->DrawIndexedInstanced(v[0], v[1], v[2], command.baseVertex, v[3]); break;
+	case COMMAND_CLEAR_RENDER_TARGET: backend->ClearRenderTarget((ID3D11RenderTargetView*)object, f); break;
+	case COMMAND_CLEAR_DEPTH: backend->ClearDepth((ID3D11DepthStencilView*)object, f[0]); break;
+	case COMMAND_RENDER_TARGETS: backend->SetRenderTargets((ID3D11RenderTargetView*)object, (ID3D11DepthStencilView*)command.object2); break;
+
+	case COMMAND_VIEWPORT:
+	{
+		StateViewport viewport = { f[0], f[1], f[2], f[3], f[4], f[5] };
+		backend->SetViewport(viewport);
+		break;
+	}
+
+	default:
+		break;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <memory>
+#include "CommandStream.h"
+#include "StateCache.h"
+
+// --------------------------------------------------------
+// Backend that writes each call into a command stream before
+// passing it along to another backend, if there is one
+// - Sits between a state cache and its usual backend, so only
+//   what the cache lets through is captured
+// --------------------------------------------------------
+class CommandStreamRecorder : public IStateBackend
+{
+public:
+	CommandStreamRecorder(std::shared_ptr<CommandStream> stream, std::shared_ptr<IStateBackend> next = 0);
+
+	void SetInputLayout(ID3D11InputLayout* layout);
+	void SetPrimitiveTopology(StateTopology topology);
+	void SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset);
+	void SetIndexBuffer(ID3D11Buffer* buffer, StateIndexFormat format, unsigned int offset);
+	void SetVertexShader(ID3D11VertexShader* shader);
+	void SetPixelShader(ID3D11PixelShader* shader);
+	void SetConstantBuffer(StateStage stage, unsigned int slot, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int count);
+	void SetShaderResource(StateStage stage, unsigned int slot, ID3D11ShaderResourceView* srv);
+	void SetSampler(StateStage stage, unsigned int slot, ID3D11SamplerState* sampler);
+	void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size);
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance);
+	void ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4]);
+	void ClearDepth(ID3D11DepthStencilView* dsv, float depth);
+	void SetViewport(const StateViewport& viewport);
+	void SetRenderTargets(ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv);
+
+private:
+	void Write(CommandType type, const void* object = 0,
+		unsigned int a = 0, unsigned int b = 0, unsigned int c = 0, unsigned int d = 0);
+
+	std::shared_ptr<CommandStream> stream;
+	std::shared_ptr<IStateBackend> next;
+};
+
+// --------------------------------------------------------
+// Command backend that turns a stream back into state backend
+// calls, handing its objects over as the Direct3D objects they
+// were recorded from
+// - Only for streams with live objects, as loaded ones would
+//   hand over made up addresses
+// --------------------------------------------------------
+class CommandStreamPlayer : public ICommandBackend
+{
+public:
+	CommandStreamPlayer(IStateBackend* backend) : backend(backend) {}
+
+	void Execute(const Command& command);
+
+private:
+	IStateBackend* backend;
+};
@@ -0,0 +1,164 @@
+#include <string.h>
+#include "ConstantBufferRing.h"
+
+// Constant buffer offsets are counted in 16 byte constants and
+// must start on a multiple of 16 of them
+#define RING_ALIGNMENT 256
+
+// How many frames the CPU can get ahead of the GPU before
+// ending a frame waits for the oldest one to finish
+#define RING_MAX_FRAMES_IN_FLIGHT 3
+
+ConstantBufferRing::ConstantBufferRing(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	unsigned int size)
+	:
+	context(context),
+	supported(false),
+	mappedSinceDiscard(false),
+	allocator(size, RING_ALIGNMENT),
+	generation(1),
+	frameFence(0),
+	queryCount(0),
+	stats(),
+	lastFrameStats()
+{
+	// Binding part of a buffer and mapping dynamic constant
+	// buffers without discarding both came with Direct3D 11.1
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> context1;
+	context.As(&context1);
+
+	if (!options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer || !context1)
+		return;
+
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.ByteWidth = (unsigned int)allocator.Align(size);
+	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	if (FAILED(device->CreateBuffer(&bufferDesc, 0, buffer.GetAddressOf())))
+		return;
+
+	D3D11_QUERY_DESC queryDesc = {};
+	queryDesc.Query = D3D11_QUERY_EVENT;
+	frameQueries.resize(RING_MAX_FRAMES_IN_FLIGHT);
+	for (auto& query : frameQueries)
+	{
+		if (FAILED(device->CreateQuery(&queryDesc, query.GetAddressOf())))
+			return;
+	}
+
+	supported = true;
+}
+
+// --------------------------------------------------------
+// Copies data into a new slice of the ring
+//
+// firstConstant, constantCount - Where the slice is, in 16 byte
+//   constants, ready to pass to *SetConstantBuffers1()
+//
+// Returns false if the ring isn't supported or the data is
+// bigger than the whole ring
+// --------------------------------------------------------
+bool ConstantBufferRing::Upload(const void* data, unsigned int size, unsigned int* firstConstant, unsigned int* constantCount)
+{
+	if (!supported)
+		return false;
+
+	size_t offset = 0;
+	if (!allocator.Allocate(size, &offset))
+	{
+		// The GPU may have finished some frames since we last checked
+		RetireFinishedFrames();
+		if (!allocator.Allocate(size, &offset))
+		{
+			// Still full, so let the driver swap in fresh memory
+			// instead of waiting for the GPU to catch up
+			allocator.Reset();
+			mappedSinceDiscard = false;
+			generation++;
+			stats.discards++;
+
+			if (!allocator.Allocate(size, &offset))
+				return false;
+		}
+	}
+
+	// The first map after creating or discarding must be a discard
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	D3D11_MAP mapType = mappedSinceDiscard ? D3D11_MAP_WRITE_NO_OVERWRITE : D3D11_MAP_WRITE_DISCARD;
+	if (FAILED(context->Map(buffer.Get(), 0, mapType, 0, &mapped)))
+		return false;
+
+	memcpy((unsigned char*)mapped.pData + offset, data, size);
+	context->Unmap(buffer.Get(), 0);
+	mappedSinceDiscard = true;
+
+	size_t aligned = allocator.Align(size);
+	*firstConstant = (unsigned int)(offset / 16);
+	*constantCount = (unsigned int)(aligned / 16);
+
+	stats.uploads++;
+	stats.bytes += (unsigned int)aligned;
+	return true;
+}
+
+// --------------------------------------------------------
+// Marks the end of the frame's uploads, so their space can be
+// reused once the GPU has finished the frame
+// - Call once per frame, after the last draw
+// --------------------------------------------------------
+void ConstantBufferRing::EndFrame()
+{
+	lastFrameStats = stats;
+	stats = {};
+
+	if (!supported)
+		return;
+
+	allocator.EndFrame(frameFence);
+
+	// Every query is still waiting on an earlier frame, so wait
+	// for the oldest to free one up
+	if (queryCount == frameQueries.size())
+	{
+		unsigned long long oldest = frameFence - queryCount;
+		while (context->GetData(frameQueries[oldest % frameQueries.size()].Get(), 0, 0, 0) == S_FALSE);
+		allocator.Retire(oldest);
+		queryCount--;
+	}
+
+	context->End(frameQueries[frameFence % frameQueries.size()].Get());
+	queryCount++;
+	frameFence++;
+
+	RetireFinishedFrames();
+
+	// Slices from this frame will eventually be overwritten, so
+	// anything reusing one next frame needs to upload it again
+	generation++;
+}
+
+// --------------------------------------------------------
+// Frees the space of frames the GPU has finished, without
+// waiting on any that it hasn't
+// --------------------------------------------------------
+void ConstantBufferRing::RetireFinishedFrames()
+{
+	while (queryCount > 0)
+	{
+		unsigned long long oldest = frameFence - queryCount;
+		HRESULT hr = context->GetData(
+			frameQueries[oldest % frameQueries.size()].Get(),
+			0, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH);
+		if (hr != S_OK)
+			break;
+
+		allocator.Retire(oldest);
+		queryCount--;
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include <wrl/client.h>
+#include <vector>
+#include "RingAllocator.h"
+
+// --------------------------------------------------------
+// Upload statistics for the current frame
+// --------------------------------------------------------
+struct ConstantBufferRingStats
+{
+	unsigned int uploads;
+	unsigned int bytes;			// Including padding to the 256 byte alignment
+	unsigned int discards;		// Times the whole buffer was swapped out because the ring was full
+};
+
+// --------------------------------------------------------
+// One large dynamic constant buffer shared by every shader
+//
+// Each upload is copied into the next free 256 byte aligned
+// slice of the buffer, mapped with NO_OVERWRITE so the GPU can
+// keep reading earlier slices, and the slice is bound with
+// *SetConstantBuffers1 offsets. An event query marks the end
+// of each frame so its slices are reused once the GPU is done.
+//
+// If the ring fills up before the GPU catches up, the buffer is
+// mapped with DISCARD instead, which lets the driver hand back
+// fresh memory. The generation number changes when that happens
+// (and every frame), so callers know their old slices are gone.
+//
+// Needs Direct3D 11.1 support for constant buffer offsets -
+// check IsSupported() before using it
+// --------------------------------------------------------
+class ConstantBufferRing
+{
+public:
+	ConstantBufferRing(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		unsigned int size = 4 * 1024 * 1024);
+
+	bool IsSupported() { return supported; }
+	bool Upload(const void* data, unsigned int size, unsigned int* firstConstant, unsigned int* constantCount);
+	void EndFrame();
+
+	ID3D11Buffer* GetBuffer() { return buffer.Get(); }
+	unsigned int GetGeneration() { return generation; }
+	unsigned int GetSize() { return (unsigned int)allocator.GetCapacity(); }
+	unsigned int GetUsed() { return (unsigned int)allocator.GetUsed(); }
+	unsigned int GetFramesInFlight() { return (unsigned int)allocator.GetFramesInFlight(); }
+	const ConstantBufferRingStats& GetStats() { return lastFrameStats; }
+
+private:
+	void RetireFinishedFrames();
+
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	bool supported;
+	bool mappedSinceDiscard;
+
+	RingAllocator allocator;
+	unsigned int generation;
+
+	// Event queries reused in turn, indexed by frame fence
+	std::vector<Microsoft::WRL::ComPtr<ID3D11Query>> frameQueries;
+	unsigned long long frameFence;		// The frame being recorded now
+	unsigned int queryCount;			// Frames ended but not yet finished by the GPU
+
+	ConstantBufferRingStats stats;
+	ConstantBufferRingStats lastFrameStats;
+};
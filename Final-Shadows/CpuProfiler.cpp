@@ -0,0 +1,169 @@
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include "CpuProfiler.h"
+
+std::atomic<bool> CpuProfiler::Enabled(true);
+std::mutex CpuProfiler::threadsMutex;
+std::vector<std::unique_ptr<CpuProfilerThread>> CpuProfiler::threads;
+CpuProfileFrame CpuProfiler::lastFrame = {};
+std::deque<CpuProfileFrame> CpuProfiler::traceFrames;
+long long CpuProfiler::frameStart = 0;
+
+static thread_local CpuProfilerThread* currentThread = 0;
+
+CpuProfilerThread::CpuProfilerThread(unsigned int index, unsigned int capacity)
+	:
+	depth(0),
+	read(0),
+	index(index),
+	events(capacity > 0 ? capacity : 1),
+	written(0)
+{
+}
+
+void CpuProfilerThread::Push(const CpuProfileEvent& e)
+{
+	unsigned long long n = written.load(std::memory_order_relaxed);
+	events[n % events.size()] = e;
+	written.store(n + 1, std::memory_order_release);
+}
+
+long long CpuProfiler::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// --------------------------------------------------------
+// Finds or creates this thread's ring
+// - Only the first call on each thread takes the lock
+// --------------------------------------------------------
+CpuProfilerThread* CpuProfiler::GetThread()
+{
+	if (currentThread)
+		return currentThread;
+
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	threads.push_back(std::unique_ptr<CpuProfilerThread>(
+		new CpuProfilerThread((unsigned int)threads.size(), EventsPerThread)));
+	currentThread = threads.back().get();
+	return currentThread;
+}
+
+unsigned int CpuProfiler::GetThreadCount()
+{
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	return (unsigned int)threads.size();
+}
+
+// --------------------------------------------------------
+// Ends the frame started by the last call, gathering every
+// thread's markers into it
+// - Markers still open carry over to the frame they finish in
+// --------------------------------------------------------
+void CpuProfiler::BeginFrame()
+{
+	long long now = Now();
+
+	lastFrame.start = frameStart;
+	lastFrame.end = now;
+	lastFrame.events.clear();
+	frameStart = now;
+
+	{
+		std::lock_guard<std::mutex> lock(threadsMutex);
+		for (auto& thread : threads)
+		{
+			unsigned long long written = thread->GetWritten();
+			if (written - thread->read > EventsPerThread)
+				thread->read = written - EventsPerThread;
+
+			for (; thread->read < written; thread->read++)
+				lastFrame.events.push_back(thread->GetEvent(thread->read));
+		}
+	}
+
+	// The very first frame has no start to measure from
+	if (lastFrame.start == 0)
+		return;
+
+	traceFrames.push_back(lastFrame);
+	if (traceFrames.size() > TraceFrames)
+		traceFrames.pop_front();
+}
+
+// --------------------------------------------------------
+// Throws away every marker finished so far this frame, such
+// as the thousands a benchmark of the markers leaves behind
+// --------------------------------------------------------
+void CpuProfiler::DiscardPending()
+{
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	for (auto& thread : threads)
+		thread->read = thread->GetWritten();
+}
+
+static void WriteJsonString(std::ostream& out, const char* s)
+{
+	out << '"';
+	for (; *s; s++)
+	{
+		if (*s == '"' || *s == '\\')
+			out << '\\';
+		if ((unsigned char)*s >= 0x20)
+			out << *s;
+	}
+	out << '"';
+}
+
+// --------------------------------------------------------
+// The kept frames in the Chrome trace event format, with each
+// marker as a complete ("X") event and each frame as one more
+// on a row of its own
+// - Times are written in microseconds from the first frame
+// --------------------------------------------------------
+std::string CpuProfiler::WriteTrace()
+{
+	std::ostringstream out;
+	out.setf(std::ios::fixed);
+	out.precision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	long long origin = traceFrames.empty() ? 0 : traceFrames.front().start;
+	unsigned int frameRow = GetThreadCount();
+	bool first = true;
+	for (size_t f = 0; f < traceFrames.size(); f++)
+	{
+		const CpuProfileFrame& frame = traceFrames[f];
+
+		out << (first ? "" : ",") << "\n{\"name\":\"Frame " << f << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":0"
+			<< ",\"tid\":" << frameRow
+			<< ",\"ts\":" << (frame.start - origin) / 1000.0
+			<< ",\"dur\":" << (frame.end - frame.start) / 1000.0 << "}";
+		first = false;
+
+		for (auto& e : frame.events)
+		{
+			out << ",\n{\"name\":";
+			WriteJsonString(out, e.name);
+			out << ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0"
+				<< ",\"tid\":" << e.thread
+				<< ",\"ts\":" << (e.start - origin) / 1000.0
+				<< ",\"dur\":" << (e.end - e.start) / 1000.0 << "}";
+		}
+	}
+
+	out << "\n]}\n";
+	return out.str();
+}
+
+bool CpuProfiler::SaveTrace(const std::string& file)
+{
+	std::ofstream stream(file);
+	if (!stream.is_open())
+		return false;
+
+	stream << WriteTrace();
+	return stream.good();
+}
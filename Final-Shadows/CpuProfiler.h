@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Markers compile to nothing when this is 0
+#ifndef CPU_PROFILING
+#define CPU_PROFILING 1
+#endif
+
+// --------------------------------------------------------
+// One finished marker
+// - Times are in nanoseconds on the profiler's clock
+// --------------------------------------------------------
+struct CpuProfileEvent
+{
+	const char* name;	// Must outlive the profiler, like a string literal
+	long long start;
+	long long end;
+	unsigned int thread;
+	int depth;			// How many markers it's nested inside
+};
+
+// --------------------------------------------------------
+// Every marker finished between two calls to BeginFrame()
+// --------------------------------------------------------
+struct CpuProfileFrame
+{
+	long long start;
+	long long end;
+	std::vector<CpuProfileEvent> events;
+};
+
+// --------------------------------------------------------
+// The markers one thread has finished, in a fixed size ring
+//
+// Only the owning thread writes to it, and publishes each
+// event by bumping the written count afterwards, so reading
+// never takes a lock. A reader that falls more than the ring's
+// size behind loses the oldest events
+// --------------------------------------------------------
+class CpuProfilerThread
+{
+public:
+	CpuProfilerThread(unsigned int index, unsigned int capacity);
+
+	void Push(const CpuProfileEvent& e);
+
+	unsigned int GetIndex() { return index; }
+	unsigned long long GetWritten() { return written.load(std::memory_order_acquire); }
+	const CpuProfileEvent& GetEvent(unsigned long long n) { return events[n % events.size()]; }
+
+	// Only touched by the owning thread
+	int depth;
+
+	// Only touched by the thread gathering frames
+	unsigned long long read;
+
+private:
+	unsigned int index;
+	std::vector<CpuProfileEvent> events;
+	std::atomic<unsigned long long> written;
+};
+
+// --------------------------------------------------------
+// Scoped CPU markers from any thread, gathered into frames
+//
+// Each thread records into its own ring the first time it
+// finishes a marker, after which recording doesn't lock or
+// allocate. BeginFrame() gathers what every thread finished
+// since the last call into the last frame, for drawing, and
+// keeps a few seconds' worth of frames to write out as a
+// Chrome trace (chrome://tracing or ui.perfetto.dev)
+//
+// Markers use std::chrono::steady_clock, which is the
+// performance counter on Windows
+// --------------------------------------------------------
+class CpuProfiler
+{
+public:
+	static long long Now();
+
+	// This thread's ring, which is created on first use
+	static CpuProfilerThread* GetThread();
+
+	// Only to be called from one thread, while no other thread
+	// is in the middle of a frame's work
+	static void BeginFrame();
+	static void DiscardPending();
+
+	static const CpuProfileFrame& GetLastFrame() { return lastFrame; }
+	static unsigned int GetThreadCount();
+
+	static std::string WriteTrace();
+	static bool SaveTrace(const std::string& file);
+
+	// Turns recording on and off without recompiling
+	static std::atomic<bool> Enabled;
+
+	static const unsigned int EventsPerThread = 16384;
+	static const unsigned int TraceFrames = 300;
+
+private:
+	static std::mutex threadsMutex;
+	static std::vector<std::unique_ptr<CpuProfilerThread>> threads;
+	static CpuProfileFrame lastFrame;
+	static std::deque<CpuProfileFrame> traceFrames;
+	static long long frameStart;
+};
+
+// --------------------------------------------------------
+// Records a marker from construction until it goes out of
+// scope - use PROFILE_SCOPE() rather than this directly, so
+// the markers can be compiled out
+// --------------------------------------------------------
+class CpuProfileScope
+{
+public:
+	CpuProfileScope(const char* name)
+		: thread(0), name(name), start(0), depth(0)
+	{
+		if (!CpuProfiler::Enabled.load(std::memory_order_relaxed))
+			return;
+
+		thread = CpuProfiler::GetThread();
+		depth = thread->depth++;
+		start = CpuProfiler::Now();
+	}
+
+	~CpuProfileScope()
+	{
+		if (!thread)
+			return;
+
+		CpuProfileEvent e = { name, start, CpuProfiler::Now(), thread->GetIndex(), depth };
+		thread->depth--;
+		thread->Push(e);
+	}
+
+private:
+	CpuProfilerThread* thread;
+	const char* name;
+	long long start;
+	int depth;
+};
+
+#define CPU_PROFILE_JOIN_NAMES(a, b) a##b
+#define CPU_PROFILE_JOIN(a, b) CPU_PROFILE_JOIN_NAMES(a, b)
+
+#if CPU_PROFILING
+#define PROFILE_SCOPE(name) CpuProfileScope CPU_PROFILE_JOIN(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
@@ -0,0 +1,355 @@
+#include <cmath>
+#include <cstring>
+#include "Culling.h"
+#include "Frustum.h"
+
+using namespace DirectX;
+
+CullingSystem::CullingSystem()
+	:
+	stats(),
+	frustumCulling(true),
+	screenSizeCulling(true),
+	temporalCaching(true),
+	cameraMoveThreshold(0.5f),
+	cameraTurnThreshold(XMConvertToRadians(2.0f)),
+	cameraEpoch(0),
+	nextEpoch(0),
+	hasCameraEpoch(false),
+	epochCameraPosition(),
+	epochCameraForward(),
+	epochCameraUp(),
+	epochCameraProj(),
+	epochScreenHeight(0.0f),
+	totalCacheLookups(0),
+	totalCacheHits(0)
+{
+}
+
+// --------------------------------------------------------
+// Resets the per-frame statistics
+// --------------------------------------------------------
+void CullingSystem::BeginFrame()
+{
+	stats = {};
+}
+
+// --------------------------------------------------------
+// Forgets every cached result, so all entities are tested
+// again next frame
+// --------------------------------------------------------
+void CullingSystem::InvalidateCache()
+{
+	hasCameraEpoch = false;
+	mainCache.clear();
+	shadowCaches.clear();
+	totalCacheLookups = 0;
+	totalCacheHits = 0;
+}
+
+// --------------------------------------------------------
+// Fraction of static entity tests that were skipped by
+// reusing an earlier result since the cache was invalidated
+// --------------------------------------------------------
+float CullingSystem::GetCacheHitRate()
+{
+	if (totalCacheLookups == 0)
+		return 0.0f;
+
+	return (float)((double)totalCacheHits / (double)totalCacheLookups);
+}
+
+// --------------------------------------------------------
+// Finds the entities that should be drawn by the camera
+//
+// screenHeight - Height of the render target in pixels
+// visibleEntities - Filled with the indices of the entities to draw
+// candidates - Indices of the only entities to test, or null to test them all
+// --------------------------------------------------------
+void CullingSystem::CullMainPass(
+	std::shared_ptr<Camera> camera,
+	float screenHeight,
+	const std::vector<std::shared_ptr<GameEntity>>& entities,
+	std::vector<int>* visibleEntities,
+	const std::vector<int>* candidates)
+{
+	visibleEntities->clear();
+
+	XMFLOAT4X4 viewMatrix = camera->GetViewMatrix();
+	XMFLOAT4X4 projMatrix = camera->GetProjectionMatrix();
+	XMMATRIX view = XMLoadFloat4x4(&viewMatrix);
+
+	XMFLOAT4 planes[6];
+	ExtractFrustumPlanes(view * XMLoadFloat4x4(&projMatrix), planes);
+
+	// Pixels covered by one world unit at a view depth of one (perspective),
+	// or at any depth (orthographic)
+	bool perspective = camera->GetProjectionType() == Camera::Perspective;
+	float pixelsPerUnit = perspective ?
+		screenHeight / (2.0f * tanf(camera->GetFov() * 0.5f)) :
+		screenHeight / camera->GetHeight();
+
+	// Static entities are tested against the camera as it was when the
+	// epoch started, so every result in the cache agrees with each other
+	XMMATRIX epochView = view;
+	XMFLOAT4 epochPlanes[6];
+	XMVECTOR epochPosition = XMVectorZero();
+	if (temporalCaching)
+	{
+		UpdateCameraEpoch(camera, screenHeight);
+
+		epochView = XMMatrixLookToLH(
+			XMLoadFloat3(&epochCameraPosition),
+			XMLoadFloat3(&epochCameraForward),
+			XMLoadFloat3(&epochCameraUp));
+		ExtractFrustumPlanes(epochView * XMLoadFloat4x4(&epochCameraProj), epochPlanes);
+		epochPosition = XMLoadFloat3(&epochCameraPosition);
+	}
+
+	int count = candidates ? (int)candidates->size() : (int)entities.size();
+	for (int c = 0; c < count; c++)
+	{
+		int i = candidates ? (*candidates)[c] : c;
+
+		stats.mainTested++;
+		GameEntity* entity = entities[i].get();
+		float threshold = entity->GetMaterial()->GetMinScreenSize();
+
+		CullResult result;
+		if (temporalCaching && entity->IsStatic())
+		{
+			if (!Lookup(mainCache, entity, cameraEpoch, threshold, &result))
+			{
+				// Grow the sphere by how far any part of it could shift in view
+				// before a new epoch starts, so the result holds until then
+				BoundingSphere sphere = entity->GetWorldBoundingSphere();
+				float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&sphere.Center) - epochPosition));
+				sphere.Radius += cameraMoveThreshold + (distance + sphere.Radius) * cameraTurnThreshold;
+
+				result = TestSphere(epochPlanes, epochView, sphere, perspective, pixelsPerUnit, threshold);
+				mainCache[entity] = { result, cameraEpoch, entity->GetTransform()->GetVersion(), entity->GetMesh().get(), threshold };
+			}
+		}
+		else
+		{
+			result = TestSphere(planes, view, entity->GetWorldBoundingSphere(), perspective, pixelsPerUnit, threshold);
+		}
+
+		switch (result)
+		{
+		case Visible: visibleEntities->push_back(i); break;
+		case OutsideFrustum: stats.mainFrustumCulled++; break;
+		case TooSmall: stats.mainScreenSizeCulled++; break;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Finds the entities that should be rendered into one
+// shadow map face
+//
+// The size threshold is measured in shadow map texels, which
+// are found from the light's projection matrix so it works for
+// both orthographic (directional) and perspective (point and spot) lights
+//
+// shadowIndex - Which shadow map face is being rendered
+// light - The light the face belongs to, used to tell when it moves
+// shadowCasters - Filled with the indices of the entities to render
+// --------------------------------------------------------
+void CullingSystem::CullShadowPass(
+	int shadowIndex,
+	const Light& light,
+	DirectX::XMFLOAT4X4 lightView,
+	DirectX::XMFLOAT4X4 lightProj,
+	int shadowMapResolution,
+	const std::vector<std::shared_ptr<GameEntity>>& entities,
+	std::vector<int>* shadowCasters)
+{
+	shadowCasters->clear();
+
+	XMMATRIX view = XMLoadFloat4x4(&lightView);
+
+	XMFLOAT4 planes[6];
+	ExtractFrustumPlanes(view * XMLoadFloat4x4(&lightProj), planes);
+
+	// Perspective projections scale by view depth, orthographic ones don't
+	bool perspective = lightProj._34 != 0.0f;
+	float texelsPerUnit = fabsf(lightProj._22) * shadowMapResolution * 0.5f;
+
+	// Anything cached for this face is only valid while its light stays put
+	ShadowFaceCache* face = nullptr;
+	if (temporalCaching)
+	{
+		if (shadowIndex >= shadowCaches.size())
+			shadowCaches.resize(shadowIndex + 1);
+
+		face = &shadowCaches[shadowIndex];
+		if (face->epoch == 0 || face->resolution != shadowMapResolution || LightMoved(face->light, light))
+		{
+			face->light = light;
+			face->resolution = shadowMapResolution;
+			face->epoch = ++nextEpoch;
+			face->entities.clear();
+		}
+	}
+
+	for (int i = 0; i < entities.size(); i++)
+	{
+		stats.shadowTested++;
+		GameEntity* entity = entities[i].get();
+		float threshold = entity->GetMaterial()->GetMinShadowScreenSize();
+
+		CullResult result;
+		if (face && entity->IsStatic())
+		{
+			if (!Lookup(face->entities, entity, face->epoch, threshold, &result))
+			{
+				result = TestSphere(planes, view, entity->GetWorldBoundingSphere(), perspective, texelsPerUnit, threshold);
+				face->entities[entity] = { result, face->epoch, entity->GetTransform()->GetVersion(), entity->GetMesh().get(), threshold };
+			}
+		}
+		else
+		{
+			result = TestSphere(planes, view, entity->GetWorldBoundingSphere(), perspective, texelsPerUnit, threshold);
+		}
+
+		switch (result)
+		{
+		case Visible: shadowCasters->push_back(i); break;
+		case OutsideFrustum: stats.shadowFrustumCulled++; break;
+		case TooSmall: stats.shadowScreenSizeCulled++; break;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Runs the frustum and screen size tests on one sphere
+//
+// pixelsPerUnit - Pixels covered by one world unit at a view
+//                 depth of one, or at any depth when orthographic
+// threshold - Smallest projected diameter worth drawing
+// --------------------------------------------------------
+CullingSystem::CullResult CullingSystem::TestSphere(
+	const XMFLOAT4 planes[6],
+	FXMMATRIX view,
+	const BoundingSphere& sphere,
+	bool perspective,
+	float pixelsPerUnit,
+	float threshold)
+{
+	if (frustumCulling && !SphereInFrustum(planes, sphere))
+		return OutsideFrustum;
+
+	if (screenSizeCulling)
+	{
+		float depth = XMVectorGetZ(XMVector3TransformCoord(XMLoadFloat3(&sphere.Center), view));
+
+		// Never cull something the camera is inside of
+		if (!perspective || depth > sphere.Radius)
+		{
+			float diameter = 2.0f * sphere.Radius * pixelsPerUnit / (perspective ? depth : 1.0f);
+			if (diameter < threshold)
+				return TooSmall;
+		}
+	}
+
+	return Visible;
+}
+
+// --------------------------------------------------------
+// Looks for a result for an entity that is still valid, which
+// means nothing it was based on has changed since
+//
+// Returns true and fills in result if one was found
+// --------------------------------------------------------
+bool CullingSystem::Lookup(
+	const std::unordered_map<const GameEntity*, CachedVisibility>& cache,
+	GameEntity* entity,
+	unsigned int epoch,
+	float threshold,
+	CullResult* result)
+{
+	stats.cacheLookups++;
+	totalCacheLookups++;
+
+	auto it = cache.find(entity);
+	if (it == cache.end())
+		return false;
+
+	const CachedVisibility& cached = it->second;
+	if (cached.epoch != epoch ||
+		cached.transformVersion != entity->GetTransform()->GetVersion() ||
+		cached.mesh != entity->GetMesh().get() ||
+		cached.threshold != threshold)
+		return false;
+
+	stats.cacheHits++;
+	totalCacheHits++;
+	*result = cached.result;
+	return true;
+}
+
+// --------------------------------------------------------
+// Starts a new camera epoch when the camera has moved or turned
+// far enough from where the current one started, or when its
+// projection has changed at all
+// --------------------------------------------------------
+void CullingSystem::UpdateCameraEpoch(std::shared_ptr<Camera> camera, float screenHeight)
+{
+	XMFLOAT3 position = camera->GetTransform()->GetPosition();
+	XMFLOAT3 forward = camera->GetTransform()->GetForward();
+	XMFLOAT3 up = camera->GetTransform()->GetUp();
+	XMFLOAT4X4 proj = camera->GetProjectionMatrix();
+
+	if (hasCameraEpoch)
+	{
+		float moved = XMVectorGetX(XMVector3Length(XMLoadFloat3(&position) - XMLoadFloat3(&epochCameraPosition)));
+		float turnedForward = XMVectorGetX(XMVector3AngleBetweenVectors(XMLoadFloat3(&forward), XMLoadFloat3(&epochCameraForward)));
+		float turnedUp = XMVectorGetX(XMVector3AngleBetweenVectors(XMLoadFloat3(&up), XMLoadFloat3(&epochCameraUp)));
+
+		if (moved <= cameraMoveThreshold &&
+			turnedForward <= cameraTurnThreshold &&
+			turnedUp <= cameraTurnThreshold &&
+			screenHeight == epochScreenHeight &&
+			memcmp(&proj, &epochCameraProj, sizeof(XMFLOAT4X4)) == 0)
+			return;
+	}
+
+	hasCameraEpoch = true;
+	cameraEpoch = ++nextEpoch;
+	epochCameraPosition = position;
+	epochCameraForward = forward;
+	epochCameraUp = up;
+	epochCameraProj = proj;
+	epochScreenHeight = screenHeight;
+}
+
+// --------------------------------------------------------
+// Checks if anything that places a light's shadow maps has changed
+// - Color and intensity don't affect what casts shadows
+// --------------------------------------------------------
+bool CullingSystem::LightMoved(const Light& a, const Light& b)
+{
+	return a.type != b.type ||
+		a.castsShadows != b.castsShadows ||
+		a.range != b.range ||
+		a.spotFalloff != b.spotFalloff ||
+		memcmp(&a.position, &b.position, sizeof(XMFLOAT3)) != 0 ||
+		memcmp(&a.direction, &b.direction, sizeof(XMFLOAT3)) != 0;
+}
+
+// --------------------------------------------------------
+// Checks if any part of a sphere is inside the frustum
+// --------------------------------------------------------
+bool CullingSystem::SphereInFrustum(const XMFLOAT4 planes[6], const BoundingSphere& sphere)
+{
+	XMVECTOR center = XMLoadFloat3(&sphere.Center);
+	for (int p = 0; p < 6; p++)
+	{
+		float distance = XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&planes[p]), center));
+		if (distance < -sphere.Radius)
+			return false;
+	}
+
+	return true;
+}
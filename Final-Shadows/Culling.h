@@ -0,0 +1,145 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "Camera.h"
+#include "GameEntity.h"
+#include "Lights.h"
+
+// --------------------------------------------------------
+// Counts of what the culling system removed this frame
+// --------------------------------------------------------
+struct CullingStats
+{
+	int mainTested;
+	int mainFrustumCulled;
+	int mainScreenSizeCulled;
+	int shadowTested;
+	int shadowFrustumCulled;
+	int shadowScreenSizeCulled;
+	int cacheLookups;		// Static entities that could have reused an earlier result
+	int cacheHits;			// Lookups that did reuse one instead of being tested again
+};
+
+// --------------------------------------------------------
+// Decides which entities are worth drawing in each pass
+//
+// Entities are removed when their bounding sphere is outside
+// the pass's frustum, or when it projects to fewer pixels
+// (or shadow map texels) than their material's threshold
+//
+// Results for static entities are remembered between frames:
+//  - Main pass results are reused until the camera moves or turns
+//    past a threshold, which starts a new camera epoch. They're
+//    tested with a margin covering that much movement, so nothing
+//    that comes into view before then is missed
+//  - Shadow pass results are reused for as long as the light
+//    that owns the shadow map face stays where it is
+// --------------------------------------------------------
+class CullingSystem
+{
+public:
+	CullingSystem();
+
+	void BeginFrame();
+	void CullMainPass(
+		std::shared_ptr<Camera> camera,
+		float screenHeight,
+		const std::vector<std::shared_ptr<GameEntity>>& entities,
+		std::vector<int>* visibleEntities,
+		const std::vector<int>* candidates = 0);
+	void CullShadowPass(
+		int shadowIndex,
+		const Light& light,
+		DirectX::XMFLOAT4X4 lightView,
+		DirectX::XMFLOAT4X4 lightProj,
+		int shadowMapResolution,
+		const std::vector<std::shared_ptr<GameEntity>>& entities,
+		std::vector<int>* shadowCasters);
+	void InvalidateCache();
+
+	const CullingStats& GetStats() { return stats; }
+	float GetCacheHitRate();
+	bool GetFrustumCulling() { return frustumCulling; }
+	bool GetScreenSizeCulling() { return screenSizeCulling; }
+	bool GetTemporalCaching() { return temporalCaching; }
+	float GetCameraMoveThreshold() { return cameraMoveThreshold; }
+	float GetCameraTurnThreshold() { return cameraTurnThreshold; }
+	unsigned int GetCameraEpoch() { return cameraEpoch; }
+
+	void SetFrustumCulling(bool enabled) { frustumCulling = enabled; InvalidateCache(); }
+	void SetScreenSizeCulling(bool enabled) { screenSizeCulling = enabled; InvalidateCache(); }
+	void SetTemporalCaching(bool enabled) { temporalCaching = enabled; InvalidateCache(); }
+	void SetCameraMoveThreshold(float distance) { cameraMoveThreshold = distance; InvalidateCache(); }
+	void SetCameraTurnThreshold(float radians) { cameraTurnThreshold = radians; InvalidateCache(); }
+
+private:
+	enum CullResult
+	{
+		Visible,
+		OutsideFrustum,
+		TooSmall
+	};
+
+	// What was decided about one entity, and what it was decided from
+	struct CachedVisibility
+	{
+		CullResult result;
+		unsigned int epoch;
+		unsigned int transformVersion;
+		const Mesh* mesh;
+		float threshold;
+	};
+
+	// Cached results for everything rendered into one shadow map face
+	struct ShadowFaceCache
+	{
+		Light light;
+		int resolution;
+		unsigned int epoch;
+		std::unordered_map<const GameEntity*, CachedVisibility> entities;
+	};
+
+	CullResult TestSphere(
+		const DirectX::XMFLOAT4 planes[6],
+		DirectX::FXMMATRIX view,
+		const DirectX::BoundingSphere& sphere,
+		bool perspective,
+		float pixelsPerUnit,
+		float threshold);
+	bool Lookup(
+		const std::unordered_map<const GameEntity*, CachedVisibility>& cache,
+		GameEntity* entity,
+		unsigned int epoch,
+		float threshold,
+		CullResult* result);
+	void UpdateCameraEpoch(std::shared_ptr<Camera> camera, float screenHeight);
+	static bool LightMoved(const Light& a, const Light& b);
+	static bool SphereInFrustum(const DirectX::XMFLOAT4 planes[6], const DirectX::BoundingSphere& sphere);
+
+	CullingStats stats;
+	bool frustumCulling;
+	bool screenSizeCulling;
+
+	// Temporal caching
+	bool temporalCaching;
+	float cameraMoveThreshold;
+	float cameraTurnThreshold;
+	unsigned int cameraEpoch;
+	unsigned int nextEpoch;
+	bool hasCameraEpoch;
+	DirectX::XMFLOAT3 epochCameraPosition;
+	DirectX::XMFLOAT3 epochCameraForward;
+	DirectX::XMFLOAT3 epochCameraUp;
+	DirectX::XMFLOAT4X4 epochCameraProj;
+	float epochScreenHeight;
+	std::unordered_map<const GameEntity*, CachedVisibility> mainCache;
+	std::vector<ShadowFaceCache> shadowCaches;
+
+	// Running totals since the cache was last invalidated
+	unsigned long long totalCacheLookups;
+	unsigned long long totalCacheHits;
+};
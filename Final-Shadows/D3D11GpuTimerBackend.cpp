@@ -0,0 +1,95 @@
+#include "D3D11GpuTimerBackend.h"
+
+D3D11GpuTimerBackend::D3D11GpuTimerBackend(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+	:
+	device(device),
+	context(context)
+{
+}
+
+// --------------------------------------------------------
+// Creates any queries that don't exist yet
+// --------------------------------------------------------
+void D3D11GpuTimerBackend::Reserve(unsigned int slotCount, unsigned int queryCount)
+{
+	if (slots.size() < slotCount)
+		slots.resize(slotCount);
+
+	D3D11_QUERY_DESC disjointDesc = {};
+	disjointDesc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+	D3D11_QUERY_DESC timestampDesc = {};
+	timestampDesc.Query = D3D11_QUERY_TIMESTAMP;
+
+	for (auto& slot : slots)
+	{
+		if (!slot.disjoint)
+			device->CreateQuery(&disjointDesc, slot.disjoint.GetAddressOf());
+
+		for (unsigned int q = (unsigned int)slot.timestamps.size(); q < queryCount; q++)
+		{
+			Microsoft::WRL::ComPtr<ID3D11Query> query;
+			device->CreateQuery(&timestampDesc, query.GetAddressOf());
+			slot.timestamps.push_back(query);
+		}
+	}
+}
+
+void D3D11GpuTimerBackend::BeginFrame(unsigned int slot)
+{
+	if (slot < slots.size() && slots[slot].disjoint)
+		context->Begin(slots[slot].disjoint.Get());
+}
+
+void D3D11GpuTimerBackend::EndFrame(unsigned int slot)
+{
+	if (slot < slots.size() && slots[slot].disjoint)
+		context->End(slots[slot].disjoint.Get());
+}
+
+// --------------------------------------------------------
+// Timestamp queries only have an end, which is when the GPU
+// writes the time
+// --------------------------------------------------------
+void D3D11GpuTimerBackend::Timestamp(unsigned int slot, unsigned int query, ID3D11DeviceContext* context)
+{
+	if (slot >= slots.size() || query >= slots[slot].timestamps.size() || !slots[slot].timestamps[query])
+		return;
+
+	if (!context)
+		context = this->context.Get();
+	context->End(slots[slot].timestamps[query].Get());
+}
+
+// --------------------------------------------------------
+// Reads the frame's clock frequency without waiting
+// - DONOTFLUSH keeps asking from pushing queued work to the
+//   GPU early
+// --------------------------------------------------------
+bool D3D11GpuTimerBackend::GetFrequency(unsigned int slot, unsigned long long* frequency, bool* disjoint)
+{
+	if (slot >= slots.size() || !slots[slot].disjoint)
+		return false;
+
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT data;
+	if (context->GetData(slots[slot].disjoint.Get(), &data, sizeof(data), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		return false;
+
+	*frequency = data.Frequency;
+	*disjoint = data.Disjoint != FALSE;
+	return true;
+}
+
+bool D3D11GpuTimerBackend::GetTimestamp(unsigned int slot, unsigned int query, unsigned long long* ticks)
+{
+	if (slot >= slots.size() || query >= slots[slot].timestamps.size() || !slots[slot].timestamps[query])
+		return false;
+
+	UINT64 data;
+	if (context->GetData(slots[slot].timestamps[query].Get(), &data, sizeof(data), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		return false;
+
+	*ticks = data;
+	return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <vector>
+#include "GpuProfiler.h"
+
+// --------------------------------------------------------
+// Timestamps from Direct3D 11 timestamp queries, with a
+// disjoint query around each frame for the clock's frequency
+// - Timestamps may be written on deferred contexts, and land
+//   in the frame whose command list they're played back in
+// --------------------------------------------------------
+class D3D11GpuTimerBackend : public IGpuTimerBackend
+{
+public:
+	D3D11GpuTimerBackend(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	void Reserve(unsigned int slotCount, unsigned int queryCount);
+	void BeginFrame(unsigned int slot);
+	void EndFrame(unsigned int slot);
+	void Timestamp(unsigned int slot, unsigned int query, ID3D11DeviceContext* context);
+	bool GetFrequency(unsigned int slot, unsigned long long* frequency, bool* disjoint);
+	bool GetTimestamp(unsigned int slot, unsigned int query, unsigned long long* ticks);
+
+private:
+	struct QuerySlot
+	{
+		Microsoft::WRL::ComPtr<ID3D11Query> disjoint;
+		std::vector<Microsoft::WRL::ComPtr<ID3D11Query>> timestamps;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	std::vector<QuerySlot> slots;
+};
@@ -0,0 +1,81 @@
+#include "D3D11StateBackend.h"
+
+// The cache's own names for Direct3D's values and limits
+static_assert(TOPOLOGY_TRIANGLE_LIST == D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST, "Topologies should match Direct3D's");
+static_assert(TOPOLOGY_TRIANGLE_STRIP == D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, "Topologies should match Direct3D's");
+static_assert(INDEX_FORMAT_R32_UINT == DXGI_FORMAT_R32_UINT, "Index formats should match DXGI's");
+static_assert(INDEX_FORMAT_R16_UINT == DXGI_FORMAT_R16_UINT, "Index formats should match DXGI's");
+static_assert(STATE_VERTEX_BUFFER_SLOTS == D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT, "Slot counts should match Direct3D's");
+static_assert(STATE_CONSTANT_BUFFER_SLOTS == D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, "Slot counts should match Direct3D's");
+static_assert(STATE_SHADER_RESOURCE_SLOTS == D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT, "Slot counts should match Direct3D's");
+static_assert(STATE_SAMPLER_SLOTS == D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT, "Slot counts should match Direct3D's");
+
+D3D11StateBackend::D3D11StateBackend(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+	:
+	context(context)
+{
+	// Only needed for binding part of a constant buffer
+	context.As(&context1);
+}
+
+void D3D11StateBackend::SetInputLayout(ID3D11InputLayout* layout) { context->IASetInputLayout(layout); }
+void D3D11StateBackend::SetPrimitiveTopology(StateTopology topology) { context->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)topology); }
+void D3D11StateBackend::SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset) { context->IASetVertexBuffers(slot, 1, &buffer, &stride, &offset); }
+void D3D11StateBackend::SetIndexBuffer(ID3D11Buffer* buffer, StateIndexFormat format, unsigned int offset) { context->IASetIndexBuffer(buffer, (DXGI_FORMAT)format, offset); }
+void D3D11StateBackend::SetVertexShader(ID3D11VertexShader* shader) { context->VSSetShader(shader, 0, 0); }
+void D3D11StateBackend::SetPixelShader(ID3D11PixelShader* shader) { context->PSSetShader(shader, 0, 0); }
+
+void D3D11StateBackend::SetConstantBuffer(StateStage stage, unsigned int slot, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int count)
+{
+	if (count > 0 && context1)
+	{
+		if (stage == STAGE_VERTEX) context1->VSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &count);
+		else context1->PSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &count);
+	}
+	else
+	{
+		if (stage == STAGE_VERTEX) context->VSSetConstantBuffers(slot, 1, &buffer);
+		else context->PSSetConstantBuffers(slot, 1, &buffer);
+	}
+}
+
+void D3D11StateBackend::SetShaderResource(StateStage stage, unsigned int slot, ID3D11ShaderResourceView* srv)
+{
+	if (stage == STAGE_VERTEX) context->VSSetShaderResources(slot, 1, &srv);
+	else context->PSSetShaderResources(slot, 1, &srv);
+}
+
+void D3D11StateBackend::SetSampler(StateStage stage, unsigned int slot, ID3D11SamplerState* sampler)
+{
+	if (stage == STAGE_VERTEX) context->VSSetSamplers(slot, 1, &sampler);
+	else context->PSSetSamplers(slot, 1, &sampler);
+}
+
+void D3D11StateBackend::SetShaderResources(StateStage stage, unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* srvs)
+{
+	if (stage == STAGE_VERTEX) context->VSSetShaderResources(startSlot, count, srvs);
+	else context->PSSetShaderResources(startSlot, count, srvs);
+}
+
+void D3D11StateBackend::SetSamplers(StateStage stage, unsigned int startSlot, unsigned int count, ID3D11SamplerState* const* samplerStates)
+{
+	if (stage == STAGE_VERTEX) context->VSSetSamplers(startSlot, count, samplerStates);
+	else context->PSSetSamplers(startSlot, count, samplerStates);
+}
+
+void D3D11StateBackend::UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size) { context->UpdateSubresource(buffer, 0, 0, data, 0, 0); }
+void D3D11StateBackend::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) { context->DrawIndexed(indexCount, startIndex, baseVertex); }
+
+void D3D11StateBackend::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	context->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void D3D11StateBackend::ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4]) { context->ClearRenderTargetView(rtv, color); }
+void D3D11StateBackend::ClearDepth(ID3D11DepthStencilView* dsv, float depth) { context->ClearDepthStencilView(dsv, D3D11_CLEAR_DEPTH, depth, 0); }
+void D3D11StateBackend::SetViewport(const StateViewport& viewport)
+{
+	D3D11_VIEWPORT d3dViewport = { viewport.topLeftX, viewport.topLeftY, viewport.width, viewport.height, viewport.minDepth, viewport.maxDepth };
+	context->RSSetViewports(1, &d3dViewport);
+}
+void D3D11StateBackend::SetRenderTargets(ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv) { context->OMSetRenderTargets(rtv ? 1 : 0, &rtv, dsv); }
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include <wrl/client.h>
+#include "StateCache.h"
+
+// --------------------------------------------------------
+// Sends state changes straight to a Direct3D context
+// --------------------------------------------------------
+class D3D11StateBackend : public IStateBackend
+{
+public:
+	D3D11StateBackend(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	void SetInputLayout(ID3D11InputLayout* layout);
+	void SetPrimitiveTopology(StateTopology topology);
+	void SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset);
+	void SetIndexBuffer(ID3D11Buffer* buffer, StateIndexFormat format, unsigned int offset);
+	void SetVertexShader(ID3D11VertexShader* shader);
+	void SetPixelShader(ID3D11PixelShader* shader);
+	void SetConstantBuffer(StateStage stage, unsigned int slot, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int count);
+	void SetShaderResource(StateStage stage, unsigned int slot, ID3D11ShaderResourceView* srv);
+	void SetSampler(StateStage stage, unsigned int slot, ID3D11SamplerState* sampler);
+	void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size);
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance);
+	void ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4]);
+	void ClearDepth(ID3D11DepthStencilView* dsv, float depth);
+	void SetViewport(const StateViewport& viewport);
+	void SetRenderTargets(ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv);
+	void SetShaderResources(StateStage stage, unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* srvs);
+	void SetSamplers(StateStage stage, unsigned int startSlot, unsigned int count, ID3D11SamplerState* const* samplerStates);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> context1;
+};
@@ -0,0 +1,26 @@
+#include "Frustum.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Pulls the 6 normalized frustum planes out of a combined
+// view-projection matrix (Gribb/Hartmann)
+// - Planes face inward, so points inside have positive distances
+// --------------------------------------------------------
+void ExtractFrustumPlanes(FXMMATRIX viewProj, XMFLOAT4 planes[6])
+{
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, viewProj);
+
+	XMVECTOR col0 = XMVectorSet(m._11, m._21, m._31, m._41);
+	XMVECTOR col1 = XMVectorSet(m._12, m._22, m._32, m._42);
+	XMVECTOR col2 = XMVectorSet(m._13, m._23, m._33, m._43);
+	XMVECTOR col3 = XMVectorSet(m._14, m._24, m._34, m._44);
+
+	XMStoreFloat4(&planes[0], XMPlaneNormalize(col3 + col0)); // Left
+	XMStoreFloat4(&planes[1], XMPlaneNormalize(col3 - col0)); // Right
+	XMStoreFloat4(&planes[2], XMPlaneNormalize(col3 + col1)); // Bottom
+	XMStoreFloat4(&planes[3], XMPlaneNormalize(col3 - col1)); // Top
+	XMStoreFloat4(&planes[4], XMPlaneNormalize(col2));        // Near (depth is 0 to 1 in Direct3D)
+	XMStoreFloat4(&planes[5], XMPlaneNormalize(col3 - col2)); // Far
+}
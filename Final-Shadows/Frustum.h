@@ -0,0 +1,7 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// Inward facing planes of a view-projection matrix's frustum, in
+// the order left, right, bottom, top, near, far
+void ExtractFrustumPlanes(DirectX::FXMMATRIX viewProj, DirectX::XMFLOAT4 planes[6]);
@@ -4,6 +4,16 @@
 #include "Helpers.h"
 #include "ImGuiMenus.h"
 #include "Material.h"
+#include "ShaderLayouts.h"
+#include "D3D11GpuTimerBackend.h"
+#include "D3D11StateBackend.h"
+#include "LightMatrices.h"
+#include "Benchmarks.h"
+#include "BenchmarkReport.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
 
 // Needed for a helper function to load pre-compiled shader files
 #pragma comment(lib, "d3dcompiler.lib")
@@ -39,6 +49,30 @@ Game::Game(HINSTANCE hInstance)
 	XMFLOAT4 camStartRot;
 	XMStoreFloat4(&camStartRot, XMQuaternionRotationAxis(XMVectorSet(1,0,0,0), Deg2Rad(30)));
 	camera = std::make_shared<Camera>(XMFLOAT3(-2.0f, 22.0f, -28.3f), camStartRot, (float)1280 / 720);
+
+	selectedEntity = -1;
+	lastPickHit = false;
+	lastPick = {};
+	lastPickTime = 0.0f;
+
+	culling = std::make_shared<CullingSystem>();
+	portals = std::make_shared<PortalSystem>();
+	pvs = std::make_shared<PVS>();
+	renderQueue = std::make_shared<RenderQueue>();
+	pvsSettings = PVS::DefaultSettings();
+
+	frameCapture = std::make_shared<CommandStream>();
+	previousCapture = std::make_shared<CommandStream>();
+	frameCaptureStats = {};
+	frameCaptureDifference = -1;
+	captureNextFrame = false;
+
+	// Off by default, and switched with SetPoolTextures() - see CreateMaterials()
+	poolTextures = false;
+
+	depthPrePass = false;
+	depthPrePassRecordMs = 0.0f;
+	shadingRecordMs = 0.0f;
 }
 
 // --------------------------------------------------------
@@ -48,6 +82,10 @@ Game::Game(HINSTANCE hInstance)
 // --------------------------------------------------------
 Game::~Game()
 {
+	// Shaders outliving the game shouldn't keep using its ring
+	ISimpleShader::ConstantRing = 0;
+	ISimpleShader::States = 0;
+
 	// ImGui clean up
 	ImGui_ImplDX11_Shutdown();
 	ImGui_ImplWin32_Shutdown();
@@ -60,8 +98,36 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
+	// Every shader uploads its constant buffers through one shared
+	// ring, as long as the device supports binding parts of a buffer
+	constantRing = std::make_shared<ConstantBufferRing>(device, context);
+	if (constantRing->IsSupported())
+		ISimpleShader::ConstantRing = constantRing.get();
+
+	// Shader and mesh bindings skip anything that's already bound
+	stateCache = std::make_shared<StateCache>(std::make_shared<D3D11StateBackend>(context));
+	ISimpleShader::States = stateCache.get();
+
+	// Runs of entities sharing a mesh and material are drawn as instances
+	instanceBatcher = std::make_shared<InstanceBatcher>(device, context);
+
+	// Shadow maps and the main pass are recorded on worker threads
+	recorder = std::make_shared<ParallelRecorder>(device, context, stateCache, instanceBatcher);
+
+	// Each shadow map adds its own scope under the shadow maps as it's set up
+	gpuProfiler = std::make_shared<GpuProfiler>(std::make_shared<D3D11GpuTimerBackend>(device, context));
+	gpuShadowMapsScope = gpuProfiler->AddScope("Shadow maps");
+	gpuMainPassScope = gpuProfiler->AddScope("Main pass");
+	gpuDepthPrePassScope = gpuProfiler->AddScope("Depth pre-pass", gpuMainPassScope);
+	gpuShadingScope = gpuProfiler->AddScope("Shading", gpuMainPassScope);
+	gpuSkyScope = gpuProfiler->AddScope("Sky", gpuMainPassScope);
+	gpuImGuiScope = gpuProfiler->AddScope("ImGui");
+
 	// Helper methods for each init task
 	LoadShaders();
+#if defined(DEBUG) || defined(_DEBUG)
+	CheckShaderLayouts();
+#endif
 	CreateGeometry();
 	LoadTextures();
 
@@ -83,11 +149,28 @@ void Game::Init()
 
 	device->CreateSamplerState(&samplerDesc, texSampler.GetAddressOf());
 
+	// After a depth pre-pass, the main pass only shades fragments whose depth
+	// matches the one already in the buffer, and has nothing left to write
+	D3D11_DEPTH_STENCIL_DESC depthEqualDesc = {};
+	depthEqualDesc.DepthEnable = true;
+	depthEqualDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+	depthEqualDesc.DepthFunc = D3D11_COMPARISON_EQUAL;
+	device->CreateDepthStencilState(&depthEqualDesc, depthEqualState.GetAddressOf());
+
 	CreateMaterials();
 	CreateEntities();
 	SetupLights();
 	SetupShadows(1024);
 
+	// Indoor scenes describe their cells and portals in a file next to their models
+	// - The snowglobe's only splits the inside of the globe in two, so portal culling
+	//   only does anything once the camera is in there
+	portals->Load(WideToNarrow(FixPath(L"../../Assets/Scenes/snowglobe.portals")));
+
+	// Use the last baked PVS, as long as the static entities haven't changed since
+	if (pvs->Load(WideToNarrow(FixPath(L"../../Assets/Scenes/snowglobe.pvs"))) && !pvs->Matches(entities))
+		pvs->Clear();
+
 	// Set initial graphics API state
 	//  - These settings persist until we change them
 	//  - Some of these, like the primitive topology & input layout, probably won't change
@@ -119,8 +202,91 @@ void Game::LoadShaders()
 	animatedPixelShader = std::make_shared<SimplePixelShader>(device, context,
 		FixPath(L"AnimatedPixelShader.cso").c_str());
 
+	pooledPixelShader = std::make_shared<SimplePixelShader>(device, context,
+		FixPath(L"PooledPixelShader.cso").c_str());
+
 	shadowMapVertexShader = std::make_shared<SimpleVertexShader>(device, context,
 		FixPath(L"ShadowMapVertexShader.cso").c_str());
+
+	// The shadow map shader is used for every caster of every shadow map,
+	// so its world matrix is looked up once here rather than by name each draw
+	// - Handles work for any copy of the same shader, such as each shadow map's
+	shadowWorldHandle = shadowMapVertexShader->GetVariableHandle("world");
+
+	// Versions of the above that read each entity's matrices from an instance buffer
+	instancedVertexShader = std::make_shared<SimpleVertexShader>(device, context,
+		FixPath(L"InstancedVertexShader.cso").c_str());
+
+	instancedShadowMapVertexShader = std::make_shared<SimpleVertexShader>(device, context,
+		FixPath(L"InstancedShadowMapVertexShader.cso").c_str());
+
+	// The depth pre-pass only needs positions, same as a shadow map, so it
+	// gets its own copies of those shaders holding the camera's matrices
+	depthPrePassVertexShader = std::make_shared<SimpleVertexShader>(device, context,
+		FixPath(L"ShadowMapVertexShader.cso").c_str());
+	depthPrePassInstancedVertexShader = std::make_shared<SimpleVertexShader>(device, context,
+		FixPath(L"InstancedShadowMapVertexShader.cso").c_str());
+
+	// Smaller variants of the main pixel shader, built by the BuildShaderVariants target,
+	// are loaded as the scene needs them - the full shader above is the fallback
+	shaderPermutations = std::make_shared<ShaderPermutationCache>(device, context, pixelShader);
+}
+
+// --------------------------------------------------------
+// Complains loudly if ShaderLayouts.h no longer matches the
+// shaders that were just loaded - a changed cbuffer would
+// otherwise only show up as a hash mismatch on its first copy
+// --------------------------------------------------------
+void Game::CheckShaderLayouts()
+{
+	if (ShaderLayoutGenerator::IsUpToDate(ShaderLayoutsFile(), GetShaderLayoutSources(), { "Lights.h" }))
+		return;
+
+	const char* message =
+		"ShaderLayouts.h doesn't match the compiled shaders.\n"
+		"Run the game with --write-shader-layouts to regenerate it, then rebuild.\n";
+	printf_s("%s", message);
+	OutputDebugStringA(message);
+	MessageBoxA(hWnd, message, "Shader layouts out of date", MB_OK | MB_ICONERROR);
+}
+
+// --------------------------------------------------------
+// The checked-in copy of the generated constant buffer structs,
+// two folders up from the executable
+// --------------------------------------------------------
+std::string Game::ShaderLayoutsFile()
+{
+	return WideToNarrow(FixPath(L"../../ShaderLayouts.h"));
+}
+
+// --------------------------------------------------------
+// The loaded shaders that ShaderLayouts.h has structs for
+// --------------------------------------------------------
+std::vector<ShaderLayoutSource> Game::GetShaderLayoutSources()
+{
+	return
+	{
+		{ "VertexShader", &vertexShader->GetReflection() },
+		{ "PixelShader", &pixelShader->GetReflection() },
+		{ "AnimatedPixelShader", &animatedPixelShader->GetReflection() },
+		{ "ShadowMapVertexShader", &shadowMapVertexShader->GetReflection() },
+		{ "InstancedVertexShader", &instancedVertexShader->GetReflection() },
+		{ "InstancedShadowMapVertexShader", &instancedShadowMapVertexShader->GetReflection() },
+	};
+}
+
+// --------------------------------------------------------
+// Regenerates the checked-in ShaderLayouts.h from the compiled
+// shaders instead of running the game, returning 0 on success
+// --------------------------------------------------------
+int Game::WriteShaderLayouts()
+{
+	ShowWindow(hWnd, SW_HIDE);
+	LoadShaders();
+
+	if (!ShaderLayoutGenerator::Write(ShaderLayoutsFile(), GetShaderLayoutSources(), { "Lights.h" }))
+		return 1;
+	return 0;
 }
 
 // --------------------------------------------------------
@@ -143,6 +309,10 @@ void Game::CreateEntities()
 	entities.push_back(std::make_shared<GameEntity>(meshes[1], materials[1]));
 	entities.push_back(std::make_shared<GameEntity>(meshes[3], materials[2]));
 
+	// None of the scene's entities move on their own, so culling can reuse their results
+	for (auto& e : entities)
+		e->SetStatic(true);
+
 	PositionGeometry();
 }
 
@@ -165,9 +335,62 @@ void Game::CreateMaterials()
 	mSnowman->SetNormal(srvDefaultNormalMap);
 	mSnowman->AddSampler("BasicSampler", texSampler);
 
+	mSnowglobe->SetPermutations(shaderPermutations);
+	mChristmasTree->SetPermutations(shaderPermutations);
+	mSnowman->SetPermutations(shaderPermutations);
+
 	materials.push_back(mSnowglobe);
 	materials.push_back(mChristmasTree);
 	materials.push_back(mSnowman);
+
+	// Textures matching in size and format can be packed into shared arrays,
+	// so materials drawing from the same arrays keep the same texture bindings
+	if (poolTextures)
+	{
+		texturePool = std::make_shared<TexturePool>(device, context);
+		for (auto& m : materials)
+			m->AddTexturesToPool(texturePool);
+
+		texturePool->Build();
+		for (auto& m : materials)
+			m->UseTexturePool(texturePool, pooledPixelShader);
+	}
+}
+
+// --------------------------------------------------------
+// Recreates the materials, such as after texture pooling is
+// switched, and points each entity at its material's replacement
+// - Changes made to the old materials in the UI are lost
+// --------------------------------------------------------
+void Game::RebuildMaterials()
+{
+	std::vector<std::shared_ptr<Material>> oldMaterials = materials;
+	materials.clear();
+	texturePool = 0;
+	CreateMaterials();
+
+	for (auto& e : entities)
+	{
+		auto found = std::find(oldMaterials.begin(), oldMaterials.end(), e->GetMaterial());
+		if (found != oldMaterials.end())
+			e->SetMaterial(materials[found - oldMaterials.begin()]);
+	}
+
+	SelectShaderPermutations();
+
+	// The old materials' ids would otherwise stay taken
+	renderQueue->ResetIds();
+}
+
+void Game::SetPoolTextures(bool pool)
+{
+	if (pool == poolTextures)
+		return;
+
+	// Before Init() there's nothing to rebuild yet
+	poolTextures = pool;
+	if (!materials.empty())
+		RebuildMaterials();
 }
 
 void Game::SetupLights()
@@ -207,7 +430,7 @@ void Game::SetupShadows(int resolution)
 	{
 		// Point lights require 6 shadow maps (A Texture Cube) while all other lights only require 1
 		if (lights[i].castsShadows == 1)
-			lights[i].type == LIGHT_TYPE_POINT ? numShadowMaps += 6 : numShadowMaps++;
+			numShadowMaps += LightMatrices::GetShadowFaceCount(lights[i]);
 		
 		// Store the current state's shadow casting settings
 		// When the user changes whether a light casts shadows through the UI, it will be noticeable by comparing the
@@ -215,8 +438,10 @@ void Game::SetupShadows(int resolution)
 		prevLightShadowSettings.push_back(lights[i].castsShadows);
 	}
 
-	// The Depth Stencil View is always the same for every shadow map
-	// but needs to be recreated each time it wants to render to a new texture, so keep the description in local scope
+	// The shaders only need to handle as many shadow maps as there now are
+	SelectShaderPermutations();
+
+	// The Depth Stencil View description is the same for every shadow map
 	shadowMapDsvDesc = {};
 	shadowMapDsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
 	shadowMapDsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
@@ -292,8 +517,8 @@ void Game::SetupShadows(int resolution)
 		if (lights[i].castsShadows == 1)
 		{
 			// Point lights require a Texture Cube while other lights only need 1 texture
-			int iterations = lights[i].type == LIGHT_TYPE_POINT ? 6 : 1;
-			for (int j = 0; j < iterations; j++)
+			int faces = LightMatrices::GetShadowFaceCount(lights[i]);
+			for (int j = 0; j < faces; j++)
 			{
 				Microsoft::WRL::ComPtr<ID3D11Texture2D> texShadowMap;
 				device->CreateTexture2D(&shadowMapTextureDesc, 0, texShadowMap.ReleaseAndGetAddressOf());
@@ -305,6 +530,30 @@ void Game::SetupShadows(int resolution)
 			}
 		}
 	}
+
+	// Each shadow map gets its own depth stencil view and shaders, so they
+	// can all be recorded at once
+	// - Shaders are kept when shadow maps are set up again, since loading them is slow
+	shadowFaces.resize(texShadowMaps.size());
+	for (int i = 0; i < shadowFaces.size(); i++)
+	{
+		device->CreateDepthStencilView(texShadowMaps[i].Get(), &shadowMapDsvDesc, shadowFaces[i].dsv.ReleaseAndGetAddressOf());
+
+		if (!shadowFaces[i].vertexShader)
+		{
+			shadowFaces[i].vertexShader = std::make_shared<SimpleVertexShader>(device, context,
+				FixPath(L"ShadowMapVertexShader.cso").c_str());
+			shadowFaces[i].instancedVertexShader = std::make_shared<SimpleVertexShader>(device, context,
+				FixPath(L"InstancedShadowMapVertexShader.cso").c_str());
+			shadowFaces[i].queue = std::make_shared<RenderQueue>();
+		}
+
+		// Faces dropped and added again time into the scope they had before,
+		// as the profiler has no way to remove one
+		if (i >= gpuShadowFaceScopes.size())
+			gpuShadowFaceScopes.push_back(gpuProfiler->AddScope("Shadow map " + std::to_string(i), gpuShadowMapsScope));
+		shadowFaces[i].gpuScope = gpuShadowFaceScopes[i];
+	}
 }
 
 
@@ -387,6 +636,8 @@ void Game::LoadTextures()
 
 void Game::UpdateUI(float dt)
 {
+	PROFILE_SCOPE("UpdateUI");
+
 	// Get a reference to our custom input manager
 	Input& input = Input::GetInstance();
 
@@ -439,6 +690,203 @@ void Game::UpdateGeometry()
 {
 }
 
+// --------------------------------------------------------
+// Switches each material to the smallest pixel shader
+// permutation that handles the current lights and shadow maps
+// --------------------------------------------------------
+void Game::SelectShaderPermutations()
+{
+	for (auto& m : materials)
+		m->SelectPermutation((int)lights.size(), numShadowMaps);
+}
+
+// --------------------------------------------------------
+// Sets the data that stays the same for the whole frame in
+// every shader used by a material
+// - These variables live in each shader's PerFrame constant
+//   buffer, so it's only uploaded by the first draw using it
+// - Each buffer is filled in as a whole from its struct in
+//   ShaderLayouts.h, which only copies into shaders whose
+//   layout matches the struct's
+// --------------------------------------------------------
+void Game::SetPerFrameData(float totalTime)
+{
+	std::vector<ISimpleShader*> vertexShaders;
+	std::vector<ISimpleShader*> pixelShaders;
+	vertexShaders.push_back(instancedVertexShader.get());
+	for (auto& m : materials)
+	{
+		if (std::find(vertexShaders.begin(), vertexShaders.end(), m->GetVertexShader().get()) == vertexShaders.end())
+			vertexShaders.push_back(m->GetVertexShader().get());
+		if (std::find(pixelShaders.begin(), pixelShaders.end(), m->GetPixelShader().get()) == pixelShaders.end())
+			pixelShaders.push_back(m->GetPixelShader().get());
+	}
+
+	// The instanced vertex shader's PerFrame buffer has the same layout, so takes the same struct
+	VertexShaderPerFrame vsPerFrame = {};
+	vsPerFrame.view = camera->GetViewMatrix();
+	vsPerFrame.proj = camera->GetProjectionMatrix();
+
+	for (ISimpleShader* vs : vertexShaders)
+		vs->SetBufferData(vsPerFrame);
+
+	PixelShaderPerFrame psPerFrame = {};
+	psPerFrame.cameraPosition = camera->GetTransform()->GetPosition();
+	for (size_t i = 0; i < lights.size() && i < _countof(psPerFrame.lights); i++)
+		psPerFrame.lights[i] = lights[i];
+
+	// The pixel shader needs the view and projection matrices used to create each Shadow Map
+	// so that it can interpret the Shadow Maps properly
+	// - They're last in the buffer, so only the ones in use are copied
+	size_t shadowMatrixCount = lightViewProjMatrices.size();
+	if (shadowMatrixCount > _countof(psPerFrame.lightViewProjs))
+		shadowMatrixCount = _countof(psPerFrame.lightViewProjs);
+	for (size_t i = 0; i < shadowMatrixCount; i++)
+		psPerFrame.lightViewProjs[i] = lightViewProjMatrices[i];
+	unsigned int psPerFrameSize = (unsigned int)(offsetof(PixelShaderPerFrame, lightViewProjs) + shadowMatrixCount * sizeof(XMFLOAT4X4));
+
+	// Animated Pixel Shader needs the totalTime var
+	AnimatedPixelShaderPerFrame animatedPerFrame = {};
+	animatedPerFrame.totalTime = totalTime;
+
+	for (ISimpleShader* ps : pixelShaders)
+	{
+		if (ps->HasBufferLayout<PixelShaderPerFrame>())
+			ps->SetBufferData(psPerFrame, psPerFrameSize);
+		else if (ps->HasBufferLayout<AnimatedPixelShaderPerFrame>())
+			ps->SetBufferData(animatedPerFrame);
+
+		if (lights.size() > 0)
+		{
+			// Send all of the Shadow Maps to the pixel shader through a Texture2DArray stored in an SRV
+			// - Resources stay bound to their slots when shaders change, so this only needs to happen once
+			ps->SetShaderResourceView("ShadowMaps", srvShadowMapArray);
+			ps->SetSamplerState("ShadowSampler", shadowMapSampler);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Bakes potentially visible sets for the static entities
+// where they are now, and saves them for the next run
+// --------------------------------------------------------
+void Game::BakePVS()
+{
+	pvs->Bake(entities, pvsSettings);
+
+	CreateDirectoryW(FixPath(L"../../Assets/Scenes").c_str(), 0);
+	pvs->Save(WideToNarrow(FixPath(L"../../Assets/Scenes/snowglobe.pvs")));
+}
+
+// --------------------------------------------------------
+// Saves the most recent frame capture next to the scene data
+// --------------------------------------------------------
+void Game::SaveFrameCapture()
+{
+	CreateDirectoryW(FixPath(L"../../Assets/Captures").c_str(), 0);
+	frameCapture->Save(WideToNarrow(FixPath(L"../../Assets/Captures/frame.cmds")));
+}
+
+// --------------------------------------------------------
+// Times the CPU-side work of the renderer at scene sizes from
+// 10 to 1,000,000, without drawing anything, and saves the
+// results as JSON
+//
+// With a baseline file from an earlier run, any result more
+// than threshold (0.1 for 10%) slower than before is reported,
+// both in the results file and on the console it was run from,
+// and the return value says what went wrong - see BenchmarkResult
+// --------------------------------------------------------
+int Game::RunBenchmarks(const std::string& outputFile, const std::string& baselineFile, float threshold)
+{
+	// Nothing is drawn, so there's no need to show the window
+	ShowWindow(hWnd, SW_HIDE);
+	Init();
+
+	// Release builds have no console of their own, so anything printed
+	// goes to the command prompt the benchmarks were started from
+	if (AttachConsole(ATTACH_PARENT_PROCESS))
+	{
+		FILE* stream;
+		freopen_s(&stream, "CONOUT$", "w", stdout);
+	}
+
+	// The same sweep as the stand-alone benchmark, with the constants
+	// packed the way the scene's vertex shader lays them out
+	BenchmarkReport report;
+	std::vector<int> scales = { 10, 100, 1000, 10000, 100000, 1000000 };
+	std::vector<std::string> names = { "world", "view", "proj", "worldInvTranspose" };
+	Benchmarks::Sweep(&report, scales, vertexShader->GetReflection(), names);
+
+	// The scene's own mesh and lights, through the same code as the sweep
+	// - The OBJ is read into memory first, so disk speed doesn't count
+	std::ifstream objFile(FixPath(L"../../Assets/Models/snowman.obj"));
+	std::stringstream objText;
+	objText << objFile.rdbuf();
+	ObjParseBenchmark obj = Benchmarks::ObjParsing(objText.str());
+	report.Add("snowman.obj parse", obj.triangles, obj.parseMs);
+	report.Add("snowman.obj parse with tinyobjloader", obj.triangles, obj.tinyObjMs);
+	report.Add("snowman.obj tangents", obj.triangles, obj.tangentsMs);
+
+	// Every shadow map's matrices, over enough runs to get past the timer's resolution
+	std::vector<Light> shadowCasters;
+	for (auto& light : lights)
+	{
+		if (light.castsShadows == 1)
+			shadowCasters.push_back(light);
+	}
+	const int shadowRuns = 100;
+	ShadowFaceBenchmark shadowTiming = Benchmarks::ShadowFaces(shadowCasters, numShadowMaps * shadowRuns);
+	report.Add("Scene shadow face matrices x100", numShadowMaps, shadowTiming.ms);
+
+	std::vector<BenchmarkRegression> regressions;
+	BenchmarkResult result = report.SaveAndCompare(outputFile, baselineFile, threshold, &regressions);
+	for (auto& r : regressions)
+		printf("Regression: %s at %d went from %.3f ms to %.3f ms\n", r.name.c_str(), r.scale, r.baselineMs, r.ms);
+
+	switch (result)
+	{
+	case BENCHMARK_SAVE_FAILED: printf("Couldn't save the results to %s\n", outputFile.c_str()); break;
+	case BENCHMARK_BASELINE_MISSING: printf("Baseline %s doesn't exist\n", baselineFile.c_str()); break;
+	case BENCHMARK_BASELINE_UNREADABLE: printf("Baseline %s isn't a benchmark results file\n", baselineFile.c_str()); break;
+	case BENCHMARK_BASELINE_EMPTY: printf("Baseline %s has no results in it\n", baselineFile.c_str()); break;
+	default: break;
+	}
+	fflush(stdout);
+	return result;
+}
+
+// --------------------------------------------------------
+// Writes the last few seconds of CPU markers out as a trace
+// for chrome://tracing, next to the frame captures
+// --------------------------------------------------------
+void Game::SaveCpuTrace()
+{
+	CreateDirectoryW(FixPath(L"../../Assets/Captures").c_str(), 0);
+	CpuProfiler::SaveTrace(WideToNarrow(FixPath(L"../../Assets/Captures/cpu_trace.json")));
+}
+
+// --------------------------------------------------------
+// Selects the entity under the mouse cursor when the scene
+// is right clicked, down to the exact triangle that was hit
+// --------------------------------------------------------
+void Game::PickEntityUnderMouse()
+{
+	Input& input = Input::GetInstance();
+	if (!input.MouseRightPress())
+		return;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	Ray ray = Picking::ScreenPointToRay(camera, (float)input.GetMouseX(), (float)input.GetMouseY(), (float)windowWidth, (float)windowHeight);
+	lastPickHit = Picking::PickEntity(ray, entities, &lastPick);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	lastPickTime = std::chrono::duration<float, std::milli>(end - start).count();
+
+	selectedEntity = lastPickHit ? lastPick.entityIndex : -1;
+}
+
 
 // --------------------------------------------------------
 // Handle resizing to match the new window size.
@@ -461,13 +909,35 @@ void Game::OnResize()
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
+	// Each frame runs from one update to the next, so the last
+	// frame's Draw() and Present() land in the frame before this one
+	CpuProfiler::BeginFrame();
+	PROFILE_SCOPE("Update");
+
 	// Example input checking: Quit if the escape key is pressed
 	if (Input::GetInstance().KeyDown(VK_ESCAPE))
 		Quit();
 
 	UpdateUI(deltaTime);
-	ImGuiMenus::WindowStats(windowWidth, windowHeight);
-	ImGuiMenus::EditScene(camera, entities, materials, &lights);
+	ImGuiMenus::WindowStats(windowWidth, windowHeight, constantRing, stateCache, renderQueue, instanceBatcher, recorder);
+	ImGuiMenus::Culling(culling, portals);
+	if (ImGuiMenus::PotentiallyVisibleSets(pvs, &pvsSettings, camera))
+		BakePVS();
+	ImGuiMenus::Benchmarks(vertexShader);
+	ImGuiMenus::DepthPrePass(&depthPrePass, gpuProfiler, gpuDepthPrePassScope, gpuShadingScope, depthPrePassRecordMs, shadingRecordMs);
+	bool pool = poolTextures;
+	if (ImGuiMenus::TexturePooling(&pool, texturePool))
+		SetPoolTextures(pool);
+	ImGuiMenus::GpuTimings(gpuProfiler);
+	if (ImGuiMenus::CpuTimings())
+		SaveCpuTrace();
+	switch (ImGuiMenus::FrameCapture(frameCapture, previousCapture, frameCaptureStats, frameCaptureDifference))
+	{
+	case ImGuiMenus::FRAME_CAPTURE_TAKE: captureNextFrame = true; break;
+	case ImGuiMenus::FRAME_CAPTURE_SAVE: SaveFrameCapture(); break;
+	default: break;
+	}
+	ImGuiMenus::EditScene(camera, entities, materials, &lights, &selectedEntity, lastPickHit ? &lastPick : 0, lastPickTime);
 
 	// Update the camera
 	if (camera != 0)
@@ -476,6 +946,7 @@ void Game::Update(float deltaTime, float totalTime)
 	}
 	
 	UpdateGeometry();
+	PickEntityUnderMouse();
 
 	// Reset shadows when a light in the scene has started or stopped casting shadows
 	for (int i = 0; i < lights.size(); i++)
@@ -493,63 +964,146 @@ void Game::Update(float deltaTime, float totalTime)
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
+	PROFILE_SCOPE("Draw");
+
+	// ImGui and anything else using the context directly may have changed
+	// what's bound since last frame, so the cache starts over
+	stateCache->Invalidate();
+	stateCache->ResetStats();
+
+	// Also reads back the GPU times of whichever earlier frames are done
+	gpuProfiler->BeginFrame();
+
+	// A captured frame is recorded on this thread, so every pass goes
+	// through the one state cache, and its constants are uploaded with
+	// buffer updates so their contents end up in the capture too
+	bool capturing = captureNextFrame;
+	bool wasParallel = recorder->GetParallel();
+	bool usedConstantRing = ISimpleShader::UseConstantRing;
+	std::shared_ptr<IStateBackend> backend = stateCache->GetBackend();
+	if (capturing)
+	{
+		std::swap(frameCapture, previousCapture);
+		frameCapture->Clear();
+		recorder->SetParallel(false);
+		ISimpleShader::UseConstantRing = false;
+		stateCache->SetBackend(std::make_shared<CommandStreamRecorder>(frameCapture, backend));
+		captureNextFrame = false;
+	}
+
 	// Frame START
 	// - These things should happen ONCE PER FRAME
 	// - At the beginning of Game::Draw() before drawing *anything*
 	{
 		// Clear the back buffer (erases what's on the screen)
 		const float bgColor[4] = { 0.4f, 0.6f, 0.75f, 1.0f }; // Cornflower Blue
-		context->ClearRenderTargetView(backBufferRTV.Get(), bgColor);
+		stateCache->ClearRenderTarget(backBufferRTV.Get(), bgColor);
 
 		// Clear the depth buffer (resets per-pixel occlusion information)
-		context->ClearDepthStencilView(depthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+		stateCache->ClearDepth(depthBufferDSV.Get(), 1.0f);
 	}
 
-	RenderShadowMaps();
-
-	// Render all objects in the scene
-	for (int i = 0; i < entities.size(); i++)
+	culling->BeginFrame();
+	ISimpleShader::ResetUploadStats();
+	instanceBatcher->BeginFrame();
+	PrepareShadowMaps();
+
+	// Only entities that are in view and large enough on screen are drawn
+	// - Static entities the PVS says can't be seen from the camera's cell aren't even tested,
+	//   as long as none of them have moved or changed mesh since it was baked
+	if (pvs->Matches(entities) && pvs->FindCandidates(camera->GetTransform()->GetPosition(), entities, &pvsCandidates))
+		culling->CullMainPass(camera, (float)windowHeight, entities, &visibleEntities, &pvsCandidates);
+	else
+		culling->CullMainPass(camera, (float)windowHeight, entities, &visibleEntities);
+
+	// Indoors, entities are also skipped when no portal leads to the cells they're in
+	if (portals->IsLoaded())
 	{
-		std::shared_ptr<SimplePixelShader> ps = entities[i]->GetMaterial()->GetPixelShader();
-		std::shared_ptr<SimpleVertexShader> vs = entities[i]->GetMaterial()->GetVertexShader();
+		portals->FindVisibleCells(camera);
+		portals->FilterEntities(entities, &visibleEntities);
+	}
 
-		// Animated Pixel Shader needs the totalTime var
-		ps->SetFloat("totalTime", totalTime);
+	// Sort the visible entities so those sharing shaders and materials are drawn
+	// together, and front to back within each group to make the most of early depth testing
+	XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+	XMFLOAT3 cameraForward = camera->GetTransform()->GetForward();
+	XMVECTOR eye = XMLoadFloat3(&cameraPosition);
+	XMVECTOR forward = XMLoadFloat3(&cameraForward);
+	renderQueue->Clear();
+	for (int v = 0; v < visibleEntities.size(); v++)
+	{
+		std::shared_ptr<GameEntity> entity = entities[visibleEntities[v]];
+		std::shared_ptr<Material> material = entity->GetMaterial();
+		BoundingSphere sphere = entity->GetWorldBoundingSphere();
+		float depth = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&sphere.Center) - eye, forward));
+
+		renderQueue->Submit(renderQueue->MakeKey(
+			0,
+			material->GetVertexShader().get(),
+			material->GetPixelShader().get(),
+			material.get(),
+			entity->GetMesh().get(),
+			depth / camera->GetFarClip()),
+			visibleEntities[v]);
+	}
+	renderQueue->Sort();
 
-		if (lights.size() > 0)
-		{
-			ps->SetData("lights", &lights[0], (int)lights.size() * sizeof(Light));
-			// Send all of the Shadow Maps to the pixel shader through a Texture2DArray stored in an SRV
-			ps->SetShaderResourceView("ShadowMaps", srvShadowMapArray);
-			ps->SetSamplerState("ShadowSampler", shadowMapSampler);
-		}
+	// Transforms update their matrices lazily, so make sure none are
+	// left to update while several threads are reading them
+	for (auto& e : entities)
+		e->GetTransform()->GetWorldInverseTransposeMatrix();
 
-		if (lightViewMatrices.size() > 0)
-		{
-			// The vertex shader needs the view and projection matrices used to create each Shadow Map
-			// so that the pixel shader can interpret the Shadow Maps properly
-			vs->SetData("lightViews", &lightViewMatrices[0], numShadowMaps * sizeof(XMFLOAT4X4));
-			vs->SetData("lightProjs", &lightProjMatrices[0], numShadowMaps * sizeof(XMFLOAT4X4));
-		}
+	// Record each shadow map and then the main pass, which are played back in that order
+	recorder->Record(numShadowMaps + 1, [&](RecordingPass& pass, int index)
+	{
+		if (index < numShadowMaps)
+			RecordShadowMap(pass, index);
+		else
+			RecordMainPass(pass, totalTime);
+	});
+	{
+		PROFILE_SCOPE("Execute command lists");
+		recorder->Execute();
+	}
 
-		entities[i]->Draw(context, camera);
+	if (capturing)
+	{
+		stateCache->SetBackend(backend);
+		recorder->SetParallel(wasParallel);
+		ISimpleShader::UseConstantRing = usedConstantRing;
+
+		CommandStatsBackend stats;
+		frameCapture->Replay(&stats);
+		frameCaptureStats = stats.GetStats();
+		frameCaptureDifference = frameCapture->FindFirstDifference(*previousCapture);
 	}
 
-	// Draw the Skybox after each entity in the scene so that only the visible parts of the Skybox are rendered
-	skybox->Draw(camera, context);
+	// Playing back command lists leaves nothing bound, so ImGui needs the back buffer again
+	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthBufferDSV.Get());
 
 	// Draw ImGui UI
 	ImGui::Render();
-	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+	{
+		PROFILE_SCOPE("Render ImGui");
+		GpuScope imGuiScope(gpuProfiler.get(), gpuImGuiScope);
+		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+	}
+	gpuProfiler->EndFrame();
 
 	// Frame END
 	// - These should happen exactly ONCE PER FRAME
 	// - At the very end of the frame (after drawing *everything*)
 	{
+		// Lets the constant ring reuse this frame's space once the GPU is done with it
+		constantRing->EndFrame();
+
 		// Present the back buffer to the user
 		//  - Puts the results of what we've drawn onto the window
 		//  - Without this, the user never sees anything
-		swapChain->Present(vsync ? 1 : 0, 0);
+		{
+			PROFILE_SCOPE("Present");
+			swapChain->Present(vsync ? 1 : 0, 0);
+		}
 
 		// Must re-bind buffers after presenting, as they become unbound
 		context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthBufferDSV.Get());
@@ -557,265 +1111,326 @@ void Game::Draw(float deltaTime, float totalTime)
 }
 
 // --------------------------------------------------------
-// Handle all frame-by-frame shadow map implementation
+// Works out each shadow map's matrices and which entities
+// cast shadows into it, ready for the shadow maps to be recorded
 // --------------------------------------------------------
-void Game::RenderShadowMaps()
+void Game::PrepareShadowMaps()
 {
-	lightViewMatrices.clear();
-	lightProjMatrices.clear();
+	PROFILE_SCOPE("PrepareShadowMaps");
 
-	// Set the renderer to the proper settings for only rendering depth buffers
-	context->RSSetState(shadowMapRasterizer.Get());
-	context->PSSetShader(0, 0, 0);
-
-	D3D11_VIEWPORT lightViewport = {};
-	lightViewport.TopLeftX = 0;
-	lightViewport.TopLeftY = 0;
-	lightViewport.Width = (float)shadowMapResolution;
-	lightViewport.Height = (float)shadowMapResolution;
-	lightViewport.MinDepth = 0.0f;
-	lightViewport.MaxDepth = 1.0f;
-	context->RSSetViewports(1, &lightViewport);
+	lightViewProjMatrices.clear();
 
 	if (numShadowMaps > 0)
 	{
 		device->CreateTexture2D(&shadowMapTextureArrayDesc, 0, texShadowMapArray.ReleaseAndGetAddressOf());
+
+		// The view can be made before the shadow maps are copied into the array,
+		// as long as it's only used once they have been
+		device->CreateShaderResourceView(texShadowMapArray.Get(), &shadowMapSrvDesc, srvShadowMapArray.ReleaseAndGetAddressOf());
 	}
 
-	// Render scene from the pov of each light that casts shadows, and store the depth buffer as a shadow map
+	// Find the view of the scene from the pov of each light that casts shadows
 	int shadowIndex = 0;
 	for (int i = 0; i < lights.size(); i++)
 	{
 		if (lights[i].castsShadows == 1)
 		{
 			// This process is repeated 6 times for point lights
-			int iterations = lights[i].type == LIGHT_TYPE_POINT ? 6 : 1;
-			for (int j = 0; j < iterations; j++)
+			int faces = LightMatrices::GetShadowFaceCount(lights[i]);
+			for (int j = 0; j < faces; j++)
 			{
-				XMFLOAT4X4 lightView;
-				XMFLOAT4X4 lightProj;
+				ShadowFaceMatrices matrices = LightMatrices::CalculateShadowFace(lights[i], j);
+				lightViewProjMatrices.push_back(matrices.viewProj);
 
-				// Create the view and projection matrices of the light based on its type
-				switch (lights[i].type)
-				{
-					case LIGHT_TYPE_DIRECTIONAL:
-					{
-						XMVECTOR lightDir = XMVector3Normalize(XMLoadFloat3(&lights[i].direction));
-						// Set the position of the directional light along the direction to the light starting from the world origin
-						// While it makes sense for the light to be far away from the scene (the sun) in order to preserve shadow quality,
-						// this position must be relatively close to the objects that will be mapped during this call
-						XMVECTOR position = -20 * lightDir;
-
-						// Setup the variables needed to rotate a new Transform object to match the light's direction
-						XMVECTOR forward = XMVectorSet(0.f, 0.f, 1.f, 1.f);
-						float dot;
-						XMStoreFloat(&dot, XMVector3Dot(forward, lightDir));
-						float angle = acos(dot);
-						XMVECTOR axis = XMVector3Cross(forward, lightDir);
-
-						// Use a Transform object to calculate the correct EyeDirection and UpDirection for the view matrix
-						Transform lightTransform = Transform();
-						lightTransform.SetRotation(XMQuaternionRotationAxis(axis, angle));
-						XMFLOAT3 lookDir = lightTransform.GetForward();
-						XMFLOAT3 upDir = lightTransform.GetUp();
-
-						XMStoreFloat4x4(&lightView,
-							XMMatrixLookToLH(
-								position,
-								XMLoadFloat3(&lookDir),
-								XMLoadFloat3(&upDir)
-							)
-						);
-
-						// Use an orthographic projection matrix because directional lights are meant to be
-						// light coming from every possible position along the specified direction
-						XMStoreFloat4x4(&lightProj,
-							XMMatrixOrthographicLH(
-								20,
-								20,
-								1.f,
-								200.f
-							)
-						);
-
-						break;
-					}
-
-					case LIGHT_TYPE_POINT:
-					{
-						// A point light is omnidirectional, so to map objects to a depth buffer in all directions, 6 depth buffers must be used
-						// Because of this, this code is repeated 6 times and each time uses a different axis direction pointing to one of the 6 faces of a cube
-						XMVECTOR lightDir = XMLoadFloat3(&cubeFaceDirections[j]);
-
-						// Setup the variables needed to rotate a new Transform object to match the light's direction
-						XMVECTOR forward = XMVectorSet(0.f, 0.f, 1.f, 1.f);
-						float dot;
-						XMStoreFloat(&dot, XMVector3Dot(forward, lightDir));
-						float angle = acos(dot);
-						XMVECTOR axis;
-						// Make sure the look direction and up direction are calculated correctly
-						// even when the light's direction lines up with the forward vector
-						if (dot != 1.f && dot != -1.f)
-						{
-							axis = XMVector3Cross(forward, lightDir);
-						}
-						else if (dot == 1.f)
-						{
-							axis = forward;
-						}
-						else
-						{
-							axis = XMVectorSet(0.f, 1.f, 0.f, 1.f);
-						}
-
-						// Use a Transform object to calculate the correct EyeDirection and UpDirection for the view matrix
-						Transform lightTransform = Transform();
-						lightTransform.SetRotation(XMQuaternionRotationAxis(axis, angle));
-						XMFLOAT3 lookDir = lightTransform.GetForward();
-						XMFLOAT3 upDir = lightTransform.GetUp();
-
-						XMStoreFloat4x4(&lightView,
-							XMMatrixLookToLH(
-								XMLoadFloat3(&lights[i].position),
-								XMLoadFloat3(&lookDir),
-								XMLoadFloat3(&upDir)
-							)
-						);
-
-						// Each projection matrix used is a frustum from the light's position to the entirety of one of its TextureCube faces
-						// This projection matrix only extends as far as the light's range
-						XMStoreFloat4x4(&lightProj,
-							XMMatrixPerspectiveFovLH(
-								90.f,
-								1.f,
-								0.1f,
-								lights[i].range
-							)
-						);
-
-						break;
-					}
-
-					case LIGHT_TYPE_SPOT:
-					{
-						XMVECTOR lightDir = XMVector3Normalize(XMLoadFloat3(&lights[i].direction));
-
-						// Setup the variables needed to rotate a new Transform object to match the light's direction
-						XMVECTOR forward = XMVectorSet(0.f, 0.f, 1.f, 1.f);
-						float dot;
-						XMStoreFloat(&dot, XMVector3Dot(forward, lightDir));
-						float angle = acos(dot);
-						XMVECTOR axis;
-						// Make sure the look direction and up direction are calculated correctly
-						// even when the light's direction lines up with the forward vector
-						if (dot != 1.f && dot != -1.f)
-						{
-							axis = XMVector3Cross(forward, lightDir);
-						}
-						else if (dot == 1.f)
-						{
-							axis = forward;
-						}
-						else
-						{
-							axis = XMVectorSet(0.f, 0.f, -1.f, 1.f);
-						}
-
-						// Use a Transform object to calculate the correct EyeDirection and UpDirection for the view matrix
-						Transform lightTransform = Transform();
-						lightTransform.SetRotation(XMQuaternionRotationAxis(axis, angle));
-						XMFLOAT3 lookDir = lightTransform.GetForward();
-						XMFLOAT3 upDir = lightTransform.GetUp();
-
-						XMStoreFloat4x4(&lightView,
-							XMMatrixLookToLH(
-								XMLoadFloat3(&lights[i].position),
-								XMLoadFloat3(&lookDir),
-								XMLoadFloat3(&upDir)
-							)
-						);
-
-						// The spotlight is the easier projection matrix to create because its range and frustum match up exactly with its matrix
-						// This matrix also uses an equal aspect ratio of 1
-						XMStoreFloat4x4(&lightProj,
-							XMMatrixPerspectiveFovLH(
-								Rad2Deg(lights[i].spotFalloff),
-								1.f,
-								0.1f,
-								lights[i].range
-							)
-						);
-
-						break;
-					}
-
-					default:
-						XMStoreFloat4x4(&lightView, XMMatrixIdentity());
-						XMStoreFloat4x4(&lightProj, XMMatrixIdentity());
-						break;
-				}
+				shadowFaces[shadowIndex].view = matrices.view;
+				shadowFaces[shadowIndex].proj = matrices.proj;
 
-				lightViewMatrices.push_back(lightView);
-				lightProjMatrices.push_back(lightProj);
+				// Skip entities outside of this shadow map or too small to show up in it
+				culling->CullShadowPass(shadowIndex, lights[i], matrices.view, matrices.proj, shadowMapResolution, entities, &shadowFaces[shadowIndex].casters);
 
-				// Clear the shadow map depth buffer
-				if (dsvShadowMap != 0)
-					context->ClearDepthStencilView(dsvShadowMap.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
-				// Set the Depth Stencil View to render to the next Texture2D in our list
-				device->CreateDepthStencilView(texShadowMaps[shadowIndex].Get(), &shadowMapDsvDesc, dsvShadowMap.ReleaseAndGetAddressOf());
-				context->OMSetRenderTargets(0, 0, dsvShadowMap.Get());
+				// Move on to the next Shadow Map
+				shadowIndex++;
+			}
+		}
+	}
+}
 
-				// Render all of the game entities in the scene to a depth buffer using a custom vertex shader
-				for (int i = 0; i < entities.size(); i++)
-				{
-					shadowMapVertexShader->SetShader();
-					shadowMapVertexShader->SetMatrix4x4("view", lightView);
-					shadowMapVertexShader->SetMatrix4x4("proj", lightProj);
-					shadowMapVertexShader->SetMatrix4x4("world", entities[i]->GetTransform()->GetWorldMatrix());
-					shadowMapVertexShader->CopyAllBufferData();
-					// Use the Mesh's draw method so no extra constant buffers or render settings are set
-					entities[i]->GetMesh()->Draw();
-				}
+// --------------------------------------------------------
+// Records rendering one shadow map, and copying it into the
+// shadow map array
+// - Only touches this shadow map's own data, so each one can be
+//   recorded on a different thread
+// --------------------------------------------------------
+void Game::RecordShadowMap(RecordingPass& pass, int shadowIndex)
+{
+	PROFILE_SCOPE("RecordShadowMap");
+	ShadowFace& face = shadowFaces[shadowIndex];
 
-				// Copy the Texture2D depth buffer that was just rendered into the Texture2DArray that will be sent to the pixel shader
-				// Calculate the subresource position to copy into
-				unsigned int subresource = D3D11CalcSubresource(0, shadowIndex, 1);
+	// Timestamps land wherever this pass's commands are played back,
+	// and the passes are played back in order, so the first and last
+	// shadow maps bracket them all
+	if (shadowIndex == 0)
+		gpuProfiler->BeginScope(gpuShadowMapsScope, pass.context.Get());
+	gpuProfiler->BeginScope(face.gpuScope, pass.context.Get());
 
-				// Copy from the current individual Shadow Map to the Shadow Map Array
-				context->CopySubresourceRegion(
-					texShadowMapArray.Get(),
-					subresource,
-					0, 0, 0,
-					texShadowMaps[shadowIndex].Get(),
-					0,
-					0
-				);
+	// Set the renderer to the proper settings for only rendering depth buffers
+	pass.context->RSSetState(shadowMapRasterizer.Get());
+	pass.states->SetPrimitiveTopology(TOPOLOGY_TRIANGLE_LIST);
+	pass.states->SetPixelShader(0);
+
+	StateViewport lightViewport = {};
+	lightViewport.topLeftX = 0;
+	lightViewport.topLeftY = 0;
+	lightViewport.width = (float)shadowMapResolution;
+	lightViewport.height = (float)shadowMapResolution;
+	lightViewport.minDepth = 0.0f;
+	lightViewport.maxDepth = 1.0f;
+	pass.states->SetViewport(lightViewport);
+
+	// Clear this shadow map's depth buffer and render to it
+	pass.states->ClearDepth(face.dsv.Get(), 1.0f);
+	pass.states->SetRenderTargets(0, face.dsv.Get());
+
+	// The light's matrices go in the shader's PerPass buffer, which is
+	// uploaded with the first caster and then left alone for the rest
+	ShadowMapVertexShaderPerPass perPass = { face.view, face.proj };
+	InstancedShadowMapVertexShaderPerPass instancedPerPass = { face.view, face.proj };
+	face.vertexShader->SetBufferData(perPass);
+	face.instancedVertexShader->SetBufferData(instancedPerPass);
+
+	// Materials don't matter for depth, so casters only need grouping by mesh
+	face.queue->Clear();
+	for (int c = 0; c < face.casters.size(); c++)
+	{
+		std::shared_ptr<GameEntity> entity = entities[face.casters[c]];
+		face.queue->Submit(face.queue->MakeKey(1, face.vertexShader.get(), 0, 0, entity->GetMesh().get(), 0), face.casters[c]);
+	}
+	face.queue->Sort();
 
-				// Move on to the next Shadow Map
-				shadowIndex++;
+	// Render all of the game entities in the scene to a depth buffer using a custom vertex shader
+	// - Casters sharing a mesh are drawn as instances
+	const std::vector<RenderPacket>& casters = face.queue->GetPackets();
+	for (int c = 0; c < casters.size();)
+	{
+		int end = c + 1;
+		while (end < casters.size() && !RenderQueue::MeshesDiffer(casters[c].key, casters[end].key))
+			end++;
+		int run = end - c;
+
+		std::shared_ptr<Mesh> mesh = entities[casters[c].entity]->GetMesh();
+		if (pass.batcher->ShouldInstance(run))
+		{
+			face.instancedVertexShader->SetShader();
+			for (int i = c; i < end; i++)
+				pass.batcher->Add(entities[casters[i].entity].get());
+
+			face.instancedVertexShader->CopyAllBufferData();
+			pass.batcher->Draw(mesh, pass.states.get());
+			pass.batcher->RecordShadowDraws(run, 1);
+		}
+		else
+		{
+			face.vertexShader->SetShader();
+			for (int i = c; i < end; i++)
+			{
+				face.vertexShader->SetMatrix4x4(shadowWorldHandle, entities[casters[i].entity]->GetTransform()->GetWorldMatrix());
+				face.vertexShader->CopyAllBufferData();
+				// Use the Mesh's draw method so no extra constant buffers or render settings are set
+				mesh->Draw(pass.states.get());
 			}
+			pass.batcher->RecordShadowDraws(run, run);
 		}
+
+		c = end;
 	}
 
-	// Once all of the Shadow Maps have been rendered, and the texture array is stored with a copy of each,
-	// use the texture array as our Shader Resource
-	if (numShadowMaps > 0)
+	// Copy the Texture2D depth buffer that was just rendered into the Texture2DArray that will be sent to the pixel shader
+	// Calculate the subresource position to copy into
+	unsigned int subresource = D3D11CalcSubresource(0, shadowIndex, 1);
+
+	// Copy from the current individual Shadow Map to the Shadow Map Array
+	pass.context->CopySubresourceRegion(
+		texShadowMapArray.Get(),
+		subresource,
+		0, 0, 0,
+		texShadowMaps[shadowIndex].Get(),
+		0,
+		0
+	);
+
+	// Reset rendering settings
+	pass.context->RSSetState(0);
+
+	gpuProfiler->EndScope(face.gpuScope, pass.context.Get());
+	if (shadowIndex == numShadowMaps - 1)
+		gpuProfiler->EndScope(gpuShadowMapsScope, pass.context.Get());
+}
+
+// --------------------------------------------------------
+// Records drawing the visible entities into the depth buffer
+// alone, so the main pass can skip every fragment that ends
+// up hidden behind another
+// - Expects the main pass's render targets and viewport to
+//   already be set
+// --------------------------------------------------------
+void Game::RecordDepthPrePass(RecordingPass& pass)
+{
+	PROFILE_SCOPE("RecordDepthPrePass");
+	pass.states->SetPixelShader(0);
+
+	ShadowMapVertexShaderPerPass perPass = { camera->GetViewMatrix(), camera->GetProjectionMatrix() };
+	InstancedShadowMapVertexShaderPerPass instancedPerPass = { camera->GetViewMatrix(), camera->GetProjectionMatrix() };
+	depthPrePassVertexShader->SetBufferData(perPass);
+	depthPrePassInstancedVertexShader->SetBufferData(instancedPerPass);
+
+	// The main pass's order works here too, since it's already front to back
+	// within each group and keeps runs sharing a mesh together
+	const std::vector<RenderPacket>& packets = renderQueue->GetPackets();
+	for (int p = 0; p < packets.size();)
 	{
-		device->CreateShaderResourceView(texShadowMapArray.Get(), &shadowMapSrvDesc, srvShadowMapArray.ReleaseAndGetAddressOf());
+		int end = p + 1;
+		while (end < packets.size() && !RenderQueue::MeshesDiffer(packets[p].key, packets[end].key))
+			end++;
+		int run = end - p;
+
+		std::shared_ptr<Mesh> mesh = entities[packets[p].entity]->GetMesh();
+		if (pass.batcher->ShouldInstance(run))
+		{
+			depthPrePassInstancedVertexShader->SetShader();
+			for (int i = p; i < end; i++)
+				pass.batcher->Add(entities[packets[i].entity].get());
+
+			depthPrePassInstancedVertexShader->CopyAllBufferData();
+			pass.batcher->Draw(mesh, pass.states.get());
+		}
+		else
+		{
+			depthPrePassVertexShader->SetShader();
+			for (int i = p; i < end; i++)
+			{
+				depthPrePassVertexShader->SetMatrix4x4(shadowWorldHandle, entities[packets[i].entity]->GetTransform()->GetWorldMatrix());
+				depthPrePassVertexShader->CopyAllBufferData();
+				mesh->Draw(pass.states.get());
+			}
+		}
+
+		p = end;
 	}
-	
-	// Reset rendering settings
-	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthBufferDSV.Get());
-	context->RSSetState(0);
-
-	D3D11_VIEWPORT standardViewport = {};
-	standardViewport.TopLeftX = 0;
-	standardViewport.TopLeftY = 0;
-	standardViewport.Width = (float)windowWidth;
-	standardViewport.Height = (float)windowHeight;
-	standardViewport.MinDepth = 0.0f;
-	standardViewport.MaxDepth = 1.0f;
-	context->RSSetViewports(1, &standardViewport);
-
-	context->RSSetState(0);
+}
+
+// --------------------------------------------------------
+// Records drawing the visible entities and the sky to the
+// back buffer, after the shadow maps are done
+// - With the depth pre-pass on, depth is laid down first and
+//   the entities are then shaded with an EQUAL depth test
+// --------------------------------------------------------
+void Game::RecordMainPass(RecordingPass& pass, float totalTime)
+{
+	PROFILE_SCOPE("RecordMainPass");
+	gpuProfiler->BeginScope(gpuMainPassScope, pass.context.Get());
+
+	// A deferred context starts out with nothing set, so the
+	// main pass can't rely on anything set before it
+	pass.states->SetRenderTargets(backBufferRTV.Get(), depthBufferDSV.Get());
+	pass.states->SetPrimitiveTopology(TOPOLOGY_TRIANGLE_LIST);
+
+	StateViewport standardViewport = {};
+	standardViewport.topLeftX = 0;
+	standardViewport.topLeftY = 0;
+	standardViewport.width = (float)windowWidth;
+	standardViewport.height = (float)windowHeight;
+	standardViewport.minDepth = 0.0f;
+	standardViewport.maxDepth = 1.0f;
+	pass.states->SetViewport(standardViewport);
+
+	// What it costs the GPU is in the pre-pass and shading scopes - these
+	// times only cover recording each half on this thread
+	auto prePassStart = std::chrono::high_resolution_clock::now();
+	if (depthPrePass)
+	{
+		GpuScope prePassScope(gpuProfiler.get(), gpuDepthPrePassScope, pass.context.Get());
+		RecordDepthPrePass(pass);
+	}
+	auto shadingStart = std::chrono::high_resolution_clock::now();
+
+	// Camera, lights and shadow data are the same for every entity
+	SetPerFrameData(totalTime);
+
+	// Materials all use vertex shaders computing position the same way as the
+	// pre-pass's, so each visible fragment matches the depth already there
+	if (depthPrePass)
+		pass.context->OMSetDepthStencilState(depthEqualState.Get(), 0);
+
+	{
+		PROFILE_SCOPE("Entity loop");
+		GpuScope shadingScope(gpuProfiler.get(), gpuShadingScope, pass.context.Get());
+
+		// Render all objects in the scene, only changing shaders and
+		// materials when they differ from the previous entity's
+		// - Sorting puts entities sharing a material and mesh next to each other,
+		//   and long enough runs of them are drawn as instances in one draw call
+		const std::vector<RenderPacket>& packets = renderQueue->GetPackets();
+		bool instancedShaderSet = false;
+		for (int p = 0; p < packets.size();)
+		{
+			int end = p + 1;
+			while (end < packets.size() && !RenderQueue::MeshesDiffer(packets[p].key, packets[end].key))
+				end++;
+			int run = end - p;
+
+			std::shared_ptr<GameEntity> entity = entities[packets[p].entity];
+			std::shared_ptr<Material> material = entity->GetMaterial();
+
+			// The instanced vertex shader only stands in for the standard one
+			bool instanced = pass.batcher->ShouldInstance(run) && material->GetVertexShader() == vertexShader;
+
+			bool first = p == 0;
+			if (first || RenderQueue::ShadersDiffer(packets[p - 1].key, packets[p].key) || instanced != instancedShaderSet)
+			{
+				if (instanced)
+					instancedVertexShader->SetShader();
+				else
+					material->GetVertexShader()->SetShader();
+				material->GetPixelShader()->SetShader();
+				instancedShaderSet = instanced;
+			}
+
+			if (first || RenderQueue::MaterialsDiffer(packets[p - 1].key, packets[p].key))
+				material->Prepare();
+
+			if (instanced)
+			{
+				for (int i = p; i < end; i++)
+					pass.batcher->Add(entities[packets[i].entity].get());
+
+				instancedVertexShader->CopyAllBufferData();
+				material->GetPixelShader()->CopyAllBufferData();
+				pass.batcher->Draw(entity->GetMesh(), pass.states.get());
+				pass.batcher->RecordMainDraws(run, 1);
+			}
+			else
+			{
+				for (int i = p; i < end; i++)
+					entities[packets[i].entity]->DrawPrepared(pass.states.get());
+				pass.batcher->RecordMainDraws(run, run);
+			}
+
+			p = end;
+		}
+	}
+
+	if (depthPrePass)
+		pass.context->OMSetDepthStencilState(0, 0);
+
+	auto shadingEnd = std::chrono::high_resolution_clock::now();
+	depthPrePassRecordMs = std::chrono::duration<float, std::milli>(shadingStart - prePassStart).count();
+	shadingRecordMs = std::chrono::duration<float, std::milli>(shadingEnd - shadingStart).count();
+
+	// Draw the Skybox after each entity in the scene so that only the visible parts of the Skybox are rendered
+	{
+		GpuScope skyScope(gpuProfiler.get(), gpuSkyScope, pass.context.Get());
+		skybox->Draw(camera, pass.context, pass.states.get());
+	}
+
+	gpuProfiler->EndScope(gpuMainPassScope, pass.context.Get());
 }
\ No newline at end of file
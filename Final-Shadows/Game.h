@@ -12,6 +12,41 @@
 #include "SimpleShader.h"
 #include "Lights.h"
 #include "Sky.h"
+#include "Picking.h"
+#include "Culling.h"
+#include "Portals.h"
+#include "PVS.h"
+#include "ConstantBufferRing.h"
+#include "StateCache.h"
+#include "RenderQueue.h"
+#include "InstanceBatcher.h"
+#include "ParallelRecorder.h"
+#include "CommandStream.h"
+#include "CommandStreamRecorder.h"
+#include "ShaderPermutationCache.h"
+#include "ShaderLayoutGenerator.h"
+#include "TexturePool.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+
+// --------------------------------------------------------
+// One shadow map's view of the scene, along with what it needs
+// to be recorded at the same time as the others
+// --------------------------------------------------------
+struct ShadowFace
+{
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 proj;
+	std::vector<int> casters;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> dsv;
+
+	// Its own copies of the shadow map shaders and queue, since
+	// shader variables can't be shared between threads
+	std::shared_ptr<SimpleVertexShader> vertexShader;
+	std::shared_ptr<SimpleVertexShader> instancedVertexShader;
+	std::shared_ptr<RenderQueue> queue;
+	int gpuScope;
+};
 
 class Game
 	: public DXCore
@@ -28,15 +63,33 @@ public:
 	void Update(float deltaTime, float totalTime);
 	void Draw(float deltaTime, float totalTime);
 
+	// Whether materials draw from shared texture arrays - see CreateMaterials()
+	// - Can be switched before Init() or at any point after
+	bool GetPoolTextures() { return poolTextures; }
+	void SetPoolTextures(bool pool);
+
+	// Runs the benchmark suite instead of the game loop, returning
+	// a BenchmarkResult as the exit code
+	int RunBenchmarks(const std::string& outputFile, const std::string& baselineFile, float threshold);
+
+	// Writes ShaderLayouts.h from the compiled shaders instead of
+	// running the game, returning 0 if it was written
+	int WriteShaderLayouts();
+
 private:
 
 	// Initialization helper methods - feel free to customize, combine, remove, etc.
 	void LoadShaders();
+	void CheckShaderLayouts();
+	std::string ShaderLayoutsFile();
+	std::vector<ShaderLayoutSource> GetShaderLayoutSources();
 	void CreateGeometry();
 	void LoadTextures();
 	void SetupShadows(int resolution);
+	void SelectShaderPermutations();
 	void SetupLights();
 	void CreateMaterials();
+	void RebuildMaterials();
 	void CreateEntities();
 
 	// Update helper methods
@@ -44,7 +97,15 @@ private:
 
 	void PositionGeometry();
 	void UpdateGeometry();
-	void RenderShadowMaps();
+	void PickEntityUnderMouse();
+	void BakePVS();
+	void SaveFrameCapture();
+	void SaveCpuTrace();
+	void SetPerFrameData(float totalTime);
+	void PrepareShadowMaps();
+	void RecordShadowMap(RecordingPass& pass, int shadowIndex);
+	void RecordDepthPrePass(RecordingPass& pass);
+	void RecordMainPass(RecordingPass& pass, float totalTime);
 
 	// Note the usage of ComPtr below
 	//  - This is a smart pointer for objects that abide by the
@@ -55,7 +116,45 @@ private:
 	std::shared_ptr<SimpleVertexShader> vertexShader;
 	std::shared_ptr<SimplePixelShader> pixelShader;
 	std::shared_ptr<SimplePixelShader> animatedPixelShader;
+	std::shared_ptr<SimplePixelShader> pooledPixelShader;
 	std::shared_ptr<SimpleVertexShader> shadowMapVertexShader;
+	SimpleShaderVariableHandle shadowWorldHandle;
+	std::shared_ptr<SimpleVertexShader> instancedVertexShader;
+	std::shared_ptr<SimpleVertexShader> instancedShadowMapVertexShader;
+	std::shared_ptr<ShaderPermutationCache> shaderPermutations;
+
+	// Position-only shaders laying down the camera's depth before the main
+	// pass, which then only shades the fragments that ended up in front
+	std::shared_ptr<SimpleVertexShader> depthPrePassVertexShader;
+	std::shared_ptr<SimpleVertexShader> depthPrePassInstancedVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> depthEqualState;
+	bool depthPrePass;
+	float depthPrePassRecordMs;	// CPU time spent recording each half of the main
+	float shadingRecordMs;		// pass - the GPU's times are in their own scopes
+
+	std::shared_ptr<ConstantBufferRing> constantRing;
+	std::shared_ptr<StateCache> stateCache;
+	std::shared_ptr<RenderQueue> renderQueue;
+	std::shared_ptr<InstanceBatcher> instanceBatcher;
+	std::shared_ptr<ParallelRecorder> recorder;
+
+	// GPU time spent on each part of the frame
+	std::shared_ptr<GpuProfiler> gpuProfiler;
+	int gpuShadowMapsScope;
+	std::vector<int> gpuShadowFaceScopes;	// One per shadow map index ever used
+	int gpuMainPassScope;
+	int gpuDepthPrePassScope;
+	int gpuShadingScope;
+	int gpuSkyScope;
+	int gpuImGuiScope;
+
+	// The last two frames captured as command streams, for
+	// counting and comparing what they asked for
+	std::shared_ptr<CommandStream> frameCapture;
+	std::shared_ptr<CommandStream> previousCapture;
+	CommandStats frameCaptureStats;
+	int frameCaptureDifference;
+	bool captureNextFrame;
 
 	// Textures, SRVs, and Sampler States
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvSnowglobe[4];
@@ -64,8 +163,12 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvDefaultNormalMap;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> texSampler;
 
+	// Material textures packed into shared arrays, while poolTextures is set
+	std::shared_ptr<TexturePool> texturePool;
+	bool poolTextures;
+
 	// Shadow Map fields
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> dsvShadowMap;
+	std::vector<ShadowFace> shadowFaces;
 	std::vector<Microsoft::WRL::ComPtr<ID3D11Texture2D>> texShadowMaps;
 	Microsoft::WRL::ComPtr<ID3D11Texture2D> texShadowMapArray;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srvShadowMapArray;
@@ -76,18 +179,8 @@ private:
 	D3D11_TEXTURE2D_DESC shadowMapTextureArrayDesc;
 	D3D11_SHADER_RESOURCE_VIEW_DESC shadowMapSrvDesc;
 
-	std::vector<DirectX::XMFLOAT4X4> lightViewMatrices;
-	std::vector<DirectX::XMFLOAT4X4> lightProjMatrices;
+	std::vector<DirectX::XMFLOAT4X4> lightViewProjMatrices;	// One per shadow map, view then projection
 	std::vector<int> prevLightShadowSettings;
-	const std::vector<DirectX::XMFLOAT3> cubeFaceDirections = 
-	{
-		DirectX::XMFLOAT3(0.f, 0.f, 1.f),
-		DirectX::XMFLOAT3(1.f, 0.f, 0.f),
-		DirectX::XMFLOAT3(0.f, 0.f, -1.f),
-		DirectX::XMFLOAT3(-1.f, 0.f, 0.f),
-		DirectX::XMFLOAT3(0.f, 1.f, 0.f),
-		DirectX::XMFLOAT3(0.f, -1.f, 0.f)
-	};
 
 	int shadowMapResolution;
 	int numShadowMaps;
@@ -100,5 +193,19 @@ private:
 	std::shared_ptr<Camera> camera;
 	std::vector<Light> lights;
 	std::shared_ptr<Sky> skybox;
+
+	// Visibility
+	std::shared_ptr<CullingSystem> culling;
+	std::shared_ptr<PortalSystem> portals;
+	std::shared_ptr<PVS> pvs;
+	PVSBakeSettings pvsSettings;
+	std::vector<int> pvsCandidates;
+	std::vector<int> visibleEntities;
+
+	// Picking results from right clicking the scene
+	int selectedEntity;
+	bool lastPickHit;
+	PickResult lastPick;
+	float lastPickTime;
 };
 
@@ -1,37 +1,87 @@
 #include "GameEntity.h"
+#include "ShaderLayouts.h"
+
+using namespace DirectX;
 
 GameEntity::GameEntity(std::shared_ptr<Mesh> meshRef, std::shared_ptr<Material> mat)
 	:
 	mesh(meshRef),
-	material(mat)
+	material(mat),
+	isStatic(false),
+	handleVertexShader(0),
+	handlePixelShader(0)
 {
 	transform = Transform();
 }
 
+// --------------------------------------------------------
+// Gets a sphere in world space which encloses this entity's mesh
+// --------------------------------------------------------
+DirectX::BoundingSphere GameEntity::GetWorldBoundingSphere()
+{
+	BoundingSphere localSphere;
+	BoundingSphere::CreateFromBoundingBox(localSphere, mesh->GetBounds());
+
+	XMFLOAT4X4 world = transform.GetWorldMatrix();
+	BoundingSphere worldSphere;
+	localSphere.Transform(worldSphere, XMLoadFloat4x4(&world));
+	return worldSphere;
+}
+
 void GameEntity::Draw(
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
-	std::shared_ptr<Camera> camera)
+	std::shared_ptr<Camera> camera,
+	StateCache* states)
 {
 	// Set the active shaders to this entity's material
 	material->GetVertexShader()->SetShader();
 	material->GetPixelShader()->SetShader();
+	material->Prepare();
+
+	DrawPrepared(states);
+}
 
+// --------------------------------------------------------
+// Draws the entity assuming its material's shaders are already
+// set and the material has been prepared, such as when the
+// previous draw used the same material
+// --------------------------------------------------------
+void GameEntity::DrawPrepared(StateCache* states)
+{
 	// Update each constant buffer's data
 	std::shared_ptr<SimpleVertexShader> vs = material->GetVertexShader();
-	vs->SetMatrix4x4("world", transform.GetWorldMatrix());	// Strings here MUST match variable
-	vs->SetMatrix4x4("view", camera->GetViewMatrix());		// names in the
-	vs->SetMatrix4x4("proj", camera->GetProjectionMatrix()); // shader's cbuffer!
-	vs->SetMatrix4x4("worldInvTranspose", transform.GetWorldInverseTransposeMatrix());
-
 	std::shared_ptr<SimplePixelShader> ps = material->GetPixelShader();
-	ps->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
+	if (vs.get() != handleVertexShader || ps.get() != handlePixelShader)
+		FindShaderHandles();
 
-	material->Prepare();
+	// Only per object data is set here - the camera and lights are set
+	// once per frame by Game, and material data by the material
+	VertexShaderPerObject perObject;
+	perObject.world = transform.GetWorldMatrix();
+	perObject.worldInvTranspose = transform.GetWorldInverseTransposeMatrix();
+	vs->SetData(perObjectHandle, &perObject, sizeof(perObject));
 
 	// Copy the constant buffer data from the CPU to the GPU
+	// - Only buffers that changed since the last draw are actually copied
 	vs->CopyAllBufferData();
 	ps->CopyAllBufferData();
 
 	// Render this game entity's mesh
-	mesh->Draw();
+	mesh->Draw(states);
+}
+
+// --------------------------------------------------------
+// Looks up the variables Draw() sets in the material's shaders
+// - The PerObject buffer is set as a whole, so the handle is
+//   only valid if its layout still matches ShaderLayouts.h
+// --------------------------------------------------------
+void GameEntity::FindShaderHandles()
+{
+	std::shared_ptr<SimpleVertexShader> vs = material->GetVertexShader();
+	std::shared_ptr<SimplePixelShader> ps = material->GetPixelShader();
+
+	perObjectHandle = vs->GetBufferHandle<VertexShaderPerObject>();
+
+	handleVertexShader = vs.get();
+	handlePixelShader = ps.get();
 }
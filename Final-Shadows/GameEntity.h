@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <DirectXCollision.h>
 #include "Transform.h"
 #include "Mesh.h"
 #include "Camera.h"
@@ -14,19 +15,35 @@ public:
 	Transform* GetTransform() { return &transform; }
 	std::shared_ptr<Mesh> GetMesh() { return mesh; }
 	std::shared_ptr<Material> GetMaterial() { return material; }
+	DirectX::BoundingSphere GetWorldBoundingSphere();
+	bool IsStatic() { return isStatic; }
 
 	void SetTransform(Transform t) { transform = t; }
 	void SetMesh(std::shared_ptr<Mesh> m) { mesh = m; }
 	void SetMaterial(std::shared_ptr<Material> m) { material = m; }
+	void SetStatic(bool s) { isStatic = s; }
 
 	void Draw(
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
-		std::shared_ptr<Camera> camera
+		std::shared_ptr<Camera> camera,
+		StateCache* states = 0
 	);
+	void DrawPrepared(StateCache* states = 0);
 
 private:
+	void FindShaderHandles();
+
 	Transform transform;
 	std::shared_ptr<Mesh> mesh;
 	std::shared_ptr<Material> material;
+
+	// Static entities aren't expected to move, so systems may reuse
+	// results computed for them on earlier frames
+	bool isStatic;
+
+	// Variables set by Draw(), looked up again whenever the material's shaders change
+	SimpleVertexShader* handleVertexShader;
+	SimplePixelShader* handlePixelShader;
+	SimpleShaderVariableHandle perObjectHandle;
 };
 
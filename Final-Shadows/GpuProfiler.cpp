@@ -0,0 +1,217 @@
+#include <algorithm>
+#include "GpuProfiler.h"
+
+bool NullGpuTimerBackend::GetFrequency(unsigned int /*slot*/, unsigned long long* frequency, bool* disjoint)
+{
+	*frequency = 1000;
+	*disjoint = false;
+	return true;
+}
+
+bool NullGpuTimerBackend::GetTimestamp(unsigned int /*slot*/, unsigned int /*query*/, unsigned long long* ticks)
+{
+	*ticks = 0;
+	return true;
+}
+
+GpuTimingHistory::GpuTimingHistory(unsigned int length)
+	:
+	length(length > 0 ? length : 1),
+	next(0),
+	stats()
+{
+}
+
+// --------------------------------------------------------
+// Adds the newest time, replacing the oldest once the
+// history is full
+// - The history is short, so the stats are just worked out
+//   again from scratch each time
+// --------------------------------------------------------
+void GpuTimingHistory::Add(float ms)
+{
+	if (times.size() < length)
+		times.push_back(ms);
+	else
+		times[next] = ms;
+	next = (next + 1) % length;
+
+	stats.lastMs = ms;
+	stats.minMs = ms;
+	stats.maxMs = ms;
+	float total = 0.0f;
+	for (float t : times)
+	{
+		if (t < stats.minMs) stats.minMs = t;
+		if (t > stats.maxMs) stats.maxMs = t;
+		total += t;
+	}
+	stats.avgMs = total / times.size();
+	stats.samples = (int)times.size();
+}
+
+void GpuTimingHistory::Clear()
+{
+	times.clear();
+	next = 0;
+	stats = {};
+}
+
+GpuProfiler::GpuProfiler(
+	std::shared_ptr<IGpuTimerBackend> backend,
+	unsigned int framesInFlight,
+	unsigned int historyLength)
+	:
+	backend(backend),
+	slots(framesInFlight > 0 ? framesInFlight : 1),
+	historyLength(historyLength),
+	frame(0),
+	currentSlot(0),
+	inFrame(false),
+	enabled(true),
+	framesRead(0),
+	framesDropped(0)
+{
+	for (auto& slot : slots)
+		slot.pending = false;
+
+	// The whole frame is always the first scope
+	AddScope("Frame");
+	scopes[0].depth = 0;
+}
+
+// --------------------------------------------------------
+// Registers a scope to time, returning the number to begin
+// and end it with
+// - Each scope takes two queries in every slot, for its start
+//   and its end
+// --------------------------------------------------------
+int GpuProfiler::AddScope(const std::string& name, int parent)
+{
+	Scope scope = { name, 1, GpuTimingHistory(historyLength) };
+	if (parent >= 0 && parent < (int)scopes.size())
+		scope.depth = scopes[parent].depth + 1;
+	scopes.push_back(scope);
+
+	unsigned int queryCount = (unsigned int)scopes.size() * 2;
+	backend->Reserve((unsigned int)slots.size(), queryCount);
+	for (auto& slot : slots)
+		slot.written.resize(queryCount, 0);
+
+	return (int)scopes.size() - 1;
+}
+
+// --------------------------------------------------------
+// Reads back whichever earlier frames the GPU has finished,
+// then starts timing a new one
+// - Frames are read oldest first, and reading stops at the
+//   first one that isn't done, so times are added in order
+// --------------------------------------------------------
+void GpuProfiler::BeginFrame()
+{
+	if (!enabled || inFrame)
+		return;
+
+	unsigned int slotCount = (unsigned int)slots.size();
+	for (unsigned int i = 0; i < slotCount; i++)
+	{
+		unsigned int slot = (unsigned int)((frame + i) % slotCount);
+		if (slots[slot].pending && !ReadSlot(slot))
+			break;
+	}
+
+	// Still waiting on the slot this frame needs
+	currentSlot = (unsigned int)(frame % slotCount);
+	if (slots[currentSlot].pending)
+	{
+		slots[currentSlot].pending = false;
+		framesDropped++;
+	}
+
+	std::fill(slots[currentSlot].written.begin(), slots[currentSlot].written.end(), 0);
+	backend->BeginFrame(currentSlot);
+	inFrame = true;
+	BeginScope(0);
+}
+
+void GpuProfiler::EndFrame()
+{
+	if (!inFrame)
+		return;
+
+	EndScope(0);
+	backend->EndFrame(currentSlot);
+	slots[currentSlot].pending = true;
+	inFrame = false;
+	frame++;
+}
+
+void GpuProfiler::BeginScope(int scope, ID3D11DeviceContext* context)
+{
+	if (!inFrame || scope < 0 || scope >= (int)scopes.size())
+		return;
+
+	unsigned int query = scope * 2;
+	backend->Timestamp(currentSlot, query, context);
+	slots[currentSlot].written[query] = 1;
+}
+
+void GpuProfiler::EndScope(int scope, ID3D11DeviceContext* context)
+{
+	if (!inFrame || scope < 0 || scope >= (int)scopes.size())
+		return;
+
+	unsigned int query = scope * 2 + 1;
+	backend->Timestamp(currentSlot, query, context);
+	slots[currentSlot].written[query] = 1;
+}
+
+// --------------------------------------------------------
+// Adds a finished frame's times to each scope's history
+//
+// Returns false if the GPU isn't done with the frame yet, in
+// which case nothing is added. Frames where the GPU's clock
+// was disturbed are thrown away
+// --------------------------------------------------------
+bool GpuProfiler::ReadSlot(unsigned int slot)
+{
+	unsigned long long frequency;
+	bool disjoint;
+	if (!backend->GetFrequency(slot, &frequency, &disjoint))
+		return false;
+
+	Slot& s = slots[slot];
+	if (disjoint || frequency == 0)
+	{
+		s.pending = false;
+		framesDropped++;
+		return true;
+	}
+
+	// Everything is read before anything is added, so a frame
+	// is either added whole or left for later
+	std::vector<float> times(scopes.size(), -1.0f);
+	for (unsigned int i = 0; i < scopes.size(); i++)
+	{
+		if (!s.written[i * 2] || !s.written[i * 2 + 1])
+			continue;
+
+		unsigned long long start, end;
+		if (!backend->GetTimestamp(slot, i * 2, &start) ||
+			!backend->GetTimestamp(slot, i * 2 + 1, &end))
+			return false;
+
+		if (end >= start)
+			times[i] = (float)((end - start) * 1000.0 / frequency);
+	}
+
+	for (unsigned int i = 0; i < scopes.size(); i++)
+	{
+		if (times[i] >= 0.0f)
+			scopes[i].history.Add(times[i]);
+	}
+
+	s.pending = false;
+	framesRead++;
+	return true;
+}
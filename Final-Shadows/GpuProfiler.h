@@ -0,0 +1,188 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Only passed along to the backend, so the profiler itself
+// doesn't need Direct3D
+struct ID3D11DeviceContext;
+
+// --------------------------------------------------------
+// Where the profiler's timestamps actually come from
+//
+// Queries are kept in slots, one per frame that can be in
+// flight at once, and numbered within each slot. Timestamps
+// may be written from any thread, each into a query no other
+// thread is using, while reading them back only happens on
+// the thread that owns the device's immediate context
+// --------------------------------------------------------
+class IGpuTimerBackend
+{
+public:
+	virtual ~IGpuTimerBackend() {}
+
+	// Makes sure each slot has at least this many queries
+	// - Called before any timestamps are written with them
+	virtual void Reserve(unsigned int slotCount, unsigned int queryCount) = 0;
+
+	// Brackets a frame's timestamps, which are only usable
+	// if nothing disturbed the GPU's clock in between
+	virtual void BeginFrame(unsigned int slot) = 0;
+	virtual void EndFrame(unsigned int slot) = 0;
+
+	// Writes a timestamp into a query once the GPU gets to it
+	// - A null context means the immediate one
+	virtual void Timestamp(unsigned int slot, unsigned int query, ID3D11DeviceContext* context) = 0;
+
+	// Each returns false until the GPU has finished with the slot
+	virtual bool GetFrequency(unsigned int slot, unsigned long long* frequency, bool* disjoint) = 0;
+	virtual bool GetTimestamp(unsigned int slot, unsigned int query, unsigned long long* ticks) = 0;
+};
+
+// --------------------------------------------------------
+// A backend with no GPU behind it, which answers every query
+// straight away with no time passed
+// - Lets the profiler run all of its bookkeeping anywhere
+// --------------------------------------------------------
+class NullGpuTimerBackend : public IGpuTimerBackend
+{
+public:
+	void Reserve(unsigned int /*slotCount*/, unsigned int /*queryCount*/) {}
+	void BeginFrame(unsigned int /*slot*/) {}
+	void EndFrame(unsigned int /*slot*/) {}
+	void Timestamp(unsigned int /*slot*/, unsigned int /*query*/, ID3D11DeviceContext* /*context*/) {}
+	bool GetFrequency(unsigned int slot, unsigned long long* frequency, bool* disjoint);
+	bool GetTimestamp(unsigned int slot, unsigned int query, unsigned long long* ticks);
+};
+
+struct GpuTimingStats
+{
+	float lastMs;
+	float minMs;
+	float avgMs;
+	float maxMs;
+	int samples;
+};
+
+// --------------------------------------------------------
+// The last so many times measured for one scope, and their
+// lowest, average and highest
+// --------------------------------------------------------
+class GpuTimingHistory
+{
+public:
+	GpuTimingHistory(unsigned int length = 120);
+
+	void Add(float ms);
+	void Clear();
+
+	const GpuTimingStats& GetStats() const { return stats; }
+
+private:
+	std::vector<float> times;
+	unsigned int length;
+	unsigned int next;
+	GpuTimingStats stats;
+};
+
+// --------------------------------------------------------
+// Times named stretches of GPU work with pairs of timestamps
+//
+// Scopes are registered up front, and each frame may begin
+// and end any of them once, in any nesting. The results come
+// back a few frames later, as the GPU catches up, so each
+// frame's queries live in their own slot of a small ring.
+// When the GPU falls so far behind that a slot is needed
+// again before its results are in, that frame is dropped
+// rather than waited on.
+//
+// Scope 0 is the whole frame, from BeginFrame() to EndFrame().
+// Beginning and ending scopes only touches that scope's own
+// queries, so different scopes can be timed from different
+// threads at once, as long as BeginFrame(), EndFrame() and
+// AddScope() stay on one thread
+// --------------------------------------------------------
+class GpuProfiler
+{
+public:
+	GpuProfiler(
+		std::shared_ptr<IGpuTimerBackend> backend,
+		unsigned int framesInFlight = 3,
+		unsigned int historyLength = 120);
+
+	// A parent of -1 puts the scope under the whole frame
+	int AddScope(const std::string& name, int parent = -1);
+
+	void BeginFrame();
+	void EndFrame();
+	void BeginScope(int scope, ID3D11DeviceContext* context = 0);
+	void EndScope(int scope, ID3D11DeviceContext* context = 0);
+
+	bool GetEnabled() { return enabled; }
+	void SetEnabled(bool e) { enabled = e; }
+
+	int GetScopeCount() { return (int)scopes.size(); }
+	const std::string& GetScopeName(int scope) { return scopes[scope].name; }
+	int GetScopeDepth(int scope) { return scopes[scope].depth; }
+	const GpuTimingStats& GetScopeStats(int scope) { return scopes[scope].history.GetStats(); }
+
+	unsigned int GetFramesInFlight() { return (unsigned int)slots.size(); }
+	unsigned int GetFramesRead() { return framesRead; }
+	unsigned int GetFramesDropped() { return framesDropped; }
+
+private:
+	struct Scope
+	{
+		std::string name;
+		int depth;
+		GpuTimingHistory history;
+	};
+
+	// Which of a frame's queries were written, since
+	// scopes that didn't run that frame have nothing to read
+	struct Slot
+	{
+		bool pending;
+		std::vector<unsigned char> written;
+	};
+
+	bool ReadSlot(unsigned int slot);
+
+	std::shared_ptr<IGpuTimerBackend> backend;
+	std::vector<Scope> scopes;
+	std::vector<Slot> slots;
+	unsigned int historyLength;
+
+	unsigned long long frame;
+	unsigned int currentSlot;
+	bool inFrame;
+	bool enabled;
+	unsigned int framesRead;
+	unsigned int framesDropped;
+};
+
+// --------------------------------------------------------
+// Times a scope until it goes out of C++ scope
+// --------------------------------------------------------
+class GpuScope
+{
+public:
+	GpuScope(GpuProfiler* profiler, int scope, ID3D11DeviceContext* context = 0)
+		: profiler(profiler), scope(scope), context(context)
+	{
+		if (profiler)
+			profiler->BeginScope(scope, context);
+	}
+
+	~GpuScope()
+	{
+		if (profiler)
+			profiler->EndScope(scope, context);
+	}
+
+private:
+	GpuProfiler* profiler;
+	int scope;
+	ID3D11DeviceContext* context;
+};
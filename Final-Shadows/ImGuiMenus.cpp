@@ -6,7 +6,14 @@ using namespace DirectX;
 // ------------------------------------------------------------------
 // Dislpay the program status in a small window
 // ------------------------------------------------------------------
-void ImGuiMenus::WindowStats(int windowWidth, int windowHeight)
+void ImGuiMenus::WindowStats(
+	int windowWidth,
+	int windowHeight,
+	std::shared_ptr<ConstantBufferRing> constantRing,
+	std::shared_ptr<StateCache> stateCache,
+	std::shared_ptr<RenderQueue> renderQueue,
+	std::shared_ptr<InstanceBatcher> instanceBatcher,
+	std::shared_ptr<ParallelRecorder> recorder)
 {
 	ImGui::Begin("Window Stats");
 
@@ -14,6 +21,63 @@ void ImGuiMenus::WindowStats(int windowWidth, int windowHeight)
 	ImGui::Text("Individual frame time: %fms", 1.0f / ImGui::GetIO().Framerate * 1000.0f);
 	ImGui::Text("Window size: %dx%d", windowWidth, windowHeight);
 
+	// Counts are from the last full frame, since they're reset as drawing starts
+	ImGui::Spacing();
+	ImGui::Text("Constant buffer uploads: %u (%.1f KB)",
+		ISimpleShader::TotalUploadCount.load(), ISimpleShader::TotalUploadBytes.load() / 1024.0f);
+	ImGui::Text("Unchanged buffers skipped: %u", ISimpleShader::TotalSkippedUploadCount.load());
+	ImGui::Checkbox("Skip setting unchanged values", &ShaderConstants::CompareOnSet);
+
+	if (constantRing->IsSupported())
+	{
+		const ConstantBufferRingStats& ringStats = constantRing->GetStats();
+		ImGui::Checkbox("Upload through constant ring", &ISimpleShader::UseConstantRing);
+		ImGui::Text("Ring: %u uploads (%.1f KB), %u discards",
+			ringStats.uploads, ringStats.bytes / 1024.0f, ringStats.discards);
+		ImGui::Text("Ring in use: %.1f / %.1f KB over %u frames",
+			constantRing->GetUsed() / 1024.0f, constantRing->GetSize() / 1024.0f, constantRing->GetFramesInFlight());
+	}
+	else
+	{
+		ImGui::Text("Constant ring needs Direct3D 11.1");
+	}
+
+	ImGui::Text("Shader reflection: %u loaded from .refl files, %u reflected",
+		ISimpleShader::ReflectionCacheHits, ISimpleShader::ReflectionCacheMisses);
+
+	const StateCacheStats& stateStats = stateCache->GetStats();
+	bool filterState = stateCache->GetEnabled();
+	ImGui::Spacing();
+	ImGui::Text("State changes: %u issued, %u redundant ones dropped", stateStats.issued, stateStats.elided);
+	if (ImGui::Checkbox("Drop redundant state changes", &filterState))
+		stateCache->SetEnabled(filterState);
+
+	const RenderQueueStats& queueStats = renderQueue->GetStats();
+	ImGui::Text("Draws: %d (%d shader, %d material, %d mesh changes)",
+		queueStats.packets, queueStats.shaderChanges, queueStats.materialChanges, queueStats.meshChanges);
+
+	bool instancing = instanceBatcher->GetEnabled();
+	if (ImGui::Checkbox("Instance entities sharing a mesh", &instancing))
+		instanceBatcher->SetEnabled(instancing);
+
+	int minBatchSize = instanceBatcher->GetMinBatchSize();
+	if (ImGui::SliderInt("Min instances per batch", &minBatchSize, 1, 32))
+		instanceBatcher->SetMinBatchSize(minBatchSize);
+
+	const InstancingStats& instancingStats = instanceBatcher->GetStats();
+	ImGui::Text("Main pass: %d entities in %d draw calls",
+		instancingStats.mainEntities, instancingStats.mainDrawCalls);
+	ImGui::Text("Shadow maps: %d entities in %d draw calls",
+		instancingStats.shadowEntities, instancingStats.shadowDrawCalls);
+
+	bool parallel = recorder->GetParallel();
+	if (ImGui::Checkbox("Record passes on worker threads", &parallel))
+		recorder->SetParallel(parallel);
+	ImGui::Text("Recording: %.3f ms on %d threads",
+		recorder->GetRecordMs(), parallel ? recorder->GetThreadCount() : 1);
+	if (parallel && constantRing->IsSupported())
+		ImGui::Text("Worker threads upload to each shader's own buffers, not the ring");
+
 	ImGui::Spacing();
 
 	if (ImGui::Button(ImGuiMenus::showUiDemoWindow ? "Hide ImGui demo window" : "Show ImGui demo window"))
@@ -27,6 +91,457 @@ void ImGuiMenus::WindowStats(int windowWidth, int windowHeight)
 	ImGui::End();
 }
 
+// ------------------------------------------------------------------
+// Toggle packing material textures into shared arrays, returning true
+// when it changes so the materials can be rebuilt
+// ------------------------------------------------------------------
+bool ImGuiMenus::TexturePooling(bool* enabled, std::shared_ptr<TexturePool> pool)
+{
+	ImGui::Begin("Texture Pool");
+
+	bool changed = ImGui::Checkbox("Pack material textures into arrays", enabled);
+	if (pool && pool->IsBuilt())
+		ImGui::Text("%d textures in %d arrays", (int)pool->GetTextureCount(), (int)pool->GetArrayCount());
+	else
+		ImGui::Text("Each material binds its own textures");
+	ImGui::TextDisabled("Switching rebuilds every material");
+
+	ImGui::End();
+
+	return changed;
+}
+
+// ------------------------------------------------------------------
+// Toggle the depth pre-pass and show what each half of the main pass
+// costs on the GPU, with the CPU's recording time alongside
+// ------------------------------------------------------------------
+void ImGuiMenus::DepthPrePass(
+	bool* enabled,
+	std::shared_ptr<GpuProfiler> profiler,
+	int prePassScope,
+	int shadingScope,
+	float prePassRecordMs,
+	float shadingRecordMs)
+{
+	ImGui::Begin("Depth Pre-Pass");
+
+	ImGui::Checkbox("Lay down depth before shading", enabled);
+
+	if (!profiler->GetEnabled())
+		ImGui::TextDisabled("Turn on \"Time GPU work\" to see GPU times");
+	else if (ImGui::BeginTable("DepthPrePassTimes", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+	{
+		ImGui::TableSetupColumn("GPU");
+		ImGui::TableSetupColumn("Min ms");
+		ImGui::TableSetupColumn("Avg ms");
+		ImGui::TableSetupColumn("Max ms");
+		ImGui::TableHeadersRow();
+
+		// The pre-pass only has times while it's on
+		int scopes[2] = { prePassScope, shadingScope };
+		for (int scope : scopes)
+		{
+			const GpuTimingStats& stats = profiler->GetScopeStats(scope);
+			if (stats.samples == 0 || (scope == prePassScope && !*enabled))
+				continue;
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", profiler->GetScopeName(scope).c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", stats.minMs);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", stats.avgMs);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", stats.maxMs);
+		}
+		ImGui::EndTable();
+	}
+
+	if (*enabled)
+		ImGui::Text("Depth pre-pass recording: %.3f ms", prePassRecordMs);
+	ImGui::Text("Shading recording: %.3f ms", shadingRecordMs);
+	ImGui::TextDisabled("Recording times are CPU time, not GPU time");
+
+	ImGui::End();
+}
+
+// ------------------------------------------------------------------
+// Show how long the GPU spent on each part of the last few frames
+// ------------------------------------------------------------------
+void ImGuiMenus::GpuTimings(std::shared_ptr<GpuProfiler> profiler)
+{
+	ImGui::Begin("GPU Timings");
+
+	bool enabled = profiler->GetEnabled();
+	if (ImGui::Checkbox("Time GPU work", &enabled))
+		profiler->SetEnabled(enabled);
+	ImGui::Text("Frames read: %u, dropped: %u (up to %u in flight)",
+		profiler->GetFramesRead(), profiler->GetFramesDropped(), profiler->GetFramesInFlight());
+
+	if (ImGui::BeginTable("GpuScopes", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+	{
+		ImGui::TableSetupColumn("Scope");
+		ImGui::TableSetupColumn("Last ms");
+		ImGui::TableSetupColumn("Min ms");
+		ImGui::TableSetupColumn("Avg ms");
+		ImGui::TableSetupColumn("Max ms");
+		ImGui::TableHeadersRow();
+
+		for (int i = 0; i < profiler->GetScopeCount(); i++)
+		{
+			const GpuTimingStats& stats = profiler->GetScopeStats(i);
+			if (stats.samples == 0)
+				continue;
+
+			// Nested scopes are indented under their parents
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%*s%s", profiler->GetScopeDepth(i) * 2, "", profiler->GetScopeName(i).c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", stats.lastMs);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", stats.minMs);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", stats.avgMs);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", stats.maxMs);
+		}
+		ImGui::EndTable();
+	}
+
+	ImGui::End();
+}
+
+// ------------------------------------------------------------------
+// Draw the last frame's CPU markers as a flame graph, with a row per
+// nesting level for each thread
+// - Returns whether the user wants the recent frames saved as a trace
+// ------------------------------------------------------------------
+bool ImGuiMenus::CpuTimings()
+{
+	ImGui::Begin("CPU Timings");
+
+#if !CPU_PROFILING
+	ImGui::Text("Markers are compiled out - build with CPU_PROFILING set to 1");
+#endif
+
+	bool enabled = CpuProfiler::Enabled;
+	if (ImGui::Checkbox("Record markers", &enabled))
+		CpuProfiler::Enabled = enabled;
+	ImGui::SameLine();
+	if (ImGui::Checkbox("Pause", &pauseCpuTimings) && pauseCpuTimings)
+		pausedCpuFrame = CpuProfiler::GetLastFrame();
+
+	const CpuProfileFrame& frame = pauseCpuTimings ? pausedCpuFrame : CpuProfiler::GetLastFrame();
+	float frameMs = (frame.end - frame.start) / 1000000.0f;
+	ImGui::Text("Frame: %.3f ms, %d markers on %u threads",
+		frameMs, (int)frame.events.size(), CpuProfiler::GetThreadCount());
+
+	// Each thread's rows start below the deepest row of the one before
+	std::vector<int> firstRow(CpuProfiler::GetThreadCount() + 1, 0);
+	for (auto& e : frame.events)
+	{
+		if (e.thread < firstRow.size() - 1 && e.depth + 1 > firstRow[e.thread + 1])
+			firstRow[e.thread + 1] = e.depth + 1;
+	}
+	for (size_t t = 1; t < firstRow.size(); t++)
+		firstRow[t] += firstRow[t - 1];
+
+	const float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+	ImVec2 origin = ImGui::GetCursorScreenPos();
+	float width = ImGui::GetContentRegionAvail().x;
+	float height = firstRow.back() * rowHeight;
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+
+	for (auto& e : frame.events)
+	{
+		if (e.thread >= firstRow.size() - 1 || frame.end <= frame.start)
+			continue;
+
+		float x0 = origin.x + (float)(e.start - frame.start) / (frame.end - frame.start) * width;
+		float x1 = origin.x + (float)(e.end - frame.start) / (frame.end - frame.start) * width;
+		if (x1 < origin.x || x0 > origin.x + width)
+			continue;
+		if (x1 - x0 < 1.0f)
+			x1 = x0 + 1.0f;
+
+		float y0 = origin.y + (firstRow[e.thread] + e.depth) * rowHeight;
+		ImVec2 a(x0, y0);
+		ImVec2 b(x1, y0 + rowHeight - 1.0f);
+
+		// The same marker keeps the same color from frame to frame
+		unsigned int hash = 2166136261u;
+		for (const char* c = e.name; *c; c++)
+			hash = (hash ^ (unsigned char)*c) * 16777619u;
+		drawList->AddRectFilled(a, b, ImColor::HSV((hash % 360) / 360.0f, 0.5f, 0.7f));
+
+		drawList->PushClipRect(a, b, true);
+		drawList->AddText(ImVec2(x0 + 2.0f, y0 + 2.0f), IM_COL32_WHITE, e.name);
+		drawList->PopClipRect();
+
+		if (ImGui::IsMouseHoveringRect(a, b))
+			ImGui::SetTooltip("%s: %.3f ms (thread %u)", e.name, (e.end - e.start) / 1000000.0f, e.thread);
+	}
+	ImGui::Dummy(ImVec2(width, height));
+
+	bool save = ImGui::Button("Save Chrome trace");
+	ImGui::SameLine();
+	ImGui::TextDisabled("(last %u frames)", CpuProfiler::TraceFrames);
+
+	ImGui::Spacing();
+	ImGui::SliderInt("Markers", &profilerBenchmarkMarkers, 1, 1000000, "%d", ImGuiSliderFlags_Logarithmic);
+	if (ImGui::Button("Measure marker overhead"))
+		cpuProfilerBenchmark = ::Benchmarks::CpuProfilerMarkers(profilerBenchmarkMarkers);
+
+	if (cpuProfilerBenchmark.markers > 0)
+	{
+		float markers = (float)cpuProfilerBenchmark.markers;
+		ImGui::Text("Recording: %.1f ns per marker",
+			(cpuProfilerBenchmark.enabledMs - cpuProfilerBenchmark.emptyMs) * 1000000.0f / markers);
+		ImGui::Text("Switched off: %.1f ns per marker",
+			(cpuProfilerBenchmark.disabledMs - cpuProfilerBenchmark.emptyMs) * 1000000.0f / markers);
+	}
+
+	ImGui::End();
+	return save;
+}
+
+// ------------------------------------------------------------------
+// Display how many entities were culled this frame and toggle culling
+// ------------------------------------------------------------------
+void ImGuiMenus::Culling(std::shared_ptr<CullingSystem> culling, std::shared_ptr<PortalSystem> portals)
+{
+	ImGui::Begin("Culling");
+
+	bool frustumCulling = culling->GetFrustumCulling();
+	bool screenSizeCulling = culling->GetScreenSizeCulling();
+	if (ImGui::Checkbox("Frustum culling", &frustumCulling))
+		culling->SetFrustumCulling(frustumCulling);
+	if (ImGui::Checkbox("Screen size culling", &screenSizeCulling))
+		culling->SetScreenSizeCulling(screenSizeCulling);
+
+	bool temporalCaching = culling->GetTemporalCaching();
+	float moveThreshold = culling->GetCameraMoveThreshold();
+	float turnThreshold = XMConvertToDegrees(culling->GetCameraTurnThreshold());
+	if (ImGui::Checkbox("Reuse static entity results", &temporalCaching))
+		culling->SetTemporalCaching(temporalCaching);
+	if (ImGui::DragFloat("Camera move threshold", &moveThreshold, 0.01f, 0.f, 10.f))
+		culling->SetCameraMoveThreshold(moveThreshold);
+	if (ImGui::DragFloat("Camera turn threshold (degrees)", &turnThreshold, 0.1f, 0.f, 45.f))
+		culling->SetCameraTurnThreshold(XMConvertToRadians(turnThreshold));
+
+	ImGui::Spacing();
+
+	const CullingStats& stats = culling->GetStats();
+	ImGui::Text("Main pass: %d tested, %d outside frustum, %d too small",
+		stats.mainTested, stats.mainFrustumCulled, stats.mainScreenSizeCulled);
+	ImGui::Text("Shadow passes: %d tested, %d outside frustum, %d too small",
+		stats.shadowTested, stats.shadowFrustumCulled, stats.shadowScreenSizeCulled);
+	ImGui::Text("Cache: %d of %d static results reused this frame", stats.cacheHits, stats.cacheLookups);
+	ImGui::Text("Cache hit rate: %.1f%%", culling->GetCacheHitRate() * 100.0f);
+	ImGui::Text("Camera epoch: %u", culling->GetCameraEpoch());
+
+	// Portals only exist in scenes that came with a cell file
+	if (portals->IsLoaded())
+	{
+		ImGui::Spacing();
+
+		bool portalCulling = portals->GetEnabled();
+		int maxDepth = portals->GetMaxDepth();
+		if (ImGui::Checkbox("Portal culling", &portalCulling))
+			portals->SetEnabled(portalCulling);
+		if (ImGui::SliderInt("Max portal depth", &maxDepth, 0, 32))
+			portals->SetMaxDepth(maxDepth);
+
+		const PortalStats& portalStats = portals->GetStats();
+		int cameraCell = portals->GetCameraCell();
+		ImGui::Text("Camera cell: %s", cameraCell == -1 ? "(outside)" : portals->GetCells()[cameraCell].name.c_str());
+		ImGui::Text("Cells: %d of %d visible", portalStats.cellsVisible, (int)portals->GetCells().size());
+		ImGui::Text("Portals: %d passed of %d tested", portalStats.portalsPassed, portalStats.portalsTested);
+		ImGui::Text("Entities in hidden cells: %d", portalStats.entitiesCulled);
+	}
+
+	ImGui::End();
+}
+
+// ------------------------------------------------------------------
+// Show the loaded PVS and its bake settings
+// - Returns true when the user asks for the PVS to be baked
+// ------------------------------------------------------------------
+bool ImGuiMenus::PotentiallyVisibleSets(std::shared_ptr<PVS> pvs, PVSBakeSettings* settings, std::shared_ptr<Camera> cam)
+{
+	ImGui::Begin("Potentially Visible Sets");
+
+	if (pvs->IsLoaded())
+	{
+		const PVSStats& stats = pvs->GetStats();
+		ImGui::Text("Cells: %d (%d distinct sets)", stats.cellCount, stats.uniqueSetCount);
+		ImGui::Text("Average static entities visible: %.2f", stats.averageVisible);
+		ImGui::Text("Compressed size: %d bytes", (int)stats.dataSize);
+		if (stats.bakeSeconds > 0.0f)
+			ImGui::Text("Bake time: %.2f s", stats.bakeSeconds);
+
+		int cell = pvs->FindCell(cam->GetTransform()->GetPosition());
+		if (cell == -1)
+			ImGui::Text("Camera cell: (outside)");
+		else
+			ImGui::Text("Camera cell: %d", cell);
+	}
+	else
+	{
+		ImGui::Text("No PVS loaded");
+	}
+
+	ImGui::Spacing();
+
+	ImGui::DragFloat("Cell size", &settings->cellSize, 0.1f, 0.25f, 50.f);
+	ImGui::DragFloat("Margin", &settings->margin, 0.1f, 0.f, 100.f);
+	ImGui::SliderInt("Samples per cell", &settings->samplesPerCell, 1, 32);
+	ImGui::SliderInt("Rays per sample", &settings->raysPerSample, 0, 4096);
+	ImGui::SliderInt("Rays per entity", &settings->raysPerEntity, 0, 64);
+	ImGui::SliderInt("Threads (0 = all)", &settings->threadCount, 0, 64);
+
+	bool bake = ImGui::Button("Bake");
+
+	ImGui::End();
+
+	return bake;
+}
+
+// ------------------------------------------------------------------
+// Run CPU-side benchmarks on demand and show their results
+// ------------------------------------------------------------------
+void ImGuiMenus::Benchmarks(std::shared_ptr<SimpleVertexShader> vs)
+{
+	ImGui::Begin("Benchmarks");
+
+	ImGui::SliderInt("Draws", &benchmarkDraws, 1, 1000000, "%d", ImGuiSliderFlags_Logarithmic);
+
+	if (ImGui::Button("Shader variables"))
+	{
+		std::vector<std::string> names = { "world", "view", "proj", "worldInvTranspose" };
+		shaderVariableBenchmark = ::Benchmarks::ShaderVariables(vs->GetReflection(), names, benchmarkDraws);
+	}
+
+	if (shaderVariableBenchmark.draws > 0)
+	{
+		ImGui::Text("%d variables over %d draws (%u uploads)", shaderVariableBenchmark.variables, shaderVariableBenchmark.draws, shaderVariableBenchmark.uploads);
+		ImGui::Text("By name: %.3f ms", shaderVariableBenchmark.byNameMs);
+		ImGui::Text("By handle: %.3f ms", shaderVariableBenchmark.byHandleMs);
+		if (shaderVariableBenchmark.byHandleMs > 0.0f)
+			ImGui::Text("Speedup: %.1fx", shaderVariableBenchmark.byNameMs / shaderVariableBenchmark.byHandleMs);
+	}
+
+	ImGui::Spacing();
+
+	// Draws are spread over 100 frames, with the GPU three frames behind
+	// - The allocator is only bookkeeping, so the ring can be sized to fit
+	//   every frame in flight without allocating anything that big
+	if (ImGui::Button("Constant ring allocations"))
+		ringAllocatorBenchmark = ::Benchmarks::RingAllocations((size_t)benchmarkDraws * 1024 * 4, 100, benchmarkDraws, 3);
+
+	if (ringAllocatorBenchmark.frames > 0)
+	{
+		ImGui::Text("%d allocations over %d frames (%d failed, %u wraps)",
+			ringAllocatorBenchmark.allocations, ringAllocatorBenchmark.frames,
+			ringAllocatorBenchmark.failures, ringAllocatorBenchmark.wraps);
+		ImGui::Text("Time: %.3f ms", ringAllocatorBenchmark.ms);
+		if (ringAllocatorBenchmark.ms > 0.0f)
+			ImGui::Text("Allocations per ms: %.0f", ringAllocatorBenchmark.allocations / ringAllocatorBenchmark.ms);
+	}
+
+	ImGui::Spacing();
+	ImGui::SliderInt("Packets", &sortBenchmarkPackets, 1, 1000000, "%d", ImGuiSliderFlags_Logarithmic);
+	if (ImGui::Button("Render queue sort"))
+		renderQueueSortBenchmark = ::Benchmarks::RenderQueueSort(sortBenchmarkPackets);
+
+	if (renderQueueSortBenchmark.packets > 0)
+	{
+		ImGui::Text("%d packets", renderQueueSortBenchmark.packets);
+		ImGui::Text("Radix sort: %.3f ms", renderQueueSortBenchmark.radixMs);
+		ImGui::Text("std::stable_sort: %.3f ms", renderQueueSortBenchmark.stdSortMs);
+		if (renderQueueSortBenchmark.radixMs > 0.0f)
+			ImGui::Text("Packets per ms: %.0f", renderQueueSortBenchmark.packets / renderQueueSortBenchmark.radixMs);
+	}
+
+	ImGui::End();
+}
+
+// ------------------------------------------------------------------
+// Show what the last captured frame asked for, and how it compares
+// to the capture before it
+// - Returns whether the user wants a new capture or to save this one
+// ------------------------------------------------------------------
+ImGuiMenus::FrameCaptureAction ImGuiMenus::FrameCapture(
+	std::shared_ptr<CommandStream> capture,
+	std::shared_ptr<CommandStream> previous,
+	const CommandStats& stats,
+	int firstDifference)
+{
+	static const char* commandNames[COMMAND_TYPE_COUNT] =
+	{
+		"Input layout", "Primitive topology", "Vertex buffer", "Index buffer",
+		"Vertex shader", "Pixel shader", "Constant buffer", "Shader resource",
+		"Sampler", "Update buffer", "Draw indexed", "Draw indexed instanced",
+		"Clear render target", "Clear depth", "Viewport", "Render targets"
+	};
+
+	ImGui::Begin("Frame Capture");
+
+	FrameCaptureAction action = FRAME_CAPTURE_NONE;
+	if (ImGui::Button("Capture next frame"))
+		action = FRAME_CAPTURE_TAKE;
+
+	if (capture->GetCommandCount() == 0)
+	{
+		ImGui::Text("No frame captured");
+		ImGui::End();
+		return action;
+	}
+
+	ImGui::SameLine();
+	if (ImGui::Button("Save"))
+		action = FRAME_CAPTURE_SAVE;
+
+	ImGui::Text("Commands: %u (%d bytes, %d objects)", capture->GetCommandCount(), (int)capture->GetByteCount(), (int)capture->GetObjectCount());
+	ImGui::Text("Draws: %u (%u instances, %u indices)", stats.draws, stats.instances, stats.indices);
+	ImGui::Text("Buffer updates: %u (%u bytes)", stats.commands[COMMAND_UPDATE_BUFFER], stats.updateBytes);
+	ImGui::Text("Redundant state changes: %u", stats.redundant);
+
+	if (ImGui::TreeNode("Commands by type"))
+	{
+		for (int t = 0; t < COMMAND_TYPE_COUNT; t++)
+			ImGui::Text("%s: %u", commandNames[t], stats.commands[t]);
+		ImGui::TreePop();
+	}
+
+	ImGui::Spacing();
+	if (previous->GetCommandCount() == 0)
+		ImGui::Text("Capture again to compare frames");
+	else if (firstDifference == -1)
+		ImGui::Text("Same commands as the previous capture");
+	else
+		ImGui::Text("Differs from the previous capture (%u commands) at command %d", previous->GetCommandCount(), firstDifference);
+
+	ImGui::Spacing();
+	ImGui::SliderInt("Replays", &replayBenchmarkRepeats, 1, 1000, "%d", ImGuiSliderFlags_Logarithmic);
+	if (ImGui::Button("Time replay"))
+		commandReplayBenchmark = ::Benchmarks::CommandReplay(*capture, replayBenchmarkRepeats);
+
+	if (commandReplayBenchmark.repeats > 0)
+	{
+		float repeats = (float)commandReplayBenchmark.repeats;
+		ImGui::Text("%u commands, %d times", commandReplayBenchmark.commands, commandReplayBenchmark.repeats);
+		ImGui::Text("Decode only: %.3f ms per replay", commandReplayBenchmark.decodeMs / repeats);
+		ImGui::Text("Into statistics backend: %.3f ms per replay", commandReplayBenchmark.statsMs / repeats);
+		ImGui::Text("Into a new stream: %.3f ms per replay", commandReplayBenchmark.encodeMs / repeats);
+	}
+
+	ImGui::End();
+	return action;
+}
+
 // ------------------------------------------------------------------
 // Provide runtime tools to edit the precreated rendered scene
 // ------------------------------------------------------------------
@@ -34,9 +549,13 @@ void ImGuiMenus::EditScene(
 	std::shared_ptr<Camera> cam,
 	std::vector<std::shared_ptr<GameEntity>> entities,
 	std::vector<std::shared_ptr<Material>> materials,
-	std::vector<Light>* lights
+	std::vector<Light>* lights,
+	int* selectedEntity,
+	const PickResult* lastPick,
+	float lastPickTime
 	)
 {
+	PROFILE_SCOPE("EditScene");
 	ImGui::Begin("Edit Scene");
 
 	if (ImGui::BeginTabBar("Scene Components"))
@@ -89,10 +608,30 @@ void ImGuiMenus::EditScene(
 		{
 			ImGui::Spacing();
 
+			// Details of the last entity picked by right clicking in the scene
+			ImGui::Text("Right click the scene to pick an entity");
+			if (lastPick != 0)
+			{
+				ImGui::Text("Picked entity %d, triangle %u", lastPick->entityIndex, lastPick->triangleIndex);
+				ImGui::Text("Barycentrics: %.3f, %.3f, %.3f", lastPick->barycentrics.x, lastPick->barycentrics.y, lastPick->barycentrics.z);
+				ImGui::Text("Hit position: %.2f, %.2f, %.2f", lastPick->position.x, lastPick->position.y, lastPick->position.z);
+				ImGui::Text("Pick query time: %.4fms", lastPickTime);
+			}
+			ImGui::Spacing();
+
 			for (int i = 0; i < entities.size(); i++)
 			{
 				ImGui::PushID(i);
-				if (ImGui::TreeNode("Entity Node", "Entity %d", i))
+
+				// Open the node of a newly picked entity
+				if (i == *selectedEntity && lastOpenedSelection != *selectedEntity)
+				{
+					ImGui::SetNextItemOpen(true);
+					lastOpenedSelection = *selectedEntity;
+				}
+
+				ImGuiTreeNodeFlags flags = i == *selectedEntity ? ImGuiTreeNodeFlags_Selected : ImGuiTreeNodeFlags_None;
+				if (ImGui::TreeNodeEx("Entity Node", flags, "Entity %d", i))
 				{
 					// Transform values
 					Transform* transform = entities[i]->GetTransform();
@@ -120,9 +659,14 @@ void ImGuiMenus::EditScene(
 					if (ImGui::DragFloat3("Scale", &scale.x, 0.01f))
 						transform->SetScale(scale);
 
+					bool isStatic = entities[i]->IsStatic();
+					if (ImGui::Checkbox("Static", &isStatic))
+						entities[i]->SetStatic(isStatic);
+
 					// Mesh details
 					ImGui::Spacing();
 					ImGui::Text("Mesh index count: %d", entities[i]->GetMesh()->GetIndexCount());
+					ImGui::Text("Mesh BVH nodes: %d", (int)entities[i]->GetMesh()->GetBVH().GetNodeCount());
 
 
 					ImGui::TreePop();
@@ -194,6 +738,18 @@ void ImGuiMenus::EditScene(
 						materials[i]->SetTextureOffset(texOffset);
 					}
 
+					// Culling thresholds
+					float minScreenSize = materials[i]->GetMinScreenSize();
+					float minShadowScreenSize = materials[i]->GetMinShadowScreenSize();
+					if (ImGui::DragFloat("Min Screen Size (pixels)", &minScreenSize, 0.1f, 0, D3D11_FLOAT32_MAX))
+					{
+						materials[i]->SetMinScreenSize(minScreenSize);
+					}
+					if (ImGui::DragFloat("Min Shadow Size (texels)", &minShadowScreenSize, 0.1f, 0, D3D11_FLOAT32_MAX))
+					{
+						materials[i]->SetMinShadowScreenSize(minShadowScreenSize);
+					}
+
 					ImGui::TreePop();
 				}
 
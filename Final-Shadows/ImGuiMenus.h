@@ -8,16 +8,77 @@
 #include "Camera.h"
 #include "GameEntity.h"
 #include "Lights.h"
+#include "Picking.h"
+#include "Culling.h"
+#include "Portals.h"
+#include "PVS.h"
+#include "Benchmarks.h"
+#include "ConstantBufferRing.h"
+#include "StateCache.h"
+#include "RenderQueue.h"
+#include "InstanceBatcher.h"
+#include "ParallelRecorder.h"
+#include "CommandStream.h"
+#include "GpuProfiler.h"
+#include "TexturePool.h"
 
 namespace ImGuiMenus
 {
-	void WindowStats(int windowWidth, int windowHeight);
+	// What the frame capture window asks the game to do
+	enum FrameCaptureAction
+	{
+		FRAME_CAPTURE_NONE,
+		FRAME_CAPTURE_TAKE,
+		FRAME_CAPTURE_SAVE
+	};
+
+	void WindowStats(
+		int windowWidth,
+		int windowHeight,
+		std::shared_ptr<ConstantBufferRing> constantRing,
+		std::shared_ptr<StateCache> stateCache,
+		std::shared_ptr<RenderQueue> renderQueue,
+		std::shared_ptr<InstanceBatcher> instanceBatcher,
+		std::shared_ptr<ParallelRecorder> recorder);
+	void Culling(std::shared_ptr<CullingSystem> culling, std::shared_ptr<PortalSystem> portals);
+	bool PotentiallyVisibleSets(std::shared_ptr<PVS> pvs, PVSBakeSettings* settings, std::shared_ptr<Camera> cam);
+	void Benchmarks(std::shared_ptr<SimpleVertexShader> vs);
+	void DepthPrePass(
+		bool* enabled,
+		std::shared_ptr<GpuProfiler> profiler,
+		int prePassScope,
+		int shadingScope,
+		float prePassRecordMs,
+		float shadingRecordMs);
+	bool TexturePooling(bool* enabled, std::shared_ptr<TexturePool> pool);
+	void GpuTimings(std::shared_ptr<GpuProfiler> profiler);
+	bool CpuTimings();
+	FrameCaptureAction FrameCapture(
+		std::shared_ptr<CommandStream> capture,
+		std::shared_ptr<CommandStream> previous,
+		const CommandStats& stats,
+		int firstDifference);
 	void EditScene(
 		std::shared_ptr<Camera> cam,
 		std::vector<std::shared_ptr<GameEntity>> entities,
 		std::vector<std::shared_ptr<Material>> materials,
-		std::vector<Light>* lights
+		std::vector<Light>* lights,
+		int* selectedEntity,
+		const PickResult* lastPick,
+		float lastPickTime
 	);
 
 	static bool showUiDemoWindow = false;
+	static int lastOpenedSelection = -1;
+	static int benchmarkDraws = 10000;
+	static ShaderVariableBenchmark shaderVariableBenchmark = {};
+	static RingAllocatorBenchmark ringAllocatorBenchmark = {};
+	static int sortBenchmarkPackets = 100000;
+	static RenderQueueSortBenchmark renderQueueSortBenchmark = {};
+	static int replayBenchmarkRepeats = 100;
+	static CommandReplayBenchmark commandReplayBenchmark = {};
+	static int profilerBenchmarkMarkers = 100000;
+	static CpuProfilerBenchmark cpuProfilerBenchmark = {};
+	static bool pauseCpuTimings = false;
+	static CpuProfileFrame pausedCpuFrame = {};
 }
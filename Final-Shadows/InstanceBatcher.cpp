@@ -0,0 +1,111 @@
+#include <string.h>
+#include "InstanceBatcher.h"
+
+InstanceBatcher::InstanceBatcher(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	unsigned int capacity)
+	:
+	device(device),
+	context(context),
+	capacity(0),
+	used(0),
+	enabled(true),
+	minBatchSize(2),
+	stats(),
+	lastFrameStats()
+{
+	CreateBuffer(capacity);
+}
+
+// --------------------------------------------------------
+// Creates the instance buffer, replacing any existing one
+// - It's marked as full, so the first map is a discard, which
+//   deferred contexts require of a new dynamic buffer
+// --------------------------------------------------------
+void InstanceBatcher::CreateBuffer(unsigned int instances)
+{
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.ByteWidth = instances * sizeof(InstanceData);
+	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	device->CreateBuffer(&bufferDesc, 0, instanceBuffer.ReleaseAndGetAddressOf());
+
+	capacity = instances;
+	used = instances;
+}
+
+// --------------------------------------------------------
+// Starts a new frame of batches
+// - The first batch discards the buffer, so nothing waits on
+//   the GPU to finish with last frame's instances
+// --------------------------------------------------------
+void InstanceBatcher::BeginFrame()
+{
+	lastFrameStats = stats;
+	stats = {};
+	used = capacity;
+	pending.clear();
+}
+
+// --------------------------------------------------------
+// Adds counts from another batcher to this frame's, such as
+// one recording a pass on another thread
+// --------------------------------------------------------
+void InstanceBatcher::AddStats(const InstancingStats& other)
+{
+	stats.mainEntities += other.mainEntities;
+	stats.mainDrawCalls += other.mainDrawCalls;
+	stats.shadowEntities += other.shadowEntities;
+	stats.shadowDrawCalls += other.shadowDrawCalls;
+}
+
+// --------------------------------------------------------
+// Adds an entity to the batch being built
+// --------------------------------------------------------
+void InstanceBatcher::Add(GameEntity* entity)
+{
+	InstanceData instance = {};
+	instance.world = entity->GetTransform()->GetWorldMatrix();
+	instance.worldInvTranspose = entity->GetTransform()->GetWorldInverseTransposeMatrix();
+	pending.push_back(instance);
+}
+
+// --------------------------------------------------------
+// Draws every entity added since the last batch as instances
+// of the mesh, using whatever shaders are currently set
+// --------------------------------------------------------
+void InstanceBatcher::Draw(std::shared_ptr<Mesh> mesh, StateCache* states)
+{
+	unsigned int count = (unsigned int)pending.size();
+	if (count == 0)
+		return;
+
+	if (count > capacity)
+		CreateBuffer(count * 2);
+
+	// Keep appending until the buffer is full, then start over
+	// with fresh memory from the driver
+	D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (used + count > capacity)
+	{
+		mapType = D3D11_MAP_WRITE_DISCARD;
+		used = 0;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(instanceBuffer.Get(), 0, mapType, 0, &mapped)))
+	{
+		pending.clear();
+		return;
+	}
+
+	memcpy((InstanceData*)mapped.pData + used, pending.data(), count * sizeof(InstanceData));
+	context->Unmap(instanceBuffer.Get(), 0);
+
+	mesh->DrawInstanced(instanceBuffer.Get(), sizeof(InstanceData), count, used, states);
+
+	used += count;
+	pending.clear();
+}
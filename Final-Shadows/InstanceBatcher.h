@@ -0,0 +1,88 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <wrl/client.h>
+#include <memory>
+#include <vector>
+#include "GameEntity.h"
+#include "Mesh.h"
+#include "StateCache.h"
+
+// --------------------------------------------------------
+// What each instance needs, matching InstancedVertexShaderInput
+// --------------------------------------------------------
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 world;
+	DirectX::XMFLOAT4X4 worldInvTranspose;
+};
+
+// --------------------------------------------------------
+// Entities drawn and the draw calls it took this frame
+// --------------------------------------------------------
+struct InstancingStats
+{
+	int mainEntities;
+	int mainDrawCalls;
+	int shadowEntities;
+	int shadowDrawCalls;
+};
+
+// --------------------------------------------------------
+// Draws runs of entities sharing a mesh and material with a
+// single DrawIndexedInstanced() call
+//
+// Entities are added one at a time, then drawn together. Their
+// matrices are appended to a dynamic vertex buffer shared by
+// every batch in the frame, and each batch starts at its own
+// instance. The buffer is discarded when it fills up and at the
+// start of each frame, and grows if a single batch won't fit.
+//
+// Instanced draws need a vertex shader taking its matrices per
+// instance (see InstancedVertexShaderInput) - setting shaders
+// and material data is left to the caller
+// --------------------------------------------------------
+class InstanceBatcher
+{
+public:
+	InstanceBatcher(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		unsigned int capacity = 1024);
+
+	void BeginFrame();
+	void Add(GameEntity* entity);
+	void Draw(std::shared_ptr<Mesh> mesh, StateCache* states);
+
+	// Runs shorter than the minimum aren't worth a batch
+	bool ShouldInstance(int runLength) { return enabled && runLength >= minBatchSize; }
+	void RecordMainDraws(int entities, int drawCalls) { stats.mainEntities += entities; stats.mainDrawCalls += drawCalls; }
+	void RecordShadowDraws(int entities, int drawCalls) { stats.shadowEntities += entities; stats.shadowDrawCalls += drawCalls; }
+
+	const InstancingStats& GetStats() { return lastFrameStats; }
+	const InstancingStats& GetFrameStats() { return stats; }
+	void AddStats(const InstancingStats& other);
+	bool GetEnabled() { return enabled; }
+	int GetMinBatchSize() { return minBatchSize; }
+	unsigned int GetCapacity() { return capacity; }
+
+	void SetEnabled(bool e) { enabled = e; }
+	void SetMinBatchSize(int size) { minBatchSize = size < 1 ? 1 : size; }
+
+private:
+	void CreateBuffer(unsigned int instances);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> instanceBuffer;
+	unsigned int capacity;
+	unsigned int used;		// Instances written since the buffer was last discarded
+
+	std::vector<InstanceData> pending;
+	bool enabled;
+	int minBatchSize;
+
+	InstancingStats stats;
+	InstancingStats lastFrameStats;
+};
@@ -0,0 +1,15 @@
+#include "ShaderIncludes.hlsli"
+
+// Same as ShadowMapVertexShader.hlsl, with the world matrix
+// of each caster coming from the instance vertex buffer
+cbuffer PerPass : register(b0)
+{
+	matrix view;
+	matrix proj;
+}
+
+float4 main( InstancedVertexShaderInput input ) : SV_POSITION
+{
+	matrix world = transpose(matrix(input.world0, input.world1, input.world2, input.world3));
+	return ProjectToScreen(world, view, proj, input.localPosition);
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#include "ShaderIncludes.hlsli"
+
+// Same as VertexShader.hlsl, except each instance's matrices come from
+// the instance vertex buffer instead of a per object constant buffer
+cbuffer PerFrame : register(b0)
+{
+	matrix view;
+	matrix proj;
+}
+
+VertexToPixel main( InstancedVertexShaderInput input )
+{
+	VertexToPixel output;
+
+	// Rows built into a matrix need transposing to match how
+	// matrices are read from constant buffers
+	matrix world = transpose(matrix(input.world0, input.world1, input.world2, input.world3));
+	matrix worldInvTranspose = transpose(matrix(
+		input.worldInvTranspose0,
+		input.worldInvTranspose1,
+		input.worldInvTranspose2,
+		input.worldInvTranspose3));
+
+	output.screenPosition = ProjectToScreen(world, view, proj, input.localPosition);
+
+	output.uv = input.uv;
+	output.normal = mul((float3x3)worldInvTranspose, input.normal);
+	output.tangent = mul((float3x3)world, input.tangent);
+	output.worldPosition = mul(world, float4(input.localPosition, 1)).xyz;
+
+	return output;
+}
\ No newline at end of file
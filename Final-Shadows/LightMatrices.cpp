@@ -0,0 +1,201 @@
+#include <cmath>
+#include "LightMatrices.h"
+#include "Transform.h"
+
+using namespace DirectX;
+
+// The direction each of a point light's shadow maps looks in
+static const XMFLOAT3 CubeFaceDirections[6] =
+{
+	XMFLOAT3(0.f, 0.f, 1.f),
+	XMFLOAT3(1.f, 0.f, 0.f),
+	XMFLOAT3(0.f, 0.f, -1.f),
+	XMFLOAT3(-1.f, 0.f, 0.f),
+	XMFLOAT3(0.f, 1.f, 0.f),
+	XMFLOAT3(0.f, -1.f, 0.f)
+};
+
+// --------------------------------------------------------
+// How many shadow maps a light needs if it casts shadows -
+// point lights need a whole cube of them
+// --------------------------------------------------------
+int LightMatrices::GetShadowFaceCount(const Light& light)
+{
+	return light.type == LIGHT_TYPE_POINT ? 6 : 1;
+}
+
+// --------------------------------------------------------
+// The view and projection of one of a light's shadow maps,
+// where face picks the side of the cube for point lights
+// --------------------------------------------------------
+ShadowFaceMatrices LightMatrices::CalculateShadowFace(const Light& light, int face)
+{
+	ShadowFaceMatrices matrices;
+	XMFLOAT4X4& lightView = matrices.view;
+	XMFLOAT4X4& lightProj = matrices.proj;
+
+	// Create the view and projection matrices of the light based on its type
+	switch (light.type)
+	{
+		case LIGHT_TYPE_DIRECTIONAL:
+		{
+			XMVECTOR lightDir = XMVector3Normalize(XMLoadFloat3(&light.direction));
+			// Set the position of the directional light along the direction to the light starting from the world origin
+			// While it makes sense for the light to be far away from the scene (the sun) in order to preserve shadow quality,
+			// this position must be relatively close to the objects that will be mapped during this call
+			XMVECTOR position = -20 * lightDir;
+
+			// Setup the variables needed to rotate a new Transform object to match the light's direction
+			XMVECTOR forward = XMVectorSet(0.f, 0.f, 1.f, 1.f);
+			float dot;
+			XMStoreFloat(&dot, XMVector3Dot(forward, lightDir));
+			float angle = acos(dot);
+			XMVECTOR axis = XMVector3Cross(forward, lightDir);
+
+			// Use a Transform object to calculate the correct EyeDirection and UpDirection for the view matrix
+			Transform lightTransform = Transform();
+			lightTransform.SetRotation(XMQuaternionRotationAxis(axis, angle));
+			XMFLOAT3 lookDir = lightTransform.GetForward();
+			XMFLOAT3 upDir = lightTransform.GetUp();
+
+			XMStoreFloat4x4(&lightView,
+				XMMatrixLookToLH(
+					position,
+					XMLoadFloat3(&lookDir),
+					XMLoadFloat3(&upDir)
+				)
+			);
+
+			// Use an orthographic projection matrix because directional lights are meant to be
+			// light coming from every possible position along the specified direction
+			XMStoreFloat4x4(&lightProj,
+				XMMatrixOrthographicLH(
+					20,
+					20,
+					1.f,
+					200.f
+				)
+			);
+
+			break;
+		}
+
+		case LIGHT_TYPE_POINT:
+		{
+			// A point light is omnidirectional, so to map objects to a depth buffer in all directions, 6 depth buffers must be used
+			// Because of this, this code is repeated 6 times and each time uses a different axis direction pointing to one of the 6 faces of a cube
+			XMVECTOR lightDir = XMLoadFloat3(&CubeFaceDirections[face]);
+
+			// Setup the variables needed to rotate a new Transform object to match the light's direction
+			XMVECTOR forward = XMVectorSet(0.f, 0.f, 1.f, 1.f);
+			float dot;
+			XMStoreFloat(&dot, XMVector3Dot(forward, lightDir));
+			float angle = acos(dot);
+			XMVECTOR axis;
+			// Make sure the look direction and up direction are calculated correctly
+			// even when the light's direction lines up with the forward vector
+			if (dot != 1.f && dot != -1.f)
+			{
+				axis = XMVector3Cross(forward, lightDir);
+			}
+			else if (dot == 1.f)
+			{
+				axis = forward;
+			}
+			else
+			{
+				axis = XMVectorSet(0.f, 1.f, 0.f, 1.f);
+			}
+
+			// Use a Transform object to calculate the correct EyeDirection and UpDirection for the view matrix
+			Transform lightTransform = Transform();
+			lightTransform.SetRotation(XMQuaternionRotationAxis(axis, angle));
+			XMFLOAT3 lookDir = lightTransform.GetForward();
+			XMFLOAT3 upDir = lightTransform.GetUp();
+
+			XMStoreFloat4x4(&lightView,
+				XMMatrixLookToLH(
+					XMLoadFloat3(&light.position),
+					XMLoadFloat3(&lookDir),
+					XMLoadFloat3(&upDir)
+				)
+			);
+
+			// Each projection matrix used is a frustum from the light's position to the entirety of one of its TextureCube faces
+			// This projection matrix only extends as far as the light's range
+			XMStoreFloat4x4(&lightProj,
+				XMMatrixPerspectiveFovLH(
+					90.f,
+					1.f,
+					0.1f,
+					light.range
+				)
+			);
+
+			break;
+		}
+
+		case LIGHT_TYPE_SPOT:
+		{
+			XMVECTOR lightDir = XMVector3Normalize(XMLoadFloat3(&light.direction));
+
+			// Setup the variables needed to rotate a new Transform object to match the light's direction
+			XMVECTOR forward = XMVectorSet(0.f, 0.f, 1.f, 1.f);
+			float dot;
+			XMStoreFloat(&dot, XMVector3Dot(forward, lightDir));
+			float angle = acos(dot);
+			XMVECTOR axis;
+			// Make sure the look direction and up direction are calculated correctly
+			// even when the light's direction lines up with the forward vector
+			if (dot != 1.f && dot != -1.f)
+			{
+				axis = XMVector3Cross(forward, lightDir);
+			}
+			else if (dot == 1.f)
+			{
+				axis = forward;
+			}
+			else
+			{
+				axis = XMVectorSet(0.f, 0.f, -1.f, 1.f);
+			}
+
+			// Use a Transform object to calculate the correct EyeDirection and UpDirection for the view matrix
+			Transform lightTransform = Transform();
+			lightTransform.SetRotation(XMQuaternionRotationAxis(axis, angle));
+			XMFLOAT3 lookDir = lightTransform.GetForward();
+			XMFLOAT3 upDir = lightTransform.GetUp();
+
+			XMStoreFloat4x4(&lightView,
+				XMMatrixLookToLH(
+					XMLoadFloat3(&light.position),
+					XMLoadFloat3(&lookDir),
+					XMLoadFloat3(&upDir)
+				)
+			);
+
+			// The spotlight is the easier projection matrix to create because its range and frustum match up exactly with its matrix
+			// This matrix also uses an equal aspect ratio of 1
+			XMStoreFloat4x4(&lightProj,
+				XMMatrixPerspectiveFovLH(
+					XMConvertToDegrees(light.spotFalloff),
+					1.f,
+					0.1f,
+					light.range
+				)
+			);
+
+			break;
+		}
+
+		default:
+			XMStoreFloat4x4(&lightView, XMMatrixIdentity());
+			XMStoreFloat4x4(&lightProj, XMMatrixIdentity());
+			break;
+	}
+
+	// The pixel shader projects into each shadow map from world space,
+	// so it's given both matrices combined rather than one at a time
+	XMStoreFloat4x4(&matrices.viewProj, XMMatrixMultiply(XMLoadFloat4x4(&lightView), XMLoadFloat4x4(&lightProj)));
+	return matrices;
+}
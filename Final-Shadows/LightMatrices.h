@@ -0,0 +1,27 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include "Lights.h"
+
+// --------------------------------------------------------
+// The matrices one shadow map is rendered and sampled with
+// --------------------------------------------------------
+struct ShadowFaceMatrices
+{
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 proj;
+	DirectX::XMFLOAT4X4 viewProj;	// Both combined, for the pixel shader
+};
+
+// --------------------------------------------------------
+// Works out the view of the scene from each shadow casting
+// light - one shadow map for directional and spot lights, and
+// one per cube face for point lights
+// - Nothing here needs Direct3D, so the stand-alone benchmark
+//   times the same code the game runs
+// --------------------------------------------------------
+namespace LightMatrices
+{
+	int GetShadowFaceCount(const Light& light);
+	ShadowFaceMatrices CalculateShadowFace(const Light& light, int face);
+}
@@ -1,6 +1,23 @@
 
 #include <Windows.h>
 #include "Game.h"
+#include "Helpers.h"
+
+// --------------------------------------------------------
+// The value of an option given as --name=value on the command
+// line, or an empty string if it isn't there
+// - Values end at the next space, so can't contain any
+// --------------------------------------------------------
+static std::string FindOption(const std::string& commandLine, const std::string& name)
+{
+	std::string option = "--" + name + "=";
+	size_t start = commandLine.find(option);
+	if (start == std::string::npos)
+		return "";
+
+	start += option.size();
+	return commandLine.substr(start, commandLine.find(' ', start) - start);
+}
 
 // --------------------------------------------------------
 // Entry point for a graphical (non-console) Windows application
@@ -35,6 +52,32 @@ int WINAPI WinMain(
 	hr = dxGame.InitDirect3D();
 	if(FAILED(hr)) return hr;
 
+	// Material textures start out packed into shared arrays with --pool-textures
+	std::string commandLine = lpCmdLine;
+	if (commandLine.find("--pool-textures") != std::string::npos)
+		dxGame.SetPoolTextures(true);
+
+	// Regenerate ShaderLayouts.h after changing a cbuffer, which Debug
+	// builds ask for when it no longer matches the compiled shaders
+	if (commandLine.find("--write-shader-layouts") != std::string::npos)
+		return dxGame.WriteShaderLayouts();
+
+	// Run the benchmark suite instead of the game, for automated runs:
+	//   --benchmark [--output=file] [--baseline=file] [--threshold=percent]
+	// - Returns 1 if anything is slower than the baseline by more than the
+	//   threshold, which defaults to 10%, and one of the other codes in
+	//   BenchmarkResult if the results or the baseline can't be used
+	if (commandLine.find("--benchmark") != std::string::npos)
+	{
+		std::string output = FindOption(commandLine, "output");
+		std::string baseline = FindOption(commandLine, "baseline");
+		std::string threshold = FindOption(commandLine, "threshold");
+		return dxGame.RunBenchmarks(
+			output.empty() ? WideToNarrow(FixPath(L"benchmark_results.json")) : output,
+			baseline,
+			threshold.empty() ? 0.1f : (float)atof(threshold.c_str()) / 100.0f);
+	}
+
 	// Begin the message and game loop, and then return
 	// whatever we get back once the game loop is over
 	return dxGame.Run();
@@ -1,4 +1,6 @@
+#include <cstring>
 #include "Material.h"
+#include "ShaderLayouts.h"
 
 Material::Material(
 	const char* name,
@@ -18,20 +20,245 @@ Material::Material(
 	roughness(roughness),
 	metallic(metallic),
 	textureScale(texScale),
-	textureOffset(texOffset)
+	textureOffset(texOffset),
+	minScreenSize(1.0f),
+	minShadowScreenSize(1.0f),
+	srvStartSlot(0),
+	samplerStartSlot(0),
+	parameterSlot(0),
+	ownsParameters(false),
+	parametersDirty(true),
+	permutation(ShaderPermutation::Full()),
+	pooled(false),
+	textureSlices(0, 0, 0, 0)
 {
+	FindShaderHandles();
+}
+
+void Material::SetPixelShader(std::shared_ptr<SimplePixelShader> pxShader)
+{
+	pixelShader = pxShader;
+	FindShaderHandles();
+}
+
+// --------------------------------------------------------
+// Looks up the pixel shader variables Prepare() sets, so
+// it doesn't have to search for them by name every draw
+// --------------------------------------------------------
+void Material::FindShaderHandles()
+{
+	colorTintHandle = pixelShader->GetVariableHandle("colorTint");
+	roughnessHandle = pixelShader->GetVariableHandle("roughnessFlat");
+	metallicHandle = pixelShader->GetVariableHandle("metallicFlat");
+	uvScaleHandle = pixelShader->GetVariableHandle("uvScale");
+	uvOffsetHandle = pixelShader->GetVariableHandle("uvOffset");
+
+	// Every material drawn with a shader laid out like this keeps its own
+	// PerMaterial buffer, so the shader's copy is never used
+	ownsParameters = pixelShader->HasBufferLayout<PixelShaderPerMaterial>();
+	if (ownsParameters)
+	{
+		pixelShader->SetBufferExternal(PixelShaderPerMaterial::BufferName(), true);
+		parameterSlot = pixelShader->GetBufferInfo(PixelShaderPerMaterial::BufferName())->BindIndex;
+	}
+
+	ResolveBindings();
+}
+
+// --------------------------------------------------------
+// Makes a fresh GPU copy of the material's parameters
+// - Buffers are immutable, since they only change when the
+//   material is edited, and a new one replaces the old
+// --------------------------------------------------------
+void Material::CreateParameterBuffer()
+{
+	PixelShaderPerMaterial parameters = {};
+	parameters.colorTint = colorTint;
+	parameters.roughnessFlat = roughness;
+	parameters.metallicFlat = metallic;
+	parameters.uvOffset = textureOffset;
+	parameters.uvScale = textureScale;
+	parameters.textureSlices = textureSlices;
+
+	// Constant buffers come in whole 16 byte rows, all of which
+	// the initial data has to cover
+	unsigned char data[(sizeof(PixelShaderPerMaterial) + 15) / 16 * 16] = {};
+	memcpy(data, &parameters, sizeof(parameters));
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.ByteWidth = sizeof(data);
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+	D3D11_SUBRESOURCE_DATA initialData = {};
+	initialData.pSysMem = data;
+
+	parameterBuffer.Reset();
+	pixelShader->GetDevice()->CreateBuffer(&desc, &initialData, parameterBuffer.GetAddressOf());
+	parametersDirty = false;
+}
+
+// --------------------------------------------------------
+// Places each named resource at its register in a table that
+// covers the lowest to the highest register used
+// - Names the shader doesn't have are skipped, which happens
+//   for textures a permutation was built without
+// --------------------------------------------------------
+template<typename T, typename FindRegister>
+static void BuildBindingTable(
+	const std::unordered_map<std::string, Microsoft::WRL::ComPtr<T>>& byName,
+	FindRegister findRegister,
+	unsigned int* startSlot,
+	std::vector<T*>* table)
+{
+	*startSlot = 0;
+	table->clear();
+
+	for (auto& b : byName)
+	{
+		unsigned int slot;
+		if (!findRegister(b.first, &slot))
+			continue;
+
+		if (table->empty())
+		{
+			*startSlot = slot;
+			table->push_back(0);
+		}
+		else if (slot < *startSlot)
+		{
+			table->insert(table->begin(), *startSlot - slot, 0);
+			*startSlot = slot;
+		}
+		else if (slot - *startSlot >= table->size())
+		{
+			table->resize(slot - *startSlot + 1, 0);
+		}
+
+		(*table)[slot - *startSlot] = b.second.Get();
+	}
+}
+
+// --------------------------------------------------------
+// Works out where the pixel shader wants this material's
+// textures and samplers, once rather than every draw
+// --------------------------------------------------------
+void Material::ResolveBindings()
+{
+	BuildBindingTable(textureSrvs,
+		[this](const std::string& name, unsigned int* slot)
+		{
+			const SimpleSRV* info = pixelShader->GetShaderResourceViewInfo(name);
+			if (info) *slot = info->BindIndex;
+			return info != 0;
+		},
+		&srvStartSlot,
+		&srvBindings);
+
+	BuildBindingTable(textureSamplers,
+		[this](const std::string& name, unsigned int* slot)
+		{
+			const SimpleSampler* info = pixelShader->GetSamplerInfo(name);
+			if (info) *slot = info->BindIndex;
+			return info != 0;
+		},
+		&samplerStartSlot,
+		&samplerBindings);
+}
+
+// --------------------------------------------------------
+// Picks the pixel shader permutation for the scene's lights and
+// this material's textures, if the material has permutations
+// - Falls back to the full shader if the variant wasn't built
+// --------------------------------------------------------
+void Material::SelectPermutation(int lightCount, int shadowMapCount)
+{
+	if (!permutations)
+		return;
+
+	std::shared_ptr<SimplePixelShader> ps;
+	ShaderPermutation selected = ShaderPermutation::Select(lightCount, shadowMapCount, HasNormalMap(), HasPbrMaps());
+	permutation = permutations->GetPixelShader(selected, &ps) ? selected : ShaderPermutation::Full();
+
+	if (ps != pixelShader)
+		SetPixelShader(ps);
+}
+
+// Textures a pool can hold, in the order of textureSlices
+static const char* PooledTextureNames[] = { "Albedo", "NormalMap", "RoughnessMap", "MetallicMap" };
+
+// --------------------------------------------------------
+// Gives each of this material's textures a slice in the pool,
+// ahead of the pool being built
+// --------------------------------------------------------
+void Material::AddTexturesToPool(std::shared_ptr<TexturePool> pool)
+{
+	for (const char* name : PooledTextureNames)
+	{
+		auto found = textureSrvs.find(name);
+		TexturePoolSlot slot;
+		if (found != textureSrvs.end())
+			pool->Add(found->second, &slot);
+	}
+}
+
+// --------------------------------------------------------
+// Swaps this material's textures for the arrays they were
+// packed into, and its pixel shader for one that reads them
+//
+// Returns false, leaving the material as it was, if the pool
+// isn't built or is missing any of the material's textures
+// - Shader permutations aren't built for pooled textures,
+//   so pooled materials always use the given shader
+// --------------------------------------------------------
+bool Material::UseTexturePool(std::shared_ptr<TexturePool> pool, std::shared_ptr<SimplePixelShader> pooledShader)
+{
+	if (pooled)
+		return true;
+	if (!pool->IsBuilt() || !pooledShader->IsShaderValid())
+		return false;
+
+	TexturePoolSlot slots[_countof(PooledTextureNames)] = {};
+	for (unsigned int i = 0; i < _countof(PooledTextureNames); i++)
+	{
+		auto found = textureSrvs.find(PooledTextureNames[i]);
+		if (found != textureSrvs.end() && !pool->Find(found->second, &slots[i]))
+			return false;
+	}
+
+	unsigned int* slices[] = { &textureSlices.x, &textureSlices.y, &textureSlices.z, &textureSlices.w };
+	for (unsigned int i = 0; i < _countof(PooledTextureNames); i++)
+	{
+		auto found = textureSrvs.find(PooledTextureNames[i]);
+		if (found == textureSrvs.end())
+			continue;
+
+		found->second = pool->GetArray(slots[i].Array);
+		*slices[i] = slots[i].Slice;
+	}
+
+	pooled = true;
+	parametersDirty = true;
+	permutations = 0;
+	permutation = ShaderPermutation::Full();
+	SetPixelShader(pooledShader);
+	return true;
 }
 
 void Material::SetRoughness(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
 	textureSrvs.insert_or_assign("RoughnessMap", srv);
 	roughness = -1;
+	parametersDirty = true;
+	ResolveBindings();
 }
 
 void Material::SetMetallic(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
 	textureSrvs.insert_or_assign("MetallicMap", srv);
 	metallic = -1;
+	parametersDirty = true;
+	ResolveBindings();
 }
 
 void Material::SetAllPbrTextures(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textures[4])
@@ -59,19 +286,26 @@ void Material::SetAllPbrTextures(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView
 
 void Material::Prepare()
 {
-	pixelShader->SetFloat4("colorTint", colorTint);
-	pixelShader->SetFloat("roughnessFlat", roughness);
-	pixelShader->SetFloat("metallicFlat", metallic);
-	pixelShader->SetFloat("uvScale", textureScale);
-	pixelShader->SetFloat2("uvOffset", textureOffset);
-
-	for (auto& s : textureSrvs)
+	if (ownsParameters)
 	{
-		pixelShader->SetShaderResourceView(s.first.c_str(), s.second);
+		if (parametersDirty)
+			CreateParameterBuffer();
+		pixelShader->SetExternalBuffer(parameterSlot, parameterBuffer.Get());
 	}
-
-	for (auto& s : textureSamplers)
+	else
 	{
-		pixelShader->SetSamplerState(s.first.c_str(), s.second);
+		pixelShader->SetFloat4(colorTintHandle, colorTint);
+		pixelShader->SetFloat(roughnessHandle, roughness);
+		pixelShader->SetFloat(metallicHandle, metallic);
+		pixelShader->SetFloat(uvScaleHandle, textureScale);
+		pixelShader->SetFloat2(uvOffsetHandle, textureOffset);
 	}
+
+	// One call for each range, which the state cache drops altogether
+	// when the previous material bound the same things
+	if (!srvBindings.empty())
+		pixelShader->SetShaderResourceViews(srvStartSlot, (unsigned int)srvBindings.size(), srvBindings.data());
+
+	if (!samplerBindings.empty())
+		pixelShader->SetSamplerStates(samplerStartSlot, (unsigned int)samplerBindings.size(), samplerBindings.data());
 }
@@ -3,7 +3,10 @@
 #include <DirectXMath.h>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 #include "SimpleShader.h"
+#include "ShaderPermutationCache.h"
+#include "TexturePool.h"
 
 class Material
 {
@@ -27,26 +30,51 @@ public:
 	float GetMetallic() { return metallic; }
 	float GetTextureScale() { return textureScale; }
 	DirectX::XMFLOAT2 GetTextureOffset() { return textureOffset; }
+	float GetMinScreenSize() { return minScreenSize; }
+	float GetMinShadowScreenSize() { return minShadowScreenSize; }
 
 	void SetVertexShader(std::shared_ptr<SimpleVertexShader> vxShader) { vertexShader = vxShader; }
-	void SetPixelShader(std::shared_ptr<SimplePixelShader> pxShader) { pixelShader = pxShader; }
+	void SetPixelShader(std::shared_ptr<SimplePixelShader> pxShader);
 	void SetName(const char* val) { name = val; }
-	void SetColorTint(DirectX::XMFLOAT4 color) { colorTint = color; }
-	void SetRoughness(float val) { roughness = val; }
-	void SetMetallic(float val) { metallic = val; }
-	void SetTextureScale(float val) { textureScale = val; }
-	void SetTextureOffset(DirectX::XMFLOAT2 val) { textureOffset = val; }
-
-	void SetAlbedo(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) { textureSrvs.insert_or_assign("Albedo", srv); }
-	void SetNormal(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) { textureSrvs.insert_or_assign("NormalMap", srv); }
+	void SetColorTint(DirectX::XMFLOAT4 color) { colorTint = color; parametersDirty = true; }
+	void SetRoughness(float val) { roughness = val; parametersDirty = true; }
+	void SetMetallic(float val) { metallic = val; parametersDirty = true; }
+	void SetTextureScale(float val) { textureScale = val; parametersDirty = true; }
+	void SetTextureOffset(DirectX::XMFLOAT2 val) { textureOffset = val; parametersDirty = true; }
+	void SetMinScreenSize(float pixels) { minScreenSize = pixels; }
+	void SetMinShadowScreenSize(float texels) { minShadowScreenSize = texels; }
+
+	void SetAlbedo(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) { textureSrvs.insert_or_assign("Albedo", srv); ResolveBindings(); }
+	void SetNormal(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) { textureSrvs.insert_or_assign("NormalMap", srv); ResolveBindings(); }
 	void SetRoughness(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	void SetMetallic(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	void SetAllPbrTextures(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textures[4]);
-	void AddSampler(std::string shaderName, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler) { textureSamplers.insert({shaderName, sampler}); }
+	void AddSampler(std::string shaderName, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler) { textureSamplers.insert({shaderName, sampler}); ResolveBindings(); }
+
+	// Materials with permutations swap their pixel shader for the smallest
+	// variant that handles the scene's lights and their own textures
+	void SetPermutations(std::shared_ptr<ShaderPermutationCache> cache) { permutations = cache; }
+	void SelectPermutation(int lightCount, int shadowMapCount);
+	ShaderPermutation GetPermutation() { return permutation; }
+	bool HasNormalMap() { return textureSrvs.count("NormalMap") > 0; }
+	bool HasPbrMaps() { return textureSrvs.count("RoughnessMap") > 0 || textureSrvs.count("MetallicMap") > 0; }
+
+	// Pooled materials bind the arrays their textures were packed into and
+	// pick their own slices in the shader, so materials drawing from the same
+	// arrays share texture bindings - add every material's textures, build
+	// the pool, then switch each material over to a TEXTURE_POOL pixel shader
+	void AddTexturesToPool(std::shared_ptr<TexturePool> pool);
+	bool UseTexturePool(std::shared_ptr<TexturePool> pool, std::shared_ptr<SimplePixelShader> pooledShader);
+	bool IsPooled() { return pooled; }
+	DirectX::XMUINT4 GetTextureSlices() { return textureSlices; }
 
 	void Prepare();
 
 private:
+	void FindShaderHandles();
+	void ResolveBindings();
+	void CreateParameterBuffer();
+
 	std::shared_ptr<SimpleVertexShader> vertexShader;
 	std::shared_ptr<SimplePixelShader> pixelShader;
 
@@ -57,7 +85,44 @@ private:
 	float textureScale;
 	DirectX::XMFLOAT2 textureOffset;
 
+	// Entities using this material are culled when their bounds project to fewer
+	// pixels on screen (or texels in a shadow map) than these thresholds
+	float minScreenSize;
+	float minShadowScreenSize;
+
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSrvs;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> textureSamplers;
+
+	// The textures and samplers above by pixel shader register, so Prepare()
+	// sets each as one range without looking anything up by name
+	// - Registers in the range this material has nothing for hold null
+	// - The maps own the references, so these are rebuilt whenever
+	//   either the maps or the pixel shader change
+	unsigned int srvStartSlot;
+	std::vector<ID3D11ShaderResourceView*> srvBindings;
+	unsigned int samplerStartSlot;
+	std::vector<ID3D11SamplerState*> samplerBindings;
+
+	std::shared_ptr<ShaderPermutationCache> permutations;
+	ShaderPermutation permutation;
+
+	bool pooled;
+	DirectX::XMUINT4 textureSlices;	// In the same order as the shader's textures
+
+	// The parameters above in the pixel shader's PerMaterial layout, made
+	// again only after one of them is set, so drawing just binds it
+	// - Pixel shaders with some other PerMaterial layout get the
+	//   parameters through the handles below instead
+	Microsoft::WRL::ComPtr<ID3D11Buffer> parameterBuffer;
+	unsigned int parameterSlot;
+	bool ownsParameters;
+	bool parametersDirty;
+
+	// Pixel shader variables set by Prepare(), looked up whenever the shader changes
+	SimpleShaderVariableHandle colorTintHandle;
+	SimpleShaderVariableHandle roughnessHandle;
+	SimpleShaderVariableHandle metallicHandle;
+	SimpleShaderVariableHandle uvScaleHandle;
+	SimpleShaderVariableHandle uvOffsetHandle;
 };
 
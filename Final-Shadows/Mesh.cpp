@@ -2,338 +2,56 @@
 #include <vector>
 #include <iostream>
 #include "Mesh.h"
+#include "MeshData.h"
 #include "Helpers.h"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "TinyObj/tiny_obj_loader.h"
-
 using namespace DirectX;
 
 Mesh::Mesh(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount,
            Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
 	:
-	indexCount(indexCount),
+	indexCount(0),
 	context(context)
 {
-	CalculateTangents(vertices, vertexCount, indices, indexCount);
-	CreateVertexIndexBuffers(vertices, vertexCount, indices, indexCount, device);
+	CreateFromVertices(vertices, vertexCount, indices, indexCount, device);
 }
 
 Mesh::Mesh(const wchar_t* objFile, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
 	:
+	indexCount(0),
 	context(context)
 {
-	// Author: Chris Cascioli
-	// Purpose: Basic .OBJ 3D model loading, supporting positions, uvs and normals
-	// 
-	// - You are allowed to directly copy/paste this into your code base
-	//   for assignments, given that you clearly cite that this is not
-	//   code of your own design.
-	//
-	// - NOTE: You'll need to #include <fstream>
-	
-	
 	// File input object
 	std::ifstream obj(objFile);
-	
-	// Check for successful open
-	if (!obj.is_open())
+
+	// Check for successful open, and that there was anything in it
+	MeshData data;
+	if (!obj.is_open() || !MeshImport::ParseObj(obj, &data))
 		return;
-	
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;	// Positions from the file
-	std::vector<XMFLOAT3> normals;		// Normals from the file
-	std::vector<XMFLOAT2> uvs;		// UVs from the file
-	std::vector<Vertex> verts;		// Verts we're assembling
-	std::vector<UINT> indices;		// Indices of these verts
-	int vertCounter = 0;			// Count of vertices
-	int indexCounter = 0;			// Count of indices
-	char chars[100];			// String for line reading
-	
-	// Still have data left?
-	while (obj.good())
-	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
-	
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-	
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-	
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-	
-			// Add to the positions
-			positions.push_back(pos);
-		}
-		else if (chars[0] == 'f')
-		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			unsigned int i[12];
-			int numbersRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-	
-			// If we only got the first number, chances are the OBJ
-			// file has no UV coordinates.  This isn't great, but we
-			// still want to load the model without crashing, so we
-			// need to re-read a different pattern (in which we assume
-			// there are no UVs denoted for any of the vertices)
-			if (numbersRead == 1)
-			{
-				// Re-read with a different pattern
-				numbersRead = sscanf_s(
-					chars,
-					"f %d//%d %d//%d %d//%d %d//%d",
-					&i[0], &i[2],
-					&i[3], &i[5],
-					&i[6], &i[8],
-					&i[9], &i[11]);
-	
-				// The following indices are where the UVs should 
-				// have been, so give them a valid value
-				i[1] = 1;
-				i[4] = 1;
-				i[7] = 1;
-				i[10] = 1;
-	
-				// If we have no UVs, create a single UV coordinate
-				// that will be used for all vertices
-				if (uvs.size() == 0)
-					uvs.push_back(XMFLOAT2(0, 0));
-			}
-	
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.position = positions[i[0] - 1];
-			v1.uv = uvs[i[1] - 1];
-			v1.normal = normals[i[2] - 1];
-	
-			Vertex v2;
-			v2.position = positions[i[3] - 1];
-			v2.uv = uvs[i[4] - 1];
-			v2.normal = normals[i[5] - 1];
-	
-			Vertex v3;
-			v3.position = positions[i[6] - 1];
-			v3.uv = uvs[i[7] - 1];
-			v3.normal = normals[i[8] - 1];
-	
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-	
-			// Flip the UV's since they're probably "upside down"
-			v1.uv.y = 1.0f - v1.uv.y;
-			v2.uv.y = 1.0f - v2.uv.y;
-			v3.uv.y = 1.0f - v3.uv.y;
-	
-			// Flip Z (LH vs. RH)
-			v1.position.z *= -1.0f;
-			v2.position.z *= -1.0f;
-			v3.position.z *= -1.0f;
-	
-			// Flip normal's Z
-			v1.normal.z *= -1.0f;
-			v2.normal.z *= -1.0f;
-			v3.normal.z *= -1.0f;
-	
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-			vertCounter += 3;
-	
-			// Add three more indices
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-	
-			// Was there a 4th face?
-			// - 12 numbers read means 4 faces WITH uv's
-			// - 8 numbers read means 4 faces WITHOUT uv's
-			if (numbersRead == 12 || numbersRead == 8)
-			{
-				// Make the last vertex
-				Vertex v4;
-				v4.position = positions[i[9] - 1];
-				v4.uv = uvs[i[10] - 1];
-				v4.normal = normals[i[11] - 1];
-	
-				// Flip the UV, Z pos and normal's Z
-				v4.uv.y = 1.0f - v4.uv.y;
-				v4.position.z *= -1.0f;
-				v4.normal.z *= -1.0f;
-	
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-				vertCounter += 3;
-	
-				// Add three more indices
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-			}
-		}
-	}
-	
-	// Close the file and create the actual buffers
-	obj.close();
-	
-	// - At this point, "verts" is a vector of Vertex structs, and can be used
-	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
-	//
-	// - The vector "indices" is similar. It's a vector of unsigned ints and
-	//    can be used directly for the index buffer: &indices[0] is the address of the first int
-	//
-	// - "vertCounter" is the number of vertices
-	// - "indexCounter" is the number of indices
-	// - Yes, these are effectively the same since OBJs do not index entire vertices!  This means
-	//    an index buffer isn't doing much for us.  We could try to optimize the mesh ourselves
-	//    and detect duplicate vertices, but at that point it would be better to use a more
-	//    sophisticated model loading library like TinyOBJLoader or The Open Asset Importer Library
-	CalculateTangents(&verts[0], vertCounter, &indices[0], indexCounter);
-	CreateVertexIndexBuffers(&verts[0], vertCounter, &indices[0], indexCounter, device);
-	indexCount = indexCounter;
+
+	CreateFromVertices(&data.vertices[0], (int)data.vertices.size(), &data.indices[0], (int)data.indices.size(), device);
 }
 
 // Create a mesh by loading it from a OBJ file with the use of tinyobjloader
 Mesh::Mesh(std::string objFile, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
 	:
+	indexCount(0),
 	context(context)
 {
-	std::string filePath = WideToNarrow(FixPath(NarrowToWide(objFile)));
-	
-	tinyobj::ObjReaderConfig reader_config;
-	reader_config.mtl_search_path = "";
-	tinyobj::ObjReader reader;
+	std::ifstream obj(WideToNarrow(FixPath(NarrowToWide(objFile))));
 
-	if (!reader.ParseFromFile(filePath, reader_config))
+	MeshData data;
+	if (!obj.is_open() || !MeshImport::ParseObjWithTinyObj(obj, &data))
 		return;
 
-	auto& attributes = reader.GetAttrib();
-	auto& shapes = reader.GetShapes();
-	//auto& materials = reader.GetMaterials();
-
-	// Variables used while reading the file
-	std::vector<Vertex> verts;		// Verts we're assembling
-	std::vector<UINT> indices;		// Indices of these verts
-	int vertCounter = 0;			// Count of vertices
-	int indexCounter = 0;			// Count of indices
-
-	// Loop over shapes
-	for (size_t s = 0; s < shapes.size(); s++)
-	{
-		// Loop over faces(polygon)
-		size_t index_offset = 0;
-		for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++)
-		{
-			size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
-
-			// Loop over vertices in the face.
-			for (size_t v = 0; v < fv; v++)
-			{
-				Vertex vertex;
-
-				// access to vertex
-				tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-				tinyobj::real_t vx = attributes.vertices[3 * size_t(idx.vertex_index) + 0];
-				tinyobj::real_t vy = attributes.vertices[3 * size_t(idx.vertex_index) + 1];
-				tinyobj::real_t vz = attributes.vertices[3 * size_t(idx.vertex_index) + 2];
-
-				vertex.position = XMFLOAT3(vx, vy, -vz);
-				indices.push_back(indexCounter);
-				indexCounter++;
-
-				// Check if `normal_index` is zero or positive. negative = no normal data
-				if (idx.normal_index >= 0)
-				{
-					tinyobj::real_t nx = attributes.normals[3 * size_t(idx.normal_index) + 0];
-					tinyobj::real_t ny = attributes.normals[3 * size_t(idx.normal_index) + 1];
-					tinyobj::real_t nz = attributes.normals[3 * size_t(idx.normal_index) + 2];
-
-					vertex.normal = XMFLOAT3(nx, ny, -nz);
-				}
-
-				// Check if `texcoord_index` is zero or positive. negative = no texcoord data
-				if (idx.texcoord_index >= 0)
-				{
-					tinyobj::real_t tx = attributes.texcoords[2 * size_t(idx.texcoord_index) + 0];
-					tinyobj::real_t ty = attributes.texcoords[2 * size_t(idx.texcoord_index) + 1];
-
-					vertex.uv = XMFLOAT2(tx, 1.0f - ty);
-				}
-
-				verts.push_back(vertex);
-				vertCounter++;
-
-				// Optional: vertex colors
-				// tinyobj::real_t red   = attributes.colors[3*size_t(idx.vertex_index)+0];
-				// tinyobj::real_t green = attributes.colors[3*size_t(idx.vertex_index)+1];
-				// tinyobj::real_t blue  = attributes.colors[3*size_t(idx.vertex_index)+2];
-			}
-			index_offset += fv;
-
-			// per-face material
-			//shapes[s].mesh.material_ids[f];
-		}
-	}
-
-	CalculateTangents(&verts[0], vertCounter, &indices[0], indexCounter);
-	CreateVertexIndexBuffers(&verts[0], vertCounter, &indices[0], indexCounter, device);
-	indexCount = indexCounter;
+	CreateFromVertices(&data.vertices[0], (int)data.vertices.size(), &data.indices[0], (int)data.indices.size(), device);
 }
 
 Mesh::~Mesh()
 {
 }
 
-void Mesh::Draw()
+void Mesh::Draw(StateCache* states)
 {
 	// DRAW geometry
 	// - These steps are generally repeated for EACH object you draw
@@ -346,8 +64,17 @@ void Mesh::Draw()
 	//  - For this demo, this step *could* simply be done once during Init()
 	//  - However, this needs to be done between EACH DrawIndexed() call
 	//     when drawing different geometry, so it's here as an example
-	context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	//  - With a state cache, they're skipped when this mesh's buffers are already set
+	if (states)
+	{
+		states->SetVertexBuffer(0, vertexBuffer.Get(), stride, offset);
+		states->SetIndexBuffer(indexBuffer.Get(), INDEX_FORMAT_R32_UINT, 0);
+	}
+	else
+	{
+		context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
+		context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	}
 
 	// Tell Direct3D to draw
 	//  - Begins the rendering pipeline on the GPU
@@ -355,10 +82,46 @@ void Mesh::Draw()
 	//  - This will use all currently set Direct3D resources (shaders, buffers, etc)
 	//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
 	//     vertices in the currently set VERTEX BUFFER
-	context->DrawIndexed(
-		indexCount, // The number of indices to use (we could draw a subset if we wanted)
-		0,          // Offset to the first index we want to use
-		0);         // Offset to add to each index when looking up vertices
+	//  - With a state cache, the draw goes to whichever context the cache records into
+	if (states)
+		states->DrawIndexed(indexCount, 0, 0);
+	else
+		context->DrawIndexed(
+			indexCount, // The number of indices to use (we could draw a subset if we wanted)
+			0,          // Offset to the first index we want to use
+			0);         // Offset to add to each index when looking up vertices
+}
+
+// --------------------------------------------------------
+// Draws several instances of the mesh in one call, with each
+// instance's data coming from a second vertex buffer
+//
+// firstInstance - Where this draw's instances start in the buffer
+// --------------------------------------------------------
+void Mesh::DrawInstanced(
+	ID3D11Buffer* instanceBuffer,
+	unsigned int instanceStride,
+	unsigned int instanceCount,
+	unsigned int firstInstance,
+	StateCache* states)
+{
+	UINT stride = sizeof(Vertex);
+	if (states)
+	{
+		states->SetVertexBuffer(0, vertexBuffer.Get(), stride, 0);
+		states->SetVertexBuffer(1, instanceBuffer, instanceStride, 0);
+		states->SetIndexBuffer(indexBuffer.Get(), INDEX_FORMAT_R32_UINT, 0);
+		states->DrawIndexedInstanced(indexCount, instanceCount, 0, 0, firstInstance);
+	}
+	else
+	{
+		ID3D11Buffer* buffers[2] = { vertexBuffer.Get(), instanceBuffer };
+		UINT strides[2] = { stride, instanceStride };
+		UINT offsets[2] = { 0, 0 };
+		context->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+		context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+		context->DrawIndexedInstanced(indexCount, instanceCount, 0, 0, firstInstance);
+	}
 }
 
 void Mesh::CreateVertexIndexBuffers(Vertex* vertices, int vertexCount, unsigned* indices, int indexCount,
@@ -417,91 +180,14 @@ void Mesh::CreateVertexIndexBuffers(Vertex* vertices, int vertexCount, unsigned*
 }
 
 // --------------------------------------------------------
-// Author: Chris Cascioli
-// Purpose: Calculates the tangents of the vertices in a mesh
-// 
-// - You are allowed to directly copy/paste this into your code base
-//   for assignments, given that you clearly cite that this is not
-//   code of your own design.
-//
-// - Code originally adapted from: http://www.terathon.com/code/tangent.html
-//   - Updated version now found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
-//   - See listing 7.4 in section 7.5 (page 9 of the PDF)
-//
-// - Note: For this code to work, your Vertex format must
-//         contain an XMFLOAT3 called Tangent
-//
-// - Be sure to call this BEFORE creating your D3D vertex/index buffers
+// Everything a mesh needs from its vertices: their tangents,
+// the buffers to draw them from and the BVH for ray queries
 // --------------------------------------------------------
-void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+void Mesh::CreateFromVertices(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount,
+	Microsoft::WRL::ComPtr<ID3D11Device> device)
 {
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
-	{
-		verts[i].tangent = XMFLOAT3(0, 0, 0);
-	}
-
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numIndices;)
-	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->position.x - v1->position.x;
-		float y1 = v2->position.y - v1->position.y;
-		float z1 = v2->position.z - v1->position.z;
-
-		float x2 = v3->position.x - v1->position.x;
-		float y2 = v3->position.y - v1->position.y;
-		float z2 = v3->position.z - v1->position.z;
-
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->uv.x - v1->uv.x;
-		float t1 = v2->uv.y - v1->uv.y;
-
-		float s2 = v3->uv.x - v1->uv.x;
-		float t2 = v3->uv.y - v1->uv.y;
-
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-
-		// Adjust tangents of each vert of the triangle
-		v1->tangent.x += tx;
-		v1->tangent.y += ty;
-		v1->tangent.z += tz;
-
-		v2->tangent.x += tx;
-		v2->tangent.y += ty;
-		v2->tangent.z += tz;
-
-		v3->tangent.x += tx;
-		v3->tangent.y += ty;
-		v3->tangent.z += tz;
-	}
-
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
-	{
-		// Grab the two vectors
-		XMVECTOR normal = XMLoadFloat3(&verts[i].normal);
-		XMVECTOR tangent = XMLoadFloat3(&verts[i].tangent);
-
-		// Use Gram-Schmidt orthonormalize to ensure
-		// the normal and tangent are exactly 90 degrees apart
-		tangent = XMVector3Normalize(
-			tangent - normal * XMVector3Dot(normal, tangent));
-
-		// Store the tangent
-		XMStoreFloat3(&verts[i].tangent, tangent);
-	}
+	MeshImport::CalculateTangents(vertices, vertexCount, indices, indexCount);
+	CreateVertexIndexBuffers(vertices, vertexCount, indices, indexCount, device);
+	bvh.Build(vertices, vertexCount, indices, indexCount);
+	this->indexCount = indexCount;
 }
@@ -4,6 +4,8 @@
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 #include <string>
 #include "Vertex.h"
+#include "MeshBVH.h"
+#include "StateCache.h"
 
 class Mesh
 {
@@ -17,17 +19,29 @@ public:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer() { return vertexBuffer; }
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer() {return indexBuffer; }
 	int GetIndexCount() { return indexCount; }
+	const MeshBVH& GetBVH() { return bvh; }
+	const DirectX::BoundingBox& GetBounds() { return bvh.GetBounds(); }
 
-	void Draw();
+	void Draw(StateCache* states = 0);
+	void DrawInstanced(
+		ID3D11Buffer* instanceBuffer,
+		unsigned int instanceStride,
+		unsigned int instanceCount,
+		unsigned int firstInstance,
+		StateCache* states = 0);
 
 private:
 	void CreateVertexIndexBuffers(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount,
 		Microsoft::WRL::ComPtr<ID3D11Device> device);
-	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+	void CreateFromVertices(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount,
+		Microsoft::WRL::ComPtr<ID3D11Device> device);
 
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
 	int indexCount;
 
+	// CPU-side triangle hierarchy used for ray queries, cooked when the mesh is imported
+	MeshBVH bvh;
+
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
 };
\ No newline at end of file
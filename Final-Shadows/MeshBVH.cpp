@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <cfloat>
+#include "MeshBVH.h"
+
+using namespace DirectX;
+
+// The most triangles a single leaf (and therefore a single packet) can hold
+#define MAX_TRIANGLES_PER_LEAF 4
+
+MeshBVH::MeshBVH()
+	:
+	triangleCount(0)
+{
+}
+
+// --------------------------------------------------------
+// Cooks the hierarchy from the mesh's vertex and index data
+// - The data is expected to be in the same space as the
+//   mesh's vertex buffer (model space)
+// --------------------------------------------------------
+void MeshBVH::Build(const Vertex* verts, int numVerts, const unsigned int* indices, int numIndices)
+{
+	nodes.clear();
+	packets.clear();
+	triangleCount = numIndices / 3;
+
+	if (numVerts <= 0 || triangleCount == 0)
+	{
+		bounds = BoundingBox();
+		return;
+	}
+
+	BoundingBox::CreateFromPoints(bounds, numVerts, &verts[0].position, sizeof(Vertex));
+
+	// Every triangle is sorted into the tree by its centroid
+	std::vector<XMFLOAT3> centroids(triangleCount);
+	std::vector<unsigned int> triangles(triangleCount);
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&verts[indices[t * 3 + 0]].position);
+		XMVECTOR p1 = XMLoadFloat3(&verts[indices[t * 3 + 1]].position);
+		XMVECTOR p2 = XMLoadFloat3(&verts[indices[t * 3 + 2]].position);
+		XMStoreFloat3(&centroids[t], (p0 + p1 + p2) / 3.0f);
+		triangles[t] = t;
+	}
+
+	// A binary tree with leaves of up to 4 triangles never needs more than this many nodes
+	nodes.reserve(2 * (triangleCount / MAX_TRIANGLES_PER_LEAF + 1));
+	packets.reserve(triangleCount / MAX_TRIANGLES_PER_LEAF + 1);
+
+	nodes.push_back(Node());
+	BuildNode(0, triangles, 0, (unsigned int)triangleCount, centroids, verts, indices);
+}
+
+// --------------------------------------------------------
+// Fills in the node at the given index with the triangles
+// in the range [start, end), splitting them at the median
+// centroid of the longest axis until they fit in a leaf
+// --------------------------------------------------------
+void MeshBVH::BuildNode(unsigned int nodeIndex, std::vector<unsigned int>& triangles, unsigned int start, unsigned int end,
+	const std::vector<XMFLOAT3>& centroids, const Vertex* verts, const unsigned int* indices)
+{
+	// Bounds of every vertex of every triangle in this node
+	XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+	XMVECTOR centroidMin = boundsMin;
+	XMVECTOR centroidMax = boundsMax;
+	for (unsigned int i = start; i < end; i++)
+	{
+		unsigned int t = triangles[i];
+		for (int v = 0; v < 3; v++)
+		{
+			XMVECTOR p = XMLoadFloat3(&verts[indices[t * 3 + v]].position);
+			boundsMin = XMVectorMin(boundsMin, p);
+			boundsMax = XMVectorMax(boundsMax, p);
+		}
+
+		XMVECTOR c = XMLoadFloat3(&centroids[t]);
+		centroidMin = XMVectorMin(centroidMin, c);
+		centroidMax = XMVectorMax(centroidMax, c);
+	}
+
+	XMStoreFloat3(&nodes[nodeIndex].boundsMin, boundsMin);
+	XMStoreFloat3(&nodes[nodeIndex].boundsMax, boundsMax);
+
+	unsigned int count = end - start;
+	if (count <= MAX_TRIANGLES_PER_LEAF)
+	{
+		// Store the triangles of this leaf as vertex 0 and two edges,
+		// which is exactly what the ray test needs
+		TrianglePacket packet = {};
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned int t = triangles[start + i];
+			XMFLOAT3 p0 = verts[indices[t * 3 + 0]].position;
+			XMFLOAT3 p1 = verts[indices[t * 3 + 1]].position;
+			XMFLOAT3 p2 = verts[indices[t * 3 + 2]].position;
+
+			packet.v0[0][i] = p0.x;
+			packet.v0[1][i] = p0.y;
+			packet.v0[2][i] = p0.z;
+			packet.edge1[0][i] = p1.x - p0.x;
+			packet.edge1[1][i] = p1.y - p0.y;
+			packet.edge1[2][i] = p1.z - p0.z;
+			packet.edge2[0][i] = p2.x - p0.x;
+			packet.edge2[1][i] = p2.y - p0.y;
+			packet.edge2[2][i] = p2.z - p0.z;
+			packet.triangleIndex[i] = t;
+		}
+
+		// Unused lanes are left as degenerate triangles, which can never be hit
+		nodes[nodeIndex].leftOrFirst = (unsigned int)packets.size();
+		nodes[nodeIndex].count = count;
+		packets.push_back(packet);
+		return;
+	}
+
+	// Split along the axis the centroids are most spread out on
+	XMFLOAT3 extent;
+	XMStoreFloat3(&extent, centroidMax - centroidMin);
+	int axis = 0;
+	if (extent.y > extent.x) axis = 1;
+	if (extent.z > (axis == 0 ? extent.x : extent.y)) axis = 2;
+
+	unsigned int mid = start + count / 2;
+	std::nth_element(triangles.begin() + start, triangles.begin() + mid, triangles.begin() + end,
+		[&centroids, axis](unsigned int a, unsigned int b)
+		{
+			return (&centroids[a].x)[axis] < (&centroids[b].x)[axis];
+		});
+
+	// Children are always stored next to each other
+	unsigned int left = (unsigned int)nodes.size();
+	nodes.push_back(Node());
+	nodes.push_back(Node());
+	nodes[nodeIndex].leftOrFirst = left;
+	nodes[nodeIndex].count = 0;
+
+	BuildNode(left, triangles, start, mid, centroids, verts, indices);
+	BuildNode(left + 1, triangles, mid, end, centroids, verts, indices);
+}
+
+// --------------------------------------------------------
+// Slab test of a ray against a node's bounds
+//
+// Returns true if the box is hit closer than maxDistance, and
+// the distance at which the ray enters the box
+// --------------------------------------------------------
+static bool RayIntersectsBounds(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax,
+	FXMVECTOR origin, FXMVECTOR invDirection, float maxDistance, float* entry)
+{
+	XMVECTOR t0 = (XMLoadFloat3(&boundsMin) - origin) * invDirection;
+	XMVECTOR t1 = (XMLoadFloat3(&boundsMax) - origin) * invDirection;
+	XMFLOAT3 tNear;
+	XMFLOAT3 tFar;
+	XMStoreFloat3(&tNear, XMVectorMin(t0, t1));
+	XMStoreFloat3(&tFar, XMVectorMax(t0, t1));
+
+	float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+
+	*entry = enter;
+	return enter <= exit;
+}
+
+// --------------------------------------------------------
+// Finds the closest triangle hit by the ray
+//
+// ray - The ray in the same space the hierarchy was built in
+// maxDistance - Hits further than this are ignored
+// hit - Filled in with the closest hit, if there is one
+//
+// Returns true if any triangle was hit
+// --------------------------------------------------------
+bool MeshBVH::Intersect(const Ray& ray, float maxDistance, MeshRayHit* hit) const
+{
+	if (nodes.empty())
+		return false;
+
+	XMVECTOR origin = XMLoadFloat3(&ray.origin);
+	XMVECTOR direction = XMLoadFloat3(&ray.direction);
+	XMVECTOR invDirection = XMVectorReciprocal(direction);
+
+	// Nodes waiting to be visited along with the distance the ray enters them
+	struct StackEntry
+	{
+		unsigned int node;
+		float entry;
+	};
+	StackEntry stack[64];
+	int stackSize = 0;
+
+	float closest = maxDistance;
+	bool found = false;
+
+	float rootEntry;
+	if (!RayIntersectsBounds(nodes[0].boundsMin, nodes[0].boundsMax, origin, invDirection, closest, &rootEntry))
+		return false;
+	stack[stackSize++] = { 0, rootEntry };
+
+	while (stackSize > 0)
+	{
+		StackEntry current = stack[--stackSize];
+
+		// A closer hit may have been found since this node was pushed
+		if (current.entry > closest)
+			continue;
+
+		const Node& node = nodes[current.node];
+		if (node.count > 0)
+		{
+			if (IntersectPacket(packets[node.leftOrFirst], node.count, origin, direction, closest, hit))
+			{
+				closest = hit->distance;
+				found = true;
+			}
+			continue;
+		}
+
+		// Visit the nearer child first by pushing it last
+		unsigned int left = node.leftOrFirst;
+		unsigned int right = node.leftOrFirst + 1;
+		float leftEntry;
+		float rightEntry;
+		bool hitLeft = RayIntersectsBounds(nodes[left].boundsMin, nodes[left].boundsMax, origin, invDirection, closest, &leftEntry);
+		bool hitRight = RayIntersectsBounds(nodes[right].boundsMin, nodes[right].boundsMax, origin, invDirection, closest, &rightEntry);
+
+		if (hitLeft && hitRight)
+		{
+			if (leftEntry < rightEntry)
+			{
+				stack[stackSize++] = { right, rightEntry };
+				stack[stackSize++] = { left, leftEntry };
+			}
+			else
+			{
+				stack[stackSize++] = { left, leftEntry };
+				stack[stackSize++] = { right, rightEntry };
+			}
+		}
+		else if (hitLeft)
+		{
+			stack[stackSize++] = { left, leftEntry };
+		}
+		else if (hitRight)
+		{
+			stack[stackSize++] = { right, rightEntry };
+		}
+	}
+
+	return found;
+}
+
+// --------------------------------------------------------
+// Moller-Trumbore ray/triangle test run on all 4 triangles
+// of a packet at once, one triangle per SIMD lane
+// --------------------------------------------------------
+bool MeshBVH::IntersectPacket(const TrianglePacket& packet, unsigned int count,
+	FXMVECTOR origin, FXMVECTOR direction, float maxDistance, MeshRayHit* hit) const
+{
+	XMVECTOR ox = XMVectorSplatX(origin);
+	XMVECTOR oy = XMVectorSplatY(origin);
+	XMVECTOR oz = XMVectorSplatZ(origin);
+	XMVECTOR dx = XMVectorSplatX(direction);
+	XMVECTOR dy = XMVectorSplatY(direction);
+	XMVECTOR dz = XMVectorSplatZ(direction);
+
+	XMVECTOR v0x = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(packet.v0[0]));
+	XMVECTOR v0y = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(packet.v0[1]));
+	XMVECTOR v0z = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(packet.v0[2]));
+	XMVECTOR e1x = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(packet.edge1[0]));
+	XMVECTOR e1y = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(packet.edge1[1]));
+	XMVECTOR e1z = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(packet.edge1[2]));
+	XMVECTOR e2x = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(packet.edge2[0]));
+	XMVECTOR e2y = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(packet.edge2[1]));
+	XMVECTOR e2z = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(packet.edge2[2]));
+
+	// p = direction x edge2
+	XMVECTOR px = dy * e2z - dz * e2y;
+	XMVECTOR py = dz * e2x - dx * e2z;
+	XMVECTOR pz = dx * e2y - dy * e2x;
+
+	// A determinant near zero means the ray is parallel to the triangle (or the lane is unused)
+	XMVECTOR det = e1x * px + e1y * py + e1z * pz;
+	XMVECTOR invDet = XMVectorReciprocal(det);
+
+	// First barycentric coordinate
+	XMVECTOR tx = ox - v0x;
+	XMVECTOR ty = oy - v0y;
+	XMVECTOR tz = oz - v0z;
+	XMVECTOR u = (tx * px + ty * py + tz * pz) * invDet;
+
+	// q = (origin - v0) x edge1
+	XMVECTOR qx = ty * e1z - tz * e1y;
+	XMVECTOR qy = tz * e1x - tx * e1z;
+	XMVECTOR qz = tx * e1y - ty * e1x;
+
+	// Second barycentric coordinate and distance along the ray
+	XMVECTOR v = (dx * qx + dy * qy + dz * qz) * invDet;
+	XMVECTOR t = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR valid = XMVectorGreater(XMVectorAbs(det), XMVectorReplicate(1e-12f));
+	valid = XMVectorAndInt(valid, XMVectorGreaterOrEqual(u, zero));
+	valid = XMVectorAndInt(valid, XMVectorGreaterOrEqual(v, zero));
+	valid = XMVectorAndInt(valid, XMVectorLessOrEqual(u + v, XMVectorSplatOne()));
+	valid = XMVectorAndInt(valid, XMVectorGreater(t, zero));
+	valid = XMVectorAndInt(valid, XMVectorLess(t, XMVectorReplicate(maxDistance)));
+
+	XMFLOAT4 uLanes;
+	XMFLOAT4 vLanes;
+	XMFLOAT4 tLanes;
+	XMUINT4 validLanes;
+	XMStoreFloat4(&uLanes, u);
+	XMStoreFloat4(&vLanes, v);
+	XMStoreFloat4(&tLanes, t);
+	XMStoreUInt4(&validLanes, valid);
+
+	// Pick the closest of the lanes that passed
+	bool found = false;
+	float closest = maxDistance;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if ((&validLanes.x)[i] == 0 || (&tLanes.x)[i] >= closest)
+			continue;
+
+		float laneU = (&uLanes.x)[i];
+		float laneV = (&vLanes.x)[i];
+		closest = (&tLanes.x)[i];
+
+		hit->triangleIndex = packet.triangleIndex[i];
+		hit->barycentrics = XMFLOAT3(1.0f - laneU - laneV, laneU, laneV);
+		hit->distance = closest;
+		found = true;
+	}
+
+	return found;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <vector>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// A ray with an origin and a direction
+// - The direction does not need to be normalized, hit
+//   distances are measured in multiples of its length
+// --------------------------------------------------------
+struct Ray
+{
+	DirectX::XMFLOAT3 origin;
+	DirectX::XMFLOAT3 direction;
+};
+
+// --------------------------------------------------------
+// Result of a ray hitting a single triangle of a mesh
+// --------------------------------------------------------
+struct MeshRayHit
+{
+	unsigned int triangleIndex;			// Index of the triangle (first index / 3)
+	DirectX::XMFLOAT3 barycentrics;		// Weights of the triangle's 3 vertices at the hit point
+	float distance;						// Distance along the ray to the hit point
+};
+
+// --------------------------------------------------------
+// Bounding volume hierarchy over the triangles of a mesh
+//
+// Cooked once when the mesh is imported, then used to
+// answer ray queries against the exact triangles without
+// testing every one of them
+// --------------------------------------------------------
+class MeshBVH
+{
+public:
+	MeshBVH();
+
+	void Build(const Vertex* verts, int numVerts, const unsigned int* indices, int numIndices);
+	bool Intersect(const Ray& ray, float maxDistance, MeshRayHit* hit) const;
+
+	const DirectX::BoundingBox& GetBounds() const { return bounds; }
+	size_t GetNodeCount() const { return nodes.size(); }
+	size_t GetTriangleCount() const { return triangleCount; }
+
+private:
+	// A node is a leaf when its count is non-zero, in which case
+	// leftOrFirst is the index of its triangle packet, otherwise
+	// leftOrFirst is the index of the left child and the right child follows it
+	struct Node
+	{
+		DirectX::XMFLOAT3 boundsMin;
+		unsigned int leftOrFirst;
+		DirectX::XMFLOAT3 boundsMax;
+		unsigned int count;
+	};
+
+	// Up to 4 triangles stored component-wise so they can be
+	// tested against a ray at the same time using SIMD registers
+	struct alignas(16) TrianglePacket
+	{
+		float v0[3][4];
+		float edge1[3][4];
+		float edge2[3][4];
+		unsigned int triangleIndex[4];
+	};
+
+	void BuildNode(unsigned int nodeIndex, std::vector<unsigned int>& triangles, unsigned int start, unsigned int end,
+		const std::vector<DirectX::XMFLOAT3>& centroids, const Vertex* verts, const unsigned int* indices);
+	bool IntersectPacket(const TrianglePacket& packet, unsigned int count,
+		DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float maxDistance, MeshRayHit* hit) const;
+
+	std::vector<Node> nodes;
+	std::vector<TrianglePacket> packets;
+	DirectX::BoundingBox bounds;
+	size_t triangleCount;
+};
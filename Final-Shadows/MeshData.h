@@ -0,0 +1,36 @@
+#pragma once
+
+#include <istream>
+#include <vector>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// A mesh's vertices and indices on the CPU, before they're
+// put into buffers
+// --------------------------------------------------------
+struct MeshData
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+};
+
+// --------------------------------------------------------
+// Reading meshes out of OBJ text, and working out what the
+// files leave out
+// - Nothing here needs Direct3D, so Mesh and the stand-alone
+//   benchmark run the same code
+// --------------------------------------------------------
+namespace MeshImport
+{
+	// Mesh's own line by line loader, for faces that are triangles
+	// or quads with positions and normals
+	// - False if there were no faces to read
+	bool ParseObj(std::istream& obj, MeshData* mesh);
+
+	// The same through tinyobjloader, which splits up any polygon
+	bool ParseObjWithTinyObj(std::istream& obj, MeshData* mesh);
+
+	// Tangents from each triangle's positions and uvs, made
+	// orthogonal to the normals
+	void CalculateTangents(Vertex* verts, int numVerts, const unsigned int* indices, int numIndices);
+}
@@ -0,0 +1,608 @@
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <thread>
+#include "PVS.h"
+
+using namespace DirectX;
+
+// Identifies the file type and layout
+static const char PVSMagic[4] = { 'P', 'V', 'S', ' ' };
+static const unsigned int PVSVersion = 1;
+
+// Largest grid that can be baked or loaded, which keeps cell
+// indices well within an int and bounds what a load allocates
+static const int PVSMaxDim = 4096;
+static const int PVSMaxCells = 1 << 24;
+
+// --------------------------------------------------------
+// Fixed size start of a PVS file, followed by:
+//  - One set index per cell, 2 bytes each if they fit or 4 if not
+//  - setCount + 1 offsets into the compressed data (4 bytes each)
+//  - dataSize bytes of compressed sets
+// --------------------------------------------------------
+struct PVSFileHeader
+{
+	char magic[4];
+	unsigned int version;
+	float gridMin[3];
+	float cellSize;
+	int dims[3];
+	unsigned int staticEntityCount;
+	unsigned int checksum;
+	unsigned int setCount;
+	unsigned int dataSize;
+};
+
+// --------------------------------------------------------
+// Small integer hash, used to give each cell its own random
+// sequence so results don't depend on which thread bakes it
+// --------------------------------------------------------
+static unsigned int Hash(unsigned int x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
+
+// --------------------------------------------------------
+// Next random number in [0, 1) from an xorshift sequence
+// - Written out by hand so every platform bakes the same result
+// --------------------------------------------------------
+static float NextRandom(unsigned int& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+PVS::PVS()
+	:
+	gridMin(),
+	cellSize(1.0f),
+	dims(),
+	staticEntityCount(0),
+	checksum(0),
+	stats()
+{
+}
+
+// --------------------------------------------------------
+// Settings that give a reasonable bake of a small scene
+// --------------------------------------------------------
+PVSBakeSettings PVS::DefaultSettings()
+{
+	PVSBakeSettings settings = {};
+	settings.cellSize = 2.0f;
+	settings.margin = 10.0f;
+	settings.samplesPerCell = 4;
+	settings.raysPerSample = 256;
+	settings.raysPerEntity = 8;
+	settings.seed = 1;
+	settings.threadCount = 0;
+	return settings;
+}
+
+// --------------------------------------------------------
+// Removes all sets
+// --------------------------------------------------------
+void PVS::Clear()
+{
+	cellSets.clear();
+	sets.clear();
+	dims[0] = dims[1] = dims[2] = 0;
+	staticEntityCount = 0;
+	checksum = 0;
+	stats = {};
+}
+
+// --------------------------------------------------------
+// Builds the sets for a list of static occluders
+//
+// Cells are handed out to worker threads one at a time. Each
+// cell's rays come from a random sequence seeded by the cell's
+// index, and sets are numbered in cell order afterwards, so the
+// result never depends on how the work was scheduled.
+// --------------------------------------------------------
+void PVS::Bake(const std::vector<PVSOccluder>& placed, const PVSBakeSettings& settings)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	Clear();
+
+	if (placed.size() == 0 || !(settings.cellSize > 0.0f))
+		return;
+
+	// Work out everything the workers need up front
+	std::vector<Occluder> occluders;
+	BoundingBox sceneBounds;
+	for (auto& p : placed)
+	{
+		XMMATRIX world = XMLoadFloat4x4(&p.world);
+
+		Occluder occluder = {};
+		XMStoreFloat4x4(&occluder.invWorld, XMMatrixInverse(nullptr, world));
+		p.bvh->GetBounds().Transform(occluder.worldBounds, world);
+		occluder.bvh = p.bvh;
+
+		if (occluders.size() == 0)
+			sceneBounds = occluder.worldBounds;
+		else
+			BoundingBox::CreateMerged(sceneBounds, sceneBounds, occluder.worldBounds);
+
+		occluders.push_back(occluder);
+	}
+
+	staticEntityCount = (unsigned int)occluders.size();
+	checksum = Checksum(placed);
+
+	// Grid covering the static entities and some space around them,
+	// with bigger cells than asked for if there would be too many
+	gridMin = XMFLOAT3(
+		sceneBounds.Center.x - sceneBounds.Extents.x - settings.margin,
+		sceneBounds.Center.y - sceneBounds.Extents.y - settings.margin,
+		sceneBounds.Center.z - sceneBounds.Extents.z - settings.margin);
+	float size[3] = {
+		(sceneBounds.Extents.x + settings.margin) * 2.0f,
+		(sceneBounds.Extents.y + settings.margin) * 2.0f,
+		(sceneBounds.Extents.z + settings.margin) * 2.0f };
+	for (cellSize = settings.cellSize; ; cellSize *= 2.0f)
+	{
+		for (int d = 0; d < 3; d++)
+		{
+			float cells = ceilf(size[d] / cellSize);
+			dims[d] = cells < 1.0f ? 1 : cells > PVSMaxDim ? PVSMaxDim + 1 : (int)cells;
+		}
+
+		if (GridFits(dims))
+			break;
+	}
+
+	int cellCount = dims[0] * dims[1] * dims[2];
+	size_t setBytes = (staticEntityCount + 7) / 8;
+	std::vector<std::vector<unsigned char>> cellBits(cellCount, std::vector<unsigned char>(setBytes, 0));
+
+	std::atomic<int> nextCell(0);
+	auto worker = [&]()
+	{
+		for (int cell = nextCell++; cell < cellCount; cell = nextCell++)
+		{
+			int x = cell % dims[0];
+			int y = (cell / dims[0]) % dims[1];
+			int z = cell / (dims[0] * dims[1]);
+			unsigned int state = Hash(settings.seed ^ Hash((unsigned int)cell)) | 1;
+			std::vector<unsigned char>& bits = cellBits[cell];
+
+			for (int s = 0; s < settings.samplesPerCell; s++)
+			{
+				XMVECTOR origin = XMVectorSet(
+					gridMin.x + (x + NextRandom(state)) * cellSize,
+					gridMin.y + (y + NextRandom(state)) * cellSize,
+					gridMin.z + (z + NextRandom(state)) * cellSize,
+					1.0f);
+
+				// Uniformly distributed directions
+				for (int r = 0; r < settings.raysPerSample; r++)
+				{
+					float dz = 1.0f - 2.0f * NextRandom(state);
+					float phi = XM_2PI * NextRandom(state);
+					float radius = sqrtf(fmaxf(0.0f, 1.0f - dz * dz));
+					XMVECTOR direction = XMVectorSet(radius * cosf(phi), radius * sinf(phi), dz, 0.0f);
+
+					int hit = CastRay(occluders, origin, direction);
+					if (hit != -1)
+						bits[hit / 8] |= 1 << (hit % 8);
+				}
+
+				// Directions towards random points within each entity's bounds
+				for (int o = 0; o < (int)occluders.size(); o++)
+				{
+					const BoundingBox& bounds = occluders[o].worldBounds;
+					for (int r = 0; r < settings.raysPerEntity; r++)
+					{
+						XMVECTOR target = XMVectorSet(
+							bounds.Center.x + (NextRandom(state) * 2.0f - 1.0f) * bounds.Extents.x,
+							bounds.Center.y + (NextRandom(state) * 2.0f - 1.0f) * bounds.Extents.y,
+							bounds.Center.z + (NextRandom(state) * 2.0f - 1.0f) * bounds.Extents.z,
+							1.0f);
+
+						XMVECTOR toTarget = target - origin;
+						if (XMVectorGetX(XMVector3LengthSq(toTarget)) < 1e-8f)
+							continue;
+
+						int hit = CastRay(occluders, origin, XMVector3Normalize(toTarget));
+						if (hit != -1)
+							bits[hit / 8] |= 1 << (hit % 8);
+					}
+				}
+			}
+		}
+	};
+
+	int threadCount = settings.threadCount > 0 ? settings.threadCount : (int)std::thread::hardware_concurrency();
+	if (threadCount < 1)
+		threadCount = 1;
+
+	std::vector<std::thread> threads;
+	for (int t = 1; t < threadCount; t++)
+		threads.push_back(std::thread(worker));
+	worker();
+	for (auto& t : threads)
+		t.join();
+
+	// Share one copy of each distinct set
+	std::map<std::vector<unsigned char>, unsigned int> setLookup;
+	cellSets.resize(cellCount);
+	for (int cell = 0; cell < cellCount; cell++)
+	{
+		auto found = setLookup.find(cellBits[cell]);
+		if (found == setLookup.end())
+		{
+			found = setLookup.insert({ cellBits[cell], (unsigned int)sets.size() }).first;
+			sets.push_back(cellBits[cell]);
+		}
+		cellSets[cell] = found->second;
+	}
+
+	UpdateStats();
+	stats.bakeSeconds = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Finds which occluder a ray hits first
+//
+// Returns the occluder's index, or -1 if the ray hits nothing
+// --------------------------------------------------------
+int PVS::CastRay(const std::vector<Occluder>& occluders, FXMVECTOR origin, FXMVECTOR direction)
+{
+	int closestIndex = -1;
+	float closest = FLT_MAX;
+
+	for (int i = 0; i < (int)occluders.size(); i++)
+	{
+		const Occluder& occluder = occluders[i];
+
+		float entry = 0.0f;
+		if (occluder.worldBounds.Contains(origin) == DISJOINT &&
+			(!occluder.worldBounds.Intersects(origin, direction, entry) || entry > closest))
+			continue;
+
+		// Distances along the unnormalized local direction stay in world units
+		XMMATRIX invWorld = XMLoadFloat4x4(&occluder.invWorld);
+		Ray localRay = {};
+		XMStoreFloat3(&localRay.origin, XMVector3TransformCoord(origin, invWorld));
+		XMStoreFloat3(&localRay.direction, XMVector3TransformNormal(direction, invWorld));
+
+		MeshRayHit hit = {};
+		if (occluder.bvh->Intersect(localRay, closest, &hit))
+		{
+			closest = hit.distance;
+			closestIndex = i;
+		}
+	}
+
+	return closestIndex;
+}
+
+// --------------------------------------------------------
+// Fingerprint of the static occluders, so sets baked for a
+// different arrangement of the scene aren't used
+// --------------------------------------------------------
+unsigned int PVS::Checksum(const std::vector<PVSOccluder>& occluders)
+{
+	// FNV-1a
+	unsigned int hash = 2166136261u;
+	auto add = [&](const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 16777619u;
+	};
+
+	for (auto& o : occluders)
+	{
+		unsigned int triangles = (unsigned int)o.bvh->GetTriangleCount();
+		add(&o.world, sizeof(XMFLOAT4X4));
+		add(&triangles, sizeof(unsigned int));
+	}
+
+	return hash;
+}
+
+// --------------------------------------------------------
+// Checks if the sets were baked for these static occluders
+// --------------------------------------------------------
+bool PVS::Matches(const std::vector<PVSOccluder>& occluders)
+{
+	return IsLoaded() && Checksum(occluders) == checksum;
+}
+
+// --------------------------------------------------------
+// Checks if a grid is small enough to bake or load
+// --------------------------------------------------------
+bool PVS::GridFits(const int dims[3])
+{
+	for (int d = 0; d < 3; d++)
+	{
+		if (dims[d] < 1 || dims[d] > PVSMaxDim)
+			return false;
+	}
+
+	return (long long)dims[0] * dims[1] * dims[2] <= PVSMaxCells;
+}
+
+// --------------------------------------------------------
+// Finds the grid cell containing a position, or -1 if it's
+// outside of the grid
+// --------------------------------------------------------
+int PVS::FindCell(XMFLOAT3 position)
+{
+	if (!IsLoaded())
+		return -1;
+
+	// Compared before converting, so positions far outside of
+	// the grid (or not a number at all) can't overflow an int
+	float x = floorf((position.x - gridMin.x) / cellSize);
+	float y = floorf((position.y - gridMin.y) / cellSize);
+	float z = floorf((position.z - gridMin.z) / cellSize);
+	if (!(x >= 0.0f && y >= 0.0f && z >= 0.0f && x < dims[0] && y < dims[1] && z < dims[2]))
+		return -1;
+
+	return (int)x + ((int)y + (int)z * dims[1]) * dims[0];
+}
+
+// --------------------------------------------------------
+// Writes the sets to a file
+// --------------------------------------------------------
+bool PVS::Save(const std::string& file)
+{
+	std::ofstream stream(file, std::ios::binary);
+	if (!stream.is_open())
+		return false;
+
+	return Save(stream);
+}
+
+// --------------------------------------------------------
+// Writes the sets to a binary stream
+// --------------------------------------------------------
+bool PVS::Save(std::ostream& stream)
+{
+	if (!IsLoaded())
+		return false;
+
+	// Compress each distinct set one after another
+	std::vector<unsigned char> data;
+	std::vector<unsigned int> offsets;
+	for (auto& set : sets)
+	{
+		offsets.push_back((unsigned int)data.size());
+		Compress(set, &data);
+	}
+	offsets.push_back((unsigned int)data.size());
+
+	PVSFileHeader header = {};
+	memcpy(header.magic, PVSMagic, sizeof(PVSMagic));
+	header.version = PVSVersion;
+	header.gridMin[0] = gridMin.x;
+	header.gridMin[1] = gridMin.y;
+	header.gridMin[2] = gridMin.z;
+	header.cellSize = cellSize;
+	memcpy(header.dims, dims, sizeof(dims));
+	header.staticEntityCount = staticEntityCount;
+	header.checksum = checksum;
+	header.setCount = (unsigned int)sets.size();
+	header.dataSize = (unsigned int)data.size();
+	stream.write((const char*)&header, sizeof(header));
+
+	// Most scenes have few enough distinct sets to index with 2 bytes
+	if (sets.size() <= 0xFFFF)
+	{
+		std::vector<unsigned short> shortSets(cellSets.begin(), cellSets.end());
+		stream.write((const char*)shortSets.data(), shortSets.size() * sizeof(unsigned short));
+	}
+	else
+	{
+		stream.write((const char*)cellSets.data(), cellSets.size() * sizeof(unsigned int));
+	}
+
+	stream.write((const char*)offsets.data(), offsets.size() * sizeof(unsigned int));
+	stream.write((const char*)data.data(), data.size());
+
+	stats.dataSize = data.size();
+	return stream.good();
+}
+
+// --------------------------------------------------------
+// Reads sets from a file written by Save()
+// --------------------------------------------------------
+bool PVS::Load(const std::string& file)
+{
+	std::ifstream stream(file, std::ios::binary);
+	if (!stream.is_open())
+	{
+		Clear();
+		return false;
+	}
+
+	return Load(stream);
+}
+
+// --------------------------------------------------------
+// Reads sets from a binary stream written by Save()
+//
+// Returns false if the data is missing or malformed, in which
+// case nothing is loaded. The stream has to be seekable, so
+// its size can be checked before anything is allocated
+// --------------------------------------------------------
+bool PVS::Load(std::istream& stream)
+{
+	Clear();
+
+	PVSFileHeader header = {};
+	stream.read((char*)&header, sizeof(header));
+	if (!stream ||
+		memcmp(header.magic, PVSMagic, sizeof(PVSMagic)) != 0 ||
+		header.version != PVSVersion ||
+		!GridFits(header.dims) ||
+		header.setCount == 0 || header.staticEntityCount == 0 ||
+		!(header.cellSize > 0.0f))
+		return false;
+
+	// Every cell uses a set, so there can't be more sets than cells
+	size_t cellCount = (size_t)header.dims[0] * header.dims[1] * header.dims[2];
+	if (header.setCount > cellCount)
+		return false;
+
+	// Make sure the rest of the file is really there
+	size_t indexSize = header.setCount <= 0xFFFF ? sizeof(unsigned short) : sizeof(unsigned int);
+	size_t expected = cellCount * indexSize + ((size_t)header.setCount + 1) * sizeof(unsigned int) + header.dataSize;
+	std::streampos bodyStart = stream.tellg();
+	stream.seekg(0, std::ios::end);
+	std::streampos streamEnd = stream.tellg();
+	stream.seekg(bodyStart);
+	if (!stream || bodyStart < 0 || (size_t)(streamEnd - bodyStart) < expected)
+		return false;
+
+	std::vector<unsigned int> indices(cellCount);
+	if (header.setCount <= 0xFFFF)
+	{
+		std::vector<unsigned short> shortSets(cellCount);
+		stream.read((char*)shortSets.data(), cellCount * sizeof(unsigned short));
+		indices.assign(shortSets.begin(), shortSets.end());
+	}
+	else
+	{
+		stream.read((char*)indices.data(), cellCount * sizeof(unsigned int));
+	}
+
+	std::vector<unsigned int> offsets(header.setCount + 1);
+	std::vector<unsigned char> data(header.dataSize);
+	stream.read((char*)offsets.data(), offsets.size() * sizeof(unsigned int));
+	stream.read((char*)data.data(), data.size());
+	if (!stream)
+		return false;
+
+	// Expand every set now so lookups are just bit tests
+	size_t setBytes = (header.staticEntityCount + 7) / 8;
+	std::vector<std::vector<unsigned char>> loadedSets(header.setCount);
+	for (unsigned int s = 0; s < header.setCount; s++)
+	{
+		if (offsets[s] > offsets[s + 1] || offsets[s + 1] > header.dataSize ||
+			!Decompress(data.data() + offsets[s], offsets[s + 1] - offsets[s], &loadedSets[s]) ||
+			loadedSets[s].size() != setBytes)
+			return false;
+	}
+
+	for (unsigned int index : indices)
+	{
+		if (index >= header.setCount)
+			return false;
+	}
+
+	gridMin = XMFLOAT3(header.gridMin[0], header.gridMin[1], header.gridMin[2]);
+	cellSize = header.cellSize;
+	memcpy(dims, header.dims, sizeof(dims));
+	staticEntityCount = header.staticEntityCount;
+	checksum = header.checksum;
+	cellSets.swap(indices);
+	sets.swap(loadedSets);
+
+	UpdateStats();
+	stats.dataSize = header.dataSize;
+	return true;
+}
+
+// --------------------------------------------------------
+// Run length encodes a bitset, where most bytes tend to be zero
+// - A control byte below 0x80 is followed by that many + 1 literal bytes
+// - A control byte of 0x80 or above stands for (byte - 0x80) + 1 zero bytes
+// --------------------------------------------------------
+void PVS::Compress(const std::vector<unsigned char>& bits, std::vector<unsigned char>* data)
+{
+	size_t i = 0;
+	while (i < bits.size())
+	{
+		size_t run = 0;
+		if (bits[i] == 0)
+		{
+			while (i + run < bits.size() && bits[i + run] == 0 && run < 128)
+				run++;
+			data->push_back((unsigned char)(0x80 + run - 1));
+		}
+		else
+		{
+			while (i + run < bits.size() && bits[i + run] != 0 && run < 128)
+				run++;
+			data->push_back((unsigned char)(run - 1));
+			data->insert(data->end(), bits.begin() + i, bits.begin() + i + run);
+		}
+		i += run;
+	}
+}
+
+// --------------------------------------------------------
+// Reverses Compress()
+//
+// Returns false if the data ends partway through a run
+// --------------------------------------------------------
+bool PVS::Decompress(const unsigned char* data, size_t size, std::vector<unsigned char>* bits)
+{
+	bits->clear();
+
+	size_t i = 0;
+	while (i < size)
+	{
+		unsigned char control = data[i++];
+		if (control >= 0x80)
+		{
+			bits->insert(bits->end(), control - 0x80 + 1, 0);
+		}
+		else
+		{
+			size_t run = control + 1;
+			if (i + run > size)
+				return false;
+
+			bits->insert(bits->end(), data + i, data + i + run);
+			i += run;
+		}
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Recounts the numbers shown about the current sets
+// --------------------------------------------------------
+void PVS::UpdateStats()
+{
+	stats.cellCount = (int)cellSets.size();
+	stats.uniqueSetCount = (int)sets.size();
+
+	// Count how many cells use each set, then how many entities each set holds
+	std::vector<unsigned int> setUses(sets.size(), 0);
+	for (unsigned int s : cellSets)
+		setUses[s]++;
+
+	double visible = 0.0;
+	for (int s = 0; s < (int)sets.size(); s++)
+	{
+		int count = 0;
+		for (unsigned char byte : sets[s])
+		{
+			for (int b = 0; b < 8; b++)
+				count += (byte >> b) & 1;
+		}
+		visible += (double)count * setUses[s];
+	}
+
+	stats.averageVisible = cellSets.size() > 0 ? (float)(visible / cellSets.size()) : 0.0f;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "MeshBVH.h"
+
+class GameEntity;
+
+// --------------------------------------------------------
+// Controls how densely a PVS is sampled while baking
+// --------------------------------------------------------
+struct PVSBakeSettings
+{
+	float cellSize;				// World units along each side of a grid cell
+	float margin;				// How far past the static geometry the grid extends
+	int samplesPerCell;			// Points in each cell that rays are cast from
+	int raysPerSample;			// Rays in random directions from each point
+	int raysPerEntity;			// Extra rays aimed at each entity from each point, so small ones aren't missed
+	unsigned int seed;			// Baking twice with the same seed and scene gives identical output
+	int threadCount;			// 0 uses every hardware thread
+};
+
+// --------------------------------------------------------
+// A static mesh placed in the world, which is all baking
+// needs to know about an entity
+// --------------------------------------------------------
+struct PVSOccluder
+{
+	DirectX::XMFLOAT4X4 world;
+	const MeshBVH* bvh;
+};
+
+// --------------------------------------------------------
+// Numbers describing the most recent bake or load
+// --------------------------------------------------------
+struct PVSStats
+{
+	int cellCount;
+	int uniqueSetCount;			// Cells that see the same entities share one set
+	float averageVisible;		// Static entities visible from an average cell
+	size_t dataSize;			// Bytes of compressed set data
+	float bakeSeconds;
+};
+
+// --------------------------------------------------------
+// Potentially visible sets for static entities
+//
+// The space around the static entities is divided into a grid
+// of cells. Baking casts rays from points in every cell, and any
+// static entity a ray hits first goes into that cell's set.
+// At runtime the camera's cell decides which static entities
+// are worth considering at all - everything else is skipped
+// before frustum culling. Entities that aren't static are
+// always considered.
+//
+// Sets are stored as bitsets with one bit per static entity, in
+// the order they appear in the entity list. Identical sets are
+// stored once, and each is run length encoded.
+//
+// The overloads taking entities are kept in PVSEntities.cpp,
+// so the rest only needs the occluders' triangles.
+// --------------------------------------------------------
+class PVS
+{
+public:
+	PVS();
+
+	void Bake(const std::vector<PVSOccluder>& occluders, const PVSBakeSettings& settings);
+	void Bake(const std::vector<std::shared_ptr<GameEntity>>& entities, const PVSBakeSettings& settings);
+	bool Save(const std::string& file);
+	bool Save(std::ostream& stream);
+	bool Load(const std::string& file);
+	bool Load(std::istream& stream);
+	void Clear();
+
+	bool IsLoaded() { return cellSets.size() > 0; }
+	bool Matches(const std::vector<PVSOccluder>& occluders);
+	bool Matches(const std::vector<std::shared_ptr<GameEntity>>& entities);
+	int FindCell(DirectX::XMFLOAT3 position);
+	bool FindCandidates(
+		DirectX::XMFLOAT3 position,
+		const std::vector<std::shared_ptr<GameEntity>>& entities,
+		std::vector<int>* candidates);
+
+	const PVSStats& GetStats() { return stats; }
+	static PVSBakeSettings DefaultSettings();
+	static std::vector<PVSOccluder> GatherOccluders(const std::vector<std::shared_ptr<GameEntity>>& entities);
+
+private:
+	// An occluder with everything ray casts need worked out up front
+	struct Occluder
+	{
+		DirectX::XMFLOAT4X4 invWorld;
+		DirectX::BoundingBox worldBounds;
+		const MeshBVH* bvh;
+	};
+
+	static int CastRay(const std::vector<Occluder>& occluders, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction);
+	static unsigned int Checksum(const std::vector<PVSOccluder>& occluders);
+	static bool GridFits(const int dims[3]);
+	static void Compress(const std::vector<unsigned char>& bits, std::vector<unsigned char>* data);
+	static bool Decompress(const unsigned char* data, size_t size, std::vector<unsigned char>* bits);
+	void UpdateStats();
+
+	// Grid
+	DirectX::XMFLOAT3 gridMin;
+	float cellSize;
+	int dims[3];
+
+	// Which scene the sets were baked for
+	unsigned int staticEntityCount;
+	unsigned int checksum;
+
+	std::vector<unsigned int> cellSets;					// Index into sets for each cell
+	std::vector<std::vector<unsigned char>> sets;		// Uncompressed bitsets
+
+	PVSStats stats;
+};
@@ -0,0 +1,76 @@
+#include "GameEntity.h"
+#include "PVS.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Places each static entity's mesh in the world, in the
+// order the sets number them
+// --------------------------------------------------------
+std::vector<PVSOccluder> PVS::GatherOccluders(const std::vector<std::shared_ptr<GameEntity>>& entities)
+{
+	std::vector<PVSOccluder> occluders;
+	for (auto& e : entities)
+	{
+		if (!e->IsStatic())
+			continue;
+
+		PVSOccluder occluder = {};
+		occluder.world = e->GetTransform()->GetWorldMatrix();
+		occluder.bvh = &e->GetMesh()->GetBVH();
+		occluders.push_back(occluder);
+	}
+
+	return occluders;
+}
+
+// --------------------------------------------------------
+// Builds the sets for every static entity in the list
+// --------------------------------------------------------
+void PVS::Bake(const std::vector<std::shared_ptr<GameEntity>>& entities, const PVSBakeSettings& settings)
+{
+	Bake(GatherOccluders(entities), settings);
+}
+
+// --------------------------------------------------------
+// Checks if the sets were baked for these static entities
+// --------------------------------------------------------
+bool PVS::Matches(const std::vector<std::shared_ptr<GameEntity>>& entities)
+{
+	return IsLoaded() && Checksum(GatherOccluders(entities)) == checksum;
+}
+
+// --------------------------------------------------------
+// Lists the entities worth considering from a position: static
+// entities in its cell's set, and every entity that isn't static
+//
+// Returns false when the position is outside of the grid, in
+// which case every entity should be considered
+// --------------------------------------------------------
+bool PVS::FindCandidates(
+	XMFLOAT3 position,
+	const std::vector<std::shared_ptr<GameEntity>>& entities,
+	std::vector<int>* candidates)
+{
+	candidates->clear();
+
+	int cell = FindCell(position);
+	if (cell == -1)
+		return false;
+
+	const std::vector<unsigned char>& bits = sets[cellSets[cell]];
+	unsigned int staticIndex = 0;
+	for (int i = 0; i < (int)entities.size(); i++)
+	{
+		if (entities[i]->IsStatic())
+		{
+			unsigned int bit = staticIndex++;
+			if (bit >= staticEntityCount || !(bits[bit / 8] & (1 << (bit % 8))))
+				continue;
+		}
+
+		candidates->push_back(i);
+	}
+
+	return true;
+}
@@ -0,0 +1,118 @@
+#include <chrono>
+#include "D3D11StateBackend.h"
+#include "ParallelRecorder.h"
+#include "SimpleShader.h"
+
+ParallelRecorder::ParallelRecorder(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> immediateContext,
+	std::shared_ptr<StateCache> immediateStates,
+	std::shared_ptr<InstanceBatcher> immediateBatcher,
+	int threadCount)
+	:
+	device(device),
+	passCount(0),
+	recordedDeferred(false),
+	workers(threadCount),
+	parallel(true),
+	recordMs(0.0f)
+{
+	immediate.context = immediateContext;
+	immediate.states = immediateStates;
+	immediate.batcher = immediateBatcher;
+}
+
+// --------------------------------------------------------
+// Records passes 0 to passCount - 1, calling record() once
+// for each with the pass to record into
+// - record() may run on any thread, so it should only change
+//   what belongs to its own pass
+// --------------------------------------------------------
+void ParallelRecorder::Record(int count, std::function<void(RecordingPass& pass, int index)> record)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	passCount = count;
+	recordedDeferred = parallel;
+	if (!parallel)
+	{
+		for (int p = 0; p < passCount; p++)
+			record(immediate, p);
+	}
+	else
+	{
+		// Contexts are created up front, as the device is only
+		// touched from this thread
+		for (int p = (int)passes.size(); p < passCount; p++)
+		{
+			RecordingPass pass;
+			device->CreateDeferredContext(0, pass.context.GetAddressOf());
+			pass.states = std::make_shared<StateCache>(std::make_shared<D3D11StateBackend>(pass.context));
+			pass.batcher = std::make_shared<InstanceBatcher>(device, pass.context);
+			passes.push_back(pass);
+		}
+
+		// Settings are copied over so they match the immediate context's
+		for (int p = 0; p < passCount; p++)
+		{
+			passes[p].states->SetEnabled(immediate.states->GetEnabled());
+			passes[p].states->ResetStats();
+			passes[p].batcher->SetEnabled(immediate.batcher->GetEnabled());
+			passes[p].batcher->SetMinBatchSize(immediate.batcher->GetMinBatchSize());
+		}
+
+		workers.Run(passCount, [&](int p) { RecordDeferred(passes[p], p, record); });
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	recordMs = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+// --------------------------------------------------------
+// Records one pass into its deferred context and closes it
+// off into a command list
+// --------------------------------------------------------
+void ParallelRecorder::RecordDeferred(RecordingPass& pass, int index, std::function<void(RecordingPass&, int)>& record)
+{
+	// Shaders on this thread record into the pass's context, and
+	// upload into their own buffers since the constant ring can
+	// only be used from the immediate context
+	StateCache* lastStates = ISimpleShader::States;
+	ConstantBufferRing* lastRing = ISimpleShader::ConstantRing;
+	ISimpleShader::States = pass.states.get();
+	ISimpleShader::ConstantRing = 0;
+
+	// Every command list starts from the default state
+	pass.states->Invalidate();
+	pass.batcher->BeginFrame();
+
+	record(pass, index);
+
+	pass.context->FinishCommandList(FALSE, pass.commandList.ReleaseAndGetAddressOf());
+
+	ISimpleShader::States = lastStates;
+	ISimpleShader::ConstantRing = lastRing;
+}
+
+// --------------------------------------------------------
+// Plays back the recorded passes on the immediate context
+// - Executing a command list resets the context's state, so
+//   anything drawing afterwards needs to set its own
+// --------------------------------------------------------
+void ParallelRecorder::Execute()
+{
+	if (!recordedDeferred)
+		return;
+
+	for (int p = 0; p < passCount; p++)
+	{
+		if (passes[p].commandList)
+			immediate.context->ExecuteCommandList(passes[p].commandList.Get(), FALSE);
+		passes[p].commandList.Reset();
+
+		immediate.states->AddStats(passes[p].states->GetStats());
+		immediate.batcher->AddStats(passes[p].batcher->GetFrameStats());
+	}
+
+	immediate.states->Invalidate();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "StateCache.h"
+#include "InstanceBatcher.h"
+#include "RecordingWorkers.h"
+
+// --------------------------------------------------------
+// Where one pass records its commands, and the state it keeps
+// while doing so
+// - Shaders and meshes reach the context through the state
+//   cache, which SimpleShader picks up per thread
+// --------------------------------------------------------
+struct RecordingPass
+{
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11CommandList> commandList;
+	std::shared_ptr<StateCache> states;
+	std::shared_ptr<InstanceBatcher> batcher;
+};
+
+// --------------------------------------------------------
+// Records a frame's passes on several threads at once, then
+// plays them back in order on the immediate context
+//
+// Each pass gets its own deferred context, state cache and
+// instance batcher, so passes only share what they read. The
+// command lists are executed in pass order, which leaves the
+// GPU work in the same order as recording them one by one.
+//
+// With parallel recording off, passes are recorded straight
+// onto the immediate context instead, one after another, using
+// the immediate context's own state cache and batcher
+// --------------------------------------------------------
+class ParallelRecorder
+{
+public:
+	ParallelRecorder(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> immediateContext,
+		std::shared_ptr<StateCache> immediateStates,
+		std::shared_ptr<InstanceBatcher> immediateBatcher,
+		int threadCount = 0);
+
+	void Record(int passCount, std::function<void(RecordingPass& pass, int index)> record);
+	void Execute();
+
+	bool GetParallel() { return parallel; }
+	void SetParallel(bool p) { parallel = p; }
+	int GetThreadCount() { return workers.GetThreadCount(); }
+	float GetRecordMs() { return recordMs; }
+
+private:
+	void RecordDeferred(RecordingPass& pass, int index, std::function<void(RecordingPass&, int)>& record);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	RecordingPass immediate;
+	std::vector<RecordingPass> passes;
+	int passCount;
+	bool recordedDeferred;
+
+	RecordingWorkers workers;
+	bool parallel;
+	float recordMs;
+};
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <cfloat>
+#include "Picking.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Unprojects a point on the screen through the camera into
+// a world space ray that starts on the near clip plane
+// --------------------------------------------------------
+Ray Picking::ScreenPointToRay(std::shared_ptr<Camera> camera, float screenX, float screenY, float screenWidth, float screenHeight)
+{
+	XMFLOAT4X4 viewMatrix = camera->GetViewMatrix();
+	XMFLOAT4X4 projMatrix = camera->GetProjectionMatrix();
+	XMMATRIX view = XMLoadFloat4x4(&viewMatrix);
+	XMMATRIX proj = XMLoadFloat4x4(&projMatrix);
+
+	XMVECTOR nearPoint = XMVector3Unproject(XMVectorSet(screenX, screenY, 0.0f, 1.0f),
+		0, 0, screenWidth, screenHeight, 0.0f, 1.0f, proj, view, XMMatrixIdentity());
+	XMVECTOR farPoint = XMVector3Unproject(XMVectorSet(screenX, screenY, 1.0f, 1.0f),
+		0, 0, screenWidth, screenHeight, 0.0f, 1.0f, proj, view, XMMatrixIdentity());
+
+	Ray ray = {};
+	XMStoreFloat3(&ray.origin, nearPoint);
+	XMStoreFloat3(&ray.direction, XMVector3Normalize(farPoint - nearPoint));
+	return ray;
+}
+
+// --------------------------------------------------------
+// Finds the closest entity hit by a world space ray
+//
+// The broad phase tests the ray against each entity's world
+// space bounds, then only the entities it hits are tested
+// against their mesh's triangles, nearest bounds first
+//
+// Returns true if any entity was hit
+// --------------------------------------------------------
+bool Picking::PickEntity(const Ray& worldRay, const std::vector<std::shared_ptr<GameEntity>>& entities, PickResult* result)
+{
+	XMVECTOR origin = XMLoadFloat3(&worldRay.origin);
+	XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&worldRay.direction));
+
+	// Broad phase
+	std::vector<std::pair<float, int>> candidates;
+	for (int i = 0; i < entities.size(); i++)
+	{
+		XMFLOAT4X4 world = entities[i]->GetTransform()->GetWorldMatrix();
+
+		BoundingBox worldBounds;
+		entities[i]->GetMesh()->GetBounds().Transform(worldBounds, XMLoadFloat4x4(&world));
+
+		float entry = 0.0f;
+		if (worldBounds.Contains(origin) != DISJOINT)
+			candidates.push_back({ 0.0f, i });
+		else if (worldBounds.Intersects(origin, direction, entry))
+			candidates.push_back({ entry, i });
+	}
+
+	std::sort(candidates.begin(), candidates.end());
+
+	// Narrow phase
+	bool found = false;
+	float closest = FLT_MAX;
+	for (auto& c : candidates)
+	{
+		// Every remaining entity's bounds start further away than what was already hit
+		if (c.first > closest)
+			break;
+
+		std::shared_ptr<GameEntity> entity = entities[c.second];
+		XMFLOAT4X4 world = entity->GetTransform()->GetWorldMatrix();
+		XMMATRIX invWorld = XMMatrixInverse(nullptr, XMLoadFloat4x4(&world));
+
+		// Move the ray into the mesh's space without renormalizing it, so
+		// distances along it stay measured in world units
+		Ray localRay = {};
+		XMStoreFloat3(&localRay.origin, XMVector3TransformCoord(origin, invWorld));
+		XMStoreFloat3(&localRay.direction, XMVector3TransformNormal(direction, invWorld));
+
+		MeshRayHit hit = {};
+		if (entity->GetMesh()->GetBVH().Intersect(localRay, closest, &hit))
+		{
+			closest = hit.distance;
+			found = true;
+
+			result->entityIndex = c.second;
+			result->triangleIndex = hit.triangleIndex;
+			result->barycentrics = hit.barycentrics;
+			result->distance = hit.distance;
+			XMStoreFloat3(&result->position, origin + direction * hit.distance);
+		}
+	}
+
+	return found;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <memory>
+#include <vector>
+#include "Camera.h"
+#include "GameEntity.h"
+#include "MeshBVH.h"
+
+// --------------------------------------------------------
+// The closest entity found under a ray, down to the exact
+// triangle and the point on it that was hit
+// --------------------------------------------------------
+struct PickResult
+{
+	int entityIndex;					// Index into the entity list that was searched
+	unsigned int triangleIndex;			// Triangle of the entity's mesh that was hit
+	DirectX::XMFLOAT3 barycentrics;		// Weights of the triangle's vertices at the hit point
+	DirectX::XMFLOAT3 position;			// World space hit point
+	float distance;						// World space distance from the ray's origin
+};
+
+namespace Picking
+{
+	Ray ScreenPointToRay(std::shared_ptr<Camera> camera, float screenX, float screenY, float screenWidth, float screenHeight);
+	bool PickEntity(const Ray& worldRay, const std::vector<std::shared_ptr<GameEntity>>& entities, PickResult* result);
+}
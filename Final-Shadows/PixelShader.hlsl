@@ -2,21 +2,63 @@
 
 #define NUM_LIGHTS 6
 
-cbuffer ExternalData : register(b0)
+// Shader permutations loop over fewer lights and shadow maps than the
+// constant buffers have room for, and skip textures the material
+// doesn't have - the defaults here make the full shader
+// - See ShaderPermutation.h and the BuildShaderVariants target in FinalShadows.vcxproj
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT NUM_LIGHTS
+#endif
+
+#ifndef SHADOW_MAP_COUNT
+#define SHADOW_MAP_COUNT MAX_NUM_SHADOW_MAPS
+#endif
+
+#ifndef NORMAL_MAP
+#define NORMAL_MAP 1
+#endif
+
+#ifndef PBR_MAPS
+#define PBR_MAPS 1
+#endif
+
+// Pooled materials read their textures from arrays shared with
+// other materials, picking a slice of each with textureSlices
+// - See PooledPixelShader.hlsl and TexturePool.h
+#ifndef TEXTURE_POOL
+#define TEXTURE_POOL 0
+#endif
+
+cbuffer PerFrame : register(b0)
 {
-	float4 colorTint;
-	float roughnessFlat;
 	float3 cameraPosition;
 	Light lights[NUM_LIGHTS];
-	float uvScale;
+	matrix lightViewProjs[MAX_NUM_SHADOW_MAPS];	// Last, so only the ones in use need copying
+}
+
+cbuffer PerMaterial : register(b1)
+{
+	float4 colorTint;
+	float roughnessFlat;
 	float metallicFlat;
 	float2 uvOffset;
+	float uvScale;
+	uint4 textureSlices;	// Albedo, normal, roughness and metallic, when pooled
 }
 
+#if TEXTURE_POOL
+Texture2DArray Albedo				: register(t0);
+Texture2DArray NormalMap			: register(t1);
+Texture2DArray RoughnessMap			: register(t2);
+Texture2DArray MetallicMap			: register(t3);
+#define SAMPLE_MATERIAL(tex, slice, uv) tex.Sample(BasicSampler, float3(uv, slice))
+#else
 Texture2D Albedo					: register(t0);
 Texture2D NormalMap					: register(t1);
 Texture2D RoughnessMap				: register(t2);
 Texture2D MetallicMap				: register(t3);
+#define SAMPLE_MATERIAL(tex, slice, uv) tex.Sample(BasicSampler, uv)
+#endif
 Texture2DArray<float4> ShadowMaps	: register(t4);
 
 SamplerState BasicSampler				: register(s0);
@@ -36,8 +78,10 @@ float4 main(VertexToPixel input) : SV_TARGET
 {
 	// Calculate pixel-specific variables ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 	input.normal = normalize(input.normal);
+#if NORMAL_MAP
 	input.tangent = normalize(input.tangent);
 	input.tangent = normalize(input.tangent - input.normal * dot(input.tangent, input.normal));
+#endif
 
 	input.uv /= uvScale;
 	input.uv.x -= uvOffset.x;
@@ -45,45 +89,49 @@ float4 main(VertexToPixel input) : SV_TARGET
 	
 	float3 view = normalize(cameraPosition - input.worldPosition);
 	
-	// Calculate distance from each light that casts shadows
-	float lightDepths[MAX_NUM_SHADOW_MAPS];
-	float2 shadowUVs[MAX_NUM_SHADOW_MAPS];
-	for (int i = 0; i < MAX_NUM_SHADOW_MAPS; i++)
-	{
-		// Because shadowPosition is not tagged as SV_POSITION we must do the perspective divide ourselves
-		lightDepths[i] = input.shadowPositions[i].z / input.shadowPositions[i].w;
-		// Adjust [-1 to 1] range to be [0 to 1] for Shadow Map UVs
-		shadowUVs[i] = input.shadowPositions[i].xy / input.shadowPositions[i].w * 0.5f + 0.5f;
-		shadowUVs[i].y = 1.0f - shadowUVs[i].y; // Flip y
-	}
-
-	
+#if NORMAL_MAP
 	// Get normals from a normal map texture
-	float3 unpackedNormal = NormalMap.Sample(BasicSampler, input.uv).rgb * 2 - 1;
+	float3 unpackedNormal = SAMPLE_MATERIAL(NormalMap, textureSlices.y, input.uv).rgb * 2 - 1;
 	float3 bitangent = cross(input.normal, input.tangent);
 	float3x3 tbn = float3x3(input.tangent, bitangent, input.normal);
 	input.normal = normalize(mul(unpackedNormal, tbn));
+#endif
 	
 	// Sample values from textures ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 	// Get base surface color
-	float3 albedo = DarkenToGamma(Albedo.Sample(BasicSampler, input.uv).rgb);
+	float3 albedo = DarkenToGamma(SAMPLE_MATERIAL(Albedo, textureSlices.x, input.uv).rgb);
 	// Get roughness value from texture, if a texture is provided
 	float roughness = roughnessFlat;
+#if PBR_MAPS
 	if (roughnessFlat == -1)
-		roughness = RoughnessMap.Sample(BasicSampler, input.uv).r;
+		roughness = SAMPLE_MATERIAL(RoughnessMap, textureSlices.z, input.uv).r;
+#endif
 	roughness = max(roughness, MIN_ROUGHNESS);
 	// Get metallic value from texture, if a texture is provided
 	float metallic = metallicFlat;
+#if PBR_MAPS
 	if (metallicFlat == -1)
-		metallic = MetallicMap.Sample(BasicSampler, input.uv).r;
+		metallic = SAMPLE_MATERIAL(MetallicMap, textureSlices.w, input.uv).r;
+#endif
 	// Get depth value of closest surface from each Shadow Map, then compare it to the actual depth of this pixel
-	float shadowAmount[MAX_NUM_SHADOW_MAPS];
-	for (int i = 0; i < MAX_NUM_SHADOW_MAPS; i++)
+	// - Positions in each light's space are worked out here from the world position,
+	//   rather than being passed down from the vertex shader
+#if SHADOW_MAP_COUNT > 0
+	float shadowAmount[SHADOW_MAP_COUNT];
+	for (int i = 0; i < SHADOW_MAP_COUNT; i++)
 	{
+		float4 shadowPosition = mul(lightViewProjs[i], float4(input.worldPosition, 1.0f));
+		// Because shadowPosition is not tagged as SV_POSITION we must do the perspective divide ourselves
+		float lightDepth = shadowPosition.z / shadowPosition.w;
+		// Adjust [-1 to 1] range to be [0 to 1] for Shadow Map UVs
+		float2 shadowUV = shadowPosition.xy / shadowPosition.w * 0.5f + 0.5f;
+		shadowUV.y = 1.0f - shadowUV.y; // Flip y
+
 		// float3(UVs to sample from, Shadow Map index in the array)
-		float3 sampleAt = float3(shadowUVs[i].x, shadowUVs[i].y, i);
-		shadowAmount[i] = ShadowMaps.SampleCmpLevelZero(ShadowSampler, sampleAt, lightDepths[i]);
+		float3 sampleAt = float3(shadowUV.x, shadowUV.y, i);
+		shadowAmount[i] = ShadowMaps.SampleCmpLevelZero(ShadowSampler, sampleAt, lightDepth);
 	}
+#endif
 	
 	// Specular color determination ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 	// Assume albedo texture is actually holding specular color where metalness == 1
@@ -98,7 +146,7 @@ float4 main(VertexToPixel input) : SV_TARGET
 	float3 finalColor = 0;
 	// Add all light color values together
 	int shadowIndex = 0;
-	for (int i = 0; i < NUM_LIGHTS; i++)
+	for (int i = 0; i < LIGHT_COUNT; i++)
 	{
 		// Lighting calculations with shadows for point lights are different from every other type of light
 		// Point lights have 6 Shadow Maps to look at while all other lights only have 1
@@ -119,7 +167,11 @@ float4 main(VertexToPixel input) : SV_TARGET
 					maxDot = max(dotProduct, maxDot);
 				}
 				// Use the sample only from the Shadow Map directly influencing this pixel
+#if SHADOW_MAP_COUNT > 0
 				finalColor += unshadowedColor * (lights[i].castsShadows ? shadowAmount[shadowIndex + directionIndex] : 1.0f);
+#else
+				finalColor += unshadowedColor;
+#endif
 				shadowIndex = lights[i].castsShadows ? shadowIndex + 6 : shadowIndex;
 				break;
 			}
@@ -127,7 +179,11 @@ float4 main(VertexToPixel input) : SV_TARGET
 			default:
 			{
 				// Multiply the unshadowed color by the amount of light that should be able to reach this pixel because of shadows, if this light casts shadows
+#if SHADOW_MAP_COUNT > 0
 				finalColor += ColorFromLight(lights[i], input.normal, input.worldPosition, view, surfaceColor, specularColor, roughness, metallic) * (lights[i].castsShadows ? shadowAmount[shadowIndex] : 1.0f);
+#else
+				finalColor += ColorFromLight(lights[i], input.normal, input.worldPosition, view, surfaceColor, specularColor, roughness, metallic);
+#endif
 				shadowIndex = lights[i].castsShadows ? shadowIndex + 1 : shadowIndex;
 				break;
 			}
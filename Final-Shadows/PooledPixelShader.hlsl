@@ -0,0 +1,6 @@
+// --------------------------------------------------------
+// The main pixel shader, reading material textures from the
+// shared arrays of a texture pool rather than one texture each
+// --------------------------------------------------------
+#define TEXTURE_POOL 1
+#include "PixelShader.hlsl"
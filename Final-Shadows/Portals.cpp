@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include "Portals.h"
+#include "Frustum.h"
+
+using namespace DirectX;
+
+PortalSystem::PortalSystem()
+	:
+	eye(),
+	farPlane(),
+	cameraCell(-1),
+	stats(),
+	enabled(true),
+	maxDepth(16)
+{
+}
+
+// --------------------------------------------------------
+// Loads cells and portals from a scene description file
+//
+// Returns false if the file can't be opened or is malformed,
+// in which case the system is left empty
+// --------------------------------------------------------
+bool PortalSystem::Load(const std::string& sceneFile)
+{
+	std::ifstream file(sceneFile);
+	if (!file.is_open())
+	{
+		Clear();
+		return false;
+	}
+
+	return Load(file);
+}
+
+// --------------------------------------------------------
+// Loads cells and portals from a scene description stream
+// --------------------------------------------------------
+bool PortalSystem::Load(std::istream& scene)
+{
+	Clear();
+
+	std::string line;
+	while (std::getline(scene, line))
+	{
+		std::istringstream tokens(line);
+		std::string type;
+		if (!(tokens >> type) || type[0] == '#')
+			continue;
+
+		if (type == "cell")
+		{
+			std::string name;
+			XMFLOAT3 min, max;
+			if (!(tokens >> name >> min.x >> min.y >> min.z >> max.x >> max.y >> max.z))
+			{
+				Clear();
+				return false;
+			}
+
+			BoundingBox bounds;
+			BoundingBox::CreateFromPoints(bounds, XMLoadFloat3(&min), XMLoadFloat3(&max));
+			AddCell(name, bounds);
+		}
+		else if (type == "portal")
+		{
+			std::string names[2];
+			int cellIndices[2] = { -1, -1 };
+			tokens >> names[0] >> names[1];
+			for (int c = 0; c < (int)cells.size(); c++)
+			{
+				if (cells[c].name == names[0]) cellIndices[0] = c;
+				if (cells[c].name == names[1]) cellIndices[1] = c;
+			}
+
+			std::vector<XMFLOAT3> points;
+			XMFLOAT3 point;
+			while (tokens >> point.x >> point.y >> point.z)
+				points.push_back(point);
+
+			if (cellIndices[0] == -1 || cellIndices[1] == -1 || points.size() < 3)
+			{
+				Clear();
+				return false;
+			}
+
+			AddPortal(cellIndices[0], cellIndices[1], points);
+		}
+		else
+		{
+			Clear();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Removes every cell and portal
+// --------------------------------------------------------
+void PortalSystem::Clear()
+{
+	cells.clear();
+	portals.clear();
+	visibleCells.clear();
+	cellsOnPath.clear();
+	cameraCell = -1;
+}
+
+// --------------------------------------------------------
+// Adds a cell and returns its index
+// --------------------------------------------------------
+int PortalSystem::AddCell(const std::string& name, BoundingBox bounds)
+{
+	PortalCell cell = {};
+	cell.name = name;
+	cell.bounds = bounds;
+	cells.push_back(cell);
+
+	visibleCells.resize(cells.size(), false);
+	cellsOnPath.resize(cells.size(), false);
+	return (int)cells.size() - 1;
+}
+
+// --------------------------------------------------------
+// Adds a portal between two existing cells and returns its index
+// --------------------------------------------------------
+int PortalSystem::AddPortal(int cellA, int cellB, const std::vector<XMFLOAT3>& points)
+{
+	Portal portal = {};
+	portal.cells[0] = cellA;
+	portal.cells[1] = cellB;
+	portal.points = points;
+	portals.push_back(portal);
+
+	int index = (int)portals.size() - 1;
+	cells[cellA].portals.push_back(index);
+	cells[cellB].portals.push_back(index);
+	return index;
+}
+
+// --------------------------------------------------------
+// Finds the first cell containing a point, or -1 if none do
+// --------------------------------------------------------
+int PortalSystem::FindCell(XMFLOAT3 position)
+{
+	for (int c = 0; c < (int)cells.size(); c++)
+	{
+		if (cells[c].bounds.Contains(XMLoadFloat3(&position)) != DISJOINT)
+			return c;
+	}
+
+	return -1;
+}
+
+// --------------------------------------------------------
+// Finds the cells the camera can see through the portals
+// --------------------------------------------------------
+void PortalSystem::FindVisibleCells(std::shared_ptr<Camera> camera)
+{
+	XMFLOAT4X4 view = camera->GetViewMatrix();
+	XMFLOAT4X4 proj = camera->GetProjectionMatrix();
+	FindVisibleCells(camera->GetTransform()->GetPosition(), XMLoadFloat4x4(&view) * XMLoadFloat4x4(&proj));
+}
+
+// --------------------------------------------------------
+// Finds the cells visible from an eye position within a
+// view frustum, given as a combined view-projection matrix
+// --------------------------------------------------------
+void PortalSystem::FindVisibleCells(XMFLOAT3 eyePosition, FXMMATRIX viewProj)
+{
+	stats = {};
+	std::fill(visibleCells.begin(), visibleCells.end(), false);
+	std::fill(cellsOnPath.begin(), cellsOnPath.end(), false);
+
+	eye = eyePosition;
+	cameraCell = FindCell(eye);
+	if (cameraCell == -1)
+		return;
+
+	XMFLOAT4 planes[6];
+	ExtractFrustumPlanes(viewProj, planes);
+	farPlane = planes[5];
+
+	VisitCell(cameraCell, std::vector<XMFLOAT4>(planes, planes + 6), 0);
+}
+
+// --------------------------------------------------------
+// Marks a cell as visible, then looks through each of its portals
+// that overlap the frustum into the cells on the other side
+//
+// frustum - Inward facing planes of the view narrowed by
+//           every portal on the way to this cell
+// --------------------------------------------------------
+void PortalSystem::VisitCell(int cell, const std::vector<XMFLOAT4>& frustum, int depth)
+{
+	if (!visibleCells[cell])
+		stats.cellsVisible++;
+	visibleCells[cell] = true;
+
+	if (depth >= maxDepth)
+		return;
+
+	// A cell can be seen through more than one portal, but looking
+	// back into a cell already on this path can't show anything new
+	cellsOnPath[cell] = true;
+
+	XMVECTOR eyePos = XMLoadFloat3(&eye);
+	std::vector<XMFLOAT3> clipped;
+	std::vector<XMFLOAT3> scratch;
+
+	for (int p : cells[cell].portals)
+	{
+		Portal& portal = portals[p];
+		int next = portal.cells[0] == cell ? portal.cells[1] : portal.cells[0];
+		if (cellsOnPath[next])
+			continue;
+
+		stats.portalsTested++;
+
+		// When the eye is in the portal's plane (standing in a doorway) it's
+		// edge-on and can't narrow anything, so the whole frustum carries on
+		XMVECTOR portalPlane = XMPlaneFromPoints(
+			XMLoadFloat3(&portal.points[0]),
+			XMLoadFloat3(&portal.points[1]),
+			XMLoadFloat3(&portal.points[2]));
+		float eyeDistance = XMVectorGetX(XMPlaneDotCoord(portalPlane, eyePos));
+		if (fabsf(eyeDistance) < 0.01f)
+		{
+			stats.portalsPassed++;
+			VisitCell(next, frustum, depth + 1);
+			continue;
+		}
+
+		// Cut away the parts of the portal outside the frustum
+		clipped = portal.points;
+		for (const XMFLOAT4& plane : frustum)
+		{
+			ClipPolygon(clipped, plane, &scratch);
+			clipped.swap(scratch);
+			if (clipped.size() < 3)
+				break;
+		}
+
+		if (clipped.size() < 3)
+			continue;
+
+		stats.portalsPassed++;
+
+		// The narrowed frustum is bounded by a plane through the eye and each
+		// edge of what's left of the portal, and starts at the portal itself
+		XMVECTOR centroid = XMVectorZero();
+		for (XMFLOAT3& point : clipped)
+			centroid += XMLoadFloat3(&point);
+		centroid /= (float)clipped.size();
+
+		std::vector<XMFLOAT4> narrowed;
+		for (int i = 0; i < (int)clipped.size(); i++)
+		{
+			XMVECTOR a = XMLoadFloat3(&clipped[i]);
+			XMVECTOR b = XMLoadFloat3(&clipped[(i + 1) % clipped.size()]);
+
+			// Skip edges too short to define a plane
+			if (XMVectorGetX(XMVector3LengthSq(XMVector3Cross(a - eyePos, b - eyePos))) < 1e-10f)
+				continue;
+
+			XMVECTOR plane = XMPlaneFromPoints(eyePos, a, b);
+			if (XMVectorGetX(XMPlaneDotCoord(plane, centroid)) < 0.0f)
+				plane = -plane;
+
+			XMFLOAT4 edgePlane;
+			XMStoreFloat4(&edgePlane, plane);
+			narrowed.push_back(edgePlane);
+		}
+
+		XMFLOAT4 nearPlane;
+		XMStoreFloat4(&nearPlane, eyeDistance > 0.0f ? -portalPlane : portalPlane);
+		narrowed.push_back(nearPlane);
+		narrowed.push_back(farPlane);
+
+		VisitCell(next, narrowed, depth + 1);
+	}
+
+	cellsOnPath[cell] = false;
+}
+
+// --------------------------------------------------------
+// Checks whether a sphere only touches cells that aren't visible
+// - Spheres outside of every cell are never hidden
+// --------------------------------------------------------
+bool PortalSystem::IsHidden(const BoundingSphere& sphere)
+{
+	bool inAnyCell = false;
+	for (int c = 0; c < (int)cells.size(); c++)
+	{
+		if (cells[c].bounds.Intersects(sphere))
+		{
+			if (visibleCells[c])
+				return false;
+			inAnyCell = true;
+		}
+	}
+
+	return inAnyCell;
+}
+
+// --------------------------------------------------------
+// Clips a convex polygon to the positive side of a plane
+// (Sutherland-Hodgman)
+// --------------------------------------------------------
+void PortalSystem::ClipPolygon(const std::vector<XMFLOAT3>& polygon, XMFLOAT4 plane, std::vector<XMFLOAT3>* clipped)
+{
+	clipped->clear();
+	XMVECTOR p = XMLoadFloat4(&plane);
+
+	for (int i = 0; i < (int)polygon.size(); i++)
+	{
+		XMVECTOR a = XMLoadFloat3(&polygon[i]);
+		XMVECTOR b = XMLoadFloat3(&polygon[(i + 1) % polygon.size()]);
+		float da = XMVectorGetX(XMPlaneDotCoord(p, a));
+		float db = XMVectorGetX(XMPlaneDotCoord(p, b));
+
+		if (da >= 0.0f)
+			clipped->push_back(polygon[i]);
+
+		// The edge crosses the plane, so keep the point where it does
+		if ((da >= 0.0f) != (db >= 0.0f))
+		{
+			XMFLOAT3 crossing;
+			XMStoreFloat3(&crossing, XMVectorLerp(a, b, da / (da - db)));
+			clipped->push_back(crossing);
+		}
+	}
+}
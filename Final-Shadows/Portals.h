@@ -0,0 +1,138 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Camera.h"
+
+// --------------------------------------------------------
+// A convex region of an indoor level
+// --------------------------------------------------------
+struct PortalCell
+{
+	std::string name;
+	DirectX::BoundingBox bounds;
+	std::vector<int> portals;		// Indices of the portals leading out of this cell
+};
+
+// --------------------------------------------------------
+// A convex opening connecting two cells
+// --------------------------------------------------------
+struct Portal
+{
+	int cells[2];
+	std::vector<DirectX::XMFLOAT3> points;		// Polygon corners, in order around its edge
+};
+
+// --------------------------------------------------------
+// Counts of the work done finding visible cells this frame
+// --------------------------------------------------------
+struct PortalStats
+{
+	int cellsVisible;
+	int portalsTested;
+	int portalsPassed;
+	int entitiesCulled;
+};
+
+// --------------------------------------------------------
+// Cell and portal visibility for indoor scenes
+//
+// Starting from the cell the camera is in, the view frustum is
+// narrowed through each portal polygon it can see, and the cells
+// behind them are visited recursively with the narrowed frustum.
+// Entities are only drawn if they touch a visible cell.
+// Anything with a GetWorldBoundingSphere() can be filtered,
+// so the traversal doesn't need the renderer at all.
+//
+// Scenes are described in a text file, one item per line:
+//   cell <name> <minX> <minY> <minZ> <maxX> <maxY> <maxZ>
+//   portal <cellA> <cellB> <x> <y> <z> <x> <y> <z> <x> <y> <z> ...
+// Lines starting with # are comments
+// --------------------------------------------------------
+class PortalSystem
+{
+public:
+	PortalSystem();
+
+	bool Load(const std::string& sceneFile);
+	bool Load(std::istream& scene);
+	void Clear();
+
+	int AddCell(const std::string& name, DirectX::BoundingBox bounds);
+	int AddPortal(int cellA, int cellB, const std::vector<DirectX::XMFLOAT3>& points);
+
+	void FindVisibleCells(std::shared_ptr<Camera> camera);
+	void FindVisibleCells(DirectX::XMFLOAT3 eye, DirectX::FXMMATRIX viewProj);
+	template<typename Entity>
+	void FilterEntities(
+		const std::vector<std::shared_ptr<Entity>>& entities,
+		std::vector<int>* visibleEntities);
+
+	bool IsLoaded() { return cells.size() > 0; }
+	bool IsCellVisible(int cell) { return cell >= 0 && cell < (int)visibleCells.size() && visibleCells[cell]; }
+	int FindCell(DirectX::XMFLOAT3 position);
+	int GetCameraCell() { return cameraCell; }
+	const std::vector<PortalCell>& GetCells() { return cells; }
+	const std::vector<Portal>& GetPortals() { return portals; }
+	const PortalStats& GetStats() { return stats; }
+	bool GetEnabled() { return enabled; }
+	int GetMaxDepth() { return maxDepth; }
+
+	void SetEnabled(bool e) { enabled = e; }
+	void SetMaxDepth(int depth) { maxDepth = depth; }
+
+private:
+	void VisitCell(int cell, const std::vector<DirectX::XMFLOAT4>& frustum, int depth);
+	bool IsHidden(const DirectX::BoundingSphere& sphere);
+	static void ClipPolygon(
+		const std::vector<DirectX::XMFLOAT3>& polygon,
+		DirectX::XMFLOAT4 plane,
+		std::vector<DirectX::XMFLOAT3>* clipped);
+
+	std::vector<PortalCell> cells;
+	std::vector<Portal> portals;
+
+	// Traversal state for the current frame
+	DirectX::XMFLOAT3 eye;
+	DirectX::XMFLOAT4 farPlane;
+	int cameraCell;
+	std::vector<bool> visibleCells;
+	std::vector<bool> cellsOnPath;
+
+	PortalStats stats;
+	bool enabled;
+	int maxDepth;
+};
+
+// --------------------------------------------------------
+// Removes entities that only touch cells the camera can't see
+// - Entities outside of every cell are left alone, as are all
+//   entities when the camera itself is outside of every cell
+// --------------------------------------------------------
+template<typename Entity>
+void PortalSystem::FilterEntities(
+	const std::vector<std::shared_ptr<Entity>>& entities,
+	std::vector<int>* visibleEntities)
+{
+	if (!enabled || cameraCell == -1)
+		return;
+
+	int kept = 0;
+	for (int v = 0; v < (int)visibleEntities->size(); v++)
+	{
+		int index = (*visibleEntities)[v];
+		if (IsHidden(entities[index]->GetWorldBoundingSphere()))
+		{
+			stats.entitiesCulled++;
+			continue;
+		}
+
+		(*visibleEntities)[kept++] = index;
+	}
+
+	visibleEntities->resize(kept);
+}
@@ -0,0 +1,93 @@
+#include "RecordingWorkers.h"
+
+RecordingWorkers::RecordingWorkers(int threadCount)
+	:
+	jobCount(0),
+	nextJob(0),
+	batch(0),
+	busyWorkers(0),
+	quitting(false)
+{
+	if (threadCount <= 0)
+		threadCount = (int)std::thread::hardware_concurrency();
+
+	// The calling thread is the first one
+	for (int t = 1; t < threadCount; t++)
+		threads.push_back(std::thread(&RecordingWorkers::WorkerLoop, this));
+}
+
+RecordingWorkers::~RecordingWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quitting = true;
+	}
+	wake.notify_all();
+
+	for (auto& t : threads)
+		t.join();
+}
+
+// --------------------------------------------------------
+// Runs job(0) through job(jobCount - 1) spread across every
+// thread, returning once all of them are done
+// --------------------------------------------------------
+void RecordingWorkers::Run(int count, std::function<void(int)> fn)
+{
+	if (threads.empty())
+	{
+		for (int j = 0; j < count; j++)
+			fn(j);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = fn;
+		jobCount = count;
+		nextJob = 0;
+		busyWorkers = (int)threads.size();
+		batch++;
+	}
+	wake.notify_all();
+
+	RunJobs();
+
+	// Every worker has to check in, even ones that found nothing
+	// left to do, before the batch can be replaced
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [this]() { return busyWorkers == 0; });
+	job = nullptr;
+}
+
+// --------------------------------------------------------
+// Waits for each new batch and helps work through it
+// --------------------------------------------------------
+void RecordingWorkers::WorkerLoop()
+{
+	unsigned long long lastBatch = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]() { return quitting || batch != lastBatch; });
+			if (quitting)
+				return;
+			lastBatch = batch;
+		}
+
+		RunJobs();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busyWorkers--;
+		}
+		finished.notify_one();
+	}
+}
+
+void RecordingWorkers::RunJobs()
+{
+	for (int j = nextJob++; j < jobCount; j = nextJob++)
+		job(j);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// A fixed set of threads for running a batch of independent
+// jobs and waiting until they've all finished
+//
+// Jobs are handed out one at a time in index order, and the
+// calling thread works through them too rather than sitting
+// idle. Which thread runs a job changes from batch to batch,
+// so a job should only write to data owned by its own index.
+// --------------------------------------------------------
+class RecordingWorkers
+{
+public:
+	// threadCount includes the calling thread - 0 uses every hardware thread
+	RecordingWorkers(int threadCount = 0);
+	~RecordingWorkers();
+
+	void Run(int jobCount, std::function<void(int)> job);
+
+	int GetThreadCount() { return (int)threads.size() + 1; }
+
+private:
+	void WorkerLoop();
+	void RunJobs();
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+
+	// The batch being run, only changed while every worker is waiting
+	std::function<void(int)> job;
+	int jobCount;
+	std::atomic<int> nextJob;
+	unsigned long long batch;
+	int busyWorkers;
+	bool quitting;
+};
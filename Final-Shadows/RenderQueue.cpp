@@ -0,0 +1,165 @@
+#include <string.h>
+#include "RenderQueue.h"
+
+#define DEPTH_MASK 0xFFFFFFull
+
+RenderQueue::RenderQueue()
+	:
+	stats()
+{
+}
+
+// --------------------------------------------------------
+// Removes every packet, ready for the next frame
+// - Ids given to shaders, materials and meshes are kept
+// --------------------------------------------------------
+void RenderQueue::Clear()
+{
+	packets.clear();
+}
+
+// --------------------------------------------------------
+// Forgets every id given out, such as after materials or
+// meshes are recreated, so the old ones don't use them up
+// - Only call between frames, as keys made before and after
+//   can't be compared
+// --------------------------------------------------------
+void RenderQueue::ResetIds()
+{
+	shaderIds.clear();
+	materialIds.clear();
+	meshIds.clear();
+}
+
+void RenderQueue::Submit(unsigned long long key, int entity)
+{
+	RenderPacket packet = {};
+	packet.key = key;
+	packet.entity = entity;
+	packets.push_back(packet);
+}
+
+// --------------------------------------------------------
+// Builds a sort key for one draw
+//
+// pass  - Which pass the draw is part of, as only 4 bits are kept
+// depth - Distance from the camera scaled to 0-1, such as
+//         view space depth over the far clip distance
+// --------------------------------------------------------
+unsigned long long RenderQueue::MakeKey(
+	unsigned int pass,
+	const void* vertexShader,
+	const void* pixelShader,
+	const void* material,
+	const void* mesh,
+	float depth)
+{
+	// Shaders are only ever bound as a pair, so the pair gets one id
+	std::pair<const void*, const void*> shaders(vertexShader, pixelShader);
+
+	depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+
+	return
+		((unsigned long long)(pass & 0xF) << PassShift) |
+		((unsigned long long)FindId(&shaderIds, shaders) << ShaderShift) |
+		((unsigned long long)FindId(&materialIds, material) << MaterialShift) |
+		((unsigned long long)FindId(&meshIds, mesh) << MeshShift) |
+		((unsigned long long)(depth * DEPTH_MASK) & DEPTH_MASK);
+}
+
+// --------------------------------------------------------
+// Finds the id given to an object, giving it the next one
+// if it hasn't been seen before
+// - Only 4096 ids fit in a key, so once all but the last are
+//   taken, everything new shares OverflowId and isn't remembered
+// --------------------------------------------------------
+template<typename T> unsigned int RenderQueue::FindId(std::map<T, unsigned int>* ids, const T& object)
+{
+	auto it = ids->find(object);
+	if (it != ids->end())
+		return it->second;
+
+	if (ids->size() >= OverflowId)
+		return OverflowId;
+
+	unsigned int id = (unsigned int)ids->size();
+	ids->insert(std::make_pair(object, id));
+	return id;
+}
+
+// --------------------------------------------------------
+// Sorts the submitted packets by key and counts the state
+// changes drawing them in that order will need
+// --------------------------------------------------------
+void RenderQueue::Sort()
+{
+	RadixSort(&packets, &scratch);
+
+	stats = {};
+	stats.packets = (int)packets.size();
+	for (size_t i = 0; i < packets.size(); i++)
+	{
+		unsigned long long previous = i == 0 ? ~packets[i].key : packets[i - 1].key;
+		if (ShadersDiffer(previous, packets[i].key)) stats.shaderChanges++;
+		if (MaterialsDiffer(previous, packets[i].key)) stats.materialChanges++;
+		if (MeshesDiffer(previous, packets[i].key)) stats.meshChanges++;
+	}
+}
+
+// --------------------------------------------------------
+// Stable least significant digit radix sort on packet keys
+//
+// Counts for all eight bytes are gathered in a single pass over
+// the packets. Bytes that are the same in every key (such as
+// the pass, usually) are skipped entirely.
+//
+// scratch - Working space, which is resized as needed and can
+//           be kept between calls to avoid reallocating
+// --------------------------------------------------------
+void RenderQueue::RadixSort(std::vector<RenderPacket>* packets, std::vector<RenderPacket>* scratch)
+{
+	size_t count = packets->size();
+	if (count < 2)
+		return;
+
+	size_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (const RenderPacket& packet : *packets)
+	{
+		for (int b = 0; b < 8; b++)
+			histograms[b][(packet.key >> (b * 8)) & 0xFF]++;
+	}
+
+	scratch->resize(count);
+	RenderPacket* source = packets->data();
+	RenderPacket* dest = scratch->data();
+
+	for (int b = 0; b < 8; b++)
+	{
+		size_t* histogram = histograms[b];
+
+		// Every key has the same byte here, so the order can't change
+		if (histogram[(source[0].key >> (b * 8)) & 0xFF] == count)
+			continue;
+
+		// Turn the counts into where each byte value's packets start
+		size_t offset = 0;
+		for (int i = 0; i < 256; i++)
+		{
+			size_t bucketCount = histogram[i];
+			histogram[i] = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+			dest[histogram[(source[i].key >> (b * 8)) & 0xFF]++] = source[i];
+
+		RenderPacket* swap = source;
+		source = dest;
+		dest = swap;
+	}
+
+	// An odd number of passes leaves the results in the scratch space
+	if (source != packets->data())
+		packets->swap(*scratch);
+}
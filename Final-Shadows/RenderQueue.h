@@ -0,0 +1,107 @@
+#pragma once
+
+#include <map>
+#include <utility>
+#include <vector>
+
+// --------------------------------------------------------
+// One draw waiting in a render queue
+// --------------------------------------------------------
+struct RenderPacket
+{
+	unsigned long long key;
+	int entity;			// Index into the entity list
+};
+
+// --------------------------------------------------------
+// How often consecutive packets differ, once sorted
+// --------------------------------------------------------
+struct RenderQueueStats
+{
+	int packets;
+	int shaderChanges;
+	int materialChanges;
+	int meshChanges;
+};
+
+// --------------------------------------------------------
+// Orders a pass's draws to keep state changes down
+//
+// Each draw is submitted with a 64 bit key. From the most
+// significant bits down, the key holds:
+//   pass      4 bits
+//   shaders  12 bits
+//   material 12 bits
+//   mesh     12 bits
+//   depth    24 bits
+// so sorting groups draws by pass, then shaders, then material
+// and mesh, and draws sharing all of those go front to back.
+//
+// Shaders, materials and meshes are given small ids the first
+// time they're seen, which stay the same from frame to frame
+// until ResetIds(). Once a field's ids run out, the rest share
+// an overflow id that never counts as the same object, so
+// they're drawn correctly, just without skipping state changes.
+// Keys are sorted with an LSD radix sort, one byte at a time.
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	void Clear();
+	void ResetIds();
+	void Submit(unsigned long long key, int entity);
+	void Sort();
+
+	unsigned long long MakeKey(
+		unsigned int pass,
+		const void* vertexShader,
+		const void* pixelShader,
+		const void* material,
+		const void* mesh,
+		float depth);
+
+	const std::vector<RenderPacket>& GetPackets() { return packets; }
+	const RenderQueueStats& GetStats() { return stats; }
+
+	// Whether two keys differ in the given field or any above it,
+	// counting overflow ids as different from everything
+	static bool ShadersDiffer(unsigned long long a, unsigned long long b)
+	{
+		return (a ^ b) >> ShaderShift != 0 || IsOverflow(a, ShaderShift);
+	}
+	static bool MaterialsDiffer(unsigned long long a, unsigned long long b)
+	{
+		return ShadersDiffer(a, b) || (a ^ b) >> MaterialShift != 0 || IsOverflow(a, MaterialShift);
+	}
+	static bool MeshesDiffer(unsigned long long a, unsigned long long b)
+	{
+		return MaterialsDiffer(a, b) || (a ^ b) >> MeshShift != 0 || IsOverflow(a, MeshShift);
+	}
+
+	static void RadixSort(std::vector<RenderPacket>* packets, std::vector<RenderPacket>* scratch);
+
+	// Bit positions of each field in a key
+	static const unsigned int PassShift = 60;
+	static const unsigned int ShaderShift = 48;
+	static const unsigned int MaterialShift = 36;
+	static const unsigned int MeshShift = 24;
+	static const unsigned int DepthBits = 24;
+
+	// Each 12 bit field's last id, shared by everything seen after the rest ran out
+	static const unsigned int OverflowId = 0xFFF;
+	static bool IsOverflow(unsigned long long key, unsigned int shift) { return ((key >> shift) & OverflowId) == OverflowId; }
+
+private:
+	template<typename T> static unsigned int FindId(std::map<T, unsigned int>* ids, const T& object);
+
+	std::vector<RenderPacket> packets;
+	std::vector<RenderPacket> scratch;
+
+	std::map<std::pair<const void*, const void*>, unsigned int> shaderIds;
+	std::map<const void*, unsigned int> materialIds;
+	std::map<const void*, unsigned int> meshIds;
+
+	RenderQueueStats stats;
+};
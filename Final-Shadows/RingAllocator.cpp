@@ -0,0 +1,118 @@
+#include "RingAllocator.h"
+
+// --------------------------------------------------------
+// capacity  - Total bytes in the ring
+// alignment - Every allocation starts on a multiple of this,
+//             which must be a power of two
+// --------------------------------------------------------
+RingAllocator::RingAllocator(size_t capacity, size_t alignment)
+	:
+	capacity(capacity),
+	alignment(alignment),
+	head(0),
+	tail(0),
+	used(0),
+	frameSize(0),
+	wrapCount(0)
+{
+}
+
+// --------------------------------------------------------
+// Finds space for an allocation in the current frame
+//
+// Returns false when there isn't enough room between the head
+// and the oldest frame still in flight, in which case nothing
+// changes and the caller has to wait for a fence or Reset()
+// --------------------------------------------------------
+bool RingAllocator::Allocate(size_t size, size_t* offset)
+{
+	size_t aligned = Align(size);
+	if (aligned == 0 || aligned > capacity)
+		return false;
+
+	// An empty ring can start over from the beginning, which
+	// avoids skipping space just because the head is near the end
+	if (used == 0)
+	{
+		head = 0;
+		tail = 0;
+	}
+
+	size_t allocated = 0;
+	if (head >= tail && used < capacity)
+	{
+		// Free space runs from the head to the end, then from 0 to the tail
+		if (head + aligned <= capacity)
+		{
+			*offset = head;
+			allocated = aligned;
+		}
+		else if (aligned <= tail)
+		{
+			*offset = 0;
+			allocated = capacity - head + aligned;
+			wrapCount++;
+		}
+	}
+	else if (head < tail && head + aligned <= tail)
+	{
+		// Free space is only the gap between the head and the tail
+		*offset = head;
+		allocated = aligned;
+	}
+
+	if (allocated == 0)
+		return false;
+
+	head = (*offset + aligned) % capacity;
+	used += allocated;
+	frameSize += allocated;
+	return true;
+}
+
+// --------------------------------------------------------
+// Closes the current frame, tagging everything allocated
+// since the last call with the given fence value
+// - Fences are expected to increase from frame to frame
+// --------------------------------------------------------
+void RingAllocator::EndFrame(unsigned long long fence)
+{
+	if (frameSize == 0)
+		return;
+
+	Frame frame = {};
+	frame.fence = fence;
+	frame.size = frameSize;
+	frame.end = head;
+	frames.push_back(frame);
+
+	frameSize = 0;
+}
+
+// --------------------------------------------------------
+// Frees the space of every frame tagged with a fence up to
+// and including the completed one
+// --------------------------------------------------------
+void RingAllocator::Retire(unsigned long long completedFence)
+{
+	while (!frames.empty() && frames.front().fence <= completedFence)
+	{
+		used -= frames.front().size;
+		tail = frames.front().end;
+		frames.pop_front();
+	}
+}
+
+// --------------------------------------------------------
+// Forgets every allocation, including those still in flight
+// - Only safe once nothing reads the old contents, like after
+//   the underlying buffer has been replaced
+// --------------------------------------------------------
+void RingAllocator::Reset()
+{
+	head = 0;
+	tail = 0;
+	used = 0;
+	frameSize = 0;
+	frames.clear();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+
+// --------------------------------------------------------
+// Sub-allocates space from a fixed size ring, such as an
+// upload buffer the GPU reads from a few frames behind the CPU
+//
+// Allocations are made at the head and grouped into frames.
+// Each frame is tagged with a fence value when it ends, and its
+// space is only handed out again once that fence is retired -
+// the caller decides what a fence is (a frame number the GPU
+// has finished with, for instance).
+//
+// When an allocation doesn't fit before the end of the ring, the
+// leftover space at the end is skipped and it starts again at 0.
+// The skipped bytes belong to the current frame and are freed
+// along with it.
+//
+// This is plain bookkeeping with no graphics API calls, so it
+// can be exercised on its own
+// --------------------------------------------------------
+class RingAllocator
+{
+public:
+	RingAllocator(size_t capacity, size_t alignment);
+
+	bool Allocate(size_t size, size_t* offset);
+	void EndFrame(unsigned long long fence);
+	void Retire(unsigned long long completedFence);
+	void Reset();
+
+	size_t GetCapacity() { return capacity; }
+	size_t GetAlignment() { return alignment; }
+	size_t GetUsed() { return used; }
+	size_t GetHead() { return head; }
+	size_t GetTail() { return tail; }
+	size_t GetFramesInFlight() { return frames.size(); }
+	unsigned int GetWrapCount() { return wrapCount; }
+
+	size_t Align(size_t size) { return (size + alignment - 1) / alignment * alignment; }
+
+private:
+	// Space allocated in one frame that can't be reused until its fence is retired
+	struct Frame
+	{
+		unsigned long long fence;
+		size_t size;
+		size_t end;
+	};
+
+	size_t capacity;
+	size_t alignment;
+	size_t head;			// Where the next allocation starts
+	size_t tail;			// Start of the oldest space still in use
+	size_t used;			// Bytes between tail and head, including any skipped at the end
+	size_t frameSize;		// Bytes allocated since the last EndFrame()
+	unsigned int wrapCount;
+	std::deque<Frame> frames;
+};
@@ -0,0 +1,145 @@
+#include <string.h>
+#include "ShaderConstants.h"
+
+bool ShaderConstants::CompareOnSet = true;
+
+void CopyingConstantBufferDevice::UpdateConstantBuffer(unsigned int index, const void* data, unsigned int size)
+{
+	if (index >= buffers.size())
+		buffers.resize(index + 1);
+
+	buffers[index].resize(size);
+	memcpy(buffers[index].data(), data, size);
+	uploadCount++;
+	uploadBytes += size;
+}
+
+// --------------------------------------------------------
+// Sets up a zeroed copy of each reflected buffer, all of
+// which need uploading before they're first used
+// --------------------------------------------------------
+void ShaderConstants::Init(const ShaderReflection& reflection)
+{
+	Clear();
+
+	buffers.resize(reflection.ConstantBuffers.size());
+	for (unsigned int b = 0; b < buffers.size(); b++)
+	{
+		const ReflectedConstantBuffer& cb = reflection.ConstantBuffers[b];
+		buffers[b].Size = cb.Size;
+		buffers[b].LayoutHash = ShaderReflection::LayoutHash(cb);
+		buffers[b].Data.assign(cb.Size, 0);
+		buffers[b].Dirty = true;
+		bufferTable.insert(std::make_pair(cb.Name, b));
+
+		for (auto& var : cb.Variables)
+		{
+			SimpleShaderVariable variable = {};
+			variable.ConstantBufferIndex = b;
+			variable.ByteOffset = var.ByteOffset;
+			variable.Size = var.Size;
+			varTable.insert(std::make_pair(var.Name, variable));
+		}
+	}
+}
+
+void ShaderConstants::Clear()
+{
+	buffers.clear();
+	bufferTable.clear();
+	varTable.clear();
+}
+
+int ShaderConstants::FindBuffer(const std::string& name) const
+{
+	auto result = bufferTable.find(name);
+	return result == bufferTable.end() ? -1 : (int)result->second;
+}
+
+const SimpleShaderVariable* ShaderConstants::FindVariable(const std::string& name) const
+{
+	auto result = varTable.find(name);
+	return result == varTable.end() ? 0 : &result->second;
+}
+
+SimpleShaderVariableHandle ShaderConstants::GetVariableHandle(const std::string& name) const
+{
+	SimpleShaderVariableHandle handle;
+	const SimpleShaderVariable* var = FindVariable(name);
+	if (var == 0)
+		return handle;
+
+	handle.ByteOffset = var->ByteOffset;
+	handle.Size = var->Size;
+	handle.ConstantBufferIndex = var->ConstantBufferIndex;
+	return handle;
+}
+
+// --------------------------------------------------------
+// A handle covering a whole buffer, for setting it from a
+// struct generated to match its layout
+// --------------------------------------------------------
+SimpleShaderVariableHandle ShaderConstants::GetBufferHandle(unsigned int index, unsigned int layoutHash) const
+{
+	SimpleShaderVariableHandle handle;
+	if (index >= buffers.size() || buffers[index].LayoutHash != layoutHash)
+		return handle;
+
+	handle.ByteOffset = 0;
+	handle.Size = buffers[index].Size;
+	handle.ConstantBufferIndex = index;
+	return handle;
+}
+
+bool ShaderConstants::SetData(const std::string& name, const void* data, unsigned int size)
+{
+	return SetData(GetVariableHandle(name), data, size);
+}
+
+// --------------------------------------------------------
+// Copies data into a variable, which can be smaller than the
+// variable, such as part of an array
+// --------------------------------------------------------
+bool ShaderConstants::SetData(SimpleShaderVariableHandle handle, const void* data, unsigned int size)
+{
+	// Invalid handles come from variables that don't exist in this shader
+	if (!handle.IsValid() || handle.ConstantBufferIndex >= buffers.size() || size > handle.Size)
+		return false;
+
+	// Nothing changes if the variable already holds this data
+	Buffer& cb = buffers[handle.ConstantBufferIndex];
+	unsigned char* dest = cb.Data.data() + handle.ByteOffset;
+	if (CompareOnSet && memcmp(dest, data, size) == 0)
+		return true;
+
+	memcpy(dest, data, size);
+	cb.Dirty = true;
+	return true;
+}
+
+void ShaderConstants::MarkAllDirty()
+{
+	for (auto& cb : buffers)
+		cb.Dirty = true;
+}
+
+void ShaderConstants::Upload(unsigned int index, IConstantBufferDevice* device)
+{
+	Buffer& cb = buffers[index];
+	device->UpdateConstantBuffer(index, cb.Data.data(), cb.Size);
+	cb.Dirty = false;
+}
+
+unsigned int ShaderConstants::UploadDirty(IConstantBufferDevice* device)
+{
+	unsigned int uploads = 0;
+	for (unsigned int i = 0; i < buffers.size(); i++)
+	{
+		if (!buffers[i].Dirty)
+			continue;
+
+		Upload(i, device);
+		uploads++;
+	}
+	return uploads;
+}
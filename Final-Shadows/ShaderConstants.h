@@ -0,0 +1,128 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ShaderReflection.h"
+
+// --------------------------------------------------------
+// Used by simple shaders to store information about
+// specific variables in constant buffers
+// --------------------------------------------------------
+struct SimpleShaderVariable
+{
+	unsigned int ByteOffset;
+	unsigned int Size;
+	unsigned int ConstantBufferIndex;
+};
+
+// --------------------------------------------------------
+// A shader variable looked up ahead of time, so it can
+// be set over and over without searching for its name
+// - Only valid for the shader it was retrieved from
+// --------------------------------------------------------
+struct SimpleShaderVariableHandle
+{
+	unsigned int ByteOffset = 0;
+	unsigned int Size = 0;
+	unsigned int ConstantBufferIndex = 0;
+
+	bool IsValid() const { return Size > 0; }
+};
+
+// --------------------------------------------------------
+// Wherever constant buffer data goes once it's been packed,
+// which for a shader is its GPU buffers
+// --------------------------------------------------------
+class IConstantBufferDevice
+{
+public:
+	virtual ~IConstantBufferDevice() {}
+
+	virtual void UpdateConstantBuffer(unsigned int index, const void* data, unsigned int size) = 0;
+};
+
+// --------------------------------------------------------
+// Stand-in device that copies each upload into memory of
+// its own, as mapping a real buffer would, and counts them
+// --------------------------------------------------------
+class CopyingConstantBufferDevice : public IConstantBufferDevice
+{
+public:
+	CopyingConstantBufferDevice() : uploadCount(0), uploadBytes(0) {}
+
+	void UpdateConstantBuffer(unsigned int index, const void* data, unsigned int size);
+
+	const std::vector<unsigned char>& GetBuffer(unsigned int index) { return buffers[index]; }
+	unsigned int GetUploadCount() { return uploadCount; }
+	unsigned int GetUploadBytes() { return uploadBytes; }
+
+private:
+	std::vector<std::vector<unsigned char>> buffers;
+	unsigned int uploadCount;
+	unsigned int uploadBytes;
+};
+
+// --------------------------------------------------------
+// The CPU side copies of a shader's constant buffers, laid
+// out as reflection says, with the variables in them
+//
+// Variables are set by name or through handles, and each
+// buffer remembers whether it's changed since it was last
+// uploaded. Uploads go through a device interface, so the
+// packing can be checked and timed without Direct3D -
+// SimpleShader uploads its buffers to the GPU through one
+// --------------------------------------------------------
+class ShaderConstants
+{
+public:
+	ShaderConstants() {}
+
+	void Init(const ShaderReflection& reflection);
+	void Clear();
+
+	unsigned int GetBufferCount() const { return (unsigned int)buffers.size(); }
+	unsigned int GetBufferSize(unsigned int index) const { return buffers[index].Size; }
+	unsigned int GetLayoutHash(unsigned int index) const { return buffers[index].LayoutHash; }
+	const unsigned char* GetBufferData(unsigned int index) const { return buffers[index].Data.data(); }
+
+	// Index of a buffer, or -1 if there isn't one by that name
+	int FindBuffer(const std::string& name) const;
+	const SimpleShaderVariable* FindVariable(const std::string& name) const;
+
+	// Invalid handles (which setters ignore) for anything that
+	// doesn't exist, or buffers that don't have the given layout
+	SimpleShaderVariableHandle GetVariableHandle(const std::string& name) const;
+	SimpleShaderVariableHandle GetBufferHandle(unsigned int index, unsigned int layoutHash) const;
+
+	// Both return false for unknown variables and data that's too big
+	bool SetData(const std::string& name, const void* data, unsigned int size);
+	bool SetData(SimpleShaderVariableHandle handle, const void* data, unsigned int size);
+
+	bool IsDirty(unsigned int index) const { return buffers[index].Dirty; }
+	void MarkDirty(unsigned int index) { buffers[index].Dirty = true; }
+	void MarkAllDirty();
+
+	// Sends a buffer to the device whether it's changed or not
+	void Upload(unsigned int index, IConstantBufferDevice* device);
+
+	// Sends only the buffers that changed, returning how many
+	unsigned int UploadDirty(IConstantBufferDevice* device);
+
+	// Skips setting values that are already there, so a buffer
+	// only needs uploading when something actually changed
+	static bool CompareOnSet;
+
+private:
+	struct Buffer
+	{
+		unsigned int Size;
+		unsigned int LayoutHash;	// From ShaderReflection::LayoutHash()
+		std::vector<unsigned char> Data;
+		bool Dirty;		// Data has changed since it was last uploaded
+	};
+
+	std::vector<Buffer> buffers;
+	std::unordered_map<std::string, unsigned int> bufferTable;
+	std::unordered_map<std::string, SimpleShaderVariable> varTable;
+};
@@ -61,6 +61,26 @@ struct VertexShaderInput
 	float2 uv				: TEXCOORD;
 };
 
+// The same vertex, along with the matrices of the instance being drawn
+// - Semantics ending in _PER_INSTANCE are read from the second vertex buffer,
+//   which holds each instance's world then inverse transpose world matrix
+// - Rows are given one at a time, in the same order as the C++ matrices
+struct InstancedVertexShaderInput
+{
+	float3 localPosition	: POSITION;
+	float3 normal			: NORMAL;
+	float3 tangent			: TANGENT;
+	float2 uv				: TEXCOORD;
+	float4 world0			: WORLD_PER_INSTANCE0;
+	float4 world1			: WORLD_PER_INSTANCE1;
+	float4 world2			: WORLD_PER_INSTANCE2;
+	float4 world3			: WORLD_PER_INSTANCE3;
+	float4 worldInvTranspose0	: WORLDINVTRANSPOSE_PER_INSTANCE0;
+	float4 worldInvTranspose1	: WORLDINVTRANSPOSE_PER_INSTANCE1;
+	float4 worldInvTranspose2	: WORLDINVTRANSPOSE_PER_INSTANCE2;
+	float4 worldInvTranspose3	: WORLDINVTRANSPOSE_PER_INSTANCE3;
+};
+
 // Struct representing the data we're sending down the pipeline
 // - Should match our pixel shader's input (hence the name: Vertex to Pixel)
 // - At a minimum, we need a piece of data defined tagged as SV_POSITION
@@ -78,7 +98,6 @@ struct VertexToPixel
 	float3 normal			: NORMAL;
 	float3 tangent			: TANGENT;
 	float3 worldPosition	: POSITION;
-	float4 shadowPositions[MAX_NUM_SHADOW_MAPS]	: SHADOW_POSITION;
 };
 
 struct VertexToPixelSky
@@ -87,6 +106,19 @@ struct VertexToPixelSky
 	float3 sampleDir	: DIRECTION;
 };
 
+// Local position to screen position, shared by every vertex shader
+// drawing into the main depth buffer
+// - The depth pre-pass and the main pass use different shaders but
+//   test with EQUAL, so both must come up with the same depth to the
+//   bit. precise keeps the compiler from reordering the math
+//   differently in each one
+float4 ProjectToScreen(matrix world, matrix view, matrix proj, float3 localPosition)
+{
+	precise matrix wvp = mul(proj, mul(view, world));
+	precise float4 screenPosition = mul(wvp, float4(localPosition, 1.0f));
+	return screenPosition;
+}
+
 float3 LightenToGamma(float3 color) { return pow(color, 1/2.2f); }
 float3 DarkenToGamma(float3 color) { return pow(color, 2.2f); }
 
@@ -0,0 +1,217 @@
+#include <fstream>
+#include <set>
+#include <sstream>
+#include "ShaderLayoutGenerator.h"
+
+// --------------------------------------------------------
+// How an HLSL type is written in C++
+// - Size is 0 for types with no fixed C++ equivalent, which
+//   are written out as bytes instead
+// --------------------------------------------------------
+struct LayoutType
+{
+	const char* HLSLName;
+	const char* CPPName;
+	unsigned int Size;
+};
+
+static const LayoutType LayoutTypes[] =
+{
+	{ "float",		"float",					4 },
+	{ "float2",		"DirectX::XMFLOAT2",		8 },
+	{ "float3",		"DirectX::XMFLOAT3",		12 },
+	{ "float4",		"DirectX::XMFLOAT4",		16 },
+	{ "float4x4",	"DirectX::XMFLOAT4X4",		64 },
+	{ "matrix",		"DirectX::XMFLOAT4X4",		64 },
+	{ "int",		"int",						4 },
+	{ "int2",		"DirectX::XMINT2",			8 },
+	{ "int3",		"DirectX::XMINT3",			12 },
+	{ "int4",		"DirectX::XMINT4",			16 },
+	{ "uint",		"unsigned int",				4 },
+	{ "uint2",		"DirectX::XMUINT2",			8 },
+	{ "uint3",		"DirectX::XMUINT3",			12 },
+	{ "uint4",		"DirectX::XMUINT4",			16 },
+	{ "bool",		"int",						4 },	// HLSL bools are 4 bytes
+};
+
+static const LayoutType* FindLayoutType(const std::string& hlslName)
+{
+	for (auto& type : LayoutTypes)
+	{
+		if (hlslName == type.HLSLName)
+			return &type;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// Size of one element of a variable, and the distance from
+// one element to the next
+// - Every element of a cbuffer array starts on a 16 byte
+//   boundary, so all but the last are rounded up to it
+// --------------------------------------------------------
+static void GetElementSize(const ReflectedVariable& var, unsigned int* size, unsigned int* stride)
+{
+	if (var.Elements == 0)
+	{
+		*size = var.Size;
+		*stride = var.Size;
+		return;
+	}
+
+	*stride = ((var.Size + 15) / 16) * 16 / var.Elements;
+	*size = var.Size - *stride * (var.Elements - 1);
+}
+
+static std::string AssertMessage(const std::string& structName, const std::string& what)
+{
+	return "\"" + structName + " " + what + " doesn't match the shader - regenerate ShaderLayouts.h\"";
+}
+
+// --------------------------------------------------------
+// Checks that a C++ struct used inside a buffer lines up with
+// the HLSL struct of the same name
+// --------------------------------------------------------
+static void WriteStructChecks(std::ostream& out, const ReflectedVariable& var)
+{
+	unsigned int size, stride;
+	GetElementSize(var, &size, &stride);
+
+	out << "static_assert(sizeof(" << var.TypeName << ") == " << size << ", "
+		<< AssertMessage(var.TypeName, "size") << ");\n";
+	for (auto& member : var.Members)
+	{
+		out << "static_assert(offsetof(" << var.TypeName << ", " << member.Name << ") == " << member.ByteOffset << ", "
+			<< AssertMessage(var.TypeName + "::" + member.Name, "offset") << ");\n";
+	}
+	out << "\n";
+}
+
+// --------------------------------------------------------
+// One member of a generated struct
+// - Arrays only map straight across when each element fills
+//   its 16 byte slot, since C++ packs them tighter than HLSL
+// --------------------------------------------------------
+static void WriteVariable(std::ostream& out, const ReflectedVariable& var)
+{
+	unsigned int size, stride;
+	GetElementSize(var, &size, &stride);
+
+	std::string cppName;
+	const LayoutType* type = FindLayoutType(var.TypeName);
+	if (type && type->Size == size)
+		cppName = type->CPPName;
+	else if (!var.Members.empty())
+		cppName = var.TypeName;
+
+	bool fits = !cppName.empty() && (var.Elements == 0 || size == stride);
+	if (!fits)
+	{
+		out << "\tunsigned char " << var.Name << "[" << var.Size << "];";
+		out << "\t// " << var.TypeName;
+		if (var.Elements > 0)
+			out << "[" << var.Elements << "]";
+		out << ", which has no matching C++ layout\n";
+		return;
+	}
+
+	out << "\t" << cppName << " " << var.Name;
+	if (var.Elements > 0)
+		out << "[" << var.Elements << "]";
+	out << ";\n";
+}
+
+// --------------------------------------------------------
+// A struct for one constant buffer, with padding filling
+// any gaps HLSL leaves between variables
+// --------------------------------------------------------
+static void WriteBuffer(std::ostream& out, const std::string& shaderName, const ReflectedConstantBuffer& cb)
+{
+	std::string structName = shaderName + cb.Name;
+
+	out << "// " << cb.Name << " in " << shaderName << "\n";
+	out << "struct " << structName << "\n{\n";
+	out << "\tstatic const char* BufferName() { return \"" << cb.Name << "\"; }\n";
+	out << "\tstatic const unsigned int LayoutHash = 0x" << std::hex << ShaderReflection::LayoutHash(cb) << std::dec << "u;\n\n";
+
+	unsigned int offset = 0;
+	unsigned int padding = 0;
+	for (auto& var : cb.Variables)
+	{
+		if (var.ByteOffset > offset)
+			out << "\tunsigned char padding" << padding++ << "[" << var.ByteOffset - offset << "];\n";
+
+		WriteVariable(out, var);
+		offset = var.ByteOffset + var.Size;
+	}
+	out << "};\n";
+
+	for (auto& var : cb.Variables)
+	{
+		out << "static_assert(offsetof(" << structName << ", " << var.Name << ") == " << var.ByteOffset << ", "
+			<< AssertMessage(structName + "::" + var.Name, "offset") << ");\n";
+	}
+	out << "static_assert(sizeof(" << structName << ") == " << offset << ", "
+		<< AssertMessage(structName, "size") << ");\n\n";
+}
+
+std::string ShaderLayoutGenerator::Generate(const std::vector<ShaderLayoutSource>& shaders, const std::vector<std::string>& includes)
+{
+	std::ostringstream out;
+	out << "#pragma once\n\n";
+	out << "// --------------------------------------------------------\n";
+	out << "// Generated by ShaderLayoutGenerator from shader reflection\n";
+	out << "// data - don't edit by hand\n";
+	out << "//\n";
+	out << "// Regenerate it by running the game with --write-shader-layouts,\n";
+	out << "// which Debug builds ask for when the shaders no longer match\n";
+	out << "// --------------------------------------------------------\n\n";
+	out << "#include <cstddef>\n";
+	out << "#include <DirectXMath.h>\n";
+	for (auto& include : includes)
+		out << "#include \"" << include << "\"\n";
+	out << "\n";
+
+	// Structs shared between buffers are checked once each
+	std::set<std::string> checkedStructs;
+	for (auto& shader : shaders)
+	{
+		for (auto& cb : shader.Reflection->ConstantBuffers)
+		{
+			for (auto& var : cb.Variables)
+			{
+				if (!var.Members.empty() && checkedStructs.insert(var.TypeName).second)
+					WriteStructChecks(out, var);
+			}
+		}
+	}
+
+	for (auto& shader : shaders)
+	{
+		for (auto& cb : shader.Reflection->ConstantBuffers)
+			WriteBuffer(out, shader.Name, cb);
+	}
+
+	return out.str();
+}
+
+bool ShaderLayoutGenerator::Write(const std::string& file, const std::vector<ShaderLayoutSource>& shaders, const std::vector<std::string>& includes)
+{
+	std::ofstream stream(file);
+	if (!stream.is_open())
+		return false;
+
+	stream << Generate(shaders, includes);
+	return stream.good();
+}
+
+bool ShaderLayoutGenerator::IsUpToDate(const std::string& file, const std::vector<ShaderLayoutSource>& shaders, const std::vector<std::string>& includes)
+{
+	std::ifstream stream(file);
+	if (!stream.is_open())
+		return false;
+
+	std::ostringstream contents;
+	contents << stream.rdbuf();
+	return contents.str() == Generate(shaders, includes);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "ShaderReflection.h"
+
+// --------------------------------------------------------
+// A shader to generate constant buffer structs for
+// - Name prefixes each struct, so the PerFrame buffer of
+//   "PixelShader" becomes PixelShaderPerFrame
+// --------------------------------------------------------
+struct ShaderLayoutSource
+{
+	std::string Name;
+	const ShaderReflection* Reflection;
+};
+
+// --------------------------------------------------------
+// Writes C++ structs that match the layout of each shader's
+// constant buffers, straight from reflection data
+//
+// Every member gets a static_assert on its offset, and each
+// struct carries a hash of the layout it was generated from,
+// which SimpleShader checks before copying the whole struct
+// into a buffer. Editing a cbuffer without regenerating the
+// header then fails to compile if the C++ side moved, or fails
+// loudly at runtime if only the HLSL side did.
+//
+// HLSL structs used in buffers, such as Light, are expected
+// to already exist in C++ under the same name - the generated
+// header checks their sizes and offsets rather than defining
+// them again.
+//
+// Nothing here needs Direct3D, so the same code can run from
+// a tool reading .refl files as well as from the game
+// --------------------------------------------------------
+namespace ShaderLayoutGenerator
+{
+	// The whole header, with the given files included at the top
+	std::string Generate(const std::vector<ShaderLayoutSource>& shaders, const std::vector<std::string>& includes);
+
+	bool Write(const std::string& file, const std::vector<ShaderLayoutSource>& shaders, const std::vector<std::string>& includes);
+
+	// Whether the file already holds exactly what Generate() would write,
+	// which is false if it can't be read at all
+	bool IsUpToDate(const std::string& file, const std::vector<ShaderLayoutSource>& shaders, const std::vector<std::string>& includes);
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+// --------------------------------------------------------
+// Generated by ShaderLayoutGenerator from shader reflection
+// data - don't edit by hand
+//
+// Regenerate it by running the game with --write-shader-layouts,
+// which Debug builds ask for when the shaders no longer match
+// --------------------------------------------------------
+
+#include <cstddef>
+#include <DirectXMath.h>
+#include "Lights.h"
+
+static_assert(sizeof(Light) == 64, "Light size doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(Light, type) == 0, "Light::type offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(Light, direction) == 4, "Light::direction offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(Light, range) == 16, "Light::range offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(Light, position) == 20, "Light::position offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(Light, intensity) == 32, "Light::intensity offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(Light, color) == 36, "Light::color offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(Light, spotFalloff) == 48, "Light::spotFalloff offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(Light, castsShadows) == 52, "Light::castsShadows offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(Light, padding) == 56, "Light::padding offset doesn't match the shader - regenerate ShaderLayouts.h");
+
+// PerFrame in VertexShader
+struct VertexShaderPerFrame
+{
+	static const char* BufferName() { return "PerFrame"; }
+	static const unsigned int LayoutHash = 0xf1d849a1u;
+
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 proj;
+};
+static_assert(offsetof(VertexShaderPerFrame, view) == 0, "VertexShaderPerFrame::view offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(VertexShaderPerFrame, proj) == 64, "VertexShaderPerFrame::proj offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(sizeof(VertexShaderPerFrame) == 128, "VertexShaderPerFrame size doesn't match the shader - regenerate ShaderLayouts.h");
+
+// PerObject in VertexShader
+struct VertexShaderPerObject
+{
+	static const char* BufferName() { return "PerObject"; }
+	static const unsigned int LayoutHash = 0xea21100fu;
+
+	DirectX::XMFLOAT4X4 world;
+	DirectX::XMFLOAT4X4 worldInvTranspose;
+};
+static_assert(offsetof(VertexShaderPerObject, world) == 0, "VertexShaderPerObject::world offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(VertexShaderPerObject, worldInvTranspose) == 64, "VertexShaderPerObject::worldInvTranspose offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(sizeof(VertexShaderPerObject) == 128, "VertexShaderPerObject size doesn't match the shader - regenerate ShaderLayouts.h");
+
+// PerFrame in PixelShader
+struct PixelShaderPerFrame
+{
+	static const char* BufferName() { return "PerFrame"; }
+	static const unsigned int LayoutHash = 0x1d7470b4u;
+
+	DirectX::XMFLOAT3 cameraPosition;
+	unsigned char padding0[4];
+	Light lights[6];
+	DirectX::XMFLOAT4X4 lightViewProjs[15];
+};
+static_assert(offsetof(PixelShaderPerFrame, cameraPosition) == 0, "PixelShaderPerFrame::cameraPosition offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(PixelShaderPerFrame, lights) == 16, "PixelShaderPerFrame::lights offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(PixelShaderPerFrame, lightViewProjs) == 400, "PixelShaderPerFrame::lightViewProjs offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(sizeof(PixelShaderPerFrame) == 1360, "PixelShaderPerFrame size doesn't match the shader - regenerate ShaderLayouts.h");
+
+// PerMaterial in PixelShader
+struct PixelShaderPerMaterial
+{
+	static const char* BufferName() { return "PerMaterial"; }
+	static const unsigned int LayoutHash = 0xd93214fu;
+
+	DirectX::XMFLOAT4 colorTint;
+	float roughnessFlat;
+	float metallicFlat;
+	DirectX::XMFLOAT2 uvOffset;
+	float uvScale;
+	unsigned char padding0[12];
+	DirectX::XMUINT4 textureSlices;
+};
+static_assert(offsetof(PixelShaderPerMaterial, colorTint) == 0, "PixelShaderPerMaterial::colorTint offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(PixelShaderPerMaterial, roughnessFlat) == 16, "PixelShaderPerMaterial::roughnessFlat offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(PixelShaderPerMaterial, metallicFlat) == 20, "PixelShaderPerMaterial::metallicFlat offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(PixelShaderPerMaterial, uvOffset) == 24, "PixelShaderPerMaterial::uvOffset offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(PixelShaderPerMaterial, uvScale) == 32, "PixelShaderPerMaterial::uvScale offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(PixelShaderPerMaterial, textureSlices) == 48, "PixelShaderPerMaterial::textureSlices offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(sizeof(PixelShaderPerMaterial) == 64, "PixelShaderPerMaterial size doesn't match the shader - regenerate ShaderLayouts.h");
+
+// PerFrame in AnimatedPixelShader
+struct AnimatedPixelShaderPerFrame
+{
+	static const char* BufferName() { return "PerFrame"; }
+	static const unsigned int LayoutHash = 0xc0986630u;
+
+	float totalTime;
+};
+static_assert(offsetof(AnimatedPixelShaderPerFrame, totalTime) == 0, "AnimatedPixelShaderPerFrame::totalTime offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(sizeof(AnimatedPixelShaderPerFrame) == 4, "AnimatedPixelShaderPerFrame size doesn't match the shader - regenerate ShaderLayouts.h");
+
+// PerMaterial in AnimatedPixelShader
+struct AnimatedPixelShaderPerMaterial
+{
+	static const char* BufferName() { return "PerMaterial"; }
+	static const unsigned int LayoutHash = 0x538d3597u;
+
+	DirectX::XMFLOAT4 colorTint;
+};
+static_assert(offsetof(AnimatedPixelShaderPerMaterial, colorTint) == 0, "AnimatedPixelShaderPerMaterial::colorTint offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(sizeof(AnimatedPixelShaderPerMaterial) == 16, "AnimatedPixelShaderPerMaterial size doesn't match the shader - regenerate ShaderLayouts.h");
+
+// PerPass in ShadowMapVertexShader
+struct ShadowMapVertexShaderPerPass
+{
+	static const char* BufferName() { return "PerPass"; }
+	static const unsigned int LayoutHash = 0xf1d849a1u;
+
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 proj;
+};
+static_assert(offsetof(ShadowMapVertexShaderPerPass, view) == 0, "ShadowMapVertexShaderPerPass::view offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(ShadowMapVertexShaderPerPass, proj) == 64, "ShadowMapVertexShaderPerPass::proj offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(sizeof(ShadowMapVertexShaderPerPass) == 128, "ShadowMapVertexShaderPerPass size doesn't match the shader - regenerate ShaderLayouts.h");
+
+// PerObject in ShadowMapVertexShader
+struct ShadowMapVertexShaderPerObject
+{
+	static const char* BufferName() { return "PerObject"; }
+	static const unsigned int LayoutHash = 0x104c3f49u;
+
+	DirectX::XMFLOAT4X4 world;
+};
+static_assert(offsetof(ShadowMapVertexShaderPerObject, world) == 0, "ShadowMapVertexShaderPerObject::world offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(sizeof(ShadowMapVertexShaderPerObject) == 64, "ShadowMapVertexShaderPerObject size doesn't match the shader - regenerate ShaderLayouts.h");
+
+// PerFrame in InstancedVertexShader
+struct InstancedVertexShaderPerFrame
+{
+	static const char* BufferName() { return "PerFrame"; }
+	static const unsigned int LayoutHash = 0xf1d849a1u;
+
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 proj;
+};
+static_assert(offsetof(InstancedVertexShaderPerFrame, view) == 0, "InstancedVertexShaderPerFrame::view offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(InstancedVertexShaderPerFrame, proj) == 64, "InstancedVertexShaderPerFrame::proj offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(sizeof(InstancedVertexShaderPerFrame) == 128, "InstancedVertexShaderPerFrame size doesn't match the shader - regenerate ShaderLayouts.h");
+
+// PerPass in InstancedShadowMapVertexShader
+struct InstancedShadowMapVertexShaderPerPass
+{
+	static const char* BufferName() { return "PerPass"; }
+	static const unsigned int LayoutHash = 0xf1d849a1u;
+
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 proj;
+};
+static_assert(offsetof(InstancedShadowMapVertexShaderPerPass, view) == 0, "InstancedShadowMapVertexShaderPerPass::view offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(offsetof(InstancedShadowMapVertexShaderPerPass, proj) == 64, "InstancedShadowMapVertexShaderPerPass::proj offset doesn't match the shader - regenerate ShaderLayouts.h");
+static_assert(sizeof(InstancedShadowMapVertexShaderPerPass) == 128, "InstancedShadowMapVertexShaderPerPass size doesn't match the shader - regenerate ShaderLayouts.h");
+
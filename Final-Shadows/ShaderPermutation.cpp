@@ -0,0 +1,99 @@
+#include "ShaderPermutation.h"
+
+// Counts each variant is compiled for, smallest first
+// - The last of each matches NUM_LIGHTS and MAX_NUM_SHADOW_MAPS
+//   in the shaders, which is as many as the constant buffers hold
+static const int LightCountBuckets[] = { 1, 2, 4, 6 };
+static const int ShadowMapCountBuckets[] = { 0, 1, 2, 4, 8, 15 };
+
+static const unsigned int LightCountBucketCount = sizeof(LightCountBuckets) / sizeof(LightCountBuckets[0]);
+static const unsigned int ShadowMapCountBucketCount = sizeof(ShadowMapCountBuckets) / sizeof(ShadowMapCountBuckets[0]);
+
+static const unsigned int LightCountShift = 0;
+static const unsigned int LightCountMask = 0x3;
+static const unsigned int ShadowMapCountShift = 2;
+static const unsigned int ShadowMapCountMask = 0x7;
+static const unsigned int NormalMapBit = 1 << 5;
+static const unsigned int PbrMapsBit = 1 << 6;
+
+// Index of the smallest bucket holding count, or the last one
+static unsigned int FindBucket(const int* buckets, unsigned int bucketCount, int count)
+{
+	for (unsigned int i = 0; i < bucketCount; i++)
+	{
+		if (count <= buckets[i])
+			return i;
+	}
+	return bucketCount - 1;
+}
+
+ShaderPermutation ShaderPermutation::Select(int lightCount, int shadowMapCount, bool normalMap, bool pbrMaps)
+{
+	unsigned int key =
+		(FindBucket(LightCountBuckets, LightCountBucketCount, lightCount) << LightCountShift) |
+		(FindBucket(ShadowMapCountBuckets, ShadowMapCountBucketCount, shadowMapCount) << ShadowMapCountShift);
+	if (normalMap)
+		key |= NormalMapBit;
+	if (pbrMaps)
+		key |= PbrMapsBit;
+	return ShaderPermutation(key);
+}
+
+ShaderPermutation ShaderPermutation::Full()
+{
+	return Select(
+		LightCountBuckets[LightCountBucketCount - 1],
+		ShadowMapCountBuckets[ShadowMapCountBucketCount - 1],
+		true,
+		true);
+}
+
+unsigned int ShaderPermutation::GetKeyCount()
+{
+	return PbrMapsBit << 1;
+}
+
+// --------------------------------------------------------
+// Whether the key's bucket indices are all in range
+// - Not every key below GetKeyCount() is valid, since the
+//   buckets don't fill their bits
+// --------------------------------------------------------
+bool ShaderPermutation::IsValid() const
+{
+	return
+		Key < GetKeyCount() &&
+		((Key >> LightCountShift) & LightCountMask) < LightCountBucketCount &&
+		((Key >> ShadowMapCountShift) & ShadowMapCountMask) < ShadowMapCountBucketCount;
+}
+
+int ShaderPermutation::GetLightCount() const
+{
+	unsigned int bucket = (Key >> LightCountShift) & LightCountMask;
+	return bucket < LightCountBucketCount ? LightCountBuckets[bucket] : 0;
+}
+
+int ShaderPermutation::GetShadowMapCount() const
+{
+	unsigned int bucket = (Key >> ShadowMapCountShift) & ShadowMapCountMask;
+	return bucket < ShadowMapCountBucketCount ? ShadowMapCountBuckets[bucket] : 0;
+}
+
+bool ShaderPermutation::HasNormalMap() const
+{
+	return (Key & NormalMapBit) != 0;
+}
+
+bool ShaderPermutation::HasPbrMaps() const
+{
+	return (Key & PbrMapsBit) != 0;
+}
+
+std::wstring ShaderPermutation::GetPixelShaderFile() const
+{
+	return
+		L"PixelShader_L" + std::to_wstring(GetLightCount()) +
+		L"_S" + std::to_wstring(GetShadowMapCount()) +
+		L"_N" + (HasNormalMap() ? L"1" : L"0") +
+		L"_P" + (HasPbrMaps() ? L"1" : L"0") +
+		L".cso";
+}
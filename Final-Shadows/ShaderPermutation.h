@@ -0,0 +1,126 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// --------------------------------------------------------
+// One compiled variant of the main pixel shader, identified
+// by a small key of feature bits:
+//  - Bits 0-1: How many lights the pixel shader loops over,
+//    as an index into the light count buckets
+//  - Bits 2-4: How many shadow maps are sampled, as an index
+//    into the shadow map count buckets
+//  - Bit 5: Whether the normal map is sampled
+//  - Bit 6: Whether roughness and metallic maps are sampled
+//
+// Counts are rounded up to the next bucket, so a scene with
+// 2 lights and 7 shadow maps uses the variant built for 2
+// lights and 8 shadow maps. Every variant keeps the constant
+// buffer layouts of the full shader, so the same C++ structs
+// fill them all, and takes the same input from the vertex
+// shader, so the vertex shaders don't need variants of their own.
+//
+// The BuildShaderVariants target in FinalShadows.vcxproj compiles
+// every key, and must list the same buckets as ShaderPermutation.cpp
+// --------------------------------------------------------
+struct ShaderPermutation
+{
+	unsigned int Key;
+
+	ShaderPermutation(unsigned int key = 0) : Key(key) {}
+
+	// The smallest variant that handles everything asked for, with
+	// counts past the last bucket clamped to it
+	static ShaderPermutation Select(int lightCount, int shadowMapCount, bool normalMap, bool pbrMaps);
+
+	// The variant matching the shader compiled without any defines
+	static ShaderPermutation Full();
+
+	// Keys run from 0 to one less than this
+	static unsigned int GetKeyCount();
+
+	bool IsValid() const;
+	int GetLightCount() const;
+	int GetShadowMapCount() const;
+	bool HasNormalMap() const;
+	bool HasPbrMaps() const;
+
+	// Compiled shader file name, such as PixelShader_L2_S8_N1_P0.cso
+	std::wstring GetPixelShaderFile() const;
+
+	bool operator==(const ShaderPermutation& other) const { return Key == other.Key; }
+	bool operator!=(const ShaderPermutation& other) const { return Key != other.Key; }
+};
+
+// --------------------------------------------------------
+// Loads shader permutations the first time they're asked for,
+// and hands out the same shaders after that
+//
+// Permutations that fail to load, or have keys that aren't
+// valid, fall back to the full shader the set was created
+// with. A failed load is remembered, so a missing file is only
+// looked for once.
+//
+// The loader returns null for a shader it couldn't load, and
+// is the only part that needs a device, so the bookkeeping can
+// be checked with any stand-in for the shader type
+// --------------------------------------------------------
+template<typename Shader>
+class ShaderPermutationSet
+{
+public:
+	typedef std::function<std::shared_ptr<Shader>(ShaderPermutation permutation)> Loader;
+
+	ShaderPermutationSet(std::shared_ptr<Shader> fullShader, Loader load)
+		:
+		fullShader(fullShader),
+		load(load),
+		loadedCount(0),
+		missingCount(0)
+	{
+	}
+
+	// Returns false if it had to fall back to the full shader
+	bool Get(ShaderPermutation permutation, std::shared_ptr<Shader>* shader)
+	{
+		// The full shader is the one built without defines
+		*shader = fullShader;
+		if (permutation == ShaderPermutation::Full())
+			return true;
+		if (!permutation.IsValid())
+			return false;
+
+		auto found = shaders.find(permutation.Key);
+		if (found == shaders.end())
+		{
+			std::shared_ptr<Shader> loaded = load(permutation);
+			if (loaded)
+				loadedCount++;
+			else
+				missingCount++;
+
+			found = shaders.insert({ permutation.Key, loaded }).first;
+		}
+
+		if (!found->second)
+			return false;
+
+		*shader = found->second;
+		return true;
+	}
+
+	unsigned int GetLoadedCount() { return loadedCount; }
+	unsigned int GetMissingCount() { return missingCount; }
+
+private:
+	std::shared_ptr<Shader> fullShader;
+	Loader load;
+
+	// By key, including nulls for shaders that failed to load
+	std::unordered_map<unsigned int, std::shared_ptr<Shader>> shaders;
+
+	unsigned int loadedCount;
+	unsigned int missingCount;
+};
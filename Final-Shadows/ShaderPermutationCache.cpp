@@ -0,0 +1,18 @@
+#include "ShaderPermutationCache.h"
+#include "Helpers.h"
+
+ShaderPermutationCache::ShaderPermutationCache(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	std::shared_ptr<SimplePixelShader> fullPixelShader)
+	:
+	pixelShaders(fullPixelShader, [device, context](ShaderPermutation permutation)
+	{
+		std::shared_ptr<SimplePixelShader> shader = std::make_shared<SimplePixelShader>(device, context,
+			FixPath(permutation.GetPixelShaderFile()).c_str());
+		if (!shader->IsShaderValid())
+			shader = 0;
+		return shader;
+	})
+{
+}
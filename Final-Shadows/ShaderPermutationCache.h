@@ -0,0 +1,34 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include "ShaderPermutation.h"
+#include "SimpleShader.h"
+
+// --------------------------------------------------------
+// Loads pixel shader permutations the first time they're
+// asked for, and hands out the same shaders after that
+// - Permutations that haven't been built fall back to the
+//   full shader the cache was created with
+// --------------------------------------------------------
+class ShaderPermutationCache
+{
+public:
+	ShaderPermutationCache(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		std::shared_ptr<SimplePixelShader> fullPixelShader);
+
+	// Returns false if it had to fall back to the full shader
+	bool GetPixelShader(ShaderPermutation permutation, std::shared_ptr<SimplePixelShader>* pixelShader)
+	{
+		return pixelShaders.Get(permutation, pixelShader);
+	}
+
+	unsigned int GetLoadedCount() { return pixelShaders.GetLoadedCount(); }
+	unsigned int GetMissingCount() { return pixelShaders.GetMissingCount(); }
+
+private:
+	ShaderPermutationSet<SimplePixelShader> pixelShaders;
+};
@@ -0,0 +1,308 @@
+#include <cstring>
+#include <fstream>
+#include "ShaderReflection.h"
+
+// Identifies the file type and layout
+static const char ShaderReflectionMagic[4] = { 'S', 'R', 'F', 'L' };
+static const unsigned int ShaderReflectionVersion = 2;
+
+// Anything bigger than this means the file is damaged
+static const unsigned int MaxReflectedCount = 4096;
+
+// --------------------------------------------------------
+// Fixed size start of a reflection file, followed by:
+//  - Each constant buffer: name, type, size, bind index, and
+//    a variable count followed by each variable's name,
+//    offset, size, type name, element count, and a member
+//    count followed by each member's name, type name and offset
+//  - Each resource: name, type, bind index
+//  - Each input element: semantic name, semantic index,
+//    mask, component type
+//
+// Numbers are 4 bytes each, and names are a 4 byte length
+// followed by that many characters
+// --------------------------------------------------------
+struct ShaderReflectionFileHeader
+{
+	char magic[4];
+	unsigned int version;
+	unsigned int bytecodeSize;
+	unsigned int bytecodeHash;
+	unsigned int constantBufferCount;
+	unsigned int resourceCount;
+	unsigned int inputCount;
+};
+
+static void WriteUInt(std::ostream& stream, unsigned int value)
+{
+	stream.write((const char*)&value, sizeof(value));
+}
+
+static void WriteString(std::ostream& stream, const std::string& s)
+{
+	WriteUInt(stream, (unsigned int)s.size());
+	stream.write(s.data(), s.size());
+}
+
+static bool ReadUInt(std::istream& stream, unsigned int* value)
+{
+	stream.read((char*)value, sizeof(*value));
+	return (bool)stream;
+}
+
+static bool ReadString(std::istream& stream, std::string* s)
+{
+	unsigned int length;
+	if (!ReadUInt(stream, &length) || length > MaxReflectedCount)
+		return false;
+
+	s->resize(length);
+	if (length > 0)
+		stream.read(&(*s)[0], length);
+	return (bool)stream;
+}
+
+void ShaderReflection::Clear()
+{
+	BytecodeSize = 0;
+	BytecodeHash = 0;
+	ConstantBuffers.clear();
+	Resources.clear();
+	Inputs.clear();
+}
+
+void ShaderReflection::SetBytecode(const void* bytecode, size_t size)
+{
+	BytecodeSize = (unsigned int)size;
+	BytecodeHash = Hash(bytecode, size);
+}
+
+bool ShaderReflection::MatchesBytecode(const void* bytecode, size_t size) const
+{
+	return BytecodeSize == size && BytecodeHash == Hash(bytecode, size);
+}
+
+const ReflectedConstantBuffer* ShaderReflection::FindConstantBuffer(const std::string& name) const
+{
+	for (auto& cb : ConstantBuffers)
+	{
+		if (cb.Name == name)
+			return &cb;
+	}
+	return 0;
+}
+
+const ReflectedVariable* ShaderReflection::FindVariable(const std::string& bufferName, const std::string& name) const
+{
+	const ReflectedConstantBuffer* cb = FindConstantBuffer(bufferName);
+	if (!cb)
+		return 0;
+
+	for (auto& var : cb->Variables)
+	{
+		if (var.Name == name)
+			return &var;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// 32 bit FNV-1a, which is plenty for telling one build of a
+// shader from the next
+// --------------------------------------------------------
+unsigned int ShaderReflection::Hash(const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// --------------------------------------------------------
+// Hashes the names, offsets and sizes of a buffer's variables,
+// which is what C++ code copying the whole buffer relies on
+// --------------------------------------------------------
+unsigned int ShaderReflection::LayoutHash(const ReflectedConstantBuffer& cb)
+{
+	std::vector<unsigned char> layout;
+	for (auto& var : cb.Variables)
+	{
+		const unsigned int values[2] = { var.ByteOffset, var.Size };
+		layout.insert(layout.end(), var.Name.begin(), var.Name.end());
+		layout.push_back(0);
+		layout.insert(layout.end(), (const unsigned char*)values, (const unsigned char*)values + sizeof(values));
+	}
+	return Hash(layout.data(), layout.size());
+}
+
+// --------------------------------------------------------
+// Writes the reflection data to a file
+// --------------------------------------------------------
+bool ShaderReflection::Save(const std::string& file) const
+{
+	std::ofstream stream(file, std::ios::binary);
+	if (!stream.is_open())
+		return false;
+
+	return Save(stream);
+}
+
+// --------------------------------------------------------
+// Writes the reflection data to a binary stream
+// --------------------------------------------------------
+bool ShaderReflection::Save(std::ostream& stream) const
+{
+	ShaderReflectionFileHeader header = {};
+	memcpy(header.magic, ShaderReflectionMagic, sizeof(ShaderReflectionMagic));
+	header.version = ShaderReflectionVersion;
+	header.bytecodeSize = BytecodeSize;
+	header.bytecodeHash = BytecodeHash;
+	header.constantBufferCount = (unsigned int)ConstantBuffers.size();
+	header.resourceCount = (unsigned int)Resources.size();
+	header.inputCount = (unsigned int)Inputs.size();
+	stream.write((const char*)&header, sizeof(header));
+
+	for (auto& cb : ConstantBuffers)
+	{
+		WriteString(stream, cb.Name);
+		WriteUInt(stream, cb.Type);
+		WriteUInt(stream, cb.Size);
+		WriteUInt(stream, cb.BindIndex);
+		WriteUInt(stream, (unsigned int)cb.Variables.size());
+		for (auto& var : cb.Variables)
+		{
+			WriteString(stream, var.Name);
+			WriteUInt(stream, var.ByteOffset);
+			WriteUInt(stream, var.Size);
+			WriteString(stream, var.TypeName);
+			WriteUInt(stream, var.Elements);
+			WriteUInt(stream, (unsigned int)var.Members.size());
+			for (auto& member : var.Members)
+			{
+				WriteString(stream, member.Name);
+				WriteString(stream, member.TypeName);
+				WriteUInt(stream, member.ByteOffset);
+			}
+		}
+	}
+
+	for (auto& res : Resources)
+	{
+		WriteString(stream, res.Name);
+		WriteUInt(stream, res.Type);
+		WriteUInt(stream, res.BindIndex);
+	}
+
+	for (auto& input : Inputs)
+	{
+		WriteString(stream, input.SemanticName);
+		WriteUInt(stream, input.SemanticIndex);
+		WriteUInt(stream, input.Mask);
+		WriteUInt(stream, input.ComponentType);
+	}
+
+	return stream.good();
+}
+
+// --------------------------------------------------------
+// Reads reflection data from a file written by Save()
+// --------------------------------------------------------
+bool ShaderReflection::Load(const std::string& file)
+{
+	std::ifstream stream(file, std::ios::binary);
+	if (!stream.is_open())
+	{
+		Clear();
+		return false;
+	}
+
+	return Load(stream);
+}
+
+// --------------------------------------------------------
+// Reads reflection data from a binary stream written by Save()
+//
+// Returns false if the data is missing or malformed, in which
+// case nothing is loaded
+// --------------------------------------------------------
+bool ShaderReflection::Load(std::istream& stream)
+{
+	Clear();
+
+	ShaderReflectionFileHeader header = {};
+	stream.read((char*)&header, sizeof(header));
+	if (!stream ||
+		memcmp(header.magic, ShaderReflectionMagic, sizeof(ShaderReflectionMagic)) != 0 ||
+		header.version != ShaderReflectionVersion ||
+		header.constantBufferCount > MaxReflectedCount ||
+		header.resourceCount > MaxReflectedCount ||
+		header.inputCount > MaxReflectedCount)
+		return false;
+
+	std::vector<ReflectedConstantBuffer> constantBuffers(header.constantBufferCount);
+	for (auto& cb : constantBuffers)
+	{
+		unsigned int variableCount;
+		if (!ReadString(stream, &cb.Name) ||
+			!ReadUInt(stream, &cb.Type) ||
+			!ReadUInt(stream, &cb.Size) ||
+			!ReadUInt(stream, &cb.BindIndex) ||
+			!ReadUInt(stream, &variableCount) ||
+			variableCount > MaxReflectedCount)
+			return false;
+
+		cb.Variables.resize(variableCount);
+		for (auto& var : cb.Variables)
+		{
+			unsigned int memberCount;
+			if (!ReadString(stream, &var.Name) ||
+				!ReadUInt(stream, &var.ByteOffset) ||
+				!ReadUInt(stream, &var.Size) ||
+				var.ByteOffset > cb.Size || var.Size > cb.Size - var.ByteOffset ||
+				!ReadString(stream, &var.TypeName) ||
+				!ReadUInt(stream, &var.Elements) ||
+				!ReadUInt(stream, &memberCount) ||
+				memberCount > MaxReflectedCount)
+				return false;
+
+			var.Members.resize(memberCount);
+			for (auto& member : var.Members)
+			{
+				if (!ReadString(stream, &member.Name) ||
+					!ReadString(stream, &member.TypeName) ||
+					!ReadUInt(stream, &member.ByteOffset))
+					return false;
+			}
+		}
+	}
+
+	std::vector<ReflectedResource> resources(header.resourceCount);
+	for (auto& res : resources)
+	{
+		if (!ReadString(stream, &res.Name) ||
+			!ReadUInt(stream, &res.Type) ||
+			!ReadUInt(stream, &res.BindIndex))
+			return false;
+	}
+
+	std::vector<ReflectedInputElement> inputs(header.inputCount);
+	for (auto& input : inputs)
+	{
+		if (!ReadString(stream, &input.SemanticName) ||
+			!ReadUInt(stream, &input.SemanticIndex) ||
+			!ReadUInt(stream, &input.Mask) ||
+			!ReadUInt(stream, &input.ComponentType))
+			return false;
+	}
+
+	BytecodeSize = header.bytecodeSize;
+	BytecodeHash = header.bytecodeHash;
+	ConstantBuffers.swap(constantBuffers);
+	Resources.swap(resources);
+	Inputs.swap(inputs);
+	return true;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// A member of a struct used in a constant buffer, with its
+// offset from the start of the struct
+// --------------------------------------------------------
+struct ReflectedMember
+{
+	std::string Name;
+	std::string TypeName;
+	unsigned int ByteOffset;
+};
+
+// --------------------------------------------------------
+// A variable in a reflected constant buffer
+// - TypeName is the HLSL type, such as float3 or float4x4,
+//   or the struct's name
+// - Elements is 0 for anything that isn't an array
+// --------------------------------------------------------
+struct ReflectedVariable
+{
+	std::string Name;
+	unsigned int ByteOffset;
+	unsigned int Size;
+	std::string TypeName;
+	unsigned int Elements;
+	std::vector<ReflectedMember> Members;
+};
+
+// --------------------------------------------------------
+// A reflected constant buffer and the variables in it
+// - Type is the D3D_CBUFFER_TYPE it was reflected as
+// --------------------------------------------------------
+struct ReflectedConstantBuffer
+{
+	std::string Name;
+	unsigned int Type;
+	unsigned int Size;
+	unsigned int BindIndex;
+	std::vector<ReflectedVariable> Variables;
+};
+
+// --------------------------------------------------------
+// A bound resource other than a constant buffer, such as a
+// texture or sampler
+// - Type is the D3D_SHADER_INPUT_TYPE it was reflected as
+// --------------------------------------------------------
+struct ReflectedResource
+{
+	std::string Name;
+	unsigned int Type;
+	unsigned int BindIndex;
+};
+
+// --------------------------------------------------------
+// One parameter of a shader's input signature
+// - ComponentType is a D3D_REGISTER_COMPONENT_TYPE
+// --------------------------------------------------------
+struct ReflectedInputElement
+{
+	std::string SemanticName;
+	unsigned int SemanticIndex;
+	unsigned int Mask;
+	unsigned int ComponentType;
+};
+
+// --------------------------------------------------------
+// Everything SimpleShader needs from shader reflection, in a
+// form that can be saved next to the compiled shader
+//
+// Loading this back is much quicker than reflecting the
+// bytecode again, and doesn't need Direct3D at all, so the
+// same files can be read by tools checking that structs on
+// the C++ side line up with the HLSL ones.
+//
+// The size and a hash of the bytecode it came from are kept,
+// so a recompiled shader doesn't pick up an old layout
+// --------------------------------------------------------
+struct ShaderReflection
+{
+	unsigned int BytecodeSize = 0;
+	unsigned int BytecodeHash = 0;
+	std::vector<ReflectedConstantBuffer> ConstantBuffers;
+	std::vector<ReflectedResource> Resources;
+	std::vector<ReflectedInputElement> Inputs;
+
+	void Clear();
+	void SetBytecode(const void* bytecode, size_t size);
+	bool MatchesBytecode(const void* bytecode, size_t size) const;
+
+	const ReflectedConstantBuffer* FindConstantBuffer(const std::string& name) const;
+	const ReflectedVariable* FindVariable(const std::string& bufferName, const std::string& name) const;
+
+	bool Save(const std::string& file) const;
+	bool Save(std::ostream& stream) const;
+	bool Load(const std::string& file);
+	bool Load(std::istream& stream);
+
+	static unsigned int Hash(const void* data, size_t size);
+	static unsigned int LayoutHash(const ReflectedConstantBuffer& cb);
+};
@@ -1,14 +1,19 @@
 #include "ShaderIncludes.hlsli"
 
-cbuffer ExternalData : register(b0)
+// The light's matrices stay the same for every caster in a shadow map
+// - The depth pre-pass also draws with this, using the camera's matrices
+cbuffer PerPass : register(b0)
 {
-	matrix world;
 	matrix view;
 	matrix proj;
 }
 
+cbuffer PerObject : register(b1)
+{
+	matrix world;
+}
+
 float4 main( VertexShaderInput input ) : SV_POSITION
 {
-	matrix wvp = mul(proj, mul(view, world));
-	return mul(wvp, float4(input.localPosition, 1.0f));
+	return ProjectToScreen(world, view, proj, input.localPosition);
 }
\ No newline at end of file
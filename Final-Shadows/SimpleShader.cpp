@@ -1,4 +1,7 @@
 #include "SimpleShader.h"
+#include "ConstantBufferRing.h"
+#include "StateCache.h"
+#include "Helpers.h"
 
 // Default error reporting state
 bool ISimpleShader::ReportErrors = false;
@@ -11,6 +14,36 @@ bool ISimpleShader::ReportWarnings = false;
 // ISimpleShader::ReportErrors = true;
 // ISimpleShader::ReportWarnings = true;
 
+// When true, setting a variable to the value it already has
+// doesn't mark its constant buffer as needing an upload
+
+// Constant buffer uploads across all shaders since the last ResetUploadStats()
+// - Atomic since shaders can be recording on several threads at once
+std::atomic<unsigned int> ISimpleShader::TotalUploadCount(0);
+std::atomic<unsigned int> ISimpleShader::TotalUploadBytes(0);
+std::atomic<unsigned int> ISimpleShader::TotalSkippedUploadCount(0);
+
+// When set, constant buffers are uploaded into slices of this
+// shared ring instead of each shader's own buffers
+// - UseConstantRing allows switching back without removing it
+// - Per thread, as the ring can only be filled from the thread
+//   using the immediate context
+thread_local ConstantBufferRing* ISimpleShader::ConstantRing = 0;
+bool ISimpleShader::UseConstantRing = true;
+
+// When set, vertex and pixel shader bindings, constant buffer
+// updates and mesh draws go through this cache, which drops any
+// bindings that match what's already bound
+// - Per thread, so each thread can record into its own context
+thread_local StateCache* ISimpleShader::States = 0;
+
+// When true, reflection data is read from and saved to a .refl
+// file next to each compiled shader, rather than reflecting
+// the bytecode every time it's loaded
+bool ISimpleShader::UseReflectionCache = true;
+unsigned int ISimpleShader::ReflectionCacheHits = 0;
+unsigned int ISimpleShader::ReflectionCacheMisses = 0;
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ BASE SIMPLE SHADER --------------------------------------------------
@@ -25,10 +58,16 @@ ISimpleShader::ISimpleShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Micros
 	this->device = device;
 	this->deviceContext = context;
 
+	// Binding slices of the constant ring needs Direct3D 11.1, which
+	// leaves this empty when it isn't available
+	context.As(&this->deviceContext1);
+
 	// Set up fields
 	this->constantBufferCount = 0;
 	this->constantBuffers = 0;
 	this->shaderValid = false;
+	this->uploadCount = 0;
+	this->uploadBytes = 0;
 }
 
 // --------------------------------------------------------
@@ -46,11 +85,7 @@ ISimpleShader::~ISimpleShader()
 void ISimpleShader::CleanUp()
 {
 	// Handle constant buffers and local data buffers
-	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		delete[] constantBuffers[i].LocalDataBuffer;
-	}
-
+	constants.Clear();
 	if (constantBuffers)
 	{
 		delete[] constantBuffers;
@@ -64,15 +99,14 @@ void ISimpleShader::CleanUp()
 		delete samplerStates[i];
 
 	// Clean up tables
-	varTable.clear();
-	cbTable.clear();
 	samplerTable.clear();
 	textureTable.clear();
 }
 
 // --------------------------------------------------------
 // Loads the specified shader and builds the variable table 
-// using shader reflection.
+// using shader reflection, or the reflection data saved the
+// last time this shader was loaded.
 //
 // shaderFile - A "wide string" specifying the compiled shader to load
 // 
@@ -94,6 +128,35 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
+	// Reflection data comes from the file saved next to the compiled
+	// shader when there is one for this exact bytecode, and is only
+	// worked out from the bytecode (and saved for next time) when not
+	std::string reflectionFile = WideToNarrow(ReflectionFileFor(shaderFile));
+	if (UseReflectionCache &&
+		reflection.Load(reflectionFile) &&
+		reflection.MatchesBytecode(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize()))
+	{
+		ReflectionCacheHits++;
+	}
+	else
+	{
+		if (!ReflectShader())
+		{
+			if (ReportErrors)
+			{
+				LogError("SimpleShader::LoadShaderFile() - Error reflecting shader from file '");
+				LogW(shaderFile);
+				LogError("'.\n");
+			}
+
+			return false;
+		}
+
+		if (UseReflectionCache)
+			reflection.Save(reflectionFile);
+		ReflectionCacheMisses++;
+	}
+
 	// Create the shader - Calls an overloaded version of this abstract
 	// method in the appropriate child class
 	shaderValid = CreateShader(shaderBlob);
@@ -109,43 +172,26 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
-	// Set up shader reflection to get information about
-	// this shader and its variables,  buffers, etc.
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-	
-	// Get the description of the shader
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
-	// Create resource arrays
-	constantBufferCount = shaderDesc.ConstantBuffers;
+	// Create resource arrays, with the local data for the buffers
+	constantBufferCount = (unsigned int)reflection.ConstantBuffers.size();
 	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
+	constants.Init(reflection);
 	
 	// Handle bound resources (like shaders and samplers)
-	unsigned int resourceCount = shaderDesc.BoundResources;
-	for (unsigned int r = 0; r < resourceCount; r++)
+	for (auto& resource : reflection.Resources)
 	{
-		// Get this resource's description
-		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
-		refl->GetResourceBindingDesc(r, &resourceDesc);
-
 		// Check the type
-		switch (resourceDesc.Type)
+		switch (resource.Type)
 		{
 		case D3D_SIT_STRUCTURED: // Treat structured buffers as texture resources
 		case D3D_SIT_TEXTURE: // A texture resource
 		{
 			// Create the SRV wrapper
 			SimpleSRV* srv = new SimpleSRV();
-			srv->BindIndex = resourceDesc.BindPoint;				// Shader bind point
+			srv->BindIndex = resource.BindIndex;					// Shader bind point
 			srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
 
-			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceDesc.Name, srv));
+			textureTable.insert(std::pair<std::string, SimpleSRV*>(resource.Name, srv));
 			shaderResourceViews.push_back(srv);
 		}
 			break;
@@ -154,10 +200,10 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		{
 			// Create the sampler wrapper
 			SimpleSampler* samp = new SimpleSampler();
-			samp->BindIndex = resourceDesc.BindPoint;			// Shader bind point
+			samp->BindIndex = resource.BindIndex;				// Shader bind point
 			samp->Index = (unsigned int)samplerStates.size();	// Raw index
 
-			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceDesc.Name, samp));
+			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resource.Name, samp));
 			samplerStates.push_back(samp);
 		}
 			break;
@@ -167,26 +213,15 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	// Loop through all constant buffers
 	for (unsigned int b = 0; b < constantBufferCount; b++)
 	{
-		// Get this buffer
-		ID3D11ShaderReflectionConstantBuffer* cb =
-			refl->GetConstantBufferByIndex(b);
-		
-		// Get the description of this buffer
-		D3D11_SHADER_BUFFER_DESC bufferDesc;
-		cb->GetDesc(&bufferDesc);
+		const ReflectedConstantBuffer& bufferDesc = reflection.ConstantBuffers[b];
 
 		// Save the type, which we reference when setting these buffers
-		constantBuffers[b].Type = bufferDesc.Type;
-		
-		// Get the description of the resource binding, so
-		// we know exactly how it's bound in the shader
-		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
-		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+		constantBuffers[b].Type = (D3D_CBUFFER_TYPE)bufferDesc.Type;
 		
-		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
+		// Set up the buffer
+		constantBuffers[b].BindIndex = bufferDesc.BindIndex;
 		constantBuffers[b].Name = bufferDesc.Name;
-		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
+		constantBuffers[b].LayoutHash = constants.GetLayoutHash(b);
 
 		// Create this constant buffer
 		D3D11_BUFFER_DESC newBuffDesc = {};
@@ -198,33 +233,16 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		newBuffDesc.StructureByteStride = 0;
 		device->CreateBuffer(&newBuffDesc, 0, constantBuffers[b].ConstantBuffer.GetAddressOf());
 
-		// Set up the data buffer for this constant buffer
+		// The local data for this buffer is already set up
 		constantBuffers[b].Size = bufferDesc.Size;
-		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
-		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
 
 		// Loop through all variables in this buffer
-		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		for (auto& varDesc : bufferDesc.Variables)
 		{
-			// Get this variable
-			ID3D11ShaderReflectionVariable* var =
-				cb->GetVariableByIndex(v);
-			
-			// Get the description of the variable and its type
-			D3D11_SHADER_VARIABLE_DESC varDesc;
-			var->GetDesc(&varDesc);
-
-			// Create the variable struct
 			SimpleShaderVariable varStruct = {};
 			varStruct.ConstantBufferIndex = b;
-			varStruct.ByteOffset = varDesc.StartOffset;
+			varStruct.ByteOffset = varDesc.ByteOffset;
 			varStruct.Size = varDesc.Size;
-			
-			// Get a string version
-			std::string varName(varDesc.Name);
-
-			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
 			constantBuffers[b].Variables.push_back(varStruct);
 		}
 	}
@@ -233,6 +251,132 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	return true;
 }
 
+// --------------------------------------------------------
+// Fills in the reflection data from the shader's bytecode
+// - Everything SimpleShader needs is gathered here, so no
+//   other part of loading has to reflect the shader again
+//
+// Returns false if the bytecode can't be reflected
+// --------------------------------------------------------
+bool ISimpleShader::ReflectShader()
+{
+	reflection.Clear();
+	reflection.SetBytecode(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize());
+
+	// Set up shader reflection to get information about
+	// this shader and its variables,  buffers, etc.
+	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
+	HRESULT hr = D3DReflect(
+		shaderBlob->GetBufferPointer(),
+		shaderBlob->GetBufferSize(),
+		IID_ID3D11ShaderReflection,
+		(void**)refl.GetAddressOf());
+	if (FAILED(hr))
+		return false;
+	
+	// Get the description of the shader
+	D3D11_SHADER_DESC shaderDesc;
+	refl->GetDesc(&shaderDesc);
+
+	// Bound resources other than constant buffers, which are
+	// picked up with their layouts below
+	for (unsigned int r = 0; r < shaderDesc.BoundResources; r++)
+	{
+		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
+		refl->GetResourceBindingDesc(r, &resourceDesc);
+		if (resourceDesc.Type == D3D_SIT_CBUFFER)
+			continue;
+
+		ReflectedResource resource;
+		resource.Name = resourceDesc.Name;
+		resource.Type = resourceDesc.Type;
+		resource.BindIndex = resourceDesc.BindPoint;
+		reflection.Resources.push_back(resource);
+	}
+
+	for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
+	{
+		ID3D11ShaderReflectionConstantBuffer* cb = refl->GetConstantBufferByIndex(b);
+		D3D11_SHADER_BUFFER_DESC bufferDesc;
+		cb->GetDesc(&bufferDesc);
+
+		// Get the description of the resource binding, so
+		// we know exactly how it's bound in the shader
+		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
+		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+
+		ReflectedConstantBuffer buffer;
+		buffer.Name = bufferDesc.Name;
+		buffer.Type = bufferDesc.Type;
+		buffer.Size = bufferDesc.Size;
+		buffer.BindIndex = bindDesc.BindPoint;
+
+		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		{
+			D3D11_SHADER_VARIABLE_DESC varDesc;
+			cb->GetVariableByIndex(v)->GetDesc(&varDesc);
+
+			// The variable's type, and the members of struct types,
+			// for tools generating matching C++ structs
+			ID3D11ShaderReflectionType* type = cb->GetVariableByIndex(v)->GetType();
+			D3D11_SHADER_TYPE_DESC typeDesc;
+			type->GetDesc(&typeDesc);
+
+			ReflectedVariable var;
+			var.Name = varDesc.Name;
+			var.ByteOffset = varDesc.StartOffset;
+			var.Size = varDesc.Size;
+			var.TypeName = typeDesc.Name ? typeDesc.Name : "";
+			var.Elements = typeDesc.Elements;
+			for (unsigned int m = 0; m < typeDesc.Members; m++)
+			{
+				D3D11_SHADER_TYPE_DESC memberDesc;
+				type->GetMemberTypeByIndex(m)->GetDesc(&memberDesc);
+
+				ReflectedMember member;
+				member.Name = type->GetMemberTypeName(m);
+				member.TypeName = memberDesc.Name ? memberDesc.Name : "";
+				member.ByteOffset = memberDesc.Offset;
+				var.Members.push_back(member);
+			}
+			buffer.Variables.push_back(var);
+		}
+
+		reflection.ConstantBuffers.push_back(buffer);
+	}
+
+	// The input signature, for vertex shaders to build input layouts from
+	for (unsigned int i = 0; i < shaderDesc.InputParameters; i++)
+	{
+		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
+		refl->GetInputParameterDesc(i, &paramDesc);
+
+		ReflectedInputElement input;
+		input.SemanticName = paramDesc.SemanticName;
+		input.SemanticIndex = paramDesc.SemanticIndex;
+		input.Mask = paramDesc.Mask;
+		input.ComponentType = paramDesc.ComponentType;
+		reflection.Inputs.push_back(input);
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Where the reflection data for a compiled shader is kept,
+// which is the same path with a .refl extension
+// --------------------------------------------------------
+std::wstring ISimpleShader::ReflectionFileFor(LPCWSTR shaderFile)
+{
+	std::wstring file(shaderFile);
+	size_t dot = file.find_last_of(L'.');
+	size_t slash = file.find_last_of(L"\\/");
+	if (dot != std::wstring::npos && (slash == std::wstring::npos || dot > slash))
+		file.erase(dot);
+
+	return file + L".refl";
+}
+
 // --------------------------------------------------------
 // Helper for looking up a variable by name and also
 // verifying that it is the requested size
@@ -240,19 +384,13 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 // name - the name of the variable to look for
 // size - the size of the variable (for verification), or -1 to bypass
 // --------------------------------------------------------
-SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
+const SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleShaderVariable>::iterator result =
-		varTable.find(name);
-
-	// Did we find the key?
-	if (result == varTable.end())
+	const SimpleShaderVariable* var = constants.FindVariable(name);
+	if (var == 0)
 		return 0;
 
-	// Grab the result from the iterator
-	SimpleShaderVariable* var = &(result->second);
-
 	// Is the data size correct ?
 	if (size > 0 && var->Size != size)
 		return 0;
@@ -267,15 +405,12 @@ SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(std::string name)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleConstantBuffer*>::iterator result =
-		cbTable.find(name);
-
-	// Did we find the key?
-	if (result == cbTable.end())
+	int index = constants.FindBuffer(name);
+	if (index < 0)
 		return 0;
 
 	// Success
-	return result->second;
+	return &constantBuffers[index];
 }
 
 // --------------------------------------------------------
@@ -345,13 +480,25 @@ void ISimpleShader::CopyAllBufferData()
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
-	// Loop through the constant buffers and copy all data
+	// Loop through the constant buffers and copy the data
+	// of any that changed since they were last copied
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer.Get(), 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+		if (NeedsUpload(i))
+			UploadConstantBuffer(i);
+		else
+			TotalSkippedUploadCount++;
+	}
+
+	// Filling up the constant ring part way through swaps its memory
+	// out, taking any buffers copied before that along with it
+	if (IsConstantRingActive())
+	{
+		for (unsigned int i = 0; i < constantBufferCount; i++)
+		{
+			if (NeedsUpload(i))
+				UploadConstantBuffer(i);
+		}
 	}
 }
 
@@ -375,14 +522,11 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	if(index >= this->constantBufferCount)
 		return;
 
-	// Check for the buffer
-	SimpleConstantBuffer* cb = &this->constantBuffers[index];
-	if (!cb) return;
-
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	// Copy the data if it changed and get out
+	if (NeedsUpload(index))
+		UploadConstantBuffer(index);
+	else
+		TotalSkippedUploadCount++;
 }
 
 // --------------------------------------------------------
@@ -401,10 +545,107 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
 	if (!cb) return;
 
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	// Copy the data if it changed and get out
+	CopyBufferData((unsigned int)(cb - constantBuffers));
+}
+
+// --------------------------------------------------------
+// Copies one constant buffer's local data to the GPU, by way
+// of UpdateConstantBuffer()
+// --------------------------------------------------------
+void ISimpleShader::UploadConstantBuffer(unsigned int index)
+{
+	constants.Upload(index, this);
+
+	unsigned int size = constants.GetBufferSize(index);
+	uploadCount++;
+	uploadBytes += size;
+	TotalUploadCount++;
+	TotalUploadBytes += size;
+}
+
+// --------------------------------------------------------
+// Puts a buffer's packed data where the GPU will read it,
+// which is a slice of the constant ring when there is one
+// --------------------------------------------------------
+void ISimpleShader::UpdateConstantBuffer(unsigned int index, const void* data, unsigned int size)
+{
+	SimpleConstantBuffer* cb = &constantBuffers[index];
+	if (IsConstantRingActive() &&
+		ConstantRing->Upload(data, size, &cb->RingFirstConstant, &cb->RingConstantCount))
+	{
+		// The data is in a new slice now, which has to be bound
+		// in place of the old one
+		cb->InRing = true;
+		cb->RingGeneration = ConstantRing->GetGeneration();
+		if (cb->Type == D3D11_CT_CBUFFER)
+			BindConstantBuffer(index);
+	}
+	else
+	{
+		if (States)
+			States->UpdateBuffer(cb->ConstantBuffer.Get(), data, size);
+		else
+			deviceContext->UpdateSubresource(
+				cb->ConstantBuffer.Get(), 0, 0,
+				data, 0, 0);
+
+		// Switch back from a ring slice to the shader's own buffer
+		if (cb->InRing)
+		{
+			cb->InRing = false;
+			if (cb->Type == D3D11_CT_CBUFFER)
+				BindConstantBuffer(index);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Checks whether a constant buffer's GPU copy is out of date
+// - Slices of the constant ring only last for the ring generation
+//   they were uploaded in, even if the local data hasn't changed
+// --------------------------------------------------------
+bool ISimpleShader::NeedsUpload(unsigned int index)
+{
+	SimpleConstantBuffer* cb = &constantBuffers[index];
+	if (cb->External)
+		return false;
+
+	if (constants.IsDirty(index))
+		return true;
+
+	if (IsConstantRingActive())
+		return !cb->InRing || cb->RingGeneration != ConstantRing->GetGeneration();
+
+	// The ring was switched off, so the shader's own buffer is stale
+	return cb->InRing;
+}
+
+// --------------------------------------------------------
+// Checks whether uploads from this shader go into the constant ring
+// --------------------------------------------------------
+bool ISimpleShader::IsConstantRingActive()
+{
+	return UseConstantRing && ConstantRing && ConstantRing->IsSupported() && deviceContext1;
+}
+
+// --------------------------------------------------------
+// Forces every constant buffer to be copied next time,
+// such as after the GPU copies have been overwritten
+// --------------------------------------------------------
+void ISimpleShader::MarkAllBuffersDirty()
+{
+	constants.MarkAllDirty();
+}
+
+// --------------------------------------------------------
+// Zeros the upload counts shared by all shaders
+// --------------------------------------------------------
+void ISimpleShader::ResetUploadStats()
+{
+	TotalUploadCount = 0;
+	TotalUploadBytes = 0;
+	TotalSkippedUploadCount = 0;
 }
 
 
@@ -420,7 +661,7 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 bool ISimpleShader::SetData(std::string name, const void* data, unsigned int size)
 {
 	// Look for the variable and verify
-	SimpleShaderVariable* var = FindVariable(name, -1);
+	const SimpleShaderVariable* var = FindVariable(name, -1);
 	if (var == 0)
 	{
 		if (ReportWarnings)
@@ -446,15 +687,98 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 	}
 
 	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
+	SimpleShaderVariableHandle handle;
+	handle.ByteOffset = var->ByteOffset;
+	handle.Size = var->Size;
+	handle.ConstantBufferIndex = var->ConstantBufferIndex;
+	return SetData(handle, data, size);
+}
 
-	// Success
+// --------------------------------------------------------
+// Copies a whole constant buffer's worth of data at once, from
+// a struct generated to match the buffer's layout
+//
+// bufferName - The name of the constant buffer
+// layoutHash - The hash of the layout the data was built for
+// data - The data to set in the buffer
+// size - The size of the data (this must be less than or
+//        equal to the buffer's size)
+//
+// Returns true if data is copied, false if the buffer doesn't
+// exist or its layout has changed since the struct was generated
+// --------------------------------------------------------
+bool ISimpleShader::SetBufferData(std::string bufferName, unsigned int layoutHash, const void* data, unsigned int size)
+{
+	SimpleShaderVariableHandle handle = GetBufferHandle(bufferName, layoutHash);
+	if (!handle.IsValid() || size > handle.Size)
+	{
+		if (ReportErrors)
+		{
+			LogError("SimpleShader::SetBufferData() - Constant buffer '");
+			Log(bufferName);
+			LogError("' not found, or its layout doesn't match the data. Regenerate ShaderLayouts.h after changing the shader.\n");
+		}
+		return false;
+	}
+
+	return constants.SetData(handle, data, size);
+}
+
+// --------------------------------------------------------
+// Gets a handle covering a whole constant buffer, for setting
+// it from a generated struct without looking it up each time
+//
+// Returns an invalid handle if the buffer doesn't exist or
+// doesn't have the layout the struct was generated from
+// --------------------------------------------------------
+SimpleShaderVariableHandle ISimpleShader::GetBufferHandle(std::string bufferName, unsigned int layoutHash)
+{
+	int index = constants.FindBuffer(bufferName);
+	if (index < 0)
+		return SimpleShaderVariableHandle();
+
+	return constants.GetBufferHandle(index, layoutHash);
+}
+
+// --------------------------------------------------------
+// Marks a constant buffer as owned by something outside the
+// shader, which sets its own copy of the buffer instead
+//
+// Returns false if the buffer doesn't exist
+// --------------------------------------------------------
+bool ISimpleShader::SetBufferExternal(std::string bufferName, bool external)
+{
+	SimpleConstantBuffer* cb = FindConstantBuffer(bufferName);
+	if (cb == 0)
+		return false;
+
+	// Taking the buffer back means the shader's copy is stale
+	if (cb->External && !external)
+		constants.MarkDirty((unsigned int)(cb - constantBuffers));
+
+	cb->External = external;
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a variable through a handle with arbitrary data of
+// the specified size
+//
+// handle - The variable's handle, from GetVariableHandle()
+// data - The data to set in the buffer
+// size - The size of the data (this must be less than or
+//        equal to the variable's size)
+//
+// Returns true if data is copied, false if the handle is
+// invalid or the data is too large
+// --------------------------------------------------------
+bool ISimpleShader::SetData(SimpleShaderVariableHandle handle, const void* data, unsigned int size)
+{
+	// Invalid handles come from variables that don't exist in this shader,
+	// and unchanged values are skipped unless CompareOnSet is off
+	return constants.SetData(handle, data, size);
+}
+
 // --------------------------------------------------------
 // Sets INTEGER data
 // --------------------------------------------------------
@@ -535,6 +859,54 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 dat
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
 
+// --------------------------------------------------------
+// Sets INTEGER data through a handle
+// --------------------------------------------------------
+bool ISimpleShader::SetInt(SimpleShaderVariableHandle handle, int data)
+{
+	return this->SetData(handle, &data, sizeof(int));
+}
+
+// --------------------------------------------------------
+// Sets a FLOAT variable through a handle
+// --------------------------------------------------------
+bool ISimpleShader::SetFloat(SimpleShaderVariableHandle handle, float data)
+{
+	return this->SetData(handle, &data, sizeof(float));
+}
+
+// --------------------------------------------------------
+// Sets a FLOAT2 variable through a handle
+// --------------------------------------------------------
+bool ISimpleShader::SetFloat2(SimpleShaderVariableHandle handle, const DirectX::XMFLOAT2& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 2);
+}
+
+// --------------------------------------------------------
+// Sets a FLOAT3 variable through a handle
+// --------------------------------------------------------
+bool ISimpleShader::SetFloat3(SimpleShaderVariableHandle handle, const DirectX::XMFLOAT3& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 3);
+}
+
+// --------------------------------------------------------
+// Sets a FLOAT4 variable through a handle
+// --------------------------------------------------------
+bool ISimpleShader::SetFloat4(SimpleShaderVariableHandle handle, const DirectX::XMFLOAT4& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 4);
+}
+
+// --------------------------------------------------------
+// Sets a MATRIX (4x4) variable through a handle
+// --------------------------------------------------------
+bool ISimpleShader::SetMatrix4x4(SimpleShaderVariableHandle handle, const DirectX::XMFLOAT4X4& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 16);
+}
+
 // --------------------------------------------------------
 // Determines if the shader contains the specified
 // variable within one of its constant buffers
@@ -568,6 +940,35 @@ const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
 	return FindVariable(name, -1);
 }
 
+// --------------------------------------------------------
+// Looks up a variable once so it can be set through the
+// handle-based setters without any more name lookups
+//
+// Returns an invalid handle (which setters ignore) if the
+// variable doesn't exist
+// --------------------------------------------------------
+SimpleShaderVariableHandle ISimpleShader::GetVariableHandle(std::string name)
+{
+	SimpleShaderVariableHandle handle;
+
+	const SimpleShaderVariable* var = FindVariable(name, -1);
+	if (var == 0)
+	{
+		if (ReportWarnings)
+		{
+			LogWarning("SimpleShader::GetVariableHandle() - Shader variable '");
+			Log(name);
+			LogWarning("' not found. Ensure the name is spelled correctly and that it exists in a constant buffer in the shader.\n");
+		}
+		return handle;
+	}
+
+	handle.ByteOffset = var->ByteOffset;
+	handle.Size = var->Size;
+	handle.ConstantBufferIndex = var->ConstantBufferIndex;
+	return handle;
+}
+
 // --------------------------------------------------------
 // Gets info about an SRV in the shader (or null)
 //
@@ -767,28 +1168,15 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 		return true;
 
 	// Vertex shader was created successfully, so we now use the
-	// shader code to re-reflect and create an input layout that 
+	// reflected input signature to create an input layout that 
 	// matches what the vertex shader expects.  Code adapted from:
 	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
 
-	// Reflect shader info
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-	
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
 	// Read input layout description from shader info
 	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDesc;
-	for (unsigned int i = 0; i< shaderDesc.InputParameters; i++)
+	for (unsigned int i = 0; i < reflection.Inputs.size(); i++)
 	{
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetInputParameterDesc(i, &paramDesc);
+		const ReflectedInputElement& paramDesc = reflection.Inputs[i];
 
 		// Check the semantic name for "_PER_INSTANCE"
 		std::string perInstanceStr = "_PER_INSTANCE";
@@ -800,7 +1188,7 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 
 		// Fill out input element desc
 		D3D11_INPUT_ELEMENT_DESC elementDesc = {};
-		elementDesc.SemanticName = paramDesc.SemanticName;
+		elementDesc.SemanticName = paramDesc.SemanticName.c_str();
 		elementDesc.SemanticIndex = paramDesc.SemanticIndex;
 		elementDesc.InputSlot = 0;
 		elementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
@@ -869,21 +1257,60 @@ void SimpleVertexShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout.Get());
-	deviceContext->VSSetShader(shader.Get(), 0, 0);
+	if (States)
+	{
+		States->SetInputLayout(inputLayout.Get());
+		States->SetVertexShader(shader.Get());
+	}
+	else
+	{
+		deviceContext->IASetInputLayout(inputLayout.Get());
+		deviceContext->VSSetShader(shader.Get(), 0, 0);
+	}
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers, and
+		// ones that are bound by whatever owns them
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || constantBuffers[i].External)
 			continue;
 
 		// This is a real constant buffer, so set it
+		BindConstantBuffer(i);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer to its register, using its slice
+// of the shared constant ring if that's where it was uploaded
+// --------------------------------------------------------
+void SimpleVertexShader::BindConstantBuffer(unsigned int index)
+{
+	SimpleConstantBuffer* cb = &constantBuffers[index];
+	if (States)
+	{
+		if (cb->InRing && ConstantRing)
+			States->SetConstantBuffer(STAGE_VERTEX, cb->BindIndex, ConstantRing->GetBuffer(), cb->RingFirstConstant, cb->RingConstantCount);
+		else
+			States->SetConstantBuffer(STAGE_VERTEX, cb->BindIndex, cb->ConstantBuffer.Get());
+	}
+	else if (cb->InRing && ConstantRing)
+	{
+		ID3D11Buffer* ring = ConstantRing->GetBuffer();
+		deviceContext1->VSSetConstantBuffers1(
+			cb->BindIndex,
+			1,
+			&ring,
+			&cb->RingFirstConstant,
+			&cb->RingConstantCount);
+	}
+	else
+	{
 		deviceContext->VSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+			cb->ConstantBuffer.GetAddressOf());
 	}
 }
 
@@ -911,7 +1338,10 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 	}
 
 	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (States)
+		States->SetShaderResource(STAGE_VERTEX, srvInfo->BindIndex, srv.Get());
+	else
+		deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -941,7 +1371,10 @@ bool SimpleVertexShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 	}
 
 	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (States)
+		States->SetSampler(STAGE_VERTEX, sampInfo->BindIndex, samplerState.Get());
+	else
+		deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
@@ -1012,20 +1445,54 @@ void SimplePixelShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 	
 	// Set the shader
-	deviceContext->PSSetShader(shader.Get(), 0, 0);
+	if (States)
+		States->SetPixelShader(shader.Get());
+	else
+		deviceContext->PSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers, and
+		// ones that are bound by whatever owns them
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || constantBuffers[i].External)
 			continue;
 
 		// This is a real constant buffer, so set it
+		BindConstantBuffer(i);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer to its register, using its slice
+// of the shared constant ring if that's where it was uploaded
+// --------------------------------------------------------
+void SimplePixelShader::BindConstantBuffer(unsigned int index)
+{
+	SimpleConstantBuffer* cb = &constantBuffers[index];
+	if (States)
+	{
+		if (cb->InRing && ConstantRing)
+			States->SetConstantBuffer(STAGE_PIXEL, cb->BindIndex, ConstantRing->GetBuffer(), cb->RingFirstConstant, cb->RingConstantCount);
+		else
+			States->SetConstantBuffer(STAGE_PIXEL, cb->BindIndex, cb->ConstantBuffer.Get());
+	}
+	else if (cb->InRing && ConstantRing)
+	{
+		ID3D11Buffer* ring = ConstantRing->GetBuffer();
+		deviceContext1->PSSetConstantBuffers1(
+			cb->BindIndex,
+			1,
+			&ring,
+			&cb->RingFirstConstant,
+			&cb->RingConstantCount);
+	}
+	else
+	{
 		deviceContext->PSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+			cb->ConstantBuffer.GetAddressOf());
 	}
 }
 
@@ -1053,7 +1520,10 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, Microsoft::WRL::
 	}
 
 	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	if (States)
+		States->SetShaderResource(STAGE_PIXEL, srvInfo->BindIndex, srv.Get());
+	else
+		deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
 
 	// Success
 	return true;
@@ -1083,12 +1553,51 @@ bool SimplePixelShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr
 	}
 
 	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	if (States)
+		States->SetSampler(STAGE_PIXEL, sampInfo->BindIndex, samplerState.Get());
+	else
+		deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a range of shader resource views in the pixel shader
+// stage, starting at the given register
+// --------------------------------------------------------
+void SimplePixelShader::SetShaderResourceViews(unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* srvs)
+{
+	if (States)
+		States->SetShaderResources(STAGE_PIXEL, startSlot, count, srvs);
+	else
+		deviceContext->PSSetShaderResources(startSlot, count, srvs);
+}
+
+// --------------------------------------------------------
+// Sets a range of sampler states in the pixel shader stage,
+// starting at the given register
+// --------------------------------------------------------
+void SimplePixelShader::SetSamplerStates(unsigned int startSlot, unsigned int count, ID3D11SamplerState* const* samplerStates)
+{
+	if (States)
+		States->SetSamplers(STAGE_PIXEL, startSlot, count, samplerStates);
+	else
+		deviceContext->PSSetSamplers(startSlot, count, samplerStates);
+}
+
+// --------------------------------------------------------
+// Binds a constant buffer created outside of the shader
+// - See SetBufferExternal()
+// --------------------------------------------------------
+void SimplePixelShader::SetExternalBuffer(unsigned int slot, ID3D11Buffer* buffer)
+{
+	if (States)
+		States->SetConstantBuffer(STAGE_PIXEL, slot, buffer);
+	else
+		deviceContext->PSSetConstantBuffers(slot, 1, &buffer);
+}
+
 
 
 
@@ -1161,15 +1670,39 @@ void SimpleDomainShader::SetShaderAndCBs()
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers, and
+		// ones that are bound by whatever owns them
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || constantBuffers[i].External)
 			continue;
 
 		// This is a real constant buffer, so set it
+		BindConstantBuffer(i);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer to its register, using its slice
+// of the shared constant ring if that's where it was uploaded
+// --------------------------------------------------------
+void SimpleDomainShader::BindConstantBuffer(unsigned int index)
+{
+	SimpleConstantBuffer* cb = &constantBuffers[index];
+	if (cb->InRing && ConstantRing)
+	{
+		ID3D11Buffer* ring = ConstantRing->GetBuffer();
+		deviceContext1->DSSetConstantBuffers1(
+			cb->BindIndex,
+			1,
+			&ring,
+			&cb->RingFirstConstant,
+			&cb->RingConstantCount);
+	}
+	else
+	{
 		deviceContext->DSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+			cb->ConstantBuffer.GetAddressOf());
 	}
 }
 
@@ -1304,15 +1837,39 @@ void SimpleHullShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers, and
+		// ones that are bound by whatever owns them
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || constantBuffers[i].External)
 			continue;
 
 		// This is a real constant buffer, so set it
+		BindConstantBuffer(i);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer to its register, using its slice
+// of the shared constant ring if that's where it was uploaded
+// --------------------------------------------------------
+void SimpleHullShader::BindConstantBuffer(unsigned int index)
+{
+	SimpleConstantBuffer* cb = &constantBuffers[index];
+	if (cb->InRing && ConstantRing)
+	{
+		ID3D11Buffer* ring = ConstantRing->GetBuffer();
+		deviceContext1->HSSetConstantBuffers1(
+			cb->BindIndex,
+			1,
+			&ring,
+			&cb->RingFirstConstant,
+			&cb->RingConstantCount);
+	}
+	else
+	{
 		deviceContext->HSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+			cb->ConstantBuffer.GetAddressOf());
 	}
 }
 
@@ -1578,15 +2135,39 @@ void SimpleGeometryShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers, and
+		// ones that are bound by whatever owns them
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || constantBuffers[i].External)
 			continue;
 
 		// This is a real constant buffer, so set it
+		BindConstantBuffer(i);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer to its register, using its slice
+// of the shared constant ring if that's where it was uploaded
+// --------------------------------------------------------
+void SimpleGeometryShader::BindConstantBuffer(unsigned int index)
+{
+	SimpleConstantBuffer* cb = &constantBuffers[index];
+	if (cb->InRing && ConstantRing)
+	{
+		ID3D11Buffer* ring = ConstantRing->GetBuffer();
+		deviceContext1->GSSetConstantBuffers1(
+			cb->BindIndex,
+			1,
+			&ring,
+			&cb->RingFirstConstant,
+			&cb->RingConstantCount);
+	}
+	else
+	{
 		deviceContext->GSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+			cb->ConstantBuffer.GetAddressOf());
 	}
 }
 
@@ -1788,15 +2369,39 @@ void SimpleComputeShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers, and
+		// ones that are bound by whatever owns them
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || constantBuffers[i].External)
 			continue;
 
 		// This is a real constant buffer, so set it
+		BindConstantBuffer(i);
+	}
+}
+
+// --------------------------------------------------------
+// Binds one constant buffer to its register, using its slice
+// of the shared constant ring if that's where it was uploaded
+// --------------------------------------------------------
+void SimpleComputeShader::BindConstantBuffer(unsigned int index)
+{
+	SimpleConstantBuffer* cb = &constantBuffers[index];
+	if (cb->InRing && ConstantRing)
+	{
+		ID3D11Buffer* ring = ConstantRing->GetBuffer();
+		deviceContext1->CSSetConstantBuffers1(
+			cb->BindIndex,
+			1,
+			&ring,
+			&cb->RingFirstConstant,
+			&cb->RingConstantCount);
+	}
+	else
+	{
 		deviceContext->CSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
+			cb->BindIndex,
 			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+			cb->ConstantBuffer.GetAddressOf());
 	}
 }
 
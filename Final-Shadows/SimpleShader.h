@@ -2,31 +2,26 @@
 #pragma comment(lib, "dxguid.lib")
 #pragma comment(lib, "d3dcompiler.lib")
 
-#include <d3d11.h>
+#include <d3d11_1.h>
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 #include <wrl/client.h>
 
+#include <atomic>
 #include <unordered_map>
 #include <vector>
 #include <string>
 
+#include "ShaderReflection.h"
+#include "ShaderConstants.h"
 
-// --------------------------------------------------------
-// Used by simple shaders to store information about
-// specific variables in constant buffers
-// --------------------------------------------------------
-struct SimpleShaderVariable
-{
-	unsigned int ByteOffset;
-	unsigned int Size;
-	unsigned int ConstantBufferIndex;
-};
+class ConstantBufferRing;
+class StateCache;
 
 // --------------------------------------------------------
 // Contains information about a specific
-// constant buffer in a shader, as well as
-// the local data buffer for it
+// constant buffer in a shader
+// - Its local data is kept by the shader's ShaderConstants
 // --------------------------------------------------------
 struct SimpleConstantBuffer
 {
@@ -35,8 +30,15 @@ struct SimpleConstantBuffer
 	unsigned int Size = 0;
 	unsigned int BindIndex = 0;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ConstantBuffer = 0;
-	unsigned char* LocalDataBuffer = 0;
 	std::vector<SimpleShaderVariable> Variables;
+	unsigned int LayoutHash = 0;	// From ShaderReflection::LayoutHash()
+	bool External = false;	// Uploaded and bound by whatever owns it, not the shader
+
+	// Where the data was last uploaded, when using the shared constant ring
+	bool InRing = false;
+	unsigned int RingGeneration = 0;
+	unsigned int RingFirstConstant = 0;
+	unsigned int RingConstantCount = 0;
 };
 
 // --------------------------------------------------------
@@ -59,8 +61,10 @@ struct SimpleSampler
 
 // --------------------------------------------------------
 // Base abstract class for simplifying shader handling
+// - Constant buffer data is packed by a ShaderConstants, which
+//   the shader is the device for
 // --------------------------------------------------------
-class ISimpleShader
+class ISimpleShader : protected IConstantBufferDevice
 {
 public:
 	ISimpleShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
@@ -89,6 +93,32 @@ public:
 	bool SetMatrix4x4(std::string name, const float data[16]);
 	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
 
+	// Sets shader data through handles from GetVariableHandle()
+	bool SetData(SimpleShaderVariableHandle handle, const void* data, unsigned int size);
+
+	bool SetInt(SimpleShaderVariableHandle handle, int data);
+	bool SetFloat(SimpleShaderVariableHandle handle, float data);
+	bool SetFloat2(SimpleShaderVariableHandle handle, const DirectX::XMFLOAT2& data);
+	bool SetFloat3(SimpleShaderVariableHandle handle, const DirectX::XMFLOAT3& data);
+	bool SetFloat4(SimpleShaderVariableHandle handle, const DirectX::XMFLOAT4& data);
+	bool SetMatrix4x4(SimpleShaderVariableHandle handle, const DirectX::XMFLOAT4X4& data);
+
+	// Sets a whole constant buffer from a struct in ShaderLayouts.h
+	// - Handles cover the whole buffer, and are only valid while
+	//   the buffer's layout matches the struct's
+	bool SetBufferData(std::string bufferName, unsigned int layoutHash, const void* data, unsigned int size);
+	SimpleShaderVariableHandle GetBufferHandle(std::string bufferName, unsigned int layoutHash);
+
+	template<typename T> bool SetBufferData(const T& data) { return SetBufferData(T::BufferName(), T::LayoutHash, &data, sizeof(T)); }
+	template<typename T> bool SetBufferData(const T& data, unsigned int size) { return SetBufferData(T::BufferName(), T::LayoutHash, &data, size < sizeof(T) ? size : (unsigned int)sizeof(T)); }
+	template<typename T> SimpleShaderVariableHandle GetBufferHandle() { return GetBufferHandle(T::BufferName(), T::LayoutHash); }
+	template<typename T> bool HasBufferLayout() { return GetBufferHandle<T>().IsValid(); }
+
+	// Hands a buffer over to something that keeps its own GPU copy,
+	// such as a material, after which the shader neither uploads
+	// nor binds it
+	bool SetBufferExternal(std::string bufferName, bool external);
+
 	// Setting shader resources
 	virtual bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) = 0;
 	virtual bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState) = 0;
@@ -100,6 +130,7 @@ public:
 
 	// Getting data about variables and resources
 	const SimpleShaderVariable* GetVariableInfo(std::string name);
+	SimpleShaderVariableHandle GetVariableHandle(std::string name);
 	
 	const SimpleSRV* GetShaderResourceViewInfo(std::string name);
 	const SimpleSRV* GetShaderResourceViewInfo(unsigned int index);
@@ -116,33 +147,66 @@ public:
 	const SimpleConstantBuffer* GetBufferInfo(unsigned int index);
 	
 	// Misc getters
+	Microsoft::WRL::ComPtr<ID3D11Device> GetDevice() { return device; }
 	Microsoft::WRL::ComPtr<ID3DBlob> GetShaderBlob() { return shaderBlob; }
+	const ShaderReflection& GetReflection() { return reflection; }
 
 	// Error reporting
 	static bool ReportErrors;
 	static bool ReportWarnings;
 
+	// Constant buffer upload tracking
+	// - Unchanged values are skipped while ShaderConstants::CompareOnSet is set
+	static std::atomic<unsigned int> TotalUploadCount;
+	static std::atomic<unsigned int> TotalUploadBytes;
+	static std::atomic<unsigned int> TotalSkippedUploadCount;
+	static void ResetUploadStats();
+	unsigned int GetUploadCount() { return uploadCount; }
+	unsigned int GetUploadBytes() { return uploadBytes; }
+	void MarkAllBuffersDirty();
+
+	// Shared upload ring for constant buffers, on the thread that set it
+	static thread_local ConstantBufferRing* ConstantRing;
+	static bool UseConstantRing;
+
+	// Filters out redundant vertex and pixel shader bindings, and
+	// picks the context the calling thread records into
+	static thread_local StateCache* States;
+
+	// Reflection data saved next to compiled shaders, and how often
+	// it could be used instead of reflecting them again
+	static bool UseReflectionCache;
+	static unsigned int ReflectionCacheHits;
+	static unsigned int ReflectionCacheMisses;
+
 protected:
 	
 	bool shaderValid;
 	Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
+	ShaderReflection reflection;
 	Microsoft::WRL::ComPtr<ID3D11Device> device;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> deviceContext1;
 
 	// Resource counts
 	unsigned int constantBufferCount;
+
+	// Uploads made by this shader
+	unsigned int uploadCount;
+	unsigned int uploadBytes;
 	
 	// Maps for variables and buffers
 	SimpleConstantBuffer*		constantBuffers; // For index-based lookup
+	ShaderConstants				constants;		// Local data and variables, by the same index
 	std::vector<SimpleSRV*>		shaderResourceViews;
 	std::vector<SimpleSampler*>	samplerStates;
-	std::unordered_map<std::string, SimpleConstantBuffer*> cbTable;
-	std::unordered_map<std::string, SimpleShaderVariable> varTable;
 	std::unordered_map<std::string, SimpleSRV*> textureTable;
 	std::unordered_map<std::string, SimpleSampler*> samplerTable;
 
 	// Initialization method
 	bool LoadShaderFile(LPCWSTR shaderFile);
+	bool ReflectShader();
+	static std::wstring ReflectionFileFor(LPCWSTR shaderFile);
 
 	// Pure virtual functions for dealing with shader types
 	virtual bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob) = 0;
@@ -150,8 +214,16 @@ protected:
 
 	virtual void CleanUp();
 
+	// Copies one buffer's local data to the GPU, which stand-in
+	// shaders can override to record uploads instead
+	virtual void UploadConstantBuffer(unsigned int index);
+	void UpdateConstantBuffer(unsigned int index, const void* data, unsigned int size);
+	virtual void BindConstantBuffer(unsigned int index) = 0;
+	bool NeedsUpload(unsigned int index);
+	bool IsConstantRingActive();
+
 	// Helpers for finding data by name
-	SimpleShaderVariable* FindVariable(std::string name, int size);
+	const SimpleShaderVariable* FindVariable(std::string name, int size);
 	SimpleConstantBuffer* FindConstantBuffer(std::string name);
 
 	// Error logging
@@ -187,6 +259,7 @@ protected:
 	 Microsoft::WRL::ComPtr<ID3D11VertexShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(unsigned int index);
 	void CleanUp();
 };
 
@@ -204,10 +277,19 @@ public:
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
 
+	// Consecutive registers set in one call, for callers that have
+	// already looked up where their resources go
+	void SetShaderResourceViews(unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* srvs);
+	void SetSamplerStates(unsigned int startSlot, unsigned int count, ID3D11SamplerState* const* samplerStates);
+
+	// Binds a buffer the shader was told is external, at its register
+	void SetExternalBuffer(unsigned int slot, ID3D11Buffer* buffer);
+
 protected:
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(unsigned int index);
 	void CleanUp();
 };
 
@@ -228,6 +310,7 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11DomainShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(unsigned int index);
 	void CleanUp();
 };
 
@@ -248,6 +331,7 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11HullShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(unsigned int index);
 	void CleanUp();
 };
 
@@ -280,6 +364,7 @@ protected:
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	bool CreateShaderWithStreamOut(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(unsigned int index);
 	void CleanUp();
 
 	// Helpers
@@ -319,5 +404,6 @@ protected:
 
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void BindConstantBuffer(unsigned int index);
 	void CleanUp();
 };
\ No newline at end of file
@@ -49,7 +49,7 @@ Sky::~Sky()
 }
 
 
-void Sky::Draw(std::shared_ptr<Camera> camera, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+void Sky::Draw(std::shared_ptr<Camera> camera, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, StateCache* states)
 {
 	// Change necessary render states
 	context->RSSetState(rasterizerState.Get());
@@ -70,7 +70,7 @@ void Sky::Draw(std::shared_ptr<Camera> camera, Microsoft::WRL::ComPtr<ID3D11Devi
 	pixelShader->CopyAllBufferData();
 
 	// Draw the mesh
-	mesh->Draw();
+	mesh->Draw(states);
 
 	// Reset any render states changed
 	context->RSSetState(nullptr);
@@ -37,7 +37,7 @@ public:
 	);
 	~Sky();
 
-	void Draw(std::shared_ptr<Camera> camera, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void Draw(std::shared_ptr<Camera> camera, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, StateCache* states = 0);
 
 private:
 	// Helper for creating a cubemap from 6 individual textures
@@ -0,0 +1,212 @@
+#include "StateCache.h"
+
+#define ARRAY_COUNT(a) (sizeof(a) / sizeof(a[0]))
+
+void RecordingStateBackend::Record(RecordedStateCall::Type type, StateStage stage, unsigned int slot, const void* object,
+	unsigned int a, unsigned int b, unsigned int c, const void* object2)
+{
+	RecordedStateCall call = {};
+	call.type = type;
+	call.stage = stage;
+	call.slot = slot;
+	call.object = object;
+	call.values[0] = a;
+	call.values[1] = b;
+	call.values[2] = c;
+	call.object2 = object2;
+	calls.push_back(call);
+}
+
+void RecordingStateBackend::SetInputLayout(ID3D11InputLayout* layout) { Record(RecordedStateCall::InputLayout, STAGE_VERTEX, 0, layout); }
+void RecordingStateBackend::SetPrimitiveTopology(StateTopology topology) { Record(RecordedStateCall::PrimitiveTopology, STAGE_VERTEX, 0, 0, topology); }
+void RecordingStateBackend::SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset) { Record(RecordedStateCall::VertexBuffer, STAGE_VERTEX, slot, buffer, stride, offset); }
+void RecordingStateBackend::SetIndexBuffer(ID3D11Buffer* buffer, StateIndexFormat format, unsigned int offset) { Record(RecordedStateCall::IndexBuffer, STAGE_VERTEX, 0, buffer, format, offset); }
+void RecordingStateBackend::SetVertexShader(ID3D11VertexShader* shader) { Record(RecordedStateCall::VertexShader, STAGE_VERTEX, 0, shader); }
+void RecordingStateBackend::SetPixelShader(ID3D11PixelShader* shader) { Record(RecordedStateCall::PixelShader, STAGE_PIXEL, 0, shader); }
+void RecordingStateBackend::SetConstantBuffer(StateStage stage, unsigned int slot, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int count) { Record(RecordedStateCall::ConstantBuffer, stage, slot, buffer, firstConstant, count); }
+void RecordingStateBackend::SetShaderResource(StateStage stage, unsigned int slot, ID3D11ShaderResourceView* srv) { Record(RecordedStateCall::ShaderResource, stage, slot, srv); }
+void RecordingStateBackend::SetSampler(StateStage stage, unsigned int slot, ID3D11SamplerState* sampler) { Record(RecordedStateCall::Sampler, stage, slot, sampler); }
+void RecordingStateBackend::UpdateBuffer(ID3D11Buffer* buffer, const void* /*data*/, unsigned int size) { Record(RecordedStateCall::UpdateBuffer, STAGE_VERTEX, 0, buffer, size); }
+void RecordingStateBackend::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) { Record(RecordedStateCall::Draw, STAGE_VERTEX, 0, 0, indexCount, startIndex, (unsigned int)baseVertex); }
+
+void RecordingStateBackend::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int /*startIndex*/, int /*baseVertex*/, unsigned int startInstance)
+{
+	Record(RecordedStateCall::DrawInstanced, STAGE_VERTEX, 0, 0, indexCount, instanceCount, startInstance);
+}
+
+void RecordingStateBackend::ClearRenderTarget(ID3D11RenderTargetView* rtv, const float /*color*/[4]) { Record(RecordedStateCall::ClearRenderTarget, STAGE_PIXEL, 0, rtv); }
+void RecordingStateBackend::ClearDepth(ID3D11DepthStencilView* dsv, float /*depth*/) { Record(RecordedStateCall::ClearDepth, STAGE_PIXEL, 0, dsv); }
+
+void RecordingStateBackend::SetViewport(const StateViewport& viewport)
+{
+	Record(RecordedStateCall::Viewport, STAGE_PIXEL, 0, 0, (unsigned int)viewport.width, (unsigned int)viewport.height);
+}
+
+void RecordingStateBackend::SetRenderTargets(ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv) { Record(RecordedStateCall::RenderTargets, STAGE_PIXEL, 0, rtv, 0, 0, 0, dsv); }
+
+
+StateCache::StateCache(std::shared_ptr<IStateBackend> backend)
+	:
+	backend(backend),
+	enabled(true),
+	stats()
+{
+	Invalidate();
+}
+
+// --------------------------------------------------------
+// Forgets everything that's bound, so the next change to each
+// slot is passed on no matter what it is
+// --------------------------------------------------------
+void StateCache::Invalidate()
+{
+	inputLayout.known = false;
+	topology.known = false;
+	indexBuffer.known = false;
+	vertexShader.known = false;
+	pixelShader.known = false;
+
+	for (auto& b : vertexBuffers) b.known = false;
+	for (int s = 0; s < STAGE_COUNT; s++)
+	{
+		for (auto& b : constantBuffers[s]) b.known = false;
+		for (auto& b : shaderResources[s]) b.known = false;
+		for (auto& b : samplers[s]) b.known = false;
+	}
+}
+
+// --------------------------------------------------------
+// Decides whether a change to one slot needs to be passed on,
+// and remembers the new value if so
+//
+// binding - The slot's last known value, or null for slots
+//           outside of what the cache tracks
+// --------------------------------------------------------
+bool StateCache::Filter(Binding* binding, const void* object, unsigned int a, unsigned int b)
+{
+	if (enabled && binding &&
+		binding->known &&
+		binding->object == object &&
+		binding->values[0] == a &&
+		binding->values[1] == b)
+	{
+		stats.elided++;
+		return false;
+	}
+
+	if (binding)
+	{
+		binding->known = true;
+		binding->object = object;
+		binding->values[0] = a;
+		binding->values[1] = b;
+	}
+
+	stats.issued++;
+	return true;
+}
+
+// --------------------------------------------------------
+// Filter() for a run of slots bound in one call, counted as a
+// single change either way
+//
+// bindings - Every slot of one kind for one stage, of which
+//            startSlot to startSlot + count are being set
+// --------------------------------------------------------
+bool StateCache::FilterRange(Binding* bindings, unsigned int bindingCount, unsigned int startSlot, unsigned int count, const void* const* objects)
+{
+	bool changed = !enabled || startSlot + count > bindingCount;
+	for (unsigned int i = 0; i < count && !changed; i++)
+	{
+		const Binding& binding = bindings[startSlot + i];
+		changed = !binding.known || binding.object != objects[i];
+	}
+
+	if (!changed)
+	{
+		stats.elided++;
+		return false;
+	}
+
+	for (unsigned int i = 0; i < count && startSlot + i < bindingCount; i++)
+	{
+		Binding& binding = bindings[startSlot + i];
+		binding.known = true;
+		binding.object = objects[i];
+		binding.values[0] = 0;
+		binding.values[1] = 0;
+	}
+
+	stats.issued++;
+	return true;
+}
+
+void StateCache::SetInputLayout(ID3D11InputLayout* layout)
+{
+	if (Filter(&inputLayout, layout))
+		backend->SetInputLayout(layout);
+}
+
+void StateCache::SetPrimitiveTopology(StateTopology t)
+{
+	if (Filter(&topology, 0, t))
+		backend->SetPrimitiveTopology(t);
+}
+
+void StateCache::SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset)
+{
+	Binding* binding = slot < ARRAY_COUNT(vertexBuffers) ? &vertexBuffers[slot] : 0;
+	if (Filter(binding, buffer, stride, offset))
+		backend->SetVertexBuffer(slot, buffer, stride, offset);
+}
+
+void StateCache::SetIndexBuffer(ID3D11Buffer* buffer, StateIndexFormat format, unsigned int offset)
+{
+	if (Filter(&indexBuffer, buffer, format, offset))
+		backend->SetIndexBuffer(buffer, format, offset);
+}
+
+void StateCache::SetVertexShader(ID3D11VertexShader* shader)
+{
+	if (Filter(&vertexShader, shader))
+		backend->SetVertexShader(shader);
+}
+
+void StateCache::SetPixelShader(ID3D11PixelShader* shader)
+{
+	if (Filter(&pixelShader, shader))
+		backend->SetPixelShader(shader);
+}
+
+void StateCache::SetConstantBuffer(StateStage stage, unsigned int slot, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int count)
+{
+	Binding* binding = slot < ARRAY_COUNT(constantBuffers[stage]) ? &constantBuffers[stage][slot] : 0;
+	if (Filter(binding, buffer, firstConstant, count))
+		backend->SetConstantBuffer(stage, slot, buffer, firstConstant, count);
+}
+
+void StateCache::SetShaderResource(StateStage stage, unsigned int slot, ID3D11ShaderResourceView* srv)
+{
+	Binding* binding = slot < ARRAY_COUNT(shaderResources[stage]) ? &shaderResources[stage][slot] : 0;
+	if (Filter(binding, srv))
+		backend->SetShaderResource(stage, slot, srv);
+}
+
+void StateCache::SetSampler(StateStage stage, unsigned int slot, ID3D11SamplerState* sampler)
+{
+	Binding* binding = slot < ARRAY_COUNT(samplers[stage]) ? &samplers[stage][slot] : 0;
+	if (Filter(binding, sampler))
+		backend->SetSampler(stage, slot, sampler);
+}
+
+void StateCache::SetShaderResources(StateStage stage, unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* srvs)
+{
+	if (FilterRange(shaderResources[stage], ARRAY_COUNT(shaderResources[stage]), startSlot, count, (const void* const*)srvs))
+		backend->SetShaderResources(stage, startSlot, count, srvs);
+}
+
+void StateCache::SetSamplers(StateStage stage, unsigned int startSlot, unsigned int count, ID3D11SamplerState* const* samplerStates)
+{
+	if (FilterRange(samplers[stage], ARRAY_COUNT(samplers[stage]), startSlot, count, (const void* const*)samplerStates))
+		backend->SetSamplers(stage, startSlot, count, samplerStates);
+}
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "StateStage.h"
+
+// Direct3D objects are only ever passed along and compared by
+// address here, so they don't need to be any more than declared
+struct ID3D11InputLayout;
+struct ID3D11Buffer;
+struct ID3D11VertexShader;
+struct ID3D11PixelShader;
+struct ID3D11ShaderResourceView;
+struct ID3D11SamplerState;
+struct ID3D11RenderTargetView;
+struct ID3D11DepthStencilView;
+
+// Slots the cache keeps track of, matching Direct3D 11's limits
+#define STATE_VERTEX_BUFFER_SLOTS 32
+#define STATE_CONSTANT_BUFFER_SLOTS 14
+#define STATE_SHADER_RESOURCE_SLOTS 128
+#define STATE_SAMPLER_SLOTS 16
+
+// --------------------------------------------------------
+// Primitive topologies, with the same values as
+// D3D11_PRIMITIVE_TOPOLOGY
+// --------------------------------------------------------
+enum StateTopology
+{
+	TOPOLOGY_POINT_LIST = 1,
+	TOPOLOGY_LINE_LIST = 2,
+	TOPOLOGY_LINE_STRIP = 3,
+	TOPOLOGY_TRIANGLE_LIST = 4,
+	TOPOLOGY_TRIANGLE_STRIP = 5
+};
+
+// --------------------------------------------------------
+// Index buffer formats, with the same values as DXGI_FORMAT
+// --------------------------------------------------------
+enum StateIndexFormat
+{
+	INDEX_FORMAT_R32_UINT = 42,
+	INDEX_FORMAT_R16_UINT = 57
+};
+
+// --------------------------------------------------------
+// Area of the render target drawn to, laid out like
+// D3D11_VIEWPORT
+// --------------------------------------------------------
+struct StateViewport
+{
+	float topLeftX;
+	float topLeftY;
+	float width;
+	float height;
+	float minDepth;
+	float maxDepth;
+};
+
+// --------------------------------------------------------
+// Where state changes end up once the cache lets them through
+// - Constant buffers with a count of 0 are bound whole,
+//   otherwise only firstConstant to firstConstant + count
+// - Buffer updates, draws, clears, viewports and render targets
+//   always go straight through, so everything a pass does
+//   reaches the same place
+// --------------------------------------------------------
+class IStateBackend
+{
+public:
+	virtual ~IStateBackend() {}
+
+	virtual void SetInputLayout(ID3D11InputLayout* layout) = 0;
+	virtual void SetPrimitiveTopology(StateTopology topology) = 0;
+	virtual void SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset) = 0;
+	virtual void SetIndexBuffer(ID3D11Buffer* buffer, StateIndexFormat format, unsigned int offset) = 0;
+	virtual void SetVertexShader(ID3D11VertexShader* shader) = 0;
+	virtual void SetPixelShader(ID3D11PixelShader* shader) = 0;
+	virtual void SetConstantBuffer(StateStage stage, unsigned int slot, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int count) = 0;
+	virtual void SetShaderResource(StateStage stage, unsigned int slot, ID3D11ShaderResourceView* srv) = 0;
+	virtual void SetSampler(StateStage stage, unsigned int slot, ID3D11SamplerState* sampler) = 0;
+	virtual void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size) = 0;
+
+	// Consecutive slots bound together - backends that can't do
+	// better than one slot at a time can leave these as they are
+	virtual void SetShaderResources(StateStage stage, unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* srvs)
+	{
+		for (unsigned int i = 0; i < count; i++)
+			SetShaderResource(stage, startSlot + i, srvs[i]);
+	}
+	virtual void SetSamplers(StateStage stage, unsigned int startSlot, unsigned int count, ID3D11SamplerState* const* samplerStates)
+	{
+		for (unsigned int i = 0; i < count; i++)
+			SetSampler(stage, startSlot + i, samplerStates[i]);
+	}
+	virtual void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) = 0;
+	virtual void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) = 0;
+	virtual void ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4]) = 0;
+	virtual void ClearDepth(ID3D11DepthStencilView* dsv, float depth) = 0;
+	virtual void SetViewport(const StateViewport& viewport) = 0;
+	virtual void SetRenderTargets(ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv) = 0;
+};
+
+// --------------------------------------------------------
+// One state change, as seen by a recording backend
+// --------------------------------------------------------
+struct RecordedStateCall
+{
+	enum Type
+	{
+		InputLayout,
+		PrimitiveTopology,
+		VertexBuffer,
+		IndexBuffer,
+		VertexShader,
+		PixelShader,
+		ConstantBuffer,
+		ShaderResource,
+		Sampler,
+		UpdateBuffer,
+		Draw,
+		DrawInstanced,
+		ClearRenderTarget,
+		ClearDepth,
+		Viewport,
+		RenderTargets
+	};
+
+	Type type;
+	StateStage stage;
+	unsigned int slot;
+	const void* object;		// Whatever was bound, compared by address only
+	unsigned int values[3];	// Stride/offset, format/offset, first constant/count, topology, draw counts or size
+	const void* object2;	// Depth stencil view, for render targets
+};
+
+// --------------------------------------------------------
+// Stand-in backend that only remembers what it was asked to
+// do, for checking the cache without a device or a GPU
+// - Not safe to share between threads, so give each its own
+// --------------------------------------------------------
+class RecordingStateBackend : public IStateBackend
+{
+public:
+	void SetInputLayout(ID3D11InputLayout* layout);
+	void SetPrimitiveTopology(StateTopology topology);
+	void SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset);
+	void SetIndexBuffer(ID3D11Buffer* buffer, StateIndexFormat format, unsigned int offset);
+	void SetVertexShader(ID3D11VertexShader* shader);
+	void SetPixelShader(ID3D11PixelShader* shader);
+	void SetConstantBuffer(StateStage stage, unsigned int slot, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int count);
+	void SetShaderResource(StateStage stage, unsigned int slot, ID3D11ShaderResourceView* srv);
+	void SetSampler(StateStage stage, unsigned int slot, ID3D11SamplerState* sampler);
+	void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size);
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance);
+	void ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4]);
+	void ClearDepth(ID3D11DepthStencilView* dsv, float depth);
+	void SetViewport(const StateViewport& viewport);
+	void SetRenderTargets(ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv);
+
+	const std::vector<RecordedStateCall>& GetCalls() { return calls; }
+	void Clear() { calls.clear(); }
+
+private:
+	void Record(RecordedStateCall::Type type, StateStage stage, unsigned int slot, const void* object,
+		unsigned int a = 0, unsigned int b = 0, unsigned int c = 0, const void* object2 = 0);
+
+	std::vector<RecordedStateCall> calls;
+};
+
+// --------------------------------------------------------
+// Counts of state changes made through the cache
+// --------------------------------------------------------
+struct StateCacheStats
+{
+	unsigned int issued;	// Passed on to the backend
+	unsigned int elided;	// Dropped for matching what's already bound
+};
+
+// --------------------------------------------------------
+// Drops state changes that match what's already bound
+//
+// The cache only knows about changes made through it, so
+// anything binding state directly on the context (ImGui, for
+// instance) has to be followed by Invalidate(), after which
+// every slot is treated as unknown and the next change to it
+// is always passed on.
+//
+// Bound objects are compared by address, which is safe since
+// the context holds a reference to whatever is bound
+// --------------------------------------------------------
+class StateCache
+{
+public:
+	StateCache(std::shared_ptr<IStateBackend> backend);
+
+	void SetInputLayout(ID3D11InputLayout* layout);
+	void SetPrimitiveTopology(StateTopology topology);
+	void SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset);
+	void SetIndexBuffer(ID3D11Buffer* buffer, StateIndexFormat format, unsigned int offset);
+	void SetVertexShader(ID3D11VertexShader* shader);
+	void SetPixelShader(ID3D11PixelShader* shader);
+	void SetConstantBuffer(StateStage stage, unsigned int slot, ID3D11Buffer* buffer, unsigned int firstConstant = 0, unsigned int count = 0);
+	void SetShaderResource(StateStage stage, unsigned int slot, ID3D11ShaderResourceView* srv);
+	void SetSampler(StateStage stage, unsigned int slot, ID3D11SamplerState* sampler);
+
+	// Ranges are passed on whole if any slot in them changed, and
+	// dropped without a single call if none did
+	void SetShaderResources(StateStage stage, unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* srvs);
+	void SetSamplers(StateStage stage, unsigned int startSlot, unsigned int count, ID3D11SamplerState* const* samplerStates);
+
+	// Never filtered, as these either aren't state changes or are
+	// rarely made more than once per pass
+	void UpdateBuffer(ID3D11Buffer* buffer, const void* data, unsigned int size) { backend->UpdateBuffer(buffer, data, size); }
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) { backend->DrawIndexed(indexCount, startIndex, baseVertex); }
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+	{
+		backend->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+	}
+	void ClearRenderTarget(ID3D11RenderTargetView* rtv, const float color[4]) { backend->ClearRenderTarget(rtv, color); }
+	void ClearDepth(ID3D11DepthStencilView* dsv, float depth) { backend->ClearDepth(dsv, depth); }
+	void SetViewport(const StateViewport& viewport) { backend->SetViewport(viewport); }
+	void SetRenderTargets(ID3D11RenderTargetView* rtv, ID3D11DepthStencilView* dsv) { backend->SetRenderTargets(rtv, dsv); }
+
+	// Swapping the backend keeps what's known to be bound, so the
+	// new one should be sending calls to the same place
+	std::shared_ptr<IStateBackend> GetBackend() { return backend; }
+	void SetBackend(std::shared_ptr<IStateBackend> b) { backend = b; }
+
+	void Invalidate();
+
+	const StateCacheStats& GetStats() { return stats; }
+	void ResetStats() { stats = {}; }
+	void AddStats(const StateCacheStats& other) { stats.issued += other.issued; stats.elided += other.elided; }
+	bool GetEnabled() { return enabled; }
+	void SetEnabled(bool e) { enabled = e; Invalidate(); }
+
+private:
+	// The last value sent for one slot, if it's still known
+	struct Binding
+	{
+		bool known;
+		const void* object;
+		unsigned int values[2];
+	};
+
+	bool Filter(Binding* binding, const void* object, unsigned int a = 0, unsigned int b = 0);
+	bool FilterRange(Binding* bindings, unsigned int bindingCount, unsigned int startSlot, unsigned int count, const void* const* objects);
+
+	std::shared_ptr<IStateBackend> backend;
+	bool enabled;
+	StateCacheStats stats;
+
+	Binding inputLayout;
+	Binding topology;
+	Binding indexBuffer;
+	Binding vertexShader;
+	Binding pixelShader;
+	Binding vertexBuffers[STATE_VERTEX_BUFFER_SLOTS];
+	Binding constantBuffers[STAGE_COUNT][STATE_CONSTANT_BUFFER_SLOTS];
+	Binding shaderResources[STAGE_COUNT][STATE_SHADER_RESOURCE_SLOTS];
+	Binding samplers[STAGE_COUNT][STATE_SAMPLER_SLOTS];
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+// --------------------------------------------------------
+// Shader stages the state cache keeps track of
+// --------------------------------------------------------
+enum StateStage
+{
+	STAGE_VERTEX,
+	STAGE_PIXEL,
+	STAGE_COUNT
+};
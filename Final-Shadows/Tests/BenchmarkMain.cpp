@@ -0,0 +1,82 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../Benchmarks.h"
+#include "../BenchmarkReport.h"
+
+// --------------------------------------------------------
+// The value of an option given as --name=value, or an empty
+// string if it isn't there
+// --------------------------------------------------------
+static std::string FindOption(int argc, char* argv[], const std::string& name)
+{
+	std::string option = "--" + name + "=";
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], option.c_str(), option.size()) == 0)
+			return argv[i] + option.size();
+	}
+	return "";
+}
+
+// --------------------------------------------------------
+// The per object constants of the scene's vertex shader, as
+// reflecting it gives them, for packing without the shader
+// --------------------------------------------------------
+static ShaderReflection VertexShaderConstants()
+{
+	ReflectedConstantBuffer cb = {};
+	cb.Name = "externalData";
+	cb.Size = 256;
+
+	const char* matrices[] = { "world", "view", "proj", "worldInvTranspose" };
+	for (unsigned int m = 0; m < 4; m++)
+		cb.Variables.push_back({ matrices[m], m * 64, 64, "float4x4", 0, {} });
+
+	ShaderReflection reflection;
+	reflection.ConstantBuffers.push_back(cb);
+	return reflection;
+}
+
+// --------------------------------------------------------
+// The renderer's CPU-side benchmarks without a window or
+// Direct3D, for running anywhere DirectXMath builds:
+//   FinalShadowsBenchmarks [--output=file] [--baseline=file]
+//                          [--threshold=percent] [--max-scale=n]
+// - Returns a BenchmarkResult, as the game's --benchmark does
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	std::string output = FindOption(argc, argv, "output");
+	std::string baseline = FindOption(argc, argv, "baseline");
+	std::string threshold = FindOption(argc, argv, "threshold");
+	std::string maxScale = FindOption(argc, argv, "max-scale");
+
+	std::vector<int> scales;
+	int largest = maxScale.empty() ? 1000000 : atoi(maxScale.c_str());
+	for (int scale = 10; scale <= largest && scale > 0; scale *= 10)
+		scales.push_back(scale);
+
+	BenchmarkReport report;
+	std::vector<std::string> names = { "world", "view", "proj", "worldInvTranspose" };
+	Benchmarks::Sweep(&report, scales, VertexShaderConstants(), names);
+
+	for (auto& record : report.GetRecords())
+		printf("%-32s %8d %10.3f ms\n", record.name.c_str(), record.scale, record.ms);
+
+	std::vector<BenchmarkRegression> regressions;
+	BenchmarkResult result = report.SaveAndCompare(
+		output.empty() ? "benchmark_results.json" : output,
+		baseline,
+		threshold.empty() ? 0.1f : (float)atof(threshold.c_str()) / 100.0f,
+		&regressions);
+
+	for (auto& r : regressions)
+		printf("Regression: %s at %d went from %.3f ms to %.3f ms\n", r.name.c_str(), r.scale, r.baselineMs, r.ms);
+	if (result != BENCHMARK_PASSED && result != BENCHMARK_REGRESSED)
+		printf("Benchmark run failed with code %d\n", (int)result);
+
+	return result;
+}
@@ -0,0 +1,117 @@
+#include <cstdio>
+#include <fstream>
+#include "TestFramework.h"
+#include "../BenchmarkReport.h"
+
+// Files for comparing runs, written next to wherever the tests run
+static const char* OutputFile = "BenchmarkReportTests_output.json";
+static const char* BaselineFile = "BenchmarkReportTests_baseline.json";
+
+static BenchmarkReport MakeReport(float sortMs)
+{
+	BenchmarkReport report;
+	report.Add("Render queue sort", 1000, sortMs);
+	report.Add("Transform updates", 1000, 0.5f);
+	return report;
+}
+
+static void WriteFile(const char* file, const std::string& contents)
+{
+	std::ofstream stream(file);
+	stream << contents;
+}
+
+TEST(BenchmarkReport, RoundTripsThroughJson)
+{
+	BenchmarkReport report = MakeReport(2.0f);
+
+	BenchmarkReport loaded;
+	CHECK(loaded.ReadJson(report.WriteJson()));
+	CHECK_EQUAL(2u, loaded.GetRecords().size());
+	CHECK(loaded.Find("Render queue sort", 1000) != 0);
+	CHECK_NEAR(2.0f, loaded.Find("Render queue sort", 1000)->ms, 0.0001f);
+	CHECK(loaded.Find("Render queue sort", 100) == 0);
+
+	// Regressions saved with a run aren't read back as results
+	std::vector<BenchmarkRegression> regressions;
+	BenchmarkRegression regression = { "Sky", 1, 1.0f, 3.0f };
+	regressions.push_back(regression);
+	std::string json = report.WriteJson(regressions);
+	CHECK(json.find("\"regressions\"") != std::string::npos);
+	CHECK(loaded.ReadJson(json));
+	CHECK_EQUAL(2u, loaded.GetRecords().size());
+	CHECK(loaded.Find("Sky", 1) == 0);
+
+	CHECK(!loaded.ReadJson("not a benchmark file"));
+}
+
+TEST(BenchmarkReport, ComparesAgainstTheThresholdAndMinimum)
+{
+	BenchmarkReport baseline = MakeReport(2.0f);
+
+	CHECK(MakeReport(2.1f).Compare(baseline, 0.1f).empty());
+
+	std::vector<BenchmarkRegression> regressions = MakeReport(2.5f).Compare(baseline, 0.1f);
+	CHECK_EQUAL(1u, regressions.size());
+	CHECK(regressions[0].name == "Render queue sort");
+	CHECK_NEAR(2.0f, regressions[0].baselineMs, 0.0001f);
+	CHECK_NEAR(2.5f, regressions[0].ms, 0.0001f);
+
+	// Twice as slow, but by too little to be more than noise
+	BenchmarkReport tiny;
+	tiny.Add("Render queue sort", 1000, 0.01f);
+	BenchmarkReport tinyBaseline;
+	tinyBaseline.Add("Render queue sort", 1000, 0.005f);
+	CHECK(tiny.Compare(tinyBaseline, 0.1f).empty());
+}
+
+TEST(BenchmarkReport, GivesEachOutcomeItsOwnExitCode)
+{
+	std::vector<BenchmarkRegression> regressions;
+	BenchmarkReport report = MakeReport(3.0f);
+
+	CHECK_EQUAL((int)BENCHMARK_PASSED, (int)report.SaveAndCompare(OutputFile, "", 0.1f, &regressions));
+	CHECK_EQUAL((int)BENCHMARK_BASELINE_MISSING, (int)report.SaveAndCompare(OutputFile, "no/such/baseline.json", 0.1f, &regressions));
+
+	WriteFile(BaselineFile, "not a benchmark file");
+	CHECK_EQUAL((int)BENCHMARK_BASELINE_UNREADABLE, (int)report.SaveAndCompare(OutputFile, BaselineFile, 0.1f, &regressions));
+
+	CHECK(BenchmarkReport().Save(BaselineFile));
+	CHECK_EQUAL((int)BENCHMARK_BASELINE_EMPTY, (int)report.SaveAndCompare(OutputFile, BaselineFile, 0.1f, &regressions));
+
+	CHECK(MakeReport(3.0f).Save(BaselineFile));
+	CHECK_EQUAL((int)BENCHMARK_PASSED, (int)report.SaveAndCompare(OutputFile, BaselineFile, 0.1f, &regressions));
+	CHECK(regressions.empty());
+
+	CHECK(MakeReport(1.0f).Save(BaselineFile));
+	CHECK_EQUAL((int)BENCHMARK_REGRESSED, (int)report.SaveAndCompare(OutputFile, BaselineFile, 0.1f, &regressions));
+	CHECK_EQUAL(1u, regressions.size());
+
+	// Saving fails even with a usable baseline
+	CHECK_EQUAL((int)BENCHMARK_SAVE_FAILED, (int)report.SaveAndCompare("no/such/folder/output.json", BaselineFile, 0.1f, &regressions));
+
+	std::remove(OutputFile);
+	std::remove(BaselineFile);
+}
+
+TEST(BenchmarkReport, SavesRegressionsWithTheResults)
+{
+	std::vector<BenchmarkRegression> regressions;
+	CHECK(MakeReport(1.0f).Save(BaselineFile));
+	CHECK_EQUAL((int)BENCHMARK_REGRESSED, (int)MakeReport(3.0f).SaveAndCompare(OutputFile, BaselineFile, 0.1f, &regressions));
+
+	std::ifstream stream(OutputFile);
+	std::string json((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	stream.close();
+	CHECK(json.find("\"regressions\"") != std::string::npos);
+	CHECK(json.find("\"baselineMs\": 1.0000") != std::string::npos);
+
+	// The saved run still works as the next run's baseline
+	BenchmarkReport saved;
+	CHECK(saved.Load(OutputFile));
+	CHECK_EQUAL(2u, saved.GetRecords().size());
+	CHECK_NEAR(3.0f, saved.Find("Render queue sort", 1000)->ms, 0.0001f);
+
+	std::remove(OutputFile);
+	std::remove(BaselineFile);
+}
@@ -0,0 +1,240 @@
+#include <cstring>
+#include <sstream>
+#include "TestFramework.h"
+#include "../CommandStream.h"
+
+// Opaque handles only need to be told apart, so any address will do
+static int Buffers[3];
+static int Shaders[2];
+static int Views[2];
+
+// Keeps every command it's sent, for looking at the arguments
+struct CapturingBackend : public ICommandBackend
+{
+	std::vector<Command> commands;
+	std::vector<std::vector<unsigned char>> updates;
+
+	void Execute(const Command& command)
+	{
+		commands.push_back(command);
+		const unsigned char* bytes = (const unsigned char*)command.data;
+		updates.push_back(bytes ? std::vector<unsigned char>(bytes, bytes + command.values[0]) : std::vector<unsigned char>());
+	}
+};
+
+static Command MakeCommand(CommandType type, const void* object = 0,
+	unsigned int a = 0, unsigned int b = 0, unsigned int c = 0, unsigned int d = 0)
+{
+	Command command = {};
+	command.type = type;
+	command.object = object;
+	command.values[0] = a;
+	command.values[1] = b;
+	command.values[2] = c;
+	command.values[3] = d;
+	return command;
+}
+
+// Something like a shadow pass followed by a couple of draws
+// in the main pass, with one of its state changes repeated
+static void WriteFrame(CommandStream* stream)
+{
+	Command clear = MakeCommand(COMMAND_CLEAR_RENDER_TARGET, &Views[0]);
+	clear.floats[0] = 0.4f; clear.floats[1] = 0.6f; clear.floats[2] = 0.75f; clear.floats[3] = 1.0f;
+	stream->Write(clear);
+
+	Command depth = MakeCommand(COMMAND_CLEAR_DEPTH, &Views[1]);
+	depth.floats[0] = 1.0f;
+	stream->Write(depth);
+
+	Command targets = MakeCommand(COMMAND_RENDER_TARGETS, &Views[0]);
+	targets.object2 = &Views[1];
+	stream->Write(targets);
+
+	Command viewport = MakeCommand(COMMAND_VIEWPORT);
+	viewport.floats[2] = 1280.0f; viewport.floats[3] = 720.0f; viewport.floats[5] = 1.0f;
+	stream->Write(viewport);
+
+	stream->Write(MakeCommand(COMMAND_PRIMITIVE_TOPOLOGY, 0, 4));
+	stream->Write(MakeCommand(COMMAND_VERTEX_SHADER, &Shaders[0]));
+	stream->Write(MakeCommand(COMMAND_PIXEL_SHADER, &Shaders[1]));
+	stream->Write(MakeCommand(COMMAND_VERTEX_BUFFER, &Buffers[0], 0, 48, 0));
+	stream->Write(MakeCommand(COMMAND_INDEX_BUFFER, &Buffers[1], 42, 0));
+	stream->Write(MakeCommand(COMMAND_CONSTANT_BUFFER, &Buffers[2], STAGE_VERTEX, 0, 256, 16));
+	stream->Write(MakeCommand(COMMAND_CONSTANT_BUFFER, &Buffers[2], STAGE_VERTEX, 0, 256, 16));
+	stream->Write(MakeCommand(COMMAND_SHADER_RESOURCE, &Views[0], STAGE_PIXEL, 3));
+	stream->Write(MakeCommand(COMMAND_SAMPLER, 0, STAGE_PIXEL, 0));
+
+	const unsigned char constants[64] = { 1, 2, 3 };
+	Command update = MakeCommand(COMMAND_UPDATE_BUFFER, &Buffers[2], sizeof(constants));
+	update.data = constants;
+	stream->Write(update);
+
+	Command draw = MakeCommand(COMMAND_DRAW_INDEXED, 0, 36, 6);
+	draw.baseVertex = -3;
+	stream->Write(draw);
+
+	Command instanced = MakeCommand(COMMAND_DRAW_INDEXED_INSTANCED, 0, 300000, 20, 0, 1);
+	instanced.baseVertex = 100;
+	stream->Write(instanced);
+}
+
+static void CheckSameStats(const CommandStats& expected, const CommandStats& actual)
+{
+	for (int t = 0; t < COMMAND_TYPE_COUNT; t++)
+		CHECK_EQUAL(expected.commands[t], actual.commands[t]);
+	CHECK_EQUAL(expected.redundant, actual.redundant);
+	CHECK_EQUAL(expected.draws, actual.draws);
+	CHECK_EQUAL(expected.indices, actual.indices);
+	CHECK_EQUAL(expected.instances, actual.instances);
+	CHECK_EQUAL(expected.updateBytes, actual.updateBytes);
+}
+
+TEST(CommandStream, CountsWithTheStatsBackend)
+{
+	CommandStream stream;
+	WriteFrame(&stream);
+	CHECK_EQUAL(16u, stream.GetCommandCount());
+	CHECK_EQUAL(7u, stream.GetObjectCount());
+
+	CommandStatsBackend stats;
+	CHECK(stream.Replay(&stats));
+	CHECK_EQUAL(2u, stats.GetStats().commands[COMMAND_CONSTANT_BUFFER]);
+	CHECK_EQUAL(1u, stats.GetStats().redundant);
+	CHECK_EQUAL(2u, stats.GetStats().draws);
+	CHECK_EQUAL(36u + 300000u * 20u, stats.GetStats().indices);
+	CHECK_EQUAL(21u, stats.GetStats().instances);
+	CHECK_EQUAL(64u, stats.GetStats().updateBytes);
+
+	stats.Reset();
+	CHECK_EQUAL(0u, stats.GetStats().draws);
+}
+
+TEST(CommandStream, RoundTripsThroughAFile)
+{
+	CommandStream stream;
+	WriteFrame(&stream);
+
+	std::stringstream file;
+	CHECK(stream.Save(file));
+
+	CommandStream loaded;
+	CHECK(loaded.Load(file));
+	CHECK(!loaded.HasLiveObjects());
+	CHECK_EQUAL(stream.GetCommandCount(), loaded.GetCommandCount());
+	CHECK_EQUAL(stream.GetObjectCount(), loaded.GetObjectCount());
+	CHECK_EQUAL(stream.GetByteCount(), loaded.GetByteCount());
+	CHECK_EQUAL(-1, stream.FindFirstDifference(loaded));
+
+	// Made up addresses count the same as the real ones
+	CommandStatsBackend before, after;
+	CHECK(stream.Replay(&before));
+	CHECK(loaded.Replay(&after));
+	CheckSameStats(before.GetStats(), after.GetStats());
+}
+
+TEST(CommandStream, ReadsBackEveryArgument)
+{
+	CommandStream stream;
+	WriteFrame(&stream);
+
+	CapturingBackend backend;
+	CHECK(stream.Replay(&backend));
+	CHECK_EQUAL(16, (int)backend.commands.size());
+
+	const Command& clear = backend.commands[0];
+	CHECK_EQUAL(COMMAND_CLEAR_RENDER_TARGET, clear.type);
+	CHECK(clear.object == &Views[0]);
+	CHECK_EQUAL(0.75f, clear.floats[2]);
+
+	const Command& targets = backend.commands[2];
+	CHECK(targets.object == &Views[0] && targets.object2 == &Views[1]);
+
+	const Command& constants = backend.commands[9];
+	CHECK(constants.object == &Buffers[2]);
+	CHECK_EQUAL(256u, constants.values[2]);
+	CHECK_EQUAL(16u, constants.values[3]);
+
+	CHECK(backend.commands[12].object == 0);
+	CHECK_EQUAL(64, (int)backend.updates[13].size());
+	CHECK_EQUAL(3, (int)backend.updates[13][2]);
+
+	const Command& draw = backend.commands[14];
+	CHECK_EQUAL(-3, draw.baseVertex);
+	CHECK_EQUAL(6u, draw.values[1]);
+
+	const Command& instanced = backend.commands[15];
+	CHECK_EQUAL(300000u, instanced.values[0]);
+	CHECK_EQUAL(20u, instanced.values[1]);
+	CHECK_EQUAL(1u, instanced.values[3]);
+	CHECK_EQUAL(100, instanced.baseVertex);
+}
+
+TEST(CommandStream, EmptyUpdateCanEndTheStream)
+{
+	CommandStream stream;
+	stream.Write(MakeCommand(COMMAND_UPDATE_BUFFER, &Buffers[0], 0));
+
+	CapturingBackend backend;
+	CHECK(stream.Replay(&backend));
+	CHECK_EQUAL(1, (int)backend.commands.size());
+	CHECK(backend.commands[0].data == 0);
+
+	std::stringstream file;
+	CHECK(stream.Save(file));
+	CommandStream loaded;
+	CHECK(loaded.Load(file));
+	CHECK_EQUAL(1u, loaded.GetCommandCount());
+}
+
+TEST(CommandStream, FindsTheFirstDifference)
+{
+	CommandStream a, b;
+	WriteFrame(&a);
+	WriteFrame(&b);
+	CHECK_EQUAL(-1, a.FindFirstDifference(b));
+
+	// Another object in the same place shows up as a different id
+	b.Write(MakeCommand(COMMAND_VERTEX_SHADER, &Shaders[0]));
+	a.Write(MakeCommand(COMMAND_VERTEX_SHADER, &Shaders[1]));
+	CHECK_EQUAL(16, a.FindFirstDifference(b));
+
+	// One stream being longer counts from where the other ends
+	CommandStream shorter;
+	WriteFrame(&shorter);
+	CHECK_EQUAL(16, shorter.FindFirstDifference(a));
+}
+
+TEST(CommandStream, RejectsBadFiles)
+{
+	CommandStream stream;
+	WriteFrame(&stream);
+	std::stringstream file;
+	CHECK(stream.Save(file));
+	const std::string good = file.str();
+
+	// Cut off part way through the commands
+	CommandStream loaded;
+	std::istringstream truncated(good.substr(0, good.size() - 10));
+	CHECK(!loaded.Load(truncated));
+	CHECK_EQUAL(0u, loaded.GetCommandCount());
+
+	std::string badMagic = good;
+	badMagic[0] = 'X';
+	std::istringstream magic(badMagic);
+	CHECK(!loaded.Load(magic));
+
+	std::string badVersion = good;
+	badVersion[4] = 99;
+	std::istringstream version(badVersion);
+	CHECK(!loaded.Load(version));
+
+	// A command type the stream doesn't know about
+	std::string badCommand = good;
+	badCommand[good.size() - stream.GetByteCount()] = (char)COMMAND_TYPE_COUNT;
+	std::istringstream command(badCommand);
+	CHECK(!loaded.Load(command));
+	CHECK_EQUAL(0u, loaded.GetByteCount());
+
+	CHECK(!loaded.Load(std::string("no/such/file.cmds")));
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+// --------------------------------------------------------
+// Empty versions of the source code annotations DirectXMath
+// uses, for compilers other than Visual C++
+// - Only on the include path when the system has no sal.h
+// --------------------------------------------------------
+#define _Analysis_assume_(expression)
+#define _Check_return_
+#define _In_
+#define _In_opt_
+#define _In_z_
+#define _In_range_(low, high)
+#define _In_reads_(count)
+#define _In_reads_opt_(count)
+#define _In_reads_bytes_(size)
+#define _In_reads_bytes_opt_(size)
+#define _Inout_
+#define _Inout_opt_
+#define _Inout_updates_(count)
+#define _Inout_updates_bytes_(size)
+#define _Out_
+#define _Out_opt_
+#define _Out_range_(low, high)
+#define _Out_writes_(count)
+#define _Out_writes_opt_(count)
+#define _Out_writes_all_(count)
+#define _Out_writes_bytes_(size)
+#define _Out_writes_bytes_all_(size)
+#define _Out_writes_to_(size, count)
+#define _Outptr_
+#define _Outptr_opt_
+#define _Post_
+#define _Pre_
+#define _Printf_format_string_
+#define _Ret_maybenull_
+#define _Ret_notnull_
+#define _Success_(expression)
+#define _Use_decl_annotations_
@@ -0,0 +1,248 @@
+#include <memory>
+#include "TestFramework.h"
+#include "../GpuProfiler.h"
+
+// --------------------------------------------------------
+// Backend with a made up GPU whose clock only moves when the
+// test moves it, and which finishes frames when it's told to
+// - Ticks are microseconds, so a millisecond is 1000 of them
+// --------------------------------------------------------
+class ScriptedGpuTimerBackend : public IGpuTimerBackend
+{
+public:
+	struct Slot
+	{
+		bool ready;
+		bool disjoint;
+		std::vector<unsigned long long> ticks;
+	};
+
+	ScriptedGpuTimerBackend() : clock(0), frequency(1000000) {}
+
+	void Reserve(unsigned int slotCount, unsigned int queryCount)
+	{
+		slots.resize(slotCount);
+		for (auto& slot : slots)
+			slot.ticks.resize(queryCount, 0);
+	}
+
+	void BeginFrame(unsigned int slot)
+	{
+		slots[slot].ready = false;
+		slots[slot].disjoint = false;
+	}
+
+	void EndFrame(unsigned int /*slot*/) {}
+
+	void Timestamp(unsigned int slot, unsigned int query, ID3D11DeviceContext* /*context*/)
+	{
+		slots[slot].ticks[query] = clock;
+	}
+
+	bool GetFrequency(unsigned int slot, unsigned long long* f, bool* disjoint)
+	{
+		if (!slots[slot].ready)
+			return false;
+
+		*f = frequency;
+		*disjoint = slots[slot].disjoint;
+		return true;
+	}
+
+	bool GetTimestamp(unsigned int slot, unsigned int query, unsigned long long* ticks)
+	{
+		if (!slots[slot].ready)
+			return false;
+
+		*ticks = slots[slot].ticks[query];
+		return true;
+	}
+
+	void Advance(float ms) { clock += (unsigned long long)(ms * 1000.0f); }
+	void Finish(unsigned int slot) { slots[slot].ready = true; }
+
+	std::vector<Slot> slots;
+	unsigned long long clock;
+	unsigned long long frequency;
+};
+
+// One frame where the GPU spends ms on a scope, and a
+// millisecond either side of it on the rest of the frame
+static void RunFrame(GpuProfiler* profiler, ScriptedGpuTimerBackend* backend, int scope, float ms)
+{
+	profiler->BeginFrame();
+	backend->Advance(1.0f);
+	profiler->BeginScope(scope);
+	backend->Advance(ms);
+	profiler->EndScope(scope);
+	backend->Advance(1.0f);
+	profiler->EndFrame();
+}
+
+TEST(GpuProfiler, ReadsFramesBackInOrder)
+{
+	std::shared_ptr<ScriptedGpuTimerBackend> backend = std::make_shared<ScriptedGpuTimerBackend>();
+	GpuProfiler profiler(backend, 3);
+	int scope = profiler.AddScope("Main pass");
+
+	RunFrame(&profiler, backend.get(), scope, 2.0f);
+	RunFrame(&profiler, backend.get(), scope, 4.0f);
+
+	// The second frame is done but the first isn't, so neither is read
+	backend->Finish(1);
+	RunFrame(&profiler, backend.get(), scope, 6.0f);
+	CHECK_EQUAL(0u, profiler.GetFramesRead());
+	CHECK_EQUAL(0, profiler.GetScopeStats(scope).samples);
+
+	// Once the first is done both come back, oldest first
+	backend->Finish(0);
+	profiler.BeginFrame();
+	CHECK_EQUAL(2u, profiler.GetFramesRead());
+	CHECK_EQUAL(0u, profiler.GetFramesDropped());
+
+	const GpuTimingStats& stats = profiler.GetScopeStats(scope);
+	CHECK_EQUAL(2, stats.samples);
+	CHECK_NEAR(4.0f, stats.lastMs, 0.001f);
+	CHECK_NEAR(2.0f, stats.minMs, 0.001f);
+	CHECK_NEAR(6.0f, profiler.GetScopeStats(0).lastMs, 0.001f);
+}
+
+TEST(GpuProfiler, LeavesUnfinishedFramesPending)
+{
+	std::shared_ptr<ScriptedGpuTimerBackend> backend = std::make_shared<ScriptedGpuTimerBackend>();
+	GpuProfiler profiler(backend, 3);
+	int scope = profiler.AddScope("Shadow maps");
+
+	// The GPU finishes the frames after the first one but not the
+	// first itself, which holds everything after it back without
+	// being given up on
+	RunFrame(&profiler, backend.get(), scope, 3.0f);
+	for (unsigned int slot = 1; slot < 3; slot++)
+	{
+		RunFrame(&profiler, backend.get(), scope, 1.0f);
+		backend->Finish(slot);
+		CHECK_EQUAL(0u, profiler.GetFramesRead());
+		CHECK_EQUAL(0u, profiler.GetFramesDropped());
+	}
+	CHECK_EQUAL(0, profiler.GetScopeStats(scope).samples);
+
+	backend->Finish(0);
+	profiler.BeginFrame();
+	CHECK_EQUAL(3u, profiler.GetFramesRead());
+	CHECK_EQUAL(0u, profiler.GetFramesDropped());
+	CHECK_EQUAL(3, profiler.GetScopeStats(scope).samples);
+	CHECK_NEAR(3.0f, profiler.GetScopeStats(scope).maxMs, 0.001f);
+	CHECK_NEAR(1.0f, profiler.GetScopeStats(scope).lastMs, 0.001f);
+}
+
+TEST(GpuProfiler, DropsFramesWhoseSlotIsNeededAgain)
+{
+	std::shared_ptr<ScriptedGpuTimerBackend> backend = std::make_shared<ScriptedGpuTimerBackend>();
+	GpuProfiler profiler(backend, 2);
+	int scope = profiler.AddScope("Sky");
+
+	// A GPU two frames behind, with only two slots to go round
+	RunFrame(&profiler, backend.get(), scope, 1.0f);
+	RunFrame(&profiler, backend.get(), scope, 2.0f);
+	RunFrame(&profiler, backend.get(), scope, 3.0f);
+	CHECK_EQUAL(1u, profiler.GetFramesDropped());
+
+	backend->Finish(0);
+	backend->Finish(1);
+	profiler.BeginFrame();
+
+	// The first frame never shows up, and the other two do in order
+	const GpuTimingStats& stats = profiler.GetScopeStats(scope);
+	CHECK_EQUAL(2u, profiler.GetFramesRead());
+	CHECK_EQUAL(2, stats.samples);
+	CHECK_NEAR(2.0f, stats.minMs, 0.001f);
+	CHECK_NEAR(3.0f, stats.maxMs, 0.001f);
+	CHECK_NEAR(3.0f, stats.lastMs, 0.001f);
+}
+
+TEST(GpuProfiler, ThrowsAwayDisjointFrames)
+{
+	std::shared_ptr<ScriptedGpuTimerBackend> backend = std::make_shared<ScriptedGpuTimerBackend>();
+	GpuProfiler profiler(backend, 3);
+	int scope = profiler.AddScope("ImGui");
+
+	RunFrame(&profiler, backend.get(), scope, 5.0f);
+	RunFrame(&profiler, backend.get(), scope, 7.0f);
+	backend->slots[0].disjoint = true;
+	backend->Finish(0);
+	backend->Finish(1);
+
+	profiler.BeginFrame();
+	CHECK_EQUAL(1u, profiler.GetFramesDropped());
+	CHECK_EQUAL(1u, profiler.GetFramesRead());
+	CHECK_EQUAL(1, profiler.GetScopeStats(scope).samples);
+	CHECK_NEAR(7.0f, profiler.GetScopeStats(scope).lastMs, 0.001f);
+	profiler.EndFrame();
+
+	// A frequency of zero can't be turned into times either
+	backend->frequency = 0;
+	backend->Finish(2);
+	profiler.BeginFrame();
+	CHECK_EQUAL(2u, profiler.GetFramesDropped());
+	CHECK_EQUAL(1, profiler.GetScopeStats(scope).samples);
+}
+
+TEST(GpuProfiler, OnlyTimesScopesThatRan)
+{
+	std::shared_ptr<ScriptedGpuTimerBackend> backend = std::make_shared<ScriptedGpuTimerBackend>();
+	GpuProfiler profiler(backend, 2);
+	int ran = profiler.AddScope("Main pass");
+	int skipped = profiler.AddScope("Depth pre-pass", ran);
+	CHECK_EQUAL(2, profiler.GetScopeDepth(skipped));
+
+	RunFrame(&profiler, backend.get(), ran, 2.0f);
+	backend->Finish(0);
+	profiler.BeginFrame();
+
+	CHECK_EQUAL(1, profiler.GetScopeStats(ran).samples);
+	CHECK_EQUAL(0, profiler.GetScopeStats(skipped).samples);
+	CHECK_NEAR(4.0f, profiler.GetScopeStats(0).lastMs, 0.001f);
+}
+
+TEST(GpuProfiler, KeepsStatsOverAWrappingHistory)
+{
+	GpuTimingHistory history(3);
+	history.Add(5.0f);
+	history.Add(1.0f);
+	history.Add(9.0f);
+	CHECK_NEAR(5.0f, history.GetStats().avgMs, 0.001f);
+
+	// The 5 falls out of the history, then the 1 does
+	history.Add(4.0f);
+	CHECK_EQUAL(3, history.GetStats().samples);
+	CHECK_NEAR(1.0f, history.GetStats().minMs, 0.001f);
+	CHECK_NEAR(9.0f, history.GetStats().maxMs, 0.001f);
+	CHECK_NEAR(14.0f / 3.0f, history.GetStats().avgMs, 0.001f);
+	CHECK_NEAR(4.0f, history.GetStats().lastMs, 0.001f);
+
+	history.Add(6.0f);
+	CHECK_NEAR(4.0f, history.GetStats().minMs, 0.001f);
+	CHECK_NEAR(19.0f / 3.0f, history.GetStats().avgMs, 0.001f);
+
+	history.Clear();
+	CHECK_EQUAL(0, history.GetStats().samples);
+
+	// The same through the profiler, with one frame in flight at a time
+	std::shared_ptr<ScriptedGpuTimerBackend> backend = std::make_shared<ScriptedGpuTimerBackend>();
+	GpuProfiler profiler(backend, 1, 2);
+	int scope = profiler.AddScope("Shadow map 0");
+	const float times[] = { 8.0f, 2.0f, 3.0f };
+	for (float ms : times)
+	{
+		RunFrame(&profiler, backend.get(), scope, ms);
+		backend->Finish(0);
+	}
+	profiler.BeginFrame();
+
+	const GpuTimingStats& stats = profiler.GetScopeStats(scope);
+	CHECK_EQUAL(3u, profiler.GetFramesRead());
+	CHECK_EQUAL(2, stats.samples);
+	CHECK_NEAR(2.0f, stats.minMs, 0.001f);
+	CHECK_NEAR(3.0f, stats.maxMs, 0.001f);
+	CHECK_NEAR(2.5f, stats.avgMs, 0.001f);
+}
@@ -0,0 +1,68 @@
+#include "TestFramework.h"
+#include "../LightMatrices.h"
+
+using namespace DirectX;
+
+static Light MakeLight(int type)
+{
+	Light light = {};
+	light.type = type;
+	light.direction = XMFLOAT3(0.0f, -1.0f, 1.0f);
+	light.position = XMFLOAT3(1.0f, 2.0f, 3.0f);
+	light.range = 10.0f;
+	light.spotFalloff = 1.0f;
+	light.castsShadows = 1;
+	return light;
+}
+
+// Where a point ends up in view space
+static XMFLOAT3 ToView(const XMFLOAT4X4& view, XMFLOAT3 point)
+{
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, XMVector3TransformCoord(XMLoadFloat3(&point), XMLoadFloat4x4(&view)));
+	return result;
+}
+
+TEST(LightMatrices, PointLightsHaveACubeOfFaces)
+{
+	CHECK_EQUAL(1, LightMatrices::GetShadowFaceCount(MakeLight(LIGHT_TYPE_DIRECTIONAL)));
+	CHECK_EQUAL(6, LightMatrices::GetShadowFaceCount(MakeLight(LIGHT_TYPE_POINT)));
+	CHECK_EQUAL(1, LightMatrices::GetShadowFaceCount(MakeLight(LIGHT_TYPE_SPOT)));
+}
+
+TEST(LightMatrices, EachCubeFaceLooksDownItsOwnAxis)
+{
+	Light light = MakeLight(LIGHT_TYPE_POINT);
+	const XMFLOAT3 axes[6] = {
+		XMFLOAT3(0, 0, 1), XMFLOAT3(1, 0, 0), XMFLOAT3(0, 0, -1),
+		XMFLOAT3(-1, 0, 0), XMFLOAT3(0, 1, 0), XMFLOAT3(0, -1, 0) };
+
+	for (int face = 0; face < 6; face++)
+	{
+		ShadowFaceMatrices matrices = LightMatrices::CalculateShadowFace(light, face);
+
+		// The light sits at the origin of its view, looking down +Z
+		XMFLOAT3 eye = ToView(matrices.view, light.position);
+		CHECK_NEAR(0.0f, eye.x, 1e-4f);
+		CHECK_NEAR(0.0f, eye.y, 1e-4f);
+		CHECK_NEAR(0.0f, eye.z, 1e-4f);
+
+		XMFLOAT3 ahead(light.position.x + axes[face].x, light.position.y + axes[face].y, light.position.z + axes[face].z);
+		XMFLOAT3 inView = ToView(matrices.view, ahead);
+		CHECK_NEAR(1.0f, inView.z, 1e-4f);
+	}
+}
+
+TEST(LightMatrices, CombinesViewAndProjection)
+{
+	for (int type = LIGHT_TYPE_DIRECTIONAL; type <= LIGHT_TYPE_SPOT; type++)
+	{
+		ShadowFaceMatrices matrices = LightMatrices::CalculateShadowFace(MakeLight(type), 0);
+
+		XMFLOAT4X4 expected;
+		XMStoreFloat4x4(&expected, XMLoadFloat4x4(&matrices.view) * XMLoadFloat4x4(&matrices.proj));
+		for (int r = 0; r < 4; r++)
+			for (int c = 0; c < 4; c++)
+				CHECK_NEAR(expected.m[r][c], matrices.viewProj.m[r][c], 1e-5f);
+	}
+}
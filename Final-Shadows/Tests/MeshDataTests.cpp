@@ -0,0 +1,73 @@
+#include <sstream>
+#include <string>
+#include "TestFramework.h"
+#include "../MeshData.h"
+
+// One quad and one triangle, with uvs going along +X and +Y
+static const char* Quads =
+	"# A quad and a triangle\n"
+	"v 0 0 0\n"
+	"v 1 0 0\n"
+	"v 1 1 0\n"
+	"v 0 1 0\n"
+	"vt 0 0\n"
+	"vt 1 0\n"
+	"vt 1 1\n"
+	"vt 0 1\n"
+	"vn 0 0 1\n"
+	"f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+	"f 1/1/1 2/2/1 3/3/1\n";
+
+static bool Parse(const std::string& text, MeshData* mesh, bool tinyObj)
+{
+	std::istringstream stream(text);
+	return tinyObj ? MeshImport::ParseObjWithTinyObj(stream, mesh) : MeshImport::ParseObj(stream, mesh);
+}
+
+TEST(MeshData, BothParsersSplitQuadsAndFlipToLeftHanded)
+{
+	for (int tinyObj = 0; tinyObj < 2; tinyObj++)
+	{
+		MeshData mesh;
+		CHECK(Parse(Quads, &mesh, tinyObj == 1));
+		CHECK_EQUAL((size_t)9, mesh.vertices.size());
+		CHECK_EQUAL((size_t)9, mesh.indices.size());
+		for (size_t i = 0; i < mesh.indices.size(); i++)
+			CHECK_EQUAL((unsigned int)i, mesh.indices[i]);
+
+		// Z and the uvs' Y are flipped, whichever parser reads them
+		const Vertex& first = mesh.vertices[0];
+		CHECK_NEAR(0.0f, first.position.x, 1e-6f);
+		CHECK_NEAR(1.0f, first.uv.y, 1e-6f);
+		CHECK_NEAR(-1.0f, first.normal.z, 1e-6f);
+
+		// Parsing again replaces what was there
+		CHECK(Parse(Quads, &mesh, tinyObj == 1));
+		CHECK_EQUAL((size_t)9, mesh.indices.size());
+	}
+}
+
+TEST(MeshData, FailsWithoutFaces)
+{
+	MeshData mesh;
+	CHECK(!Parse("", &mesh, false));
+	CHECK(!Parse("v 0 0 0\nvn 0 0 1\n", &mesh, false));
+	CHECK(!Parse("v 0 0 0\nvn 0 0 1\n", &mesh, true));
+	CHECK(mesh.vertices.empty());
+}
+
+TEST(MeshData, TangentsFollowTheUvsAndStayOrthogonal)
+{
+	MeshData mesh;
+	CHECK(Parse(Quads, &mesh, false));
+	MeshImport::CalculateTangents(&mesh.vertices[0], (int)mesh.vertices.size(), &mesh.indices[0], (int)mesh.indices.size());
+
+	// U runs along +X in the file, and X isn't flipped
+	for (auto& v : mesh.vertices)
+	{
+		CHECK_NEAR(1.0f, v.tangent.x, 1e-5f);
+		CHECK_NEAR(0.0f, v.tangent.y, 1e-5f);
+		CHECK_NEAR(0.0f, v.tangent.z, 1e-5f);
+		CHECK_NEAR(0.0f, v.tangent.x * v.normal.x + v.tangent.y * v.normal.y + v.tangent.z * v.normal.z, 1e-5f);
+	}
+}
@@ -0,0 +1,190 @@
+#include <sstream>
+#include <string>
+#include "TestFramework.h"
+#include "../PVS.h"
+
+using namespace DirectX;
+
+// A cube from -1 to 1 on each axis
+static MeshBVH MakeCube()
+{
+	Vertex verts[8] = {};
+	for (int i = 0; i < 8; i++)
+		verts[i].position = XMFLOAT3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f);
+
+	unsigned int indices[36] = {
+		0, 2, 1, 1, 2, 3,	4, 5, 6, 5, 7, 6,
+		0, 1, 4, 1, 5, 4,	2, 6, 3, 3, 6, 7,
+		0, 4, 2, 2, 4, 6,	1, 3, 5, 3, 7, 5 };
+
+	MeshBVH bvh;
+	bvh.Build(verts, 8, indices, 36);
+	return bvh;
+}
+
+static PVSOccluder Place(const MeshBVH& bvh, XMFLOAT3 position, XMFLOAT3 scale)
+{
+	PVSOccluder occluder = {};
+	XMStoreFloat4x4(&occluder.world,
+		XMMatrixScaling(scale.x, scale.y, scale.z) * XMMatrixTranslation(position.x, position.y, position.z));
+	occluder.bvh = &bvh;
+	return occluder;
+}
+
+// Two small boxes with a wall between them, so cells on either
+// side of the wall see different things
+static std::vector<PVSOccluder> MakeScene(const MeshBVH& cube)
+{
+	std::vector<PVSOccluder> occluders;
+	occluders.push_back(Place(cube, XMFLOAT3(-6, 0, 0), XMFLOAT3(1, 1, 1)));
+	occluders.push_back(Place(cube, XMFLOAT3(0, 0, 0), XMFLOAT3(0.5f, 6, 6)));
+	occluders.push_back(Place(cube, XMFLOAT3(6, 0, 0), XMFLOAT3(1, 1, 1)));
+	return occluders;
+}
+
+static PVSBakeSettings SmallSettings(int threadCount)
+{
+	PVSBakeSettings settings = PVS::DefaultSettings();
+	settings.margin = 2.0f;
+	settings.samplesPerCell = 2;
+	settings.raysPerSample = 32;
+	settings.raysPerEntity = 2;
+	settings.seed = 7;
+	settings.threadCount = threadCount;
+	return settings;
+}
+
+static std::string BakeToBytes(const std::vector<PVSOccluder>& occluders, int threadCount)
+{
+	PVS pvs;
+	pvs.Bake(occluders, SmallSettings(threadCount));
+
+	std::ostringstream stream;
+	CHECK(pvs.Save(stream));
+	return stream.str();
+}
+
+static bool LoadBytes(PVS* pvs, const std::string& bytes)
+{
+	std::istringstream stream(bytes);
+	return pvs->Load(stream);
+}
+
+TEST(PVS, BakesTheSameSetsOnAnyNumberOfThreads)
+{
+	MeshBVH cube = MakeCube();
+	std::vector<PVSOccluder> occluders = MakeScene(cube);
+
+	std::string single = BakeToBytes(occluders, 1);
+	std::string several = BakeToBytes(occluders, 4);
+	CHECK(single.size() > 0);
+	CHECK(single == several);
+
+	// A different seed really does change the result, so the above means something
+	PVS reseeded;
+	PVSBakeSettings settings = SmallSettings(4);
+	settings.seed = 8;
+	reseeded.Bake(occluders, settings);
+	std::ostringstream stream;
+	reseeded.Save(stream);
+	CHECK(stream.str() != single);
+}
+
+TEST(PVS, SeparatesCellsOnEitherSideOfAWall)
+{
+	MeshBVH cube = MakeCube();
+	std::vector<PVSOccluder> occluders = MakeScene(cube);
+
+	PVS pvs;
+	pvs.Bake(occluders, SmallSettings(2));
+	CHECK(pvs.IsLoaded());
+	CHECK(pvs.GetStats().uniqueSetCount > 1);
+	CHECK(pvs.FindCell(XMFLOAT3(-6, 0, 3)) != pvs.FindCell(XMFLOAT3(6, 0, 3)));
+	CHECK_EQUAL(-1, pvs.FindCell(XMFLOAT3(-100, 0, 0)));
+	CHECK_EQUAL(-1, pvs.FindCell(XMFLOAT3(1e30f, 0, 0)));
+	CHECK_EQUAL(-1, pvs.FindCell(XMFLOAT3(0, -1e30f, 0)));
+}
+
+TEST(PVS, RoundTripsThroughSaveAndLoad)
+{
+	MeshBVH cube = MakeCube();
+	std::vector<PVSOccluder> occluders = MakeScene(cube);
+
+	PVS baked;
+	baked.Bake(occluders, SmallSettings(2));
+	std::ostringstream saved;
+	CHECK(baked.Save(saved));
+
+	PVS loaded;
+	CHECK(LoadBytes(&loaded, saved.str()));
+	CHECK(loaded.Matches(occluders));
+	CHECK_EQUAL(baked.GetStats().cellCount, loaded.GetStats().cellCount);
+	CHECK_EQUAL(baked.GetStats().uniqueSetCount, loaded.GetStats().uniqueSetCount);
+	CHECK_EQUAL(baked.FindCell(XMFLOAT3(-6, 0, 3)), loaded.FindCell(XMFLOAT3(-6, 0, 3)));
+
+	std::ostringstream resaved;
+	CHECK(loaded.Save(resaved));
+	CHECK(saved.str() == resaved.str());
+
+	// Moving a static entity means the sets no longer apply
+	occluders[0] = Place(cube, XMFLOAT3(-5, 0, 0), XMFLOAT3(1, 1, 1));
+	CHECK(!loaded.Matches(occluders));
+}
+
+TEST(PVS, RejectsTruncatedFiles)
+{
+	MeshBVH cube = MakeCube();
+	std::string bytes = BakeToBytes(MakeScene(cube), 1);
+
+	for (size_t length = 0; length < bytes.size(); length++)
+	{
+		PVS pvs;
+		CHECK(!LoadBytes(&pvs, bytes.substr(0, length)));
+		CHECK(!pvs.IsLoaded());
+	}
+}
+
+TEST(PVS, RejectsCorruptFiles)
+{
+	MeshBVH cube = MakeCube();
+	std::string bytes = BakeToBytes(MakeScene(cube), 1);
+
+	// Offsets of fields in the file header
+	const size_t dimsOffset = 24;
+	const size_t setCountOffset = 44;
+	const size_t dataSizeOffset = 48;
+	const size_t firstIndexOffset = 52;
+
+	auto corrupt = [&](size_t offset, unsigned int value)
+	{
+		std::string copy = bytes;
+		copy.replace(offset, sizeof(value), (const char*)&value, sizeof(value));
+		PVS pvs;
+		return !LoadBytes(&pvs, copy) && !pvs.IsLoaded();
+	};
+
+	std::string badMagic = bytes;
+	badMagic[0] = 'X';
+	PVS pvs;
+	CHECK(!LoadBytes(&pvs, badMagic));
+
+	// Grids too big to allocate, or whose cell count would overflow
+	CHECK(corrupt(dimsOffset, 0x40000000));
+	CHECK(corrupt(dimsOffset, 0));
+	CHECK(corrupt(dimsOffset, 0xFFFFFFFF));
+	CHECK(corrupt(dimsOffset, 4096));
+
+	// Sizes that point past the end of the file
+	CHECK(corrupt(setCountOffset, 0x7FFFFFFF));
+	CHECK(corrupt(dataSizeOffset, 0xFFFFFFFF));
+
+	// A cell using a set that doesn't exist
+	std::string badIndex = bytes;
+	badIndex[firstIndexOffset] = (char)0xFF;
+	badIndex[firstIndexOffset + 1] = (char)0xFF;
+	CHECK(!LoadBytes(&pvs, badIndex));
+	CHECK(!pvs.IsLoaded());
+
+	// The untouched bytes still load
+	CHECK(LoadBytes(&pvs, bytes));
+}
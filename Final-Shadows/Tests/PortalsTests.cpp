@@ -0,0 +1,182 @@
+#include <memory>
+#include <sstream>
+#include "TestFramework.h"
+#include "../Portals.h"
+
+using namespace DirectX;
+
+// Three rooms in a row along +Z, joined by doorways in the middle of
+// the walls between them, and a fourth off to the side of the first
+static const char* Rooms =
+	"# A row of rooms\n"
+	"cell first 0 0 0 10 10 10\n"
+	"cell second 0 0 10 10 10 20\n"
+	"cell third 0 0 20 10 10 30\n"
+	"cell side 10 0 0 20 10 10\n"
+	"portal first second 4 0 10 4 3 10 6 3 10 6 0 10\n"
+	"portal second third 4 0 20 4 3 20 6 3 20 6 0 20\n"
+	"portal first side 10 0 4 10 3 4 10 3 6 10 0 6\n";
+
+// Stands in for a game entity, which is only asked for its bounds
+struct TestEntity
+{
+	BoundingSphere sphere;
+
+	TestEntity(XMFLOAT3 center, float radius) : sphere(center, radius) {}
+	BoundingSphere GetWorldBoundingSphere() { return sphere; }
+};
+
+static void LoadRooms(PortalSystem* portals)
+{
+	std::istringstream scene(Rooms);
+	CHECK(portals->Load(scene));
+}
+
+static void LookFrom(PortalSystem* portals, XMFLOAT3 eye, XMFLOAT3 direction)
+{
+	XMMATRIX view = XMMatrixLookToLH(XMLoadFloat3(&eye), XMLoadFloat3(&direction), XMVectorSet(0, 1, 0, 0));
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0f, 0.1f, 100.0f);
+	portals->FindVisibleCells(eye, view * proj);
+}
+
+TEST(Portals, LoadsCellsAndPortals)
+{
+	PortalSystem portals;
+	LoadRooms(&portals);
+
+	CHECK_EQUAL(4, (int)portals.GetCells().size());
+	CHECK_EQUAL(3, (int)portals.GetPortals().size());
+	CHECK(portals.GetCells()[1].name == "second");
+	CHECK_EQUAL(2, (int)portals.GetCells()[1].portals.size());
+	CHECK_EQUAL(0, portals.FindCell(XMFLOAT3(5, 1, 5)));
+	CHECK_EQUAL(3, portals.FindCell(XMFLOAT3(15, 1, 5)));
+	CHECK_EQUAL(-1, portals.FindCell(XMFLOAT3(-5, 1, 5)));
+}
+
+TEST(Portals, RejectsMalformedScenes)
+{
+	PortalSystem portals;
+
+	std::istringstream missingCell("cell first 0 0 0 10 10 10\nportal first nowhere 0 0 0 1 0 0 1 1 0\n");
+	CHECK(!portals.Load(missingCell));
+	CHECK(!portals.IsLoaded());
+
+	std::istringstream tooFewPoints("cell a 0 0 0 1 1 1\ncell b 1 0 0 2 1 1\nportal a b 1 0 0 1 1 0\n");
+	CHECK(!portals.Load(tooFewPoints));
+	CHECK(!portals.IsLoaded());
+
+	std::istringstream unknownItem("room a 0 0 0 1 1 1\n");
+	CHECK(!portals.Load(unknownItem));
+	CHECK(!portals.IsLoaded());
+}
+
+TEST(Portals, SeesThroughLinedUpDoorways)
+{
+	PortalSystem portals;
+	LoadRooms(&portals);
+
+	LookFrom(&portals, XMFLOAT3(5, 1.5f, 2), XMFLOAT3(0, 0, 1));
+	CHECK_EQUAL(0, portals.GetCameraCell());
+	CHECK(portals.IsCellVisible(0));
+	CHECK(portals.IsCellVisible(1));
+	CHECK(portals.IsCellVisible(2));
+	CHECK(!portals.IsCellVisible(3));
+	CHECK_EQUAL(3, portals.GetStats().cellsVisible);
+}
+
+TEST(Portals, NothingBehindTheCamera)
+{
+	PortalSystem portals;
+	LoadRooms(&portals);
+
+	LookFrom(&portals, XMFLOAT3(5, 1.5f, 8), XMFLOAT3(0, 0, -1));
+	CHECK(portals.IsCellVisible(0));
+	CHECK(!portals.IsCellVisible(1));
+	CHECK(!portals.IsCellVisible(2));
+	CHECK(!portals.IsCellVisible(3));
+	CHECK_EQUAL(1, portals.GetStats().cellsVisible);
+}
+
+TEST(Portals, DoorwayNarrowsTheView)
+{
+	PortalSystem portals;
+	LoadRooms(&portals);
+
+	// From the corner, the second doorway is in the view but can't
+	// be seen through the first
+	LookFrom(&portals, XMFLOAT3(1, 1.5f, 2), XMFLOAT3(0, 0, 1));
+	CHECK(portals.IsCellVisible(0));
+	CHECK(portals.IsCellVisible(1));
+	CHECK(!portals.IsCellVisible(2));
+	CHECK(portals.GetStats().portalsTested > portals.GetStats().portalsPassed);
+}
+
+TEST(Portals, StopsAtMaxDepth)
+{
+	PortalSystem portals;
+	LoadRooms(&portals);
+	portals.SetMaxDepth(1);
+
+	LookFrom(&portals, XMFLOAT3(5, 1.5f, 2), XMFLOAT3(0, 0, 1));
+	CHECK(portals.IsCellVisible(0));
+	CHECK(portals.IsCellVisible(1));
+	CHECK(!portals.IsCellVisible(2));
+}
+
+TEST(Portals, CameraOutsideEveryCell)
+{
+	PortalSystem portals;
+	LoadRooms(&portals);
+
+	LookFrom(&portals, XMFLOAT3(5, 1.5f, -20), XMFLOAT3(0, 0, 1));
+	CHECK_EQUAL(-1, portals.GetCameraCell());
+	CHECK_EQUAL(0, portals.GetStats().cellsVisible);
+
+	std::vector<std::shared_ptr<TestEntity>> entities;
+	entities.push_back(std::make_shared<TestEntity>(XMFLOAT3(5, 1, 25), 1.0f));
+	std::vector<int> visible = { 0 };
+	portals.FilterEntities(entities, &visible);
+	CHECK_EQUAL(1, (int)visible.size());
+}
+
+TEST(Portals, FiltersEntitiesInHiddenCells)
+{
+	PortalSystem portals;
+	LoadRooms(&portals);
+
+	std::vector<std::shared_ptr<TestEntity>> entities;
+	entities.push_back(std::make_shared<TestEntity>(XMFLOAT3(5, 1, 5), 1.0f));		// First room
+	entities.push_back(std::make_shared<TestEntity>(XMFLOAT3(5, 1, 15), 1.0f));		// Second room
+	entities.push_back(std::make_shared<TestEntity>(XMFLOAT3(5, 1, 10), 1.0f));		// In the first doorway
+	entities.push_back(std::make_shared<TestEntity>(XMFLOAT3(-20, 1, 5), 1.0f));	// Outside
+	entities.push_back(std::make_shared<TestEntity>(XMFLOAT3(15, 1, 5), 1.0f));		// Side room
+
+	// Only the first room can be seen
+	LookFrom(&portals, XMFLOAT3(5, 1.5f, 8), XMFLOAT3(0, 0, -1));
+
+	std::vector<int> visible = { 0, 1, 2, 3, 4 };
+	portals.FilterEntities(entities, &visible);
+	CHECK_EQUAL(3, (int)visible.size());
+	CHECK(visible == std::vector<int>({ 0, 2, 3 }));
+	CHECK_EQUAL(2, portals.GetStats().entitiesCulled);
+
+	// Only what was already visible is filtered, in the same order
+	visible = { 3, 1, 0 };
+	portals.FilterEntities(entities, &visible);
+	CHECK(visible == std::vector<int>({ 3, 0 }));
+}
+
+TEST(Portals, DisabledKeepsEverything)
+{
+	PortalSystem portals;
+	LoadRooms(&portals);
+	portals.SetEnabled(false);
+
+	std::vector<std::shared_ptr<TestEntity>> entities;
+	entities.push_back(std::make_shared<TestEntity>(XMFLOAT3(5, 1, 25), 1.0f));
+
+	LookFrom(&portals, XMFLOAT3(5, 1.5f, 8), XMFLOAT3(0, 0, -1));
+	std::vector<int> visible = { 0 };
+	portals.FilterEntities(entities, &visible);
+	CHECK_EQUAL(1, (int)visible.size());
+}
@@ -0,0 +1,228 @@
+#include <memory>
+#include <thread>
+#include "TestFramework.h"
+#include "../CommandStream.h"
+#include "../CommandStreamRecorder.h"
+#include "../RecordingWorkers.h"
+#include "../ShaderConstants.h"
+#include "../StateCache.h"
+
+static const int PassCount = 24;
+
+// Made up objects, which are only ever compared by address
+template<typename T> static T* Handle(size_t id)
+{
+	return reinterpret_cast<T*>(id * 16);
+}
+
+// A vertex shader's per object constants, shared by every pass
+// the way a shader's reflection is
+static ShaderReflection MakeReflection()
+{
+	ReflectedConstantBuffer cb = {};
+	cb.Name = "perObject";
+	cb.Size = 80;
+	cb.Variables.push_back({ "world", 0, 64, "float4x4", 0, {} });
+	cb.Variables.push_back({ "tint", 64, 12, "float3", 0, {} });
+
+	ShaderReflection reflection;
+	reflection.ConstantBuffers.push_back(cb);
+	return reflection;
+}
+
+// --------------------------------------------------------
+// Uploads constants the way a shader does: copied into memory
+// of their own, then sent through the state cache as an update
+// --------------------------------------------------------
+class StateCacheConstantDevice : public IConstantBufferDevice
+{
+public:
+	StateCacheConstantDevice(StateCache* states) : states(states) {}
+
+	void UpdateConstantBuffer(unsigned int index, const void* data, unsigned int size)
+	{
+		copies.UpdateConstantBuffer(index, data, size);
+		states->UpdateBuffer(Handle<ID3D11Buffer>(100 + index), copies.GetBuffer(index).data(), size);
+	}
+
+	unsigned int GetUploadCount() { return copies.GetUploadCount(); }
+
+private:
+	StateCache* states;
+	CopyingConstantBufferDevice copies;
+};
+
+// --------------------------------------------------------
+// What one pass records with, each writing to a command
+// stream of its own, like a pass with its own deferred context
+// --------------------------------------------------------
+struct TestPass
+{
+	std::shared_ptr<CommandStream> stream;
+	StateCache states;
+	ShaderConstants constants;
+	StateCacheConstantDevice device;
+
+	TestPass(const ShaderReflection& reflection)
+		:
+		stream(std::make_shared<CommandStream>()),
+		states(std::make_shared<CommandStreamRecorder>(stream)),
+		device(&states)
+	{
+		constants.Init(reflection);
+	}
+};
+
+// --------------------------------------------------------
+// Records a pass the way the renderer does, with draws that
+// differ from pass to pass in both content and length so the
+// jobs finish out of order
+// --------------------------------------------------------
+static void RecordPass(int pass, TestPass* p)
+{
+	// Every pass starts from the default state, and uploads its
+	// constants before its first draw
+	p->states.Invalidate();
+	p->constants.MarkAllDirty();
+
+	SimpleShaderVariableHandle world = p->constants.GetVariableHandle("world");
+	SimpleShaderVariableHandle tint = p->constants.GetVariableHandle("tint");
+
+	StateViewport viewport = { 0, 0, 256.0f * (1 + pass % 2), 256.0f, 0, 1 };
+	p->states.SetViewport(viewport);
+	p->states.SetPrimitiveTopology(TOPOLOGY_TRIANGLE_LIST);
+	p->states.SetVertexShader(Handle<ID3D11VertexShader>(1 + pass % 4));
+	p->states.SetPixelShader(Handle<ID3D11PixelShader>(5 + pass % 2));
+
+	int draws = 1 + (pass * 7) % 13;
+	for (int d = 0; d < draws; d++)
+	{
+		// Some draws repeat the last one's values, which shouldn't be uploaded again
+		float matrix[16] = {};
+		for (int i = 0; i < 16; i++)
+			matrix[i] = (float)(pass * 100 + (d / 2) * 10 + i);
+		float color[3] = { (float)pass, 0.5f, (float)(d / 2 % 3) };
+		p->constants.SetData(world, matrix, sizeof(matrix));
+		p->constants.SetData(tint, color, sizeof(color));
+		p->constants.UploadDirty(&p->device);
+
+		p->states.SetConstantBuffer(STAGE_VERTEX, 0, Handle<ID3D11Buffer>(100));
+		p->states.SetVertexBuffer(0, Handle<ID3D11Buffer>(10 + (pass + d / 3) % 5), 48, 0);
+		p->states.SetIndexBuffer(Handle<ID3D11Buffer>(20 + (pass + d / 3) % 5), INDEX_FORMAT_R32_UINT, 0);
+		p->states.SetShaderResource(STAGE_PIXEL, 0, Handle<ID3D11ShaderResourceView>(30 + d % 2));
+		p->states.DrawIndexed(36 * (d + 1), 0, -pass);
+	}
+
+	// Give other threads a chance to get ahead
+	if (pass % 3 == 0)
+		std::this_thread::yield();
+}
+
+static unsigned int CountDraws(const CommandStream& stream)
+{
+	CommandStatsBackend stats;
+	stream.Replay(&stats);
+	return stats.GetStats().draws;
+}
+
+TEST(RecordingWorkers, ParallelPassesReplayLikeSerialRecording)
+{
+	ShaderReflection reflection = MakeReflection();
+
+	// Every pass one after another with a single state cache
+	TestPass serial(reflection);
+	for (int p = 0; p < PassCount; p++)
+		RecordPass(p, &serial);
+	CHECK(serial.states.GetStats().elided > 0);
+	CHECK(serial.device.GetUploadCount() < CountDraws(*serial.stream));
+
+	// Each pass with its own, on whichever thread picks it up
+	// - The same passes are reused every frame, as the renderer's are
+	RecordingWorkers workers(4);
+	CHECK_EQUAL(4, workers.GetThreadCount());
+
+	std::vector<std::unique_ptr<TestPass>> passes;
+	for (int p = 0; p < PassCount; p++)
+		passes.push_back(std::unique_ptr<TestPass>(new TestPass(reflection)));
+
+	for (int frame = 0; frame < 20; frame++)
+	{
+		for (auto& pass : passes)
+		{
+			pass->stream->Clear();
+			pass->states.ResetStats();
+		}
+
+		workers.Run(PassCount, [&](int p) { RecordPass(p, passes[p].get()); });
+
+		// Played back in pass order, they make up the same frame
+		std::shared_ptr<CommandStream> combined = std::make_shared<CommandStream>();
+		CommandStreamWriter combinedWriter(combined);
+		StateCacheStats combinedStats = {};
+		for (int p = 0; p < PassCount; p++)
+		{
+			CHECK(passes[p]->stream->Replay(&combinedWriter));
+			combinedStats.issued += passes[p]->states.GetStats().issued;
+			combinedStats.elided += passes[p]->states.GetStats().elided;
+		}
+
+		CHECK_EQUAL(serial.stream->GetCommandCount(), combined->GetCommandCount());
+		CHECK_EQUAL(serial.stream->GetByteCount(), combined->GetByteCount());
+		CHECK_EQUAL(-1, serial.stream->FindFirstDifference(*combined));
+		CHECK_EQUAL(serial.states.GetStats().issued, combinedStats.issued);
+		CHECK_EQUAL(serial.states.GetStats().elided, combinedStats.elided);
+
+		CommandStatsBackend serialCommands, combinedCommands;
+		serial.stream->Replay(&serialCommands);
+		combined->Replay(&combinedCommands);
+		CHECK_EQUAL(serialCommands.GetStats().draws, combinedCommands.GetStats().draws);
+		CHECK_EQUAL(serialCommands.GetStats().updateBytes, combinedCommands.GetStats().updateBytes);
+	}
+
+	unsigned int parallelUploads = 0;
+	for (auto& pass : passes)
+		parallelUploads += pass->device.GetUploadCount();
+	CHECK_EQUAL(serial.device.GetUploadCount() * 20, parallelUploads);
+}
+
+TEST(RecordingWorkers, RunsEveryJobOnceAcrossThreads)
+{
+	RecordingWorkers workers(3);
+
+	for (int batch = 0; batch < 50; batch++)
+	{
+		int jobCount = batch % 10;
+		std::vector<int> runs(jobCount, 0);
+		std::vector<std::thread::id> threads(jobCount);
+		workers.Run(jobCount, [&](int j)
+		{
+			runs[j]++;
+			threads[j] = std::this_thread::get_id();
+		});
+
+		// Everything is done by the time Run() returns
+		for (int j = 0; j < jobCount; j++)
+		{
+			CHECK_EQUAL(1, runs[j]);
+			CHECK(threads[j] != std::thread::id());
+		}
+	}
+}
+
+TEST(RecordingWorkers, SingleThreadRunsInOrderOnTheCaller)
+{
+	RecordingWorkers workers(1);
+	CHECK_EQUAL(1, workers.GetThreadCount());
+
+	std::thread::id caller = std::this_thread::get_id();
+	std::vector<int> order;
+	workers.Run(5, [&](int j)
+	{
+		CHECK(std::this_thread::get_id() == caller);
+		order.push_back(j);
+	});
+
+	CHECK_EQUAL(5, (int)order.size());
+	for (int j = 0; j < (int)order.size(); j++)
+		CHECK_EQUAL(j, order[j]);
+}
@@ -0,0 +1,76 @@
+#include <vector>
+#include "TestFramework.h"
+#include "../RenderQueue.h"
+
+// Stand-ins for shaders, materials and meshes, which the queue
+// only tells apart by address
+static int Objects[8192];
+
+TEST(RenderQueue, SortsByShadersThenMaterialThenMeshThenDepth)
+{
+	RenderQueue queue;
+	queue.Submit(queue.MakeKey(0, &Objects[0], &Objects[1], &Objects[10], &Objects[20], 0.5f), 0);
+	queue.Submit(queue.MakeKey(0, &Objects[2], &Objects[3], &Objects[10], &Objects[20], 0.1f), 1);
+	queue.Submit(queue.MakeKey(0, &Objects[0], &Objects[1], &Objects[11], &Objects[20], 0.2f), 2);
+	queue.Submit(queue.MakeKey(0, &Objects[0], &Objects[1], &Objects[10], &Objects[20], 0.25f), 3);
+	queue.Sort();
+
+	const std::vector<RenderPacket>& packets = queue.GetPackets();
+	CHECK_EQUAL(4, (int)packets.size());
+	CHECK_EQUAL(3, packets[0].entity);
+	CHECK_EQUAL(0, packets[1].entity);
+	CHECK_EQUAL(2, packets[2].entity);
+	CHECK_EQUAL(1, packets[3].entity);
+
+	CHECK(!RenderQueue::MeshesDiffer(packets[0].key, packets[1].key));
+	CHECK(RenderQueue::MaterialsDiffer(packets[1].key, packets[2].key));
+	CHECK(!RenderQueue::ShadersDiffer(packets[1].key, packets[2].key));
+	CHECK(RenderQueue::ShadersDiffer(packets[2].key, packets[3].key));
+
+	CHECK_EQUAL(4, queue.GetStats().packets);
+	CHECK_EQUAL(2, queue.GetStats().shaderChanges);
+	CHECK_EQUAL(3, queue.GetStats().materialChanges);
+	CHECK_EQUAL(3, queue.GetStats().meshChanges);
+}
+
+TEST(RenderQueue, NeverMistakesObjectsPastTheLastIdForEachOther)
+{
+	RenderQueue queue;
+	unsigned long long first = 0, second = 0;
+	for (int m = 0; m < 4200; m++)
+	{
+		unsigned long long key = queue.MakeKey(0, &Objects[0], &Objects[1], &Objects[100 + m], &Objects[20], 0.0f);
+		if (m == 4100) first = key;
+		if (m == 4101) second = key;
+	}
+
+	// Different materials sharing a key still count as a change,
+	// as does the same material seen twice
+	CHECK(first == second);
+	CHECK(RenderQueue::MaterialsDiffer(first, second));
+	CHECK(RenderQueue::MeshesDiffer(first, second));
+	CHECK(!RenderQueue::ShadersDiffer(first, second));
+
+	// Ones given ids before running out still match themselves
+	unsigned long long early = queue.MakeKey(0, &Objects[0], &Objects[1], &Objects[100], &Objects[20], 0.0f);
+	unsigned long long earlyAgain = queue.MakeKey(0, &Objects[0], &Objects[1], &Objects[100], &Objects[20], 0.5f);
+	CHECK(!RenderQueue::MeshesDiffer(early, earlyAgain));
+	CHECK(RenderQueue::MaterialsDiffer(early, first));
+}
+
+TEST(RenderQueue, GivesIdsOutAgainAfterAReset)
+{
+	RenderQueue queue;
+	for (int m = 0; m < 5000; m++)
+		queue.MakeKey(0, &Objects[0], &Objects[1], &Objects[100 + m], &Objects[20], 0.0f);
+
+	unsigned long long full = queue.MakeKey(0, &Objects[0], &Objects[1], &Objects[6000], &Objects[20], 0.0f);
+	CHECK(RenderQueue::IsOverflow(full, RenderQueue::MaterialShift));
+
+	queue.ResetIds();
+	unsigned long long a = queue.MakeKey(0, &Objects[0], &Objects[1], &Objects[6000], &Objects[20], 0.0f);
+	unsigned long long b = queue.MakeKey(0, &Objects[0], &Objects[1], &Objects[6000], &Objects[20], 1.0f);
+	CHECK(!RenderQueue::IsOverflow(a, RenderQueue::MaterialShift));
+	CHECK(!RenderQueue::MaterialsDiffer(a, b));
+	CHECK(!RenderQueue::MeshesDiffer(a, b));
+}
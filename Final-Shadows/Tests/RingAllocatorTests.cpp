@@ -0,0 +1,135 @@
+#include "TestFramework.h"
+#include "../RingAllocator.h"
+
+TEST(RingAllocator, AlignsEveryAllocation)
+{
+	RingAllocator ring(256, 16);
+	size_t offset = 1;
+
+	CHECK(ring.Allocate(1, &offset));
+	CHECK_EQUAL(0u, offset);
+	CHECK(ring.Allocate(17, &offset));
+	CHECK_EQUAL(16u, offset);
+	CHECK(ring.Allocate(16, &offset));
+	CHECK_EQUAL(48u, offset);
+
+	CHECK_EQUAL(64u, ring.GetUsed());
+	CHECK_EQUAL(64u, ring.GetHead());
+	CHECK_EQUAL(32u, ring.Align(17));
+	CHECK_EQUAL(32u, ring.Align(32));
+}
+
+TEST(RingAllocator, WrapsAroundOnceOlderFramesRetire)
+{
+	RingAllocator ring(256, 16);
+	size_t offset;
+
+	CHECK(ring.Allocate(100, &offset));
+	CHECK_EQUAL(0u, offset);
+	ring.EndFrame(1);
+	CHECK(ring.Allocate(100, &offset));
+	CHECK_EQUAL(112u, offset);
+	ring.EndFrame(2);
+	ring.Retire(1);
+	CHECK_EQUAL(112u, ring.GetTail());
+
+	// Doesn't fit in the 32 bytes left at the end, so those are
+	// skipped and the allocation starts over at 0
+	CHECK(ring.Allocate(64, &offset));
+	CHECK_EQUAL(0u, offset);
+	CHECK_EQUAL(1u, ring.GetWrapCount());
+	CHECK_EQUAL(64u, ring.GetHead());
+	CHECK_EQUAL(112u + 32u + 64u, ring.GetUsed());
+	ring.EndFrame(3);
+
+	// The skipped bytes go with the frame that skipped them
+	ring.Retire(2);
+	CHECK_EQUAL(96u, ring.GetUsed());
+	ring.Retire(3);
+	CHECK_EQUAL(0u, ring.GetUsed());
+	CHECK_EQUAL(0u, ring.GetFramesInFlight());
+}
+
+TEST(RingAllocator, RefusesToOverwriteFramesInFlight)
+{
+	RingAllocator ring(256, 16);
+	size_t offset;
+
+	CHECK(ring.Allocate(128, &offset));
+	ring.EndFrame(1);
+	CHECK(ring.Allocate(128, &offset));
+	CHECK_EQUAL(128u, offset);
+	ring.EndFrame(2);
+
+	// Full, and a failed allocation changes nothing
+	offset = 12345;
+	CHECK(!ring.Allocate(16, &offset));
+	CHECK_EQUAL(12345u, offset);
+	CHECK_EQUAL(256u, ring.GetUsed());
+	CHECK_EQUAL(2u, ring.GetFramesInFlight());
+
+	// Retiring a fence that hasn't been reached frees nothing
+	ring.Retire(0);
+	CHECK(!ring.Allocate(16, &offset));
+
+	// Only the space of the retired frame comes back
+	ring.Retire(1);
+	CHECK(ring.Allocate(64, &offset));
+	CHECK_EQUAL(0u, offset);
+	CHECK(ring.Allocate(64, &offset));
+	CHECK_EQUAL(64u, offset);
+	CHECK(!ring.Allocate(16, &offset));
+}
+
+TEST(RingAllocator, RefusesToWrapOntoTheTail)
+{
+	RingAllocator ring(256, 16);
+	size_t offset;
+
+	CHECK(ring.Allocate(64, &offset));
+	ring.EndFrame(1);
+	CHECK(ring.Allocate(160, &offset));
+	ring.EndFrame(2);
+	ring.Retire(1);
+
+	// 32 bytes at the end and 64 at the start, but neither is enough
+	CHECK(!ring.Allocate(80, &offset));
+	CHECK_EQUAL(0u, ring.GetWrapCount());
+	CHECK_EQUAL(224u, ring.GetHead());
+	CHECK_EQUAL(160u, ring.GetUsed());
+
+	CHECK(ring.Allocate(48, &offset));
+	CHECK_EQUAL(0u, offset);
+}
+
+TEST(RingAllocator, RejectsEmptyAndOversizeRequests)
+{
+	RingAllocator ring(250, 16);
+	size_t offset;
+
+	CHECK(!ring.Allocate(0, &offset));
+	CHECK(!ring.Allocate(251, &offset));
+
+	// Fits the ring, but not once it's rounded up to the alignment
+	CHECK(!ring.Allocate(249, &offset));
+	CHECK(ring.Allocate(240, &offset));
+	CHECK_EQUAL(0u, ring.GetFramesInFlight());
+	CHECK_EQUAL(240u, ring.GetUsed());
+}
+
+TEST(RingAllocator, ResetForgetsFramesInFlight)
+{
+	RingAllocator ring(256, 16);
+	size_t offset;
+
+	CHECK(ring.Allocate(200, &offset));
+	ring.EndFrame(1);
+	ring.EndFrame(2);
+	CHECK_EQUAL(1u, ring.GetFramesInFlight());
+
+	ring.Reset();
+	CHECK_EQUAL(0u, ring.GetUsed());
+	CHECK_EQUAL(0u, ring.GetFramesInFlight());
+	CHECK(ring.Allocate(256, &offset));
+	CHECK_EQUAL(0u, offset);
+}
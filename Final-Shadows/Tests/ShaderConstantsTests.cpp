@@ -0,0 +1,146 @@
+#include <string.h>
+#include "TestFramework.h"
+#include "../ShaderConstants.h"
+
+// A per object buffer and a per frame one, as a pixel shader might have
+static ShaderReflection MakeReflection()
+{
+	ShaderReflection reflection;
+
+	ReflectedConstantBuffer perObject = {};
+	perObject.Name = "perObject";
+	perObject.Size = 208;
+	perObject.Variables.push_back({ "world", 0, 64, "float4x4", 0, {} });
+	perObject.Variables.push_back({ "lights", 64, 128, "Light", 2, {} });
+	perObject.Variables.push_back({ "tint", 192, 12, "float3", 0, {} });
+	reflection.ConstantBuffers.push_back(perObject);
+
+	ReflectedConstantBuffer perFrame = {};
+	perFrame.Name = "perFrame";
+	perFrame.Size = 16;
+	perFrame.BindIndex = 1;
+	perFrame.Variables.push_back({ "time", 0, 4, "float", 0, {} });
+	perFrame.Variables.push_back({ "frame", 4, 4, "int", 0, {} });
+	reflection.ConstantBuffers.push_back(perFrame);
+	return reflection;
+}
+
+TEST(ShaderConstants, PacksVariablesWhereReflectionPutsThem)
+{
+	ShaderConstants constants;
+	constants.Init(MakeReflection());
+	CHECK_EQUAL(2u, constants.GetBufferCount());
+	CHECK_EQUAL(1, constants.FindBuffer("perFrame"));
+	CHECK_EQUAL(-1, constants.FindBuffer("perMaterial"));
+
+	float world[16];
+	for (int i = 0; i < 16; i++)
+		world[i] = (float)i;
+	const float tint[3] = { 0.25f, 0.5f, 0.75f };
+	const int frame = 42;
+	CHECK(constants.SetData("world", world, sizeof(world)));
+	CHECK(constants.SetData(constants.GetVariableHandle("tint"), tint, sizeof(tint)));
+	CHECK(constants.SetData("frame", &frame, sizeof(frame)));
+
+	CopyingConstantBufferDevice device;
+	CHECK_EQUAL(2u, constants.UploadDirty(&device));
+	CHECK_EQUAL(2u, device.GetUploadCount());
+	CHECK_EQUAL(224u, device.GetUploadBytes());
+
+	const std::vector<unsigned char>& perObject = device.GetBuffer(0);
+	CHECK_EQUAL(208u, perObject.size());
+	CHECK(memcmp(perObject.data(), world, sizeof(world)) == 0);
+	CHECK(memcmp(perObject.data() + 192, tint, sizeof(tint)) == 0);
+
+	// Whatever wasn't set is still zero
+	for (unsigned int i = 64; i < 192; i++)
+		CHECK_EQUAL(0, (int)perObject[i]);
+
+	int uploadedFrame;
+	memcpy(&uploadedFrame, device.GetBuffer(1).data() + 4, sizeof(int));
+	CHECK_EQUAL(42, uploadedFrame);
+}
+
+TEST(ShaderConstants, RejectsUnknownAndOversizedData)
+{
+	ShaderConstants constants;
+	constants.Init(MakeReflection());
+	CopyingConstantBufferDevice device;
+	constants.UploadDirty(&device);
+
+	float data[32] = {};
+	CHECK(!constants.SetData("missing", data, 4));
+	CHECK(!constants.GetVariableHandle("missing").IsValid());
+	CHECK(!constants.SetData(constants.GetVariableHandle("missing"), data, 4));
+	CHECK(!constants.SetData("tint", data, 16));
+	CHECK(!constants.SetData("time", data, 8));
+
+	// Part of an array is fine
+	data[0] = 1.0f;
+	CHECK(constants.SetData("lights", data, 16));
+
+	CHECK(constants.IsDirty(0));
+	CHECK(!constants.IsDirty(1));
+}
+
+TEST(ShaderConstants, OnlyUploadsBuffersThatChanged)
+{
+	ShaderConstants constants;
+	constants.Init(MakeReflection());
+	CopyingConstantBufferDevice device;
+	CHECK_EQUAL(2u, constants.UploadDirty(&device));
+	CHECK_EQUAL(0u, constants.UploadDirty(&device));
+
+	// Setting what's already there changes nothing
+	float time = 0.0f;
+	CHECK(constants.SetData("time", &time, sizeof(time)));
+	CHECK_EQUAL(0u, constants.UploadDirty(&device));
+
+	time = 1.5f;
+	CHECK(constants.SetData("time", &time, sizeof(time)));
+	CHECK(!constants.IsDirty(0));
+	CHECK(constants.IsDirty(1));
+	CHECK_EQUAL(1u, constants.UploadDirty(&device));
+	CHECK_EQUAL(3u, device.GetUploadCount());
+
+	// Without comparing, every set needs another upload
+	ShaderConstants::CompareOnSet = false;
+	CHECK(constants.SetData("time", &time, sizeof(time)));
+	ShaderConstants::CompareOnSet = true;
+	CHECK_EQUAL(1u, constants.UploadDirty(&device));
+
+	constants.MarkAllDirty();
+	CHECK_EQUAL(2u, constants.UploadDirty(&device));
+	CHECK_EQUAL(6u, device.GetUploadCount());
+
+	// Uploading one buffer on its own doesn't care whether it changed
+	constants.Upload(0, &device);
+	CHECK_EQUAL(7u, device.GetUploadCount());
+}
+
+TEST(ShaderConstants, BufferHandlesNeedTheSameLayout)
+{
+	ShaderReflection reflection = MakeReflection();
+	ShaderConstants constants;
+	constants.Init(reflection);
+
+	unsigned int layout = ShaderReflection::LayoutHash(reflection.ConstantBuffers[1]);
+	CHECK_EQUAL(layout, constants.GetLayoutHash(1));
+	CHECK(!constants.GetBufferHandle(1, layout + 1).IsValid());
+	CHECK(!constants.GetBufferHandle(2, layout).IsValid());
+
+	SimpleShaderVariableHandle handle = constants.GetBufferHandle(1, layout);
+	CHECK(handle.IsValid());
+	CHECK_EQUAL(16u, handle.Size);
+
+	const unsigned char bytes[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+	CHECK(constants.SetData(handle, bytes, sizeof(bytes)));
+	CHECK(memcmp(constants.GetBufferData(1), bytes, sizeof(bytes)) == 0);
+
+	// Loading another shader's layout starts over
+	reflection.ConstantBuffers.pop_back();
+	constants.Init(reflection);
+	CHECK_EQUAL(1u, constants.GetBufferCount());
+	CHECK(constants.FindVariable("time") == 0);
+	CHECK(constants.FindVariable("world") != 0);
+}
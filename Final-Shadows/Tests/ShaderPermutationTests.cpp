@@ -0,0 +1,142 @@
+#include <set>
+#include "TestFramework.h"
+#include "../ShaderPermutation.h"
+
+TEST(ShaderPermutation, PacksFeaturesIntoTheKey)
+{
+	CHECK_EQUAL(0u, ShaderPermutation::Select(1, 0, false, false).Key);
+
+	// Lights in bits 0-1, shadow maps in 2-4, then normal and PBR maps
+	ShaderPermutation p = ShaderPermutation::Select(4, 2, true, false);
+	CHECK_EQUAL(2u | (2u << 2) | (1u << 5), p.Key);
+	CHECK_EQUAL(4, p.GetLightCount());
+	CHECK_EQUAL(2, p.GetShadowMapCount());
+	CHECK(p.HasNormalMap());
+	CHECK(!p.HasPbrMaps());
+
+	ShaderPermutation pbr = ShaderPermutation::Select(1, 0, false, true);
+	CHECK_EQUAL(1u << 6, pbr.Key);
+	CHECK(pbr.HasPbrMaps());
+	CHECK(!pbr.HasNormalMap());
+
+	CHECK_EQUAL(128u, ShaderPermutation::GetKeyCount());
+}
+
+TEST(ShaderPermutation, RoundsCountsUpToTheNextBucket)
+{
+	ShaderPermutation p = ShaderPermutation::Select(2, 7, false, false);
+	CHECK_EQUAL(2, p.GetLightCount());
+	CHECK_EQUAL(8, p.GetShadowMapCount());
+
+	CHECK_EQUAL(4, ShaderPermutation::Select(3, 0, false, false).GetLightCount());
+	CHECK_EQUAL(6, ShaderPermutation::Select(5, 0, false, false).GetLightCount());
+	CHECK_EQUAL(4, ShaderPermutation::Select(1, 3, false, false).GetShadowMapCount());
+	CHECK_EQUAL(15, ShaderPermutation::Select(1, 9, false, false).GetShadowMapCount());
+
+	// Nothing is still the smallest bucket, and too much is the biggest
+	CHECK_EQUAL(1, ShaderPermutation::Select(0, 0, false, false).GetLightCount());
+	CHECK_EQUAL(0, ShaderPermutation::Select(1, -1, false, false).GetShadowMapCount());
+	CHECK_EQUAL(6, ShaderPermutation::Select(100, 0, false, false).GetLightCount());
+	CHECK_EQUAL(15, ShaderPermutation::Select(1, 100, false, false).GetShadowMapCount());
+}
+
+TEST(ShaderPermutation, FullHasEverything)
+{
+	ShaderPermutation full = ShaderPermutation::Full();
+	CHECK(full.IsValid());
+	CHECK_EQUAL(6, full.GetLightCount());
+	CHECK_EQUAL(15, full.GetShadowMapCount());
+	CHECK(full.HasNormalMap() && full.HasPbrMaps());
+	CHECK(full == ShaderPermutation::Select(6, 15, true, true));
+	CHECK(full != ShaderPermutation::Select(6, 8, true, true));
+}
+
+TEST(ShaderPermutation, EveryValidKeyHasItsOwnFile)
+{
+	// 4 light buckets, 6 shadow map buckets and two feature bits,
+	// which is what the BuildShaderVariants target compiles
+	std::set<std::wstring> files;
+	int valid = 0;
+	for (unsigned int key = 0; key < ShaderPermutation::GetKeyCount(); key++)
+	{
+		ShaderPermutation p(key);
+		if (!p.IsValid())
+			continue;
+
+		valid++;
+		files.insert(p.GetPixelShaderFile());
+		CHECK(ShaderPermutation::Select(p.GetLightCount(), p.GetShadowMapCount(), p.HasNormalMap(), p.HasPbrMaps()) == p);
+	}
+
+	CHECK_EQUAL(4 * 6 * 2 * 2, valid);
+	CHECK_EQUAL(valid, (int)files.size());
+	CHECK(!ShaderPermutation(ShaderPermutation::GetKeyCount()).IsValid());
+	CHECK(!ShaderPermutation(7u << 2).IsValid());
+	CHECK(ShaderPermutation::Select(2, 8, true, false).GetPixelShaderFile() == L"PixelShader_L2_S8_N1_P0.cso");
+}
+
+// Stands in for a compiled shader, remembering which key it was loaded for
+struct FakeShader
+{
+	unsigned int key;
+	FakeShader(unsigned int key) : key(key) {}
+};
+
+TEST(ShaderPermutation, FallsBackToTheFullShader)
+{
+	std::shared_ptr<FakeShader> full = std::make_shared<FakeShader>(ShaderPermutation::Full().Key);
+	std::vector<unsigned int> loads;
+
+	// Only variants without PBR maps were built
+	ShaderPermutationSet<FakeShader> set(full, [&](ShaderPermutation p)
+	{
+		loads.push_back(p.Key);
+		return p.HasPbrMaps() ? std::shared_ptr<FakeShader>() : std::make_shared<FakeShader>(p.Key);
+	});
+
+	std::shared_ptr<FakeShader> shader;
+	ShaderPermutation built = ShaderPermutation::Select(2, 1, true, false);
+	CHECK(set.Get(built, &shader));
+	CHECK(shader && shader->key == built.Key);
+
+	ShaderPermutation missing = ShaderPermutation::Select(2, 1, true, true);
+	CHECK(!set.Get(missing, &shader));
+	CHECK(shader == full);
+
+	// The full shader is handed out without loading anything
+	CHECK(set.Get(ShaderPermutation::Full(), &shader));
+	CHECK(shader == full);
+
+	// As are keys that don't name a variant
+	CHECK(!set.Get(ShaderPermutation(7u << 2), &shader));
+	CHECK(shader == full);
+
+	CHECK_EQUAL(2, (int)loads.size());
+	CHECK_EQUAL(1u, set.GetLoadedCount());
+	CHECK_EQUAL(1u, set.GetMissingCount());
+}
+
+TEST(ShaderPermutation, LoadsEachVariantOnce)
+{
+	std::shared_ptr<FakeShader> full = std::make_shared<FakeShader>(ShaderPermutation::Full().Key);
+	int loads = 0;
+	ShaderPermutationSet<FakeShader> set(full, [&](ShaderPermutation p)
+	{
+		loads++;
+		return p.GetLightCount() > 2 ? std::shared_ptr<FakeShader>() : std::make_shared<FakeShader>(p.Key);
+	});
+
+	std::shared_ptr<FakeShader> first, second;
+	CHECK(set.Get(ShaderPermutation::Select(1, 0, false, false), &first));
+	CHECK(set.Get(ShaderPermutation::Select(1, 0, false, false), &second));
+	CHECK(first == second);
+
+	// A missing file is only looked for once too
+	CHECK(!set.Get(ShaderPermutation::Select(4, 0, false, false), &first));
+	CHECK(!set.Get(ShaderPermutation::Select(3, 0, false, false), &second));
+	CHECK(first == full && second == full);
+
+	CHECK_EQUAL(2, loads);
+	CHECK_EQUAL(1u, set.GetLoadedCount());
+	CHECK_EQUAL(1u, set.GetMissingCount());
+}
@@ -0,0 +1,147 @@
+#include <sstream>
+#include "TestFramework.h"
+#include "../ShaderReflection.h"
+
+// Roughly what reflecting the scene's vertex shader gives
+static ShaderReflection MakeReflection()
+{
+	const unsigned char bytecode[] = { 0x44, 0x58, 0x42, 0x43, 1, 2, 3, 4 };
+
+	ShaderReflection reflection;
+	reflection.SetBytecode(bytecode, sizeof(bytecode));
+
+	ReflectedConstantBuffer cb = {};
+	cb.Name = "perObject";
+	cb.Size = 208;
+	cb.BindIndex = 0;
+
+	ReflectedVariable world = { "world", 0, 64, "float4x4", 0, {} };
+	ReflectedVariable lights = { "lights", 64, 128, "Light", 2, {} };
+	lights.Members.push_back({ "Color", "float3", 0 });
+	lights.Members.push_back({ "Intensity", "float", 12 });
+	ReflectedVariable tint = { "tint", 192, 12, "float3", 0, {} };
+	cb.Variables.push_back(world);
+	cb.Variables.push_back(lights);
+	cb.Variables.push_back(tint);
+	reflection.ConstantBuffers.push_back(cb);
+
+	reflection.Resources.push_back({ "Albedo", 2, 0 });
+	reflection.Resources.push_back({ "BasicSampler", 3, 0 });
+	reflection.Inputs.push_back({ "POSITION", 0, 7, 3 });
+	reflection.Inputs.push_back({ "TEXCOORD", 0, 3, 3 });
+	return reflection;
+}
+
+static std::string Saved(const ShaderReflection& reflection)
+{
+	std::ostringstream file;
+	CHECK(reflection.Save(file));
+	return file.str();
+}
+
+static bool LoadFrom(const std::string& bytes, ShaderReflection* reflection)
+{
+	std::istringstream file(bytes);
+	return reflection->Load(file);
+}
+
+TEST(ShaderReflection, RoundTripsThroughAFile)
+{
+	ShaderReflection original = MakeReflection();
+	ShaderReflection loaded;
+	CHECK(LoadFrom(Saved(original), &loaded));
+
+	CHECK_EQUAL(original.BytecodeSize, loaded.BytecodeSize);
+	CHECK_EQUAL(original.BytecodeHash, loaded.BytecodeHash);
+	CHECK_EQUAL(1, (int)loaded.ConstantBuffers.size());
+	CHECK_EQUAL(2, (int)loaded.Resources.size());
+	CHECK_EQUAL(2, (int)loaded.Inputs.size());
+
+	const ReflectedVariable* lights = loaded.FindVariable("perObject", "lights");
+	CHECK(lights != 0);
+	if (lights)
+	{
+		CHECK_EQUAL(64u, lights->ByteOffset);
+		CHECK_EQUAL(2u, lights->Elements);
+		CHECK(lights->TypeName == "Light");
+		CHECK_EQUAL(2, (int)lights->Members.size());
+		CHECK(lights->Members[1].Name == "Intensity");
+		CHECK_EQUAL(12u, lights->Members[1].ByteOffset);
+	}
+
+	CHECK(loaded.Resources[1].Name == "BasicSampler");
+	CHECK(loaded.Inputs[1].SemanticName == "TEXCOORD");
+	CHECK_EQUAL(3u, loaded.Inputs[1].Mask);
+	CHECK_EQUAL(ShaderReflection::LayoutHash(original.ConstantBuffers[0]), ShaderReflection::LayoutHash(loaded.ConstantBuffers[0]));
+
+	// Writing it out again gives exactly the same bytes
+	CHECK(Saved(loaded) == Saved(original));
+}
+
+TEST(ShaderReflection, MatchesOnlyItsOwnBytecode)
+{
+	ShaderReflection reflection = MakeReflection();
+	const unsigned char same[] = { 0x44, 0x58, 0x42, 0x43, 1, 2, 3, 4 };
+	const unsigned char rebuilt[] = { 0x44, 0x58, 0x42, 0x43, 1, 2, 3, 5 };
+
+	CHECK(reflection.MatchesBytecode(same, sizeof(same)));
+	CHECK(!reflection.MatchesBytecode(rebuilt, sizeof(rebuilt)));
+	CHECK(!reflection.MatchesBytecode(same, sizeof(same) - 1));
+}
+
+TEST(ShaderReflection, RejectsTruncatedFiles)
+{
+	std::string good = Saved(MakeReflection());
+
+	// Every cut, from inside the header to the last byte, is caught
+	for (size_t length = 0; length < good.size(); length++)
+	{
+		ShaderReflection loaded = MakeReflection();
+		if (LoadFrom(good.substr(0, length), &loaded))
+		{
+			CHECK(!"Truncated file loaded");
+			break;
+		}
+
+		// Nothing is left over from before
+		CHECK(loaded.ConstantBuffers.empty());
+		CHECK_EQUAL(0u, loaded.BytecodeSize);
+	}
+}
+
+TEST(ShaderReflection, RejectsBadMagicAndVersion)
+{
+	std::string good = Saved(MakeReflection());
+	ShaderReflection loaded;
+
+	std::string badMagic = good;
+	badMagic[3] = 'X';
+	CHECK(!LoadFrom(badMagic, &loaded));
+
+	// The version follows the four byte magic
+	std::string oldVersion = good;
+	oldVersion[4] = 1;
+	CHECK(!LoadFrom(oldVersion, &loaded));
+
+	std::string newVersion = good;
+	newVersion[4] = 3;
+	CHECK(!LoadFrom(newVersion, &loaded));
+
+	CHECK(LoadFrom(good, &loaded));
+}
+
+TEST(ShaderReflection, RejectsVariablesOutsideTheirBuffer)
+{
+	ShaderReflection reflection = MakeReflection();
+	reflection.ConstantBuffers[0].Variables[2].ByteOffset = 200;
+
+	ShaderReflection loaded;
+	CHECK(!LoadFrom(Saved(reflection), &loaded));
+}
+
+TEST(ShaderReflection, ReportsMissingFiles)
+{
+	ShaderReflection loaded = MakeReflection();
+	CHECK(!loaded.Load(std::string("no/such/shader.refl")));
+	CHECK(loaded.ConstantBuffers.empty());
+}
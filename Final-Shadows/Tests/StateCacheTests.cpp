@@ -0,0 +1,215 @@
+#include <memory>
+#include "TestFramework.h"
+#include "../StateCache.h"
+
+// Made up objects, which the cache only ever compares by address
+template<typename T> static T* Handle(size_t id)
+{
+	return reinterpret_cast<T*>(id * 16);
+}
+
+struct CacheWithRecorder
+{
+	std::shared_ptr<RecordingStateBackend> recorder;
+	StateCache cache;
+
+	CacheWithRecorder() : recorder(std::make_shared<RecordingStateBackend>()), cache(recorder) {}
+	size_t CallCount() { return recorder->GetCalls().size(); }
+};
+
+TEST(StateCache, DropsRepeatsOfTheSameSlot)
+{
+	CacheWithRecorder c;
+	ID3D11Buffer* buffer = Handle<ID3D11Buffer>(1);
+
+	c.cache.SetVertexBuffer(0, buffer, 32, 0);
+	c.cache.SetVertexBuffer(0, buffer, 32, 0);
+	CHECK_EQUAL((size_t)1, c.CallCount());
+
+	// Another slot, stride or offset is a change of its own
+	c.cache.SetVertexBuffer(1, buffer, 32, 0);
+	c.cache.SetVertexBuffer(0, buffer, 16, 0);
+	c.cache.SetVertexBuffer(0, buffer, 16, 64);
+	CHECK_EQUAL((size_t)4, c.CallCount());
+
+	c.cache.SetInputLayout(Handle<ID3D11InputLayout>(2));
+	c.cache.SetInputLayout(Handle<ID3D11InputLayout>(2));
+	c.cache.SetPrimitiveTopology(TOPOLOGY_TRIANGLE_LIST);
+	c.cache.SetPrimitiveTopology(TOPOLOGY_TRIANGLE_LIST);
+	c.cache.SetIndexBuffer(buffer, INDEX_FORMAT_R32_UINT, 0);
+	c.cache.SetIndexBuffer(buffer, INDEX_FORMAT_R16_UINT, 0);
+	c.cache.SetVertexShader(Handle<ID3D11VertexShader>(3));
+	c.cache.SetVertexShader(Handle<ID3D11VertexShader>(3));
+	c.cache.SetPixelShader(Handle<ID3D11PixelShader>(4));
+	c.cache.SetPixelShader(Handle<ID3D11PixelShader>(4));
+	CHECK_EQUAL((size_t)10, c.CallCount());
+	CHECK(c.recorder->GetCalls()[7].values[0] == INDEX_FORMAT_R16_UINT);
+}
+
+TEST(StateCache, TracksEachStageSeparately)
+{
+	CacheWithRecorder c;
+	ID3D11Buffer* constants = Handle<ID3D11Buffer>(1);
+	ID3D11SamplerState* sampler = Handle<ID3D11SamplerState>(2);
+
+	c.cache.SetConstantBuffer(STAGE_VERTEX, 0, constants);
+	c.cache.SetConstantBuffer(STAGE_PIXEL, 0, constants);
+	c.cache.SetConstantBuffer(STAGE_PIXEL, 0, constants);
+	c.cache.SetSampler(STAGE_VERTEX, 3, sampler);
+	c.cache.SetSampler(STAGE_PIXEL, 3, sampler);
+	c.cache.SetSampler(STAGE_VERTEX, 3, sampler);
+	CHECK_EQUAL((size_t)4, c.CallCount());
+
+	// Binding part of a buffer isn't the same as binding all of it
+	c.cache.SetConstantBuffer(STAGE_VERTEX, 0, constants, 16, 16);
+	c.cache.SetConstantBuffer(STAGE_VERTEX, 0, constants, 16, 16);
+	c.cache.SetConstantBuffer(STAGE_VERTEX, 0, constants, 32, 16);
+	CHECK_EQUAL((size_t)6, c.CallCount());
+
+	const RecordedStateCall& last = c.recorder->GetCalls().back();
+	CHECK(last.type == RecordedStateCall::ConstantBuffer);
+	CHECK(last.stage == STAGE_VERTEX);
+	CHECK_EQUAL(32u, last.values[0]);
+}
+
+TEST(StateCache, PassesRangesOnWholeOrNotAtAll)
+{
+	CacheWithRecorder c;
+	ID3D11ShaderResourceView* srvs[3] = {
+		Handle<ID3D11ShaderResourceView>(1),
+		Handle<ID3D11ShaderResourceView>(2),
+		Handle<ID3D11ShaderResourceView>(3) };
+
+	// The recorder binds ranges a slot at a time
+	c.cache.SetShaderResources(STAGE_PIXEL, 4, 3, srvs);
+	CHECK_EQUAL((size_t)3, c.CallCount());
+	CHECK_EQUAL(1u, c.cache.GetStats().issued);
+
+	c.cache.SetShaderResources(STAGE_PIXEL, 4, 3, srvs);
+	CHECK_EQUAL((size_t)3, c.CallCount());
+	CHECK_EQUAL(1u, c.cache.GetStats().elided);
+
+	// A range remembers each of its slots
+	c.cache.SetShaderResource(STAGE_PIXEL, 5, srvs[1]);
+	CHECK_EQUAL((size_t)3, c.CallCount());
+
+	// One different slot sends the whole range again
+	srvs[1] = Handle<ID3D11ShaderResourceView>(9);
+	c.cache.SetShaderResources(STAGE_PIXEL, 4, 3, srvs);
+	CHECK_EQUAL((size_t)6, c.CallCount());
+	CHECK(c.recorder->GetCalls()[3].object == srvs[0]);
+	CHECK_EQUAL(4u, c.recorder->GetCalls()[3].slot);
+
+	ID3D11SamplerState* samplers[2] = { Handle<ID3D11SamplerState>(4), Handle<ID3D11SamplerState>(5) };
+	c.cache.SetSamplers(STAGE_PIXEL, 0, 2, samplers);
+	c.cache.SetSamplers(STAGE_PIXEL, 0, 2, samplers);
+	c.cache.SetSamplers(STAGE_VERTEX, 0, 2, samplers);
+	CHECK_EQUAL((size_t)10, c.CallCount());
+
+	// Ranges past the slots the cache tracks are always passed on
+	c.cache.SetSamplers(STAGE_PIXEL, STATE_SAMPLER_SLOTS - 1, 2, samplers);
+	c.cache.SetSamplers(STAGE_PIXEL, STATE_SAMPLER_SLOTS - 1, 2, samplers);
+	CHECK_EQUAL((size_t)14, c.CallCount());
+}
+
+TEST(StateCache, ForgetsEverythingWhenInvalidated)
+{
+	CacheWithRecorder c;
+	ID3D11Buffer* buffer = Handle<ID3D11Buffer>(1);
+	ID3D11ShaderResourceView* srv = Handle<ID3D11ShaderResourceView>(2);
+
+	c.cache.SetVertexBuffer(0, buffer, 32, 0);
+	c.cache.SetShaderResource(STAGE_PIXEL, 0, srv);
+	c.cache.Invalidate();
+	c.cache.SetVertexBuffer(0, buffer, 32, 0);
+	c.cache.SetShaderResource(STAGE_PIXEL, 0, srv);
+	CHECK_EQUAL((size_t)4, c.CallCount());
+
+	c.cache.SetVertexBuffer(0, buffer, 32, 0);
+	c.cache.SetShaderResource(STAGE_PIXEL, 0, srv);
+	CHECK_EQUAL((size_t)4, c.CallCount());
+}
+
+TEST(StateCache, PassesEverythingOnWhenDisabled)
+{
+	CacheWithRecorder c;
+	ID3D11VertexShader* shader = Handle<ID3D11VertexShader>(1);
+
+	c.cache.SetEnabled(false);
+	CHECK(!c.cache.GetEnabled());
+	for (int i = 0; i < 3; i++)
+		c.cache.SetVertexShader(shader);
+	CHECK_EQUAL((size_t)3, c.CallCount());
+	CHECK_EQUAL(3u, c.cache.GetStats().issued);
+	CHECK_EQUAL(0u, c.cache.GetStats().elided);
+
+	// Turning it back on starts from nothing known
+	c.cache.SetEnabled(true);
+	c.cache.SetVertexShader(shader);
+	c.cache.SetVertexShader(shader);
+	CHECK_EQUAL((size_t)4, c.CallCount());
+}
+
+TEST(StateCache, NeverFiltersDrawsOrUpdates)
+{
+	CacheWithRecorder c;
+	ID3D11Buffer* buffer = Handle<ID3D11Buffer>(1);
+	float data[4] = {};
+	float color[4] = {};
+	StateViewport viewport = { 0, 0, 640, 480, 0, 1 };
+
+	for (int i = 0; i < 2; i++)
+	{
+		c.cache.UpdateBuffer(buffer, data, sizeof(data));
+		c.cache.DrawIndexed(36, 0, 0);
+		c.cache.DrawIndexedInstanced(36, 4, 0, 0, 0);
+		c.cache.ClearRenderTarget(Handle<ID3D11RenderTargetView>(2), color);
+		c.cache.ClearDepth(Handle<ID3D11DepthStencilView>(3), 1.0f);
+		c.cache.SetViewport(viewport);
+		c.cache.SetRenderTargets(Handle<ID3D11RenderTargetView>(2), Handle<ID3D11DepthStencilView>(3));
+	}
+
+	CHECK_EQUAL((size_t)14, c.CallCount());
+	CHECK_EQUAL(0u, c.cache.GetStats().issued + c.cache.GetStats().elided);
+	CHECK_EQUAL(640u, c.recorder->GetCalls()[5].values[0]);
+}
+
+TEST(StateCache, CountsIssuedAndElidedChanges)
+{
+	CacheWithRecorder c;
+	ID3D11PixelShader* shaders[2] = { Handle<ID3D11PixelShader>(1), Handle<ID3D11PixelShader>(2) };
+
+	for (int i = 0; i < 10; i++)
+		c.cache.SetPixelShader(shaders[i / 4 % 2]);
+	CHECK_EQUAL(3u, c.cache.GetStats().issued);
+	CHECK_EQUAL(7u, c.cache.GetStats().elided);
+
+	StateCacheStats other = { 5, 6 };
+	c.cache.AddStats(other);
+	CHECK_EQUAL(8u, c.cache.GetStats().issued);
+	CHECK_EQUAL(13u, c.cache.GetStats().elided);
+
+	c.cache.ResetStats();
+	CHECK_EQUAL(0u, c.cache.GetStats().issued);
+	CHECK_EQUAL(0u, c.cache.GetStats().elided);
+
+	// What's bound is still known after resetting the counts
+	c.cache.SetPixelShader(shaders[0]);
+	CHECK_EQUAL(1u, c.cache.GetStats().elided);
+}
+
+TEST(StateCache, KeepsWhatsBoundWhenTheBackendChanges)
+{
+	CacheWithRecorder c;
+	ID3D11InputLayout* layout = Handle<ID3D11InputLayout>(1);
+	c.cache.SetInputLayout(layout);
+
+	std::shared_ptr<RecordingStateBackend> next = std::make_shared<RecordingStateBackend>();
+	c.cache.SetBackend(next);
+	CHECK(c.cache.GetBackend() == next);
+
+	c.cache.SetInputLayout(layout);
+	c.cache.SetInputLayout(Handle<ID3D11InputLayout>(2));
+	CHECK_EQUAL((size_t)1, c.CallCount());
+	CHECK_EQUAL((size_t)1, next->GetCalls().size());
+}
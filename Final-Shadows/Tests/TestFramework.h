@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+// --------------------------------------------------------
+// Just enough of a test runner for the parts of the renderer
+// that don't need Direct3D
+//
+// Tests register themselves with TEST(Suite, Name) and fail
+// through the CHECK macros, which report the failure and let
+// the test carry on. The runner takes a suite name, so each
+// suite can be its own CTest test
+// --------------------------------------------------------
+struct TestCase
+{
+	const char* suite;
+	const char* name;
+	void (*run)();
+};
+
+class TestRunner
+{
+public:
+	static bool Register(const char* suite, const char* name, void (*run)());
+	static void Fail(const char* file, int line, const char* expression);
+
+	// Returns the number of failed checks, or -1 if nothing matched
+	static int Run(const char* suite);
+
+private:
+	static std::vector<TestCase>& GetTests();
+	static int failures;
+};
+
+#define TEST(suite, name) \
+	static void suite##_##name(); \
+	static const bool suite##_##name##_registered = TestRunner::Register(#suite, #name, suite##_##name); \
+	static void suite##_##name()
+
+#define CHECK(expression) \
+	do { if (!(expression)) TestRunner::Fail(__FILE__, __LINE__, #expression); } while (0)
+
+#define CHECK_EQUAL(expected, actual) CHECK((expected) == (actual))
+#define CHECK_NEAR(expected, actual, tolerance) CHECK(std::fabs((expected) - (actual)) <= (tolerance))
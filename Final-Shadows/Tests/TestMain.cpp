@@ -0,0 +1,62 @@
+#include <cstdio>
+#include <cstring>
+#include "TestFramework.h"
+
+int TestRunner::failures = 0;
+
+std::vector<TestCase>& TestRunner::GetTests()
+{
+	// Tests register themselves during static initialization, in
+	// whatever order the files happen to be in, so the list is
+	// made on first use
+	static std::vector<TestCase> tests;
+	return tests;
+}
+
+bool TestRunner::Register(const char* suite, const char* name, void (*run)())
+{
+	TestCase test = { suite, name, run };
+	GetTests().push_back(test);
+	return true;
+}
+
+void TestRunner::Fail(const char* file, int line, const char* expression)
+{
+	std::printf("%s(%d): check failed: %s\n", file, line, expression);
+	failures++;
+}
+
+int TestRunner::Run(const char* suite)
+{
+	int ran = 0;
+	for (auto& test : GetTests())
+	{
+		if (suite && strcmp(suite, test.suite) != 0)
+			continue;
+
+		int failuresBefore = failures;
+		test.run();
+		ran++;
+
+		std::printf("%s %s.%s\n", failures == failuresBefore ? "[  OK  ]" : "[ FAIL ]", test.suite, test.name);
+	}
+
+	return ran > 0 ? failures : -1;
+}
+
+// --------------------------------------------------------
+// Runs every test, or just the suite named on the command line
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	const char* suite = argc > 1 ? argv[1] : 0;
+	int failures = TestRunner::Run(suite);
+	if (failures < 0)
+	{
+		std::printf("No tests in suite '%s'\n", suite ? suite : "");
+		return 1;
+	}
+
+	std::printf("%d failed check(s)\n", failures);
+	return failures == 0 ? 0 : 1;
+}
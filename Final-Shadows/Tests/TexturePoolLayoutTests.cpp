@@ -0,0 +1,94 @@
+#include "TestFramework.h"
+#include "../TexturePoolLayout.h"
+
+// DXGI_FORMAT values, which the layout only compares
+static const unsigned int FormatRGBA8 = 28;
+static const unsigned int FormatRGBA8Srgb = 29;
+
+static TexturePoolShape Shape(unsigned int width, unsigned int height, unsigned int mips, unsigned int format)
+{
+	TexturePoolShape shape = { width, height, mips, format };
+	return shape;
+}
+
+TEST(TexturePoolLayout, GivesMatchingTexturesConsecutiveSlices)
+{
+	TexturePoolLayout layout;
+	for (unsigned int i = 0; i < 5; i++)
+	{
+		TexturePoolSlot slot = layout.Add(Shape(512, 512, 10, FormatRGBA8));
+		CHECK_EQUAL(0u, slot.Array);
+		CHECK_EQUAL(i, slot.Slice);
+	}
+
+	CHECK_EQUAL(1u, layout.GetArrayCount());
+	CHECK_EQUAL(5u, layout.GetSliceCount(0));
+	CHECK(layout.GetShape(0) == Shape(512, 512, 10, FormatRGBA8));
+}
+
+TEST(TexturePoolLayout, KeepsEachShapeInItsOwnArray)
+{
+	TexturePoolLayout layout;
+	TexturePoolSlot base = layout.Add(Shape(512, 512, 10, FormatRGBA8));
+	TexturePoolSlot wider = layout.Add(Shape(1024, 512, 10, FormatRGBA8));
+	TexturePoolSlot taller = layout.Add(Shape(512, 1024, 10, FormatRGBA8));
+	TexturePoolSlot fewerMips = layout.Add(Shape(512, 512, 1, FormatRGBA8));
+	TexturePoolSlot srgb = layout.Add(Shape(512, 512, 10, FormatRGBA8Srgb));
+
+	CHECK_EQUAL(0u, base.Array);
+	CHECK_EQUAL(1u, wider.Array);
+	CHECK_EQUAL(2u, taller.Array);
+	CHECK_EQUAL(3u, fewerMips.Array);
+	CHECK_EQUAL(4u, srgb.Array);
+	CHECK_EQUAL(5u, layout.GetArrayCount());
+
+	// Coming back to a shape carries on where its array left off
+	TexturePoolSlot again = layout.Add(Shape(512, 512, 1, FormatRGBA8));
+	CHECK_EQUAL(3u, again.Array);
+	CHECK_EQUAL(1u, again.Slice);
+	CHECK_EQUAL(2u, layout.GetSliceCount(3));
+	CHECK_EQUAL(1u, layout.GetSliceCount(4));
+
+	CHECK(Shape(512, 512, 10, FormatRGBA8) != Shape(512, 512, 10, FormatRGBA8Srgb));
+}
+
+TEST(TexturePoolLayout, StartsANewArrayWhenOneIsFull)
+{
+	TexturePoolLayout layout(2);
+	CHECK_EQUAL(2u, layout.GetMaxSlices());
+
+	TexturePoolSlot first = layout.Add(Shape(256, 256, 9, FormatRGBA8));
+	TexturePoolSlot second = layout.Add(Shape(256, 256, 9, FormatRGBA8));
+	TexturePoolSlot other = layout.Add(Shape(128, 128, 8, FormatRGBA8));
+	TexturePoolSlot third = layout.Add(Shape(256, 256, 9, FormatRGBA8));
+	TexturePoolSlot fourth = layout.Add(Shape(256, 256, 9, FormatRGBA8));
+	TexturePoolSlot fifth = layout.Add(Shape(256, 256, 9, FormatRGBA8));
+
+	CHECK(first.Array == 0 && first.Slice == 0);
+	CHECK(second.Array == 0 && second.Slice == 1);
+	CHECK(other.Array == 1 && other.Slice == 0);
+
+	// Doesn't fit in the first array, so gets one of its own
+	CHECK(third.Array == 2 && third.Slice == 0);
+	CHECK(fourth.Array == 2 && fourth.Slice == 1);
+	CHECK(fifth.Array == 3 && fifth.Slice == 0);
+
+	CHECK_EQUAL(4u, layout.GetArrayCount());
+	CHECK(layout.GetShape(2) == layout.GetShape(0));
+	for (unsigned int a = 0; a < layout.GetArrayCount(); a++)
+		CHECK(layout.GetSliceCount(a) <= layout.GetMaxSlices());
+}
+
+TEST(TexturePoolLayout, HoldsAtLeastOneSlicePerArray)
+{
+	TexturePoolLayout layout(0);
+	CHECK_EQUAL(1u, layout.GetMaxSlices());
+
+	CHECK_EQUAL(0u, layout.Add(Shape(64, 64, 7, FormatRGBA8)).Array);
+	CHECK_EQUAL(1u, layout.Add(Shape(64, 64, 7, FormatRGBA8)).Array);
+
+	layout.Clear();
+	CHECK_EQUAL(0u, layout.GetArrayCount());
+	TexturePoolSlot slot = layout.Add(Shape(64, 64, 7, FormatRGBA8));
+	CHECK(slot.Array == 0 && slot.Slice == 0);
+}
@@ -0,0 +1,124 @@
+#include "TexturePool.h"
+
+TexturePool::TexturePool(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+	:
+	device(device),
+	context(context),
+	built(false)
+{
+}
+
+// --------------------------------------------------------
+// Gives a texture a slice in the pool, to be filled by Build()
+//
+// Returns false for views that aren't of a single 2D texture,
+// such as cube maps, or once the pool has been built
+// --------------------------------------------------------
+bool TexturePool::Add(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, TexturePoolSlot* slot)
+{
+	if (Find(srv, slot))
+		return true;
+	if (!srv || built)
+		return false;
+
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	srv->GetResource(resource.GetAddressOf());
+	if (FAILED(resource.As(&texture)))
+		return false;
+
+	D3D11_TEXTURE2D_DESC desc;
+	texture->GetDesc(&desc);
+	if (desc.ArraySize != 1 || desc.SampleDesc.Count != 1 || (desc.MiscFlags & D3D11_RESOURCE_MISC_TEXTURECUBE))
+		return false;
+
+	TexturePoolShape shape = { desc.Width, desc.Height, desc.MipLevels, (unsigned int)desc.Format };
+
+	PooledTexture pooled;
+	pooled.texture = texture;
+	pooled.slot = layout.Add(shape);
+	textureIndices.insert({ srv.Get(), (unsigned int)textures.size() });
+	textures.push_back(pooled);
+
+	*slot = pooled.slot;
+	return true;
+}
+
+// --------------------------------------------------------
+// Looks up the slot of a texture that was already added
+// --------------------------------------------------------
+bool TexturePool::Find(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, TexturePoolSlot* slot)
+{
+	auto found = textureIndices.find(srv.Get());
+	if (found == textureIndices.end())
+		return false;
+
+	*slot = textures[found->second].slot;
+	return true;
+}
+
+// --------------------------------------------------------
+// Creates each array and copies every texture into its slice
+// - The original textures are let go of afterwards, so they're
+//   freed once nothing else holds on to them
+// --------------------------------------------------------
+bool TexturePool::Build()
+{
+	if (built)
+		return true;
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D11Texture2D>> arrayTextures(layout.GetArrayCount());
+	arrays.resize(layout.GetArrayCount());
+	for (unsigned int i = 0; i < layout.GetArrayCount(); i++)
+	{
+		const TexturePoolShape& shape = layout.GetShape(i);
+
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = shape.Width;
+		desc.Height = shape.Height;
+		desc.MipLevels = shape.MipLevels;
+		desc.ArraySize = layout.GetSliceCount(i);
+		desc.Format = (DXGI_FORMAT)shape.Format;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		if (FAILED(device->CreateTexture2D(&desc, 0, arrayTextures[i].GetAddressOf())))
+			return false;
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = desc.Format;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MostDetailedMip = 0;
+		srvDesc.Texture2DArray.MipLevels = desc.MipLevels;
+		srvDesc.Texture2DArray.FirstArraySlice = 0;
+		srvDesc.Texture2DArray.ArraySize = desc.ArraySize;
+		if (FAILED(device->CreateShaderResourceView(arrayTextures[i].Get(), &srvDesc, arrays[i].GetAddressOf())))
+			return false;
+	}
+
+	for (auto& pooled : textures)
+	{
+		unsigned int mipLevels = layout.GetShape(pooled.slot.Array).MipLevels;
+		for (unsigned int mip = 0; mip < mipLevels; mip++)
+		{
+			context->CopySubresourceRegion(
+				arrayTextures[pooled.slot.Array].Get(),
+				D3D11CalcSubresource(mip, pooled.slot.Slice, mipLevels),
+				0, 0, 0,
+				pooled.texture.Get(),
+				D3D11CalcSubresource(mip, 0, mipLevels),
+				0);
+		}
+		pooled.texture.Reset();
+	}
+
+	built = true;
+	return true;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TexturePool::GetArray(unsigned int array)
+{
+	return array < arrays.size() ? arrays[array] : 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <unordered_map>
+#include <vector>
+#include "TexturePoolLayout.h"
+
+// --------------------------------------------------------
+// Packs textures of the same size and format into the slices
+// of shared Texture2DArrays
+//
+// Textures are added one at a time while loading, then Build()
+// creates the arrays and copies every mip of each texture into
+// its slice. After that a texture is drawn from by binding its
+// array and picking the slice in the shader, so anything using
+// textures from the same arrays binds the same views.
+//
+// Adding the same view twice gives back the same slot, so
+// textures shared between materials are only stored once
+// --------------------------------------------------------
+class TexturePool
+{
+public:
+	TexturePool(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	bool Add(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, TexturePoolSlot* slot);
+	bool Find(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, TexturePoolSlot* slot);
+	bool Build();
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetArray(unsigned int array);
+	unsigned int GetArrayCount() { return layout.GetArrayCount(); }
+	unsigned int GetTextureCount() { return (unsigned int)textures.size(); }
+	bool IsBuilt() { return built; }
+
+private:
+	// A texture waiting to be copied into its slice
+	struct PooledTexture
+	{
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+		TexturePoolSlot slot;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	TexturePoolLayout layout;
+	std::vector<PooledTexture> textures;
+	std::unordered_map<ID3D11ShaderResourceView*, unsigned int> textureIndices;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> arrays;
+	bool built;
+};
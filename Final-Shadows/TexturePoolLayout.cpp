@@ -0,0 +1,36 @@
+#include "TexturePoolLayout.h"
+
+// --------------------------------------------------------
+// maxSlices - The most textures one array can hold, at least 1
+// --------------------------------------------------------
+TexturePoolLayout::TexturePoolLayout(unsigned int maxSlices)
+	:
+	maxSlices(maxSlices > 0 ? maxSlices : 1)
+{
+}
+
+// --------------------------------------------------------
+// Finds a slice for one more texture of the given shape
+// --------------------------------------------------------
+TexturePoolSlot TexturePoolLayout::Add(const TexturePoolShape& shape)
+{
+	TexturePoolSlot slot = {};
+	for (unsigned int i = 0; i < arrays.size(); i++)
+	{
+		if (arrays[i].shape == shape && arrays[i].slices < maxSlices)
+		{
+			slot.Array = i;
+			slot.Slice = arrays[i].slices++;
+			return slot;
+		}
+	}
+
+	PoolArray array = {};
+	array.shape = shape;
+	array.slices = 1;
+	arrays.push_back(array);
+
+	slot.Array = (unsigned int)arrays.size() - 1;
+	slot.Slice = 0;
+	return slot;
+}
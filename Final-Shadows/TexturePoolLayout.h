@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+
+// --------------------------------------------------------
+// The size and format of one texture, which has to match
+// exactly for textures to share an array
+// --------------------------------------------------------
+struct TexturePoolShape
+{
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int MipLevels;
+	unsigned int Format;	// A DXGI_FORMAT
+
+	bool operator==(const TexturePoolShape& other) const
+	{
+		return Width == other.Width && Height == other.Height && MipLevels == other.MipLevels && Format == other.Format;
+	}
+	bool operator!=(const TexturePoolShape& other) const { return !(*this == other); }
+};
+
+// --------------------------------------------------------
+// Where one texture ended up: an array, and a slice of it
+// --------------------------------------------------------
+struct TexturePoolSlot
+{
+	unsigned int Array;
+	unsigned int Slice;
+};
+
+// --------------------------------------------------------
+// Decides which textures share a texture array, and which
+// slice each one gets
+//
+// Textures go into the first array with the same shape that
+// still has room, and start a new array otherwise, so the
+// order they're added in is the order of their slices. Arrays
+// are capped at a number of slices, which defaults to the most
+// Direct3D 11 allows.
+//
+// This is plain bookkeeping with no graphics API calls, so it
+// can be exercised on its own
+// --------------------------------------------------------
+class TexturePoolLayout
+{
+public:
+	TexturePoolLayout(unsigned int maxSlices = 2048);
+
+	TexturePoolSlot Add(const TexturePoolShape& shape);
+	void Clear() { arrays.clear(); }
+
+	unsigned int GetArrayCount() { return (unsigned int)arrays.size(); }
+	const TexturePoolShape& GetShape(unsigned int array) { return arrays[array].shape; }
+	unsigned int GetSliceCount(unsigned int array) { return arrays[array].slices; }
+	unsigned int GetMaxSlices() { return maxSlices; }
+
+private:
+	struct PoolArray
+	{
+		TexturePoolShape shape;
+		unsigned int slices;
+	};
+
+	unsigned int maxSlices;
+	std::vector<PoolArray> arrays;
+};
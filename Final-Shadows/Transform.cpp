@@ -2,6 +2,8 @@
 #include "Transform.h"
 using namespace DirectX;
 
+unsigned int Transform::nextVersion = 0;
+
 Transform::Transform()
 	: Transform(
 		XMFLOAT3(0.0f, 0.0f, 0.0f),
@@ -16,7 +18,8 @@ Transform::Transform(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 scale, Direct
 	position(position),
 	scale(scale),
 	transformChanged(true),
-	rotationChanged(true)
+	rotationChanged(true),
+	version(0)
 {
 	XMStoreFloat4x4(&worldMatrix, XMMatrixIdentity());
 	XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixIdentity());
@@ -262,6 +265,17 @@ DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
 	return worldInverseTransposeMatrix;
 }
 
+// ------------------------------------------------------------------
+// Identifies the current world matrix, so systems caching results
+// based on it can tell when they're out of date
+// ------------------------------------------------------------------
+unsigned int Transform::GetVersion()
+{
+	UpdateWorldMatrix();
+
+	return version;
+}
+
 // ------------------------------------------------------------------
 // Update Class Fields When Transform Has Been Changed
 // ------------------------------------------------------------------
@@ -281,6 +295,7 @@ void Transform::UpdateWorldMatrix()
 		XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixInverse(nullptr, XMMatrixTranspose(world)));
 
 		transformChanged = false;
+		version = ++nextVersion;
 	}
 }
 
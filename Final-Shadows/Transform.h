@@ -32,6 +32,7 @@ public:
 	void UpdateWorldMatrix();
 	DirectX::XMFLOAT4X4 GetWorldMatrix();
 	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix();
+	unsigned int GetVersion();
 
 
 	void MoveAbsolute(float x, float y, float z);
@@ -62,5 +63,10 @@ private:
 
 	bool transformChanged;
 	bool rotationChanged;
+
+	// Changes every time the world matrix is rebuilt, and is unique
+	// across all transforms so copies can't be confused with each other
+	unsigned int version;
+	static unsigned int nextVersion;
 };
 
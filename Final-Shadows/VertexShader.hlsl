@@ -1,13 +1,17 @@
 #include "ShaderIncludes.hlsli"
 
-cbuffer ExternalData : register(b0)
+// Constant buffers are split by how often they change, so data
+// that's the same for a whole frame isn't uploaded with every draw
+cbuffer PerFrame : register(b0)
 {
-	matrix world;
-	matrix worldInvTranspose;
 	matrix view;
 	matrix proj;
-	matrix lightViews[MAX_NUM_SHADOW_MAPS];
-	matrix lightProjs[MAX_NUM_SHADOW_MAPS];
+}
+
+cbuffer PerObject : register(b1)
+{
+	matrix world;
+	matrix worldInvTranspose;
 }
 
 // --------------------------------------------------------
@@ -30,16 +34,7 @@ VertexToPixel main( VertexShaderInput input )
 	// - Each of these components is then automatically divided by the W component, 
 	//   which we're leaving at 1.0 for now (this is more useful when dealing with 
 	//   a perspective projection matrix, which we'll get to in the future).
-	matrix wvp = mul(proj, mul(view, world));
-	output.screenPosition = mul(wvp, float4(input.localPosition, 1.0f));
-	
-	// Do an additional position calculation for each Shadow Map being used
-	// using the view and projection matrices specific to the light casting this shadow
-	for (int i = 0; i < MAX_NUM_SHADOW_MAPS; i++)
-	{
-		matrix lightWvp = mul(lightProjs[i], mul(lightViews[i], world));
-		output.shadowPositions[i] = mul(lightWvp, float4(input.localPosition, 1.0f));
-	}
+	output.screenPosition = ProjectToScreen(world, view, proj, input.localPosition);
 
 	// Pass the uv value through 
 	// - The values will be interpolated per-pixel by the rasterizer